@@ -34,6 +34,11 @@ option(
 option(WITH_LOGGING_TIMING_DATA
        "Build with logging all Add and Erase Segment calls." OFF)
 
+# Turn this option on to have --benchmark runs count allocations per frame.
+# This replaces the global operator new, so leave it off for normal builds.
+option(WITH_BENCHMARK_ALLOCATION_COUNT
+       "Build with a counting operator new for benchmark reports." OFF)
+
 if(NOT MSVC)
   # Change this number to utilize a different number of jobs for building
   # FFMPEG.
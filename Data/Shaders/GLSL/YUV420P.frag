@@ -0,0 +1,60 @@
+uniform sampler2D Texture1;
+uniform int TextureWidth;
+uniform int TextureHeight;
+
+/*
+ * Convert from planar YUV 4:2:0 to RGB.
+ *
+ * This is used by MovieTexture_Generic.  Each texel holds four samples.  Each
+ * group of three rows holds two rows of Y, followed by one row of U and V for
+ * both, interleaved.  The output is four times as wide as the input, and two
+ * thirds as tall, and texels are aligned, so we can find the samples for each
+ * fragment exactly.
+ */
+float Sample( vec4 texel, float fIndex )
+{
+	if( fIndex < 0.5 )
+		return texel.r;
+	if( fIndex < 1.5 )
+		return texel.g;
+	if( fIndex < 2.5 )
+		return texel.b;
+	return texel.a;
+}
+
+void main(void)
+{
+	vec2 fRealSize = vec2( float(TextureWidth), float(TextureHeight) );
+
+	/* The coordinates of this fragment in the destination image. */
+	float fX = floor( gl_TexCoord[0].x * fRealSize.x * 4.0 );
+	float fY = floor( gl_TexCoord[0].y * fRealSize.y / 1.5 );
+
+	float fGroup = floor( fY / 2.0 );
+	float fLumaRow = fGroup * 3.0 + mod( fY, 2.0 );
+	float fChromaRow = fGroup * 3.0 + 2.0;
+	float fChromaX = floor( fX / 2.0 );
+
+	/* Sample texel centers. */
+	vec4 luma = texture2D( Texture1, vec2(floor(fX / 4.0) + 0.5, fLumaRow + 0.5) / fRealSize );
+	vec4 chroma = texture2D( Texture1, vec2(floor(fChromaX / 2.0) + 0.5, fChromaRow + 0.5) / fRealSize );
+
+	vec3 yuv;
+	yuv.x = Sample( luma, mod(fX, 4.0) );
+	if( mod(fChromaX, 2.0) < 0.5 )
+		yuv.yz = chroma.rg;
+	else
+		yuv.yz = chroma.ba;
+	yuv -= vec3(16.0/255.0, 128.0/255.0, 128.0/255.0);
+
+	mat3 conv = mat3(
+		// Y     U (Cb)    V (Cr)
+		1.1643,  0.000,    1.5958,  // R
+		1.1643, -0.39173, -0.81290, // G
+		1.1643,  2.017,    0.000);  // B
+
+	gl_FragColor.r=dot(yuv,conv[0]);
+	gl_FragColor.g=dot(yuv,conv[1]);
+	gl_FragColor.b=dot(yuv,conv[2]);
+	gl_FragColor.a = 1.0;
+}
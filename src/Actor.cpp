@@ -13,6 +13,7 @@
 #include "LightsManager.h" // for NUM_CabinetLight
 #include "ActorUtil.h"
 #include "Preference.h"
+#include "FrameProfiler.h"
 
 #include <cmath>
 #include <cstddef>
@@ -1335,6 +1336,8 @@ void Actor::AddRotationR( float rot )
 
 void Actor::RunCommands( const LuaReference& cmds, const LuaReference *pParamTable )
 {
+	PROFILE_SCOPE( "Lua command" );
+
 	if( !cmds.IsSet() || cmds.IsNil() )
 	{
 		LuaHelpers::ReportScriptErrorFmt("RunCommands: commands for %s are unset or nil", GetLineage().c_str());
@@ -255,6 +255,13 @@ public:
 	 * aborted actors.
 	 * @return false, as by default Actors shouldn't be aborted on drawing. */
 	virtual bool EarlyAbortDraw() const { return false; }
+	/**
+	 * @brief Can this Actor be drawn into an open quad batch?
+	 *
+	 * That is, it only draws textured quads, sets no render state but its
+	 * own, and doesn't touch the camera or the Z buffer.
+	 * @return false by default. */
+	virtual bool CanDrawBatched() const { return false; }
 	/** @brief Calculate values that may be needed  for drawing. */
 	virtual void PreDraw();
 	/** @brief Reset internal diffuse and glow. */
@@ -11,6 +11,7 @@
 #include "ScreenDimensions.h"
 
 #include <cstdint>
+#include <typeinfo>
 #include <vector>
 
 /* Tricky: We need ActorFrames created in Lua to auto delete their children.
@@ -220,6 +221,21 @@ void ActorFrame::BeginDraw()
 }
 
 
+bool ActorFrame::CanDrawBatched() const
+{
+	// Lots of classes derived from ActorFrame draw things of their own.
+	if( typeid(*this) != typeid(ActorFrame) && typeid(*this) != typeid(ActorFrameAutoDeleteChildren) )
+		return false;
+	if( m_FakeParent != nullptr || !m_WrapperStates.empty() || !m_DrawFunction.IsNil() || m_fFOV != -1 || m_bOverrideLighting )
+		return false;
+	for( Actor *pActor : m_SubActors )
+	{
+		if( !pActor->CanDrawBatched() )
+			return false;
+	}
+	return true;
+}
+
 void ActorFrame::DrawPrimitives()
 {
 	if( m_bClearZBuffer )
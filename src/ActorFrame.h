@@ -69,6 +69,7 @@ public:
 	virtual void UpdateInternal( float fDeltaTime );
 	virtual void BeginDraw();
 	virtual void DrawPrimitives();
+	virtual bool CanDrawBatched() const;
 	virtual void EndDraw();
 
 	// propagated commands
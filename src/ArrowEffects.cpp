@@ -12,6 +12,7 @@
 #include "GameState.h"
 #include "Style.h"
 #include "ThemeMetric.h"
+#include "FrameProfiler.h"
 
 #include <cfloat>
 #include <cmath>
@@ -125,6 +126,9 @@ namespace
 		float m_fBeatFactor[3];
 		float m_fExpandSeconds;
 		float m_fTanExpandSeconds;
+		// Each column's notes are mostly positioned in order, so time
+		// spacing's lookups can pick up from the column's last one.
+		TimingData::LookupCursor m_TimeSpacingCursor[MAX_COLS_PER_PLAYER];
 
 		// m_prev_style is for checking whether ArrowEffects::Init needs to be
 		// called.  Finding all the placed ArrowEffects is used and making sure
@@ -176,10 +180,9 @@ static float CalculateTornadoOffsetFromMagnitude(int dimension, int col_id,
 	return (adjusted_pixel_offset - real_pixel_offset) * magnitude;
 }
 
-static float CalculateDrunkAngle(float speed, int col, float offset,
+static float CalculateDrunkAngle(float time, float speed, int col, float offset,
 	float col_frequency, float y_offset, float period, float offset_frequency)
 {
-	float time = ArrowEffects::GetTime();
 	return time * (1+speed) + col*( (offset*col_frequency) + col_frequency)
 		+ y_offset * ( (period*offset_frequency) + offset_frequency) / SCREEN_HEIGHT;
 }
@@ -315,6 +318,7 @@ void ArrowEffects::Init(PlayerNumber pn)
 
 void ArrowEffects::Update()
 {
+	PROFILE_SCOPE( "ArrowEffects update" );
 	static float fLastTime = 0;
 	float fTime = RageTimer::GetTimeSinceStartFast();
 
@@ -459,59 +463,127 @@ static float GetDisplayedBeat( const PlayerState* pPlayerState, float beat )
 	return beat;
 }
 
+namespace
+{
+	// The parts of GetYOffset that are the same for every note.
+	struct YOffsetArgs
+	{
+		const SongPosition *position;
+		const TimingData *timing;
+		bool beat_spacing;
+		bool time_spacing;
+		bool step_editor;
+		float song_displayed_beat;
+		float displayed_speed_percent;
+		float song_seconds;
+		float scroll_bps;
+		float arrow_spacing;
+		float scroll_speed;
+		float expand_scale;
+		float tan_expand_scale;
+	};
+}
+
+static void PrepareYOffset( const PlayerState* pPlayerState, YOffsetArgs &args )
+{
+	args.position = &pPlayerState->GetDisplayedPosition();
+	args.timing = GAMESTATE->m_pCurSteps[pPlayerState->m_PlayerNumber]->GetTimingData();
+	args.beat_spacing = curr_options->m_fTimeSpacing != 1.0f;
+	args.time_spacing = curr_options->m_fTimeSpacing != 0.0f;
+	args.step_editor = GAMESTATE->m_bInStepEditor;
+
+	const float fSongBeat = args.position->m_fSongBeatVisible;
+	if( args.beat_spacing && !args.step_editor )
+	{
+		args.song_displayed_beat = GetDisplayedBeat( pPlayerState, fSongBeat );
+		args.displayed_speed_percent = args.timing->GetDisplayedSpeedPercent(
+			args.position->m_fSongBeatVisible, args.position->m_fMusicSecondsVisible );
+	}
+	if( args.time_spacing )
+	{
+		args.song_seconds = pPlayerState->m_Position.m_fMusicSecondsVisible;
+		float fBPM = curr_options->m_fScrollBPM;
+		args.scroll_bps = fBPM/60.f / GAMESTATE->m_SongOptions.GetCurrent().m_fMusicRate;
+	}
+
+	// TODO: If we allow noteskins to have metricable row spacing
+	// (per issue 24), edit this to reflect that. -aj
+	args.arrow_spacing = ARROW_SPACING;
+
+	// Factor in scroll speed
+	args.scroll_speed = curr_options->m_fScrollSpeed;
+	if(curr_options->m_fMaxScrollBPM != 0)
+	{
+		args.scroll_speed= curr_options->m_fMaxScrollBPM /
+			(pPlayerState->m_fReadBPM * GAMESTATE->m_SongOptions.GetCurrent().m_fMusicRate);
+	}
+
+	const float* fAccels = curr_options->m_fAccels;
+	// TODO: Don't index by PlayerNumber.
+	const PerPlayerData &data = g_EffectData[pPlayerState->m_PlayerNumber];
+	if( fAccels[PlayerOptions::ACCEL_EXPAND] != 0 )
+	{
+		float fExpandMultiplier = SCALE( RageFastCos(data.m_fExpandSeconds*EXPAND_MULTIPLIER_FREQUENCY*(fAccels[PlayerOptions::ACCEL_EXPAND_PERIOD]+1)),
+						EXPAND_MULTIPLIER_SCALE_FROM_LOW, EXPAND_MULTIPLIER_SCALE_FROM_HIGH,
+						EXPAND_MULTIPLIER_SCALE_TO_LOW, EXPAND_MULTIPLIER_SCALE_TO_HIGH );
+		args.expand_scale = SCALE( fAccels[PlayerOptions::ACCEL_EXPAND],
+				      EXPAND_SPEED_SCALE_FROM_LOW, EXPAND_SPEED_SCALE_FROM_HIGH,
+				      EXPAND_SPEED_SCALE_TO_LOW, fExpandMultiplier );
+	}
+	if( fAccels[PlayerOptions::ACCEL_TAN_EXPAND] != 0 )
+	{
+		float fTanExpandMultiplier = SCALE( SelectTanType(data.m_fTanExpandSeconds*EXPAND_MULTIPLIER_FREQUENCY*(fAccels[PlayerOptions::ACCEL_TAN_EXPAND_PERIOD]+1), curr_options->m_bCosecant),
+						EXPAND_MULTIPLIER_SCALE_FROM_LOW, EXPAND_MULTIPLIER_SCALE_FROM_HIGH,
+						EXPAND_MULTIPLIER_SCALE_TO_LOW, EXPAND_MULTIPLIER_SCALE_TO_HIGH );
+		args.tan_expand_scale = SCALE( fAccels[PlayerOptions::ACCEL_TAN_EXPAND],
+				      EXPAND_SPEED_SCALE_FROM_LOW, EXPAND_SPEED_SCALE_FROM_HIGH,
+				      EXPAND_SPEED_SCALE_TO_LOW, fTanExpandMultiplier );
+	}
+}
+
 /* For visibility testing: if bAbsolute is false, random modifiers must return
  * the minimum possible scroll speed. */
-float ArrowEffects::GetYOffset( const PlayerState* pPlayerState, int iCol, float fNoteBeat, float &fPeakYOffsetOut, bool &bIsPastPeakOut, bool bAbsolute )
+// The note's time, for time spacing, from the column's cursor.
+static float GetNoteSeconds( const YOffsetArgs &args, const PlayerState* pPlayerState, int iCol, float fNoteBeat )
+{
+	if( iCol >= 0 && iCol < MAX_COLS_PER_PLAYER )
+		return args.timing->GetElapsedTimeFromBeat( fNoteBeat, g_EffectData[pPlayerState->m_PlayerNumber].m_TimeSpacingCursor[iCol] );
+	return args.timing->GetElapsedTimeFromBeat( fNoteBeat );
+}
+
+// fNoteSeconds is only used with time spacing.
+static float GetYOffsetFromArgs( const YOffsetArgs &args, const PlayerState* pPlayerState, int iCol, float fNoteBeat, float fNoteSeconds, float &fPeakYOffsetOut, bool &bIsPastPeakOut, bool bAbsolute )
 {
 	// Default values that are returned if boomerang is off.
 	fPeakYOffsetOut = FLT_MAX;
 	bIsPastPeakOut = true;
 
 	float fYOffset = 0;
-	const SongPosition &position = pPlayerState->GetDisplayedPosition();
-
-	float fSongBeat = position.m_fSongBeatVisible;
-
-	Steps *pCurSteps = GAMESTATE->m_pCurSteps[pPlayerState->m_PlayerNumber];
 
 	/* Usually, fTimeSpacing is 0 or 1, in which case we use entirely beat spacing or
 	 * entirely time spacing (respectively). Occasionally, we tween between them. */
-	if( curr_options->m_fTimeSpacing != 1.0f )
+	if( args.beat_spacing )
 	{
-		if( GAMESTATE->m_bInStepEditor ) {
+		if( args.step_editor ) {
 			// Use constant spacing in step editor
-			fYOffset = fNoteBeat - fSongBeat;
+			fYOffset = fNoteBeat - args.position->m_fSongBeatVisible;
 		} else {
-			fYOffset = GetDisplayedBeat(pPlayerState, fNoteBeat) - GetDisplayedBeat(pPlayerState, fSongBeat);
-			fYOffset *= pCurSteps->GetTimingData()->GetDisplayedSpeedPercent(
-								     position.m_fSongBeatVisible,
-								     position.m_fMusicSecondsVisible );
+			fYOffset = GetDisplayedBeat(pPlayerState, fNoteBeat) - args.song_displayed_beat;
+			fYOffset *= args.displayed_speed_percent;
 		}
 		fYOffset *= 1 - curr_options->m_fTimeSpacing;
 	}
 
-	if( curr_options->m_fTimeSpacing != 0.0f )
+	if( args.time_spacing )
 	{
-		float fSongSeconds = pPlayerState->m_Position.m_fMusicSecondsVisible;
-		float fNoteSeconds = pCurSteps->GetTimingData()->GetElapsedTimeFromBeat(fNoteBeat);
-		float fSecondsUntilStep = fNoteSeconds - fSongSeconds;
-		float fBPM = curr_options->m_fScrollBPM;
-		float fBPS = fBPM/60.f / GAMESTATE->m_SongOptions.GetCurrent().m_fMusicRate;
-		float fYOffsetTimeSpacing = fSecondsUntilStep * fBPS;
+		float fSecondsUntilStep = fNoteSeconds - args.song_seconds;
+		float fYOffsetTimeSpacing = fSecondsUntilStep * args.scroll_bps;
 		fYOffset += fYOffsetTimeSpacing * curr_options->m_fTimeSpacing;
 	}
 
-	// TODO: If we allow noteskins to have metricable row spacing
-	// (per issue 24), edit this to reflect that. -aj
-	fYOffset *= ARROW_SPACING;
+	fYOffset *= args.arrow_spacing;
 
-	// Factor in scroll speed
-	float fScrollSpeed = curr_options->m_fScrollSpeed;
-	if(curr_options->m_fMaxScrollBPM != 0)
-	{
-		fScrollSpeed= curr_options->m_fMaxScrollBPM /
-			(pPlayerState->m_fReadBPM * GAMESTATE->m_SongOptions.GetCurrent().m_fMusicRate);
-	}
+	float fScrollSpeed = args.scroll_speed;
 
 	// don't mess with the arrows after they've crossed 0
 	if( fYOffset < 0 )
@@ -522,9 +594,6 @@ float ArrowEffects::GetYOffset( const PlayerState* pPlayerState, int iCol, float
 	const float* fAccels = curr_options->m_fAccels;
 	const float* fEffects = curr_options->m_fEffects;
 
-	// TODO: Don't index by PlayerNumber.
-	PerPlayerData &data = g_EffectData[pPlayerState->m_PlayerNumber];
-
 	float fYAdjust = 0;	// fill this in depending on PlayerOptions
 
 	if( fAccels[PlayerOptions::ACCEL_BOOST] != 0 )
@@ -582,24 +651,10 @@ float ArrowEffects::GetYOffset( const PlayerState* pPlayerState, int iCol, float
 	}
 
 	if( fAccels[PlayerOptions::ACCEL_EXPAND] != 0 )
-	{
-		float fExpandMultiplier = SCALE( RageFastCos(data.m_fExpandSeconds*EXPAND_MULTIPLIER_FREQUENCY*(fAccels[PlayerOptions::ACCEL_EXPAND_PERIOD]+1)),
-						EXPAND_MULTIPLIER_SCALE_FROM_LOW, EXPAND_MULTIPLIER_SCALE_FROM_HIGH,
-						EXPAND_MULTIPLIER_SCALE_TO_LOW, EXPAND_MULTIPLIER_SCALE_TO_HIGH );
-		fScrollSpeed *=	SCALE( fAccels[PlayerOptions::ACCEL_EXPAND],
-				      EXPAND_SPEED_SCALE_FROM_LOW, EXPAND_SPEED_SCALE_FROM_HIGH,
-				      EXPAND_SPEED_SCALE_TO_LOW, fExpandMultiplier );
-	}
+		fScrollSpeed *= args.expand_scale;
 
 	if( fAccels[PlayerOptions::ACCEL_TAN_EXPAND] != 0 )
-	{
-		float fTanExpandMultiplier = SCALE( SelectTanType(data.m_fTanExpandSeconds*EXPAND_MULTIPLIER_FREQUENCY*(fAccels[PlayerOptions::ACCEL_TAN_EXPAND_PERIOD]+1), curr_options->m_bCosecant),
-						EXPAND_MULTIPLIER_SCALE_FROM_LOW, EXPAND_MULTIPLIER_SCALE_FROM_HIGH,
-						EXPAND_MULTIPLIER_SCALE_TO_LOW, EXPAND_MULTIPLIER_SCALE_TO_HIGH );
-		fScrollSpeed *=	SCALE( fAccels[PlayerOptions::ACCEL_TAN_EXPAND],
-				      EXPAND_SPEED_SCALE_FROM_LOW, EXPAND_SPEED_SCALE_FROM_HIGH,
-				      EXPAND_SPEED_SCALE_TO_LOW, fTanExpandMultiplier );
-	}
+		fScrollSpeed *= args.tan_expand_scale;
 
 	fYOffset *= fScrollSpeed;
 	fPeakYOffsetOut *= fScrollSpeed;
@@ -607,6 +662,33 @@ float ArrowEffects::GetYOffset( const PlayerState* pPlayerState, int iCol, float
 	return fYOffset;
 }
 
+float ArrowEffects::GetYOffset( const PlayerState* pPlayerState, int iCol, float fNoteBeat, float &fPeakYOffsetOut, bool &bIsPastPeakOut, bool bAbsolute )
+{
+	YOffsetArgs args;
+	PrepareYOffset( pPlayerState, args );
+	const float fNoteSeconds = args.time_spacing? GetNoteSeconds( args, pPlayerState, iCol, fNoteBeat ): 0;
+	return GetYOffsetFromArgs( args, pPlayerState, iCol, fNoteBeat, fNoteSeconds, fPeakYOffsetOut, bIsPastPeakOut, bAbsolute );
+}
+
+void ArrowEffects::GetYOffsets( const PlayerState* pPlayerState, int iCol, NoteBatch &batch )
+{
+	YOffsetArgs args;
+	PrepareYOffset( pPlayerState, args );
+
+	const std::size_t iCount = batch.size();
+	batch.y_offset.resize( iCount );
+	// The notes are in beat order, so convert them all in one pass.
+	if( args.time_spacing )
+		args.timing->GetElapsedTimesFromBeats( batch.beat, batch.note_seconds );
+	float fThrowAway;
+	bool bThrowAway;
+	for( std::size_t i = 0; i < iCount; ++i )
+	{
+		const float fNoteSeconds = args.time_spacing? batch.note_seconds[i]: 0;
+		batch.y_offset[i] = GetYOffsetFromArgs( args, pPlayerState, iCol, batch.beat[i], fNoteSeconds, fThrowAway, bThrowAway, false );
+	}
+}
+
 static void ArrowGetReverseShiftAndScale(int iCol, float fYReverseOffsetPixels, float &fShiftOut, float &fScaleOut)
 {
 	// XXX: Hack: we need to scale the reverse shift by the zoom.
@@ -625,17 +707,29 @@ static void ArrowGetReverseShiftAndScale(int iCol, float fYReverseOffsetPixels,
 	fScaleOut = SCALE( fPercentReverse, 0.f, 1.f, 1.f, -1.f );
 }
 
-float ArrowEffects::GetYPos( const PlayerState* pPlayerState, int iCol, float fYOffset, float fYReverseOffsetPixels, bool WithReverse)
+/* The functions named *Batch below work on several notes in one column at
+ * once: each effect that's on is applied to all of the notes before the next
+ * one is checked, and anything that doesn't depend on the note is worked out
+ * once.  The single note functions call them with one note. */
+static void GetYPosBatch( const PlayerState* pPlayerState, int iCol, const float *pYOffset, float fYReverseOffsetPixels, bool WithReverse, float *pOut, std::size_t iCount )
 {
-	float f = fYOffset;
-
 	if( WithReverse )
 	{
 		float fShift, fScale;
 		ArrowGetReverseShiftAndScale(iCol, fYReverseOffsetPixels, fShift, fScale);
 
-		f *= fScale;
-		f += fShift;
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			float f = pYOffset[i];
+			f *= fScale;
+			f += fShift;
+			pOut[i] = f;
+		}
+	}
+	else
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] = pYOffset[i];
 	}
 
 	// TODO: Don't index by PlayerNumber.
@@ -647,27 +741,49 @@ float ArrowEffects::GetYPos( const PlayerState* pPlayerState, int iCol, float fY
 	// checking whether tipsy is on. -Kyz
 	// TODO: Don't index by PlayerNumber.
 	PerPlayerData& data= g_EffectData[curr_options->m_pn];
-	f+= fEffects[PlayerOptions::EFFECT_TIPSY] * data.m_tipsy_result[iCol];
-	f+= fEffects[PlayerOptions::EFFECT_TAN_TIPSY] * data.m_tan_tipsy_result[iCol];
+	const float fTipsy = fEffects[PlayerOptions::EFFECT_TIPSY] * data.m_tipsy_result[iCol];
+	const float fTanTipsy = fEffects[PlayerOptions::EFFECT_TAN_TIPSY] * data.m_tan_tipsy_result[iCol];
+	for( std::size_t i = 0; i < iCount; ++i )
+	{
+		pOut[i] += fTipsy;
+		pOut[i] += fTanTipsy;
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_ATTENUATE_Y] != 0 )
 	{
 		const float fXOffset = pCols[iCol].fXOffset;
-		f += fEffects[PlayerOptions::EFFECT_ATTENUATE_Y] * (fYOffset/ARROW_SIZE) * (fYOffset/ARROW_SIZE) * (fXOffset/ARROW_SIZE);
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_ATTENUATE_Y] * (pYOffset[i]/ARROW_SIZE) * (pYOffset[i]/ARROW_SIZE) * (fXOffset/ARROW_SIZE);
 	}
 
 
 	if( fEffects[PlayerOptions::EFFECT_BEAT_Y] != 0 )
 	{
-		const float fShift = data.m_fBeatFactor[dim_y]*RageFastSin( fYOffset / ((fEffects[PlayerOptions::EFFECT_BEAT_Y_PERIOD]*BEAT_Y_OFFSET_HEIGHT)+BEAT_Y_OFFSET_HEIGHT) + PI/BEAT_Y_PI_HEIGHT );
-		f += fEffects[PlayerOptions::EFFECT_BEAT_Y] * fShift;
+		const float fHeight = (fEffects[PlayerOptions::EFFECT_BEAT_Y_PERIOD]*BEAT_Y_OFFSET_HEIGHT)+BEAT_Y_OFFSET_HEIGHT;
+		const float fPhase = PI/BEAT_Y_PI_HEIGHT;
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			const float fShift = data.m_fBeatFactor[dim_y]*RageFastSin( pYOffset[i] / fHeight + fPhase );
+			pOut[i] += fEffects[PlayerOptions::EFFECT_BEAT_Y] * fShift;
+		}
 	}
 
 	// In beware's DDR Extreme-focused fork of StepMania 3.9, this value is
 	// floored, making arrows show on integer Y coordinates. Supposedly it makes
 	// the arrows look better, but testing needs to be done.
 	// todo: make this a noteskin metric instead of a theme metric? -aj
-	return QUANTIZE_ARROW_Y ? std::floor(f) : f;
+	if( QUANTIZE_ARROW_Y )
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] = std::floor( pOut[i] );
+	}
+}
+
+float ArrowEffects::GetYPos( const PlayerState* pPlayerState, int iCol, float fYOffset, float fYReverseOffsetPixels, bool WithReverse)
+{
+	float f;
+	GetYPosBatch( pPlayerState, iCol, &fYOffset, fYReverseOffsetPixels, WithReverse, &f, 1 );
+	return f;
 }
 
 float ArrowEffects::GetYOffsetFromYPos(int iCol, float YPos, float fYReverseOffsetPixels)
@@ -694,9 +810,10 @@ float ArrowEffects::GetYOffsetFromYPos(int iCol, float YPos, float fYReverseOffs
 	return f;
 }
 
-float ArrowEffects::GetXPos( const PlayerState* pPlayerState, int iColNum, float fYOffset )
+static void GetXPosBatch( const PlayerState* pPlayerState, int iColNum, const float *pYOffset, float *pOut, std::size_t iCount )
 {
-	float fPixelOffsetFromCenter = 0; // fill this in below
+	for( std::size_t i = 0; i < iCount; ++i )
+		pOut[i] = 0; // fill this in below
 
 	const Style* pStyle = GAMESTATE->GetCurrentStyle(pPlayerState->m_PlayerNumber);
 	const float* fEffects = curr_options->m_fEffects;
@@ -707,48 +824,64 @@ float ArrowEffects::GetXPos( const PlayerState* pPlayerState, int iColNum, float
 
 	if( fEffects[PlayerOptions::EFFECT_TORNADO] != 0 )
 	{
-		fPixelOffsetFromCenter += CalculateTornadoOffsetFromMagnitude(dim_x,
-			iColNum, fEffects[PlayerOptions::EFFECT_TORNADO],
-			fEffects[PlayerOptions::EFFECT_TORNADO_OFFSET],
-			fEffects[PlayerOptions::EFFECT_TORNADO_PERIOD],
-			pCols, pPlayerState->m_NotefieldZoom, data, fYOffset, false);
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += CalculateTornadoOffsetFromMagnitude(dim_x,
+				iColNum, fEffects[PlayerOptions::EFFECT_TORNADO],
+				fEffects[PlayerOptions::EFFECT_TORNADO_OFFSET],
+				fEffects[PlayerOptions::EFFECT_TORNADO_PERIOD],
+				pCols, pPlayerState->m_NotefieldZoom, data, pYOffset[i], false);
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_TAN_TORNADO] != 0 )
 	{
-		fPixelOffsetFromCenter += CalculateTornadoOffsetFromMagnitude(dim_x,
-			iColNum, fEffects[PlayerOptions::EFFECT_TAN_TORNADO],
-			fEffects[PlayerOptions::EFFECT_TAN_TORNADO_OFFSET],
-			fEffects[PlayerOptions::EFFECT_TAN_TORNADO_PERIOD],
-			pCols, pPlayerState->m_NotefieldZoom, data, fYOffset, true);
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += CalculateTornadoOffsetFromMagnitude(dim_x,
+				iColNum, fEffects[PlayerOptions::EFFECT_TAN_TORNADO],
+				fEffects[PlayerOptions::EFFECT_TAN_TORNADO_OFFSET],
+				fEffects[PlayerOptions::EFFECT_TAN_TORNADO_PERIOD],
+				pCols, pPlayerState->m_NotefieldZoom, data, pYOffset[i], true);
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_BUMPY_X] != 0 )
-		fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_BUMPY_X] *
-			40*RageFastSin( CalculateBumpyAngle(fYOffset,
-			fEffects[PlayerOptions::EFFECT_BUMPY_X_OFFSET],
-			fEffects[PlayerOptions::EFFECT_BUMPY_X_PERIOD]) );
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_BUMPY_X] *
+				40*RageFastSin( CalculateBumpyAngle(pYOffset[i],
+				fEffects[PlayerOptions::EFFECT_BUMPY_X_OFFSET],
+				fEffects[PlayerOptions::EFFECT_BUMPY_X_PERIOD]) );
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_TAN_BUMPY_X] != 0 )
-		fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_TAN_BUMPY_X] *
-			40*SelectTanType( CalculateBumpyAngle(fYOffset,
-			fEffects[PlayerOptions::EFFECT_TAN_BUMPY_X_OFFSET],
-			fEffects[PlayerOptions::EFFECT_TAN_BUMPY_X_PERIOD]), curr_options->m_bCosecant );
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_TAN_BUMPY_X] *
+				40*SelectTanType( CalculateBumpyAngle(pYOffset[i],
+				fEffects[PlayerOptions::EFFECT_TAN_BUMPY_X_OFFSET],
+				fEffects[PlayerOptions::EFFECT_TAN_BUMPY_X_PERIOD]), curr_options->m_bCosecant );
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_DRUNK] != 0 )
-		fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_DRUNK] *
-			( RageFastCos( CalculateDrunkAngle(fEffects[PlayerOptions::EFFECT_DRUNK_SPEED], iColNum,
-					fEffects[PlayerOptions::EFFECT_DRUNK_OFFSET], DRUNK_COLUMN_FREQUENCY,
-					fYOffset, fEffects[PlayerOptions::EFFECT_DRUNK_PERIOD],
-					DRUNK_OFFSET_FREQUENCY) ) * ARROW_SIZE*DRUNK_ARROW_MAGNITUDE );
+	{
+		const float fTime = ArrowEffects::GetTime();
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_DRUNK] *
+				( RageFastCos( CalculateDrunkAngle(fTime, fEffects[PlayerOptions::EFFECT_DRUNK_SPEED], iColNum,
+						fEffects[PlayerOptions::EFFECT_DRUNK_OFFSET], DRUNK_COLUMN_FREQUENCY,
+						pYOffset[i], fEffects[PlayerOptions::EFFECT_DRUNK_PERIOD],
+						DRUNK_OFFSET_FREQUENCY) ) * ARROW_SIZE*DRUNK_ARROW_MAGNITUDE );
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_TAN_DRUNK] != 0 )
-		fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_TAN_DRUNK] *
-			( SelectTanType( CalculateDrunkAngle(fEffects[PlayerOptions::EFFECT_TAN_DRUNK_SPEED],
-					iColNum, fEffects[PlayerOptions::EFFECT_TAN_DRUNK_OFFSET],
-					DRUNK_COLUMN_FREQUENCY, fYOffset,
-					fEffects[PlayerOptions::EFFECT_TAN_DRUNK_PERIOD], DRUNK_OFFSET_FREQUENCY)
-					, curr_options->m_bCosecant) * ARROW_SIZE*DRUNK_ARROW_MAGNITUDE );
+	{
+		const float fTime = ArrowEffects::GetTime();
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_TAN_DRUNK] *
+				( SelectTanType( CalculateDrunkAngle(fTime, fEffects[PlayerOptions::EFFECT_TAN_DRUNK_SPEED],
+						iColNum, fEffects[PlayerOptions::EFFECT_TAN_DRUNK_OFFSET],
+						DRUNK_COLUMN_FREQUENCY, pYOffset[i],
+						fEffects[PlayerOptions::EFFECT_TAN_DRUNK_PERIOD], DRUNK_OFFSET_FREQUENCY)
+						, curr_options->m_bCosecant) * ARROW_SIZE*DRUNK_ARROW_MAGNITUDE );
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_FLIP] != 0 )
 	{
@@ -758,74 +891,106 @@ float ArrowEffects::GetXPos( const PlayerState* pPlayerState, int iColNum, float
 		const float fOldPixelOffset = pCols[iColNum].fXOffset * pPlayerState->m_NotefieldZoom;
 		const float fNewPixelOffset = pCols[iNewCol].fXOffset * pPlayerState->m_NotefieldZoom;
 		const float fDistance = fNewPixelOffset - fOldPixelOffset;
-		fPixelOffsetFromCenter += fDistance * fEffects[PlayerOptions::EFFECT_FLIP];
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fDistance * fEffects[PlayerOptions::EFFECT_FLIP];
 	}
 	if( fEffects[PlayerOptions::EFFECT_INVERT] != 0 )
-		fPixelOffsetFromCenter += data.m_fInvertDistance[iColNum] * fEffects[PlayerOptions::EFFECT_INVERT];
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += data.m_fInvertDistance[iColNum] * fEffects[PlayerOptions::EFFECT_INVERT];
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_BEAT] != 0 )
 	{
-		const float fShift = data.m_fBeatFactor[dim_x]*RageFastSin( fYOffset / ((fEffects[PlayerOptions::EFFECT_BEAT_PERIOD]*BEAT_OFFSET_HEIGHT)+BEAT_OFFSET_HEIGHT) + PI/BEAT_PI_HEIGHT );
-		fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_BEAT] * fShift;
+		const float fHeight = (fEffects[PlayerOptions::EFFECT_BEAT_PERIOD]*BEAT_OFFSET_HEIGHT)+BEAT_OFFSET_HEIGHT;
+		const float fPhase = PI/BEAT_PI_HEIGHT;
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			const float fShift = data.m_fBeatFactor[dim_x]*RageFastSin( pYOffset[i] / fHeight + fPhase );
+			pOut[i] += fEffects[PlayerOptions::EFFECT_BEAT] * fShift;
+		}
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_ZIGZAG] != 0 )
 	{
-		float fResult = RageTriangle( (PI * (1/(fEffects[PlayerOptions::EFFECT_ZIGZAG_PERIOD]+1)) *
-		((fYOffset+(100.0f*(fEffects[PlayerOptions::EFFECT_ZIGZAG_OFFSET])))/ARROW_SIZE) ) );
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			float fResult = RageTriangle( (PI * (1/(fEffects[PlayerOptions::EFFECT_ZIGZAG_PERIOD]+1)) *
+			((pYOffset[i]+(100.0f*(fEffects[PlayerOptions::EFFECT_ZIGZAG_OFFSET])))/ARROW_SIZE) ) );
 
-		fPixelOffsetFromCenter += (fEffects[PlayerOptions::EFFECT_ZIGZAG]*ARROW_SIZE/2) * fResult;
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_ZIGZAG]*ARROW_SIZE/2) * fResult;
+		}
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_SAWTOOTH] != 0 )
-		fPixelOffsetFromCenter += (fEffects[PlayerOptions::EFFECT_SAWTOOTH]*ARROW_SIZE) *
-			((0.5f / (fEffects[PlayerOptions::EFFECT_SAWTOOTH_PERIOD]+1) * fYOffset) / ARROW_SIZE -
-			std::floor((0.5f / (fEffects[PlayerOptions::EFFECT_SAWTOOTH_PERIOD]+1) * fYOffset) / ARROW_SIZE) );
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_SAWTOOTH]*ARROW_SIZE) *
+				((0.5f / (fEffects[PlayerOptions::EFFECT_SAWTOOTH_PERIOD]+1) * pYOffset[i]) / ARROW_SIZE -
+				std::floor((0.5f / (fEffects[PlayerOptions::EFFECT_SAWTOOTH_PERIOD]+1) * pYOffset[i]) / ARROW_SIZE) );
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_PARABOLA_X] != 0 )
-		fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_PARABOLA_X] * (fYOffset/ARROW_SIZE) * (fYOffset/ARROW_SIZE);
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_PARABOLA_X] * (pYOffset[i]/ARROW_SIZE) * (pYOffset[i]/ARROW_SIZE);
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_ATTENUATE_X] != 0 )
 	{
 		const float fXOffset = pCols[iColNum].fXOffset;
-		fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_ATTENUATE_X] * (fYOffset/ARROW_SIZE) * (fYOffset/ARROW_SIZE) * (fXOffset/ARROW_SIZE);
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_ATTENUATE_X] * (pYOffset[i]/ARROW_SIZE) * (pYOffset[i]/ARROW_SIZE) * (fXOffset/ARROW_SIZE);
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_DIGITAL] != 0 )
-		fPixelOffsetFromCenter += (fEffects[PlayerOptions::EFFECT_DIGITAL] * ARROW_SIZE * 0.5f) *
-			std::round((fEffects[PlayerOptions::EFFECT_DIGITAL_STEPS]+1) * RageFastSin(
-				CalculateDigitalAngle(fYOffset,
-				fEffects[PlayerOptions::EFFECT_DIGITAL_OFFSET],
-				fEffects[PlayerOptions::EFFECT_DIGITAL_PERIOD]) ) )/(fEffects[PlayerOptions::EFFECT_DIGITAL_STEPS]+1);
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_DIGITAL] * ARROW_SIZE * 0.5f) *
+				std::round((fEffects[PlayerOptions::EFFECT_DIGITAL_STEPS]+1) * RageFastSin(
+					CalculateDigitalAngle(pYOffset[i],
+					fEffects[PlayerOptions::EFFECT_DIGITAL_OFFSET],
+					fEffects[PlayerOptions::EFFECT_DIGITAL_PERIOD]) ) )/(fEffects[PlayerOptions::EFFECT_DIGITAL_STEPS]+1);
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_TAN_DIGITAL] != 0 )
-		fPixelOffsetFromCenter += (fEffects[PlayerOptions::EFFECT_TAN_DIGITAL] * ARROW_SIZE * 0.5f) *
-			std::round((fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_STEPS]+1) * SelectTanType(
-				CalculateDigitalAngle(fYOffset,
-				fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_OFFSET],
-				fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_PERIOD]), curr_options->m_bCosecant ) )/(fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_STEPS]+1);
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_TAN_DIGITAL] * ARROW_SIZE * 0.5f) *
+				std::round((fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_STEPS]+1) * SelectTanType(
+					CalculateDigitalAngle(pYOffset[i],
+					fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_OFFSET],
+					fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_PERIOD]), curr_options->m_bCosecant ) )/(fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_STEPS]+1);
+	}
 
 
 	if( fEffects[PlayerOptions::EFFECT_SQUARE] != 0 )
 	{
-		float fResult = RageSquare( (PI * (fYOffset+(1.0f*(fEffects[PlayerOptions::EFFECT_SQUARE_OFFSET]))) /
-			(ARROW_SIZE+(fEffects[PlayerOptions::EFFECT_SQUARE_PERIOD]*ARROW_SIZE))) );
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			float fResult = RageSquare( (PI * (pYOffset[i]+(1.0f*(fEffects[PlayerOptions::EFFECT_SQUARE_OFFSET]))) /
+				(ARROW_SIZE+(fEffects[PlayerOptions::EFFECT_SQUARE_PERIOD]*ARROW_SIZE))) );
 
-		fPixelOffsetFromCenter += (fEffects[PlayerOptions::EFFECT_SQUARE] * ARROW_SIZE * 0.5f) * fResult;
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_SQUARE] * ARROW_SIZE * 0.5f) * fResult;
+		}
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_BOUNCE] != 0 )
 	{
-		float fBounceAmt = std::abs( RageFastSin( ( (fYOffset + (1.0f * (fEffects[PlayerOptions::EFFECT_BOUNCE_OFFSET]) ) ) /
-			( 60 + (fEffects[PlayerOptions::EFFECT_BOUNCE_PERIOD]*60) ) ) ) );
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			float fBounceAmt = std::abs( RageFastSin( ( (pYOffset[i] + (1.0f * (fEffects[PlayerOptions::EFFECT_BOUNCE_OFFSET]) ) ) /
+				( 60 + (fEffects[PlayerOptions::EFFECT_BOUNCE_PERIOD]*60) ) ) ) );
 
-		fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_BOUNCE] * ARROW_SIZE * 0.5f * fBounceAmt;
+			pOut[i] += fEffects[PlayerOptions::EFFECT_BOUNCE] * ARROW_SIZE * 0.5f * fBounceAmt;
+		}
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_XMODE] != 0 )
 	{
 		// based off of code by v1toko for StepNXA, except it should work on
 		// any gametype now.
+		bool bNegate = false;
 		switch( pStyle->m_StyleType )
 		{
 			case StyleType_OnePlayerTwoSides:
@@ -834,36 +999,40 @@ float ArrowEffects::GetXPos( const PlayerState* pPlayerState, int iColNum, float
 					// find the middle, and split based on iColNum
 					// it's unknown if this will work for routine.
 					const int iMiddleColumn = std::floor(pStyle->m_iColsPerPlayer/2.0f);
-					if( iColNum > iMiddleColumn-1 )
-						fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_XMODE]*-(fYOffset);
-					else
-						fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_XMODE]*fYOffset;
+					bNegate = iColNum > iMiddleColumn-1;
 				}
 				break;
 			case StyleType_OnePlayerOneSide:
 			case StyleType_TwoPlayersTwoSides:
 				{
 					// the code was the same for both of these cases in StepNXA.
-					if( pPlayerState->m_PlayerNumber == PLAYER_2 )
-						fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_XMODE]*-(fYOffset);
-					else
-						fPixelOffsetFromCenter += fEffects[PlayerOptions::EFFECT_XMODE]*fYOffset;
+					bNegate = pPlayerState->m_PlayerNumber == PLAYER_2;
 				}
 				break;
 			DEFAULT_FAIL(pStyle->m_StyleType);
 		}
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_XMODE] * (bNegate? -(pYOffset[i]):pYOffset[i]);
 	}
 
-	fPixelOffsetFromCenter += pCols[iColNum].fXOffset * pPlayerState->m_NotefieldZoom;
+	const float fColumnOffset = pCols[iColNum].fXOffset * pPlayerState->m_NotefieldZoom;
+	for( std::size_t i = 0; i < iCount; ++i )
+		pOut[i] += fColumnOffset;
 
 	if( fEffects[PlayerOptions::EFFECT_TINY] != 0 )
 	{
 		// Allow Tiny to pull tracks together, but not to push them apart.
 		float fTinyPercent = fEffects[PlayerOptions::EFFECT_TINY];
 		fTinyPercent = std::min( std::pow(TINY_PERCENT_BASE, fTinyPercent), (float)TINY_PERCENT_GATE );
-		fPixelOffsetFromCenter *= fTinyPercent;
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] *= fTinyPercent;
 	}
+}
 
+float ArrowEffects::GetXPos( const PlayerState* pPlayerState, int iColNum, float fYOffset )
+{
+	float fPixelOffsetFromCenter;
+	GetXPosBatch( pPlayerState, iColNum, &fYOffset, &fPixelOffsetFromCenter, 1 );
 	return fPixelOffsetFromCenter;
 }
 
@@ -897,6 +1066,16 @@ float ArrowEffects::GetRotationY(const PlayerState* pPlayerState, float fYOffset
 	return fRotation;
 }
 
+static float GetDizzyRotation( const PlayerState* pPlayerState, float fNoteBeat )
+{
+	const float fSongBeat = pPlayerState->m_Position.m_fSongBeatVisible;
+	float fDizzyRotation = fNoteBeat - fSongBeat;
+	fDizzyRotation *= curr_options->m_fEffects[PlayerOptions::EFFECT_DIZZY];
+	fDizzyRotation = std::fmod( fDizzyRotation, 2*PI );
+	fDizzyRotation *= 180/PI;
+	return fDizzyRotation;
+}
+
 float ArrowEffects::GetRotationZ( const PlayerState* pPlayerState, float fNoteBeat, bool bIsHoldHead, int iCol )
 {
 	const float* fEffects = curr_options->m_fEffects;
@@ -908,15 +1087,57 @@ float ArrowEffects::GetRotationZ( const PlayerState* pPlayerState, float fNoteBe
 
 	// As usual, enable dizzy hold heads at your own risk. -Wolfman2000
 	if( fEffects[PlayerOptions::EFFECT_DIZZY] != 0 && ( curr_options->m_bDizzyHolds || !bIsHoldHead ) )
+		fRotation += GetDizzyRotation( pPlayerState, fNoteBeat );
+	return fRotation;
+}
+
+/* The confusion part of each rotation is the same for every note in the
+ * column, so it's worked out once; roll, twirl and dizzy are added after it
+ * in the same order as the single-note functions. */
+static void GetRotationsBatch( const PlayerState* pPlayerState, int iCol, ArrowEffects::NoteBatch &batch )
+{
+	const float* fEffects = curr_options->m_fEffects;
+	const std::size_t iCount = batch.size();
+
+	float fRotX = 0, fRotY = 0, fRotZ = 0;
+	if( fEffects[PlayerOptions::EFFECT_CONFUSION_X] != 0 || fEffects[PlayerOptions::EFFECT_CONFUSION_X_OFFSET] != 0 ||
+		curr_options->m_fConfusionX[iCol] != 0 )
+		fRotX += ArrowEffects::ReceptorGetRotationX( pPlayerState, iCol );
+	if( fEffects[PlayerOptions::EFFECT_CONFUSION_Y] != 0 || fEffects[PlayerOptions::EFFECT_CONFUSION_Y_OFFSET] != 0 ||
+		curr_options->m_fConfusionY[iCol] != 0 )
+		fRotY += ArrowEffects::ReceptorGetRotationY( pPlayerState, iCol );
+	if( fEffects[PlayerOptions::EFFECT_CONFUSION] != 0 || fEffects[PlayerOptions::EFFECT_CONFUSION_OFFSET] != 0 ||
+		curr_options->m_fConfusionZ[iCol] != 0 )
+		fRotZ += ArrowEffects::ReceptorGetRotationZ( pPlayerState, iCol );
+
+	for( std::size_t i = 0; i < iCount; ++i )
 	{
-		const float fSongBeat = pPlayerState->m_Position.m_fSongBeatVisible;
-		float fDizzyRotation = fNoteBeat - fSongBeat;
-		fDizzyRotation *= fEffects[PlayerOptions::EFFECT_DIZZY];
-		fDizzyRotation = std::fmod( fDizzyRotation, 2*PI );
-		fDizzyRotation *= 180/PI;
-		fRotation += fDizzyRotation;
+		batch.rot_x[i] = fRotX;
+		batch.rot_y[i] = fRotY;
+		batch.rot_z[i] = fRotZ;
+	}
+
+	if( fEffects[PlayerOptions::EFFECT_ROLL] != 0 )
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			if( !batch.hold_cap[i] )
+				batch.rot_x[i] += fEffects[PlayerOptions::EFFECT_ROLL] * batch.y_offset[i]/2;
+		}
+	}
+	if( fEffects[PlayerOptions::EFFECT_TWIRL] != 0 )
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			batch.rot_y[i] += fEffects[PlayerOptions::EFFECT_TWIRL] * batch.y_offset[i]/2;
+	}
+	if( fEffects[PlayerOptions::EFFECT_DIZZY] != 0 )
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			if( curr_options->m_bDizzyHolds || !batch.hold_head[i] )
+				batch.rot_z[i] += GetDizzyRotation( pPlayerState, batch.beat[i] );
+		}
 	}
-	return fRotation;
 }
 
 float ArrowEffects::ReceptorGetRotationZ( const PlayerState* pPlayerState, int iCol )
@@ -1074,10 +1295,44 @@ static float GetSuddenStartLine()
 		GetCenterLine() * curr_options->m_fAppearances[PlayerOptions::APPEARANCE_SUDDEN_OFFSET];
 }
 
-// used by ArrowGetAlpha and ArrowGetGlow below
-float ArrowGetPercentVisible(float fYPosWithoutReverse, int iCol, float fYOffset)
+/* Everything in ArrowGetPercentVisible that doesn't depend on the note.
+ * Blink reads the mod timer, which doesn't move within a frame. */
+struct PercentVisibleArgs
+{
+	float center_line;
+	float hidden_start_line;
+	float hidden_end_line;
+	float sudden_start_line;
+	float sudden_end_line;
+	float blink_adjust;
+};
+
+static void PreparePercentVisible( PercentVisibleArgs &args )
+{
+	const float* fAppearances = curr_options->m_fAppearances;
+	args = PercentVisibleArgs();
+	args.center_line = GetCenterLine();
+	if( fAppearances[PlayerOptions::APPEARANCE_HIDDEN] != 0 )
+	{
+		args.hidden_start_line = GetHiddenStartLine();
+		args.hidden_end_line = GetHiddenEndLine();
+	}
+	if( fAppearances[PlayerOptions::APPEARANCE_SUDDEN] != 0 )
+	{
+		args.sudden_start_line = GetSuddenStartLine();
+		args.sudden_end_line = GetSuddenEndLine();
+	}
+	if( fAppearances[PlayerOptions::APPEARANCE_BLINK] != 0 )
+	{
+		float f = RageFastSin(ArrowEffects::GetTime()*10);
+		f = Quantize( f, BLINK_MOD_FREQUENCY );
+		args.blink_adjust = SCALE( f, 0, 1, -1, 0 );
+	}
+}
+
+static float GetPercentVisibleFromArgs( const PercentVisibleArgs &args, float fYPosWithoutReverse, int iCol, float fYOffset )
 {
-	const float fDistFromCenterLine = fYPosWithoutReverse - GetCenterLine();
+	const float fDistFromCenterLine = fYPosWithoutReverse - args.center_line;
 
 	float fYPos;
 	if( curr_options->m_bStealthType )
@@ -1095,13 +1350,13 @@ float ArrowGetPercentVisible(float fYPosWithoutReverse, int iCol, float fYOffset
 
 	if( fAppearances[PlayerOptions::APPEARANCE_HIDDEN] != 0 )
 	{
-		float fHiddenVisibleAdjust = SCALE( fYPos, GetHiddenStartLine(), GetHiddenEndLine(), 0, -1 );
+		float fHiddenVisibleAdjust = SCALE( fYPos, args.hidden_start_line, args.hidden_end_line, 0, -1 );
 		CLAMP( fHiddenVisibleAdjust, -1, 0 );
 		fVisibleAdjust += fAppearances[PlayerOptions::APPEARANCE_HIDDEN] * fHiddenVisibleAdjust;
 	}
 	if( fAppearances[PlayerOptions::APPEARANCE_SUDDEN] != 0 )
 	{
-		float fSuddenVisibleAdjust = SCALE( fYPos, GetSuddenStartLine(), GetSuddenEndLine(), -1, 0 );
+		float fSuddenVisibleAdjust = SCALE( fYPos, args.sudden_start_line, args.sudden_end_line, -1, 0 );
 		CLAMP( fSuddenVisibleAdjust, -1, 0 );
 		fVisibleAdjust += fAppearances[PlayerOptions::APPEARANCE_SUDDEN] * fSuddenVisibleAdjust;
 	}
@@ -1112,11 +1367,7 @@ float ArrowGetPercentVisible(float fYPosWithoutReverse, int iCol, float fYOffset
 		fVisibleAdjust -= curr_options->m_fStealth[iCol];
 	}
 	if( fAppearances[PlayerOptions::APPEARANCE_BLINK] != 0 )
-	{
-		float f = RageFastSin(ArrowEffects::GetTime()*10);
-		f = Quantize( f, BLINK_MOD_FREQUENCY );
-		fVisibleAdjust += SCALE( f, 0, 1, -1, 0 );
-	}
+		fVisibleAdjust += args.blink_adjust;
 	if( fAppearances[PlayerOptions::APPEARANCE_RANDOMVANISH] != 0 )
 	{
 		const float fRealFadeDist = 80;
@@ -1127,13 +1378,16 @@ float ArrowGetPercentVisible(float fYPosWithoutReverse, int iCol, float fYOffset
 	return clamp(1 + fVisibleAdjust, 0.0f, 1.0f);
 }
 
-float ArrowEffects::GetAlpha( const PlayerState* pPlayerState, int iCol, float fYOffset, float fPercentFadeToFail, float fYReverseOffsetPixels, float fDrawDistanceBeforeTargetsPixels, float fFadeInPercentOfDrawFar)
+// used by ArrowGetAlpha and ArrowGetGlow below
+float ArrowGetPercentVisible(float fYPosWithoutReverse, int iCol, float fYOffset)
 {
-	// Get the YPos without reverse (that is, factor in EFFECT_TIPSY).
-	float fYPosWithoutReverse = ArrowEffects::GetYPos(pPlayerState, iCol, fYOffset, fYReverseOffsetPixels, false );
-
-	float fPercentVisible = ArrowGetPercentVisible(fYPosWithoutReverse, iCol, fYOffset);
+	PercentVisibleArgs args;
+	PreparePercentVisible( args );
+	return GetPercentVisibleFromArgs( args, fYPosWithoutReverse, iCol, fYOffset );
+}
 
+static float GetAlphaFromPercentVisible( float fPercentVisible, float fYPosWithoutReverse, float fPercentFadeToFail, float fDrawDistanceBeforeTargetsPixels, float fFadeInPercentOfDrawFar )
+{
 	if( fPercentFadeToFail != -1 )
 		fPercentVisible = 1 - fPercentFadeToFail;
 
@@ -1147,18 +1401,33 @@ float ArrowEffects::GetAlpha( const PlayerState* pPlayerState, int iCol, float f
 	return (fPercentVisible>0.5f) ? 1.0f : 0.0f;
 }
 
-float ArrowEffects::GetGlow( const PlayerState* pPlayerState, int iCol, float fYOffset, float fPercentFadeToFail, float fYReverseOffsetPixels, float fDrawDistanceBeforeTargetsPixels, float fFadeInPercentOfDrawFar)
+static float GetGlowFromPercentVisible( float fPercentVisible, float fPercentFadeToFail )
+{
+	if( fPercentFadeToFail != -1 )
+		fPercentVisible = 1 - fPercentFadeToFail;
+
+	const float fDistFromHalf = std::abs( fPercentVisible - 0.5f );
+	return SCALE( fDistFromHalf, 0, 0.5f, 1.3f, 0 );
+}
+
+float ArrowEffects::GetAlpha( const PlayerState* pPlayerState, int iCol, float fYOffset, float fPercentFadeToFail, float fYReverseOffsetPixels, float fDrawDistanceBeforeTargetsPixels, float fFadeInPercentOfDrawFar)
 {
 	// Get the YPos without reverse (that is, factor in EFFECT_TIPSY).
 	float fYPosWithoutReverse = ArrowEffects::GetYPos(pPlayerState, iCol, fYOffset, fYReverseOffsetPixels, false );
 
 	float fPercentVisible = ArrowGetPercentVisible(fYPosWithoutReverse, iCol, fYOffset);
 
-	if( fPercentFadeToFail != -1 )
-		fPercentVisible = 1 - fPercentFadeToFail;
+	return GetAlphaFromPercentVisible( fPercentVisible, fYPosWithoutReverse, fPercentFadeToFail, fDrawDistanceBeforeTargetsPixels, fFadeInPercentOfDrawFar );
+}
 
-	const float fDistFromHalf = std::abs( fPercentVisible - 0.5f );
-	return SCALE( fDistFromHalf, 0, 0.5f, 1.3f, 0 );
+float ArrowEffects::GetGlow( const PlayerState* pPlayerState, int iCol, float fYOffset, float fPercentFadeToFail, float fYReverseOffsetPixels, float fDrawDistanceBeforeTargetsPixels, float fFadeInPercentOfDrawFar)
+{
+	// Get the YPos without reverse (that is, factor in EFFECT_TIPSY).
+	float fYPosWithoutReverse = ArrowEffects::GetYPos(pPlayerState, iCol, fYOffset, fYReverseOffsetPixels, false );
+
+	float fPercentVisible = ArrowGetPercentVisible(fYPosWithoutReverse, iCol, fYOffset);
+
+	return GetGlowFromPercentVisible( fPercentVisible, fPercentFadeToFail );
 }
 
 float ArrowEffects::GetBrightness( const PlayerState* pPlayerState, float fNoteBeat )
@@ -1175,9 +1444,10 @@ float ArrowEffects::GetBrightness( const PlayerState* pPlayerState, float fNoteB
 }
 
 
-float ArrowEffects::GetZPos( const PlayerState* pPlayerState, int iCol, float fYOffset)
+static void GetZPosBatch( const PlayerState* pPlayerState, int iCol, const float *pYOffset, float *pOut, std::size_t iCount )
 {
-	float fZPos=0;
+	for( std::size_t i = 0; i < iCount; ++i )
+		pOut[i] = 0;
 	const float* fEffects = curr_options->m_fEffects;
 	const Style* pStyle = GAMESTATE->GetCurrentStyle(pPlayerState->m_PlayerNumber);
 
@@ -1187,114 +1457,165 @@ float ArrowEffects::GetZPos( const PlayerState* pPlayerState, int iCol, float fY
 
 	if( fEffects[PlayerOptions::EFFECT_TORNADO_Z] != 0 )
 	{
-		fZPos += CalculateTornadoOffsetFromMagnitude(dim_z, iCol,
-			fEffects[PlayerOptions::EFFECT_TORNADO_Z],
-			fEffects[PlayerOptions::EFFECT_TORNADO_Z_OFFSET],
-			fEffects[PlayerOptions::EFFECT_TORNADO_Z_PERIOD],
-			pCols, pPlayerState->m_NotefieldZoom, data, fYOffset, false);
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += CalculateTornadoOffsetFromMagnitude(dim_z, iCol,
+				fEffects[PlayerOptions::EFFECT_TORNADO_Z],
+				fEffects[PlayerOptions::EFFECT_TORNADO_Z_OFFSET],
+				fEffects[PlayerOptions::EFFECT_TORNADO_Z_PERIOD],
+				pCols, pPlayerState->m_NotefieldZoom, data, pYOffset[i], false);
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_TAN_TORNADO_Z] != 0 )
 	{
-		fZPos += CalculateTornadoOffsetFromMagnitude(dim_z, iCol,
-			fEffects[PlayerOptions::EFFECT_TAN_TORNADO_Z],
-			fEffects[PlayerOptions::EFFECT_TAN_TORNADO_Z_OFFSET],
-			fEffects[PlayerOptions::EFFECT_TAN_TORNADO_Z_PERIOD],
-			pCols, pPlayerState->m_NotefieldZoom, data, fYOffset, true);
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += CalculateTornadoOffsetFromMagnitude(dim_z, iCol,
+				fEffects[PlayerOptions::EFFECT_TAN_TORNADO_Z],
+				fEffects[PlayerOptions::EFFECT_TAN_TORNADO_Z_OFFSET],
+				fEffects[PlayerOptions::EFFECT_TAN_TORNADO_Z_PERIOD],
+				pCols, pPlayerState->m_NotefieldZoom, data, pYOffset[i], true);
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_BUMPY] != 0 )
-		fZPos += fEffects[PlayerOptions::EFFECT_BUMPY] * 40*RageFastSin(
-			CalculateBumpyAngle(fYOffset,
-			fEffects[PlayerOptions::EFFECT_BUMPY_OFFSET],
-			fEffects[PlayerOptions::EFFECT_BUMPY_PERIOD]) );
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_BUMPY] * 40*RageFastSin(
+				CalculateBumpyAngle(pYOffset[i],
+				fEffects[PlayerOptions::EFFECT_BUMPY_OFFSET],
+				fEffects[PlayerOptions::EFFECT_BUMPY_PERIOD]) );
+	}
 
 	if( curr_options->m_fBumpy[iCol] != 0 )
-		fZPos += curr_options->m_fBumpy[iCol] * 40*RageFastSin(
-			CalculateBumpyAngle(fYOffset,
-			fEffects[PlayerOptions::EFFECT_BUMPY_OFFSET],
-			fEffects[PlayerOptions::EFFECT_BUMPY_PERIOD]) );
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += curr_options->m_fBumpy[iCol] * 40*RageFastSin(
+				CalculateBumpyAngle(pYOffset[i],
+				fEffects[PlayerOptions::EFFECT_BUMPY_OFFSET],
+				fEffects[PlayerOptions::EFFECT_BUMPY_PERIOD]) );
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_TAN_BUMPY] != 0 )
-		fZPos += fEffects[PlayerOptions::EFFECT_TAN_BUMPY] * 40*SelectTanType(
-			CalculateBumpyAngle(fYOffset,
-			fEffects[PlayerOptions::EFFECT_TAN_BUMPY_OFFSET],
-			fEffects[PlayerOptions::EFFECT_TAN_BUMPY_PERIOD]), curr_options->m_bCosecant );
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_TAN_BUMPY] * 40*SelectTanType(
+				CalculateBumpyAngle(pYOffset[i],
+				fEffects[PlayerOptions::EFFECT_TAN_BUMPY_OFFSET],
+				fEffects[PlayerOptions::EFFECT_TAN_BUMPY_PERIOD]), curr_options->m_bCosecant );
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_ZIGZAG_Z] != 0 )
 	{
-		float fResult = RageTriangle( (PI * (1/(fEffects[PlayerOptions::EFFECT_ZIGZAG_Z_PERIOD]+1)) *
-			((fYOffset+(100.0f*(fEffects[PlayerOptions::EFFECT_ZIGZAG_Z_OFFSET])))/ARROW_SIZE) ) );
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			float fResult = RageTriangle( (PI * (1/(fEffects[PlayerOptions::EFFECT_ZIGZAG_Z_PERIOD]+1)) *
+				((pYOffset[i]+(100.0f*(fEffects[PlayerOptions::EFFECT_ZIGZAG_Z_OFFSET])))/ARROW_SIZE) ) );
 
-		fZPos += (fEffects[PlayerOptions::EFFECT_ZIGZAG_Z]*ARROW_SIZE/2) * fResult;
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_ZIGZAG_Z]*ARROW_SIZE/2) * fResult;
+		}
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_SAWTOOTH_Z] != 0 )
-		fZPos += (fEffects[PlayerOptions::EFFECT_SAWTOOTH_Z]*ARROW_SIZE) *
-			((0.5f/(fEffects[PlayerOptions::EFFECT_SAWTOOTH_Z_PERIOD]+1)*fYOffset)/ARROW_SIZE -
-				std::floor((0.5f/(fEffects[PlayerOptions::EFFECT_SAWTOOTH_Z_PERIOD]+1)*fYOffset)/ARROW_SIZE));
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_SAWTOOTH_Z]*ARROW_SIZE) *
+				((0.5f/(fEffects[PlayerOptions::EFFECT_SAWTOOTH_Z_PERIOD]+1)*pYOffset[i])/ARROW_SIZE -
+					std::floor((0.5f/(fEffects[PlayerOptions::EFFECT_SAWTOOTH_Z_PERIOD]+1)*pYOffset[i])/ARROW_SIZE));
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_PARABOLA_Z] != 0 )
-		fZPos += fEffects[PlayerOptions::EFFECT_PARABOLA_Z] * (fYOffset/ARROW_SIZE) * (fYOffset/ARROW_SIZE);
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_PARABOLA_Z] * (pYOffset[i]/ARROW_SIZE) * (pYOffset[i]/ARROW_SIZE);
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_ATTENUATE_Z] != 0 )
 	{
 		const float fXOffset = pCols[iCol].fXOffset;
-		fZPos += fEffects[PlayerOptions::EFFECT_ATTENUATE_Z] * (fYOffset/ARROW_SIZE) * (fYOffset/ARROW_SIZE) * (fXOffset/ARROW_SIZE);
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_ATTENUATE_Z] * (pYOffset[i]/ARROW_SIZE) * (pYOffset[i]/ARROW_SIZE) * (fXOffset/ARROW_SIZE);
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_DRUNK_Z] != 0 )
-		fZPos += fEffects[PlayerOptions::EFFECT_DRUNK_Z] *
-			( RageFastCos( CalculateDrunkAngle(fEffects[PlayerOptions::EFFECT_DRUNK_Z_SPEED], iCol,
-					fEffects[PlayerOptions::EFFECT_DRUNK_Z_OFFSET], DRUNK_Z_COLUMN_FREQUENCY,
-					fYOffset, fEffects[PlayerOptions::EFFECT_DRUNK_Z_PERIOD],
-					DRUNK_Z_OFFSET_FREQUENCY) ) * ARROW_SIZE*DRUNK_Z_ARROW_MAGNITUDE );
+	{
+		const float fTime = ArrowEffects::GetTime();
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_DRUNK_Z] *
+				( RageFastCos( CalculateDrunkAngle(fTime, fEffects[PlayerOptions::EFFECT_DRUNK_Z_SPEED], iCol,
+						fEffects[PlayerOptions::EFFECT_DRUNK_Z_OFFSET], DRUNK_Z_COLUMN_FREQUENCY,
+						pYOffset[i], fEffects[PlayerOptions::EFFECT_DRUNK_Z_PERIOD],
+						DRUNK_Z_OFFSET_FREQUENCY) ) * ARROW_SIZE*DRUNK_Z_ARROW_MAGNITUDE );
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_TAN_DRUNK_Z] != 0 )
-		fZPos += fEffects[PlayerOptions::EFFECT_TAN_DRUNK_Z] *
-			( SelectTanType( CalculateDrunkAngle(fEffects[PlayerOptions::EFFECT_TAN_DRUNK_Z_SPEED],
-					iCol, fEffects[PlayerOptions::EFFECT_TAN_DRUNK_Z_OFFSET],
-					DRUNK_Z_COLUMN_FREQUENCY, fYOffset,
-					fEffects[PlayerOptions::EFFECT_TAN_DRUNK_Z_PERIOD],
-					DRUNK_Z_OFFSET_FREQUENCY)
-					, curr_options->m_bCosecant) * ARROW_SIZE*DRUNK_Z_ARROW_MAGNITUDE );
+	{
+		const float fTime = ArrowEffects::GetTime();
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += fEffects[PlayerOptions::EFFECT_TAN_DRUNK_Z] *
+				( SelectTanType( CalculateDrunkAngle(fTime, fEffects[PlayerOptions::EFFECT_TAN_DRUNK_Z_SPEED],
+						iCol, fEffects[PlayerOptions::EFFECT_TAN_DRUNK_Z_OFFSET],
+						DRUNK_Z_COLUMN_FREQUENCY, pYOffset[i],
+						fEffects[PlayerOptions::EFFECT_TAN_DRUNK_Z_PERIOD],
+						DRUNK_Z_OFFSET_FREQUENCY)
+						, curr_options->m_bCosecant) * ARROW_SIZE*DRUNK_Z_ARROW_MAGNITUDE );
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_BEAT_Z] != 0 )
 	{
-		const float fShift = data.m_fBeatFactor[dim_z]*RageFastSin( fYOffset / ((fEffects[PlayerOptions::EFFECT_BEAT_Z_PERIOD]*BEAT_Z_OFFSET_HEIGHT)+BEAT_Z_OFFSET_HEIGHT) + PI/BEAT_Z_PI_HEIGHT );
-		fZPos += fEffects[PlayerOptions::EFFECT_BEAT_Z] * fShift;
+		const float fHeight = (fEffects[PlayerOptions::EFFECT_BEAT_Z_PERIOD]*BEAT_Z_OFFSET_HEIGHT)+BEAT_Z_OFFSET_HEIGHT;
+		const float fPhase = PI/BEAT_Z_PI_HEIGHT;
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			const float fShift = data.m_fBeatFactor[dim_z]*RageFastSin( pYOffset[i] / fHeight + fPhase );
+			pOut[i] += fEffects[PlayerOptions::EFFECT_BEAT_Z] * fShift;
+		}
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_DIGITAL_Z] != 0 )
-		fZPos += (fEffects[PlayerOptions::EFFECT_DIGITAL_Z] * ARROW_SIZE * 0.5f) *
-			std::round((fEffects[PlayerOptions::EFFECT_DIGITAL_Z_STEPS]+1) * RageFastSin(
-				CalculateDigitalAngle(fYOffset,
-				fEffects[PlayerOptions::EFFECT_DIGITAL_Z_OFFSET],
-				fEffects[PlayerOptions::EFFECT_DIGITAL_Z_PERIOD]) ) ) /(fEffects[PlayerOptions::EFFECT_DIGITAL_Z_STEPS]+1);
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_DIGITAL_Z] * ARROW_SIZE * 0.5f) *
+				std::round((fEffects[PlayerOptions::EFFECT_DIGITAL_Z_STEPS]+1) * RageFastSin(
+					CalculateDigitalAngle(pYOffset[i],
+					fEffects[PlayerOptions::EFFECT_DIGITAL_Z_OFFSET],
+					fEffects[PlayerOptions::EFFECT_DIGITAL_Z_PERIOD]) ) ) /(fEffects[PlayerOptions::EFFECT_DIGITAL_Z_STEPS]+1);
+	}
 
 	if( fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z] != 0 )
-		fZPos += (fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z] * ARROW_SIZE * 0.5f) *
-			std::round((fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z_STEPS]+1) * SelectTanType(
-				CalculateDigitalAngle(fYOffset,
-				fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z_OFFSET],
-				fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z_PERIOD]), curr_options->m_bCosecant ) ) /(fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z_STEPS]+1);
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z] * ARROW_SIZE * 0.5f) *
+				std::round((fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z_STEPS]+1) * SelectTanType(
+					CalculateDigitalAngle(pYOffset[i],
+					fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z_OFFSET],
+					fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z_PERIOD]), curr_options->m_bCosecant ) ) /(fEffects[PlayerOptions::EFFECT_TAN_DIGITAL_Z_STEPS]+1);
+	}
 
 
 	if( fEffects[PlayerOptions::EFFECT_SQUARE_Z] != 0 )
 	{
-		float fResult = RageSquare( (PI * (fYOffset+(1.0f*(fEffects[PlayerOptions::EFFECT_SQUARE_Z_OFFSET]))) /
-			(ARROW_SIZE+(fEffects[PlayerOptions::EFFECT_SQUARE_Z_PERIOD]*ARROW_SIZE))) );
-		fZPos += (fEffects[PlayerOptions::EFFECT_SQUARE_Z] * ARROW_SIZE * 0.5f) * fResult;
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			float fResult = RageSquare( (PI * (pYOffset[i]+(1.0f*(fEffects[PlayerOptions::EFFECT_SQUARE_Z_OFFSET]))) /
+				(ARROW_SIZE+(fEffects[PlayerOptions::EFFECT_SQUARE_Z_PERIOD]*ARROW_SIZE))) );
+			pOut[i] += (fEffects[PlayerOptions::EFFECT_SQUARE_Z] * ARROW_SIZE * 0.5f) * fResult;
+		}
 	}
 
 	if( fEffects[PlayerOptions::EFFECT_BOUNCE_Z] != 0 )
 	{
-		float fBounceAmt = std::abs( RageFastSin( ( (fYOffset + (1.0f * (fEffects[PlayerOptions::EFFECT_BOUNCE_Z_OFFSET]) ) ) /
-			( 60 + (fEffects[PlayerOptions::EFFECT_BOUNCE_Z_PERIOD]*60) ) ) ) );
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			float fBounceAmt = std::abs( RageFastSin( ( (pYOffset[i] + (1.0f * (fEffects[PlayerOptions::EFFECT_BOUNCE_Z_OFFSET]) ) ) /
+				( 60 + (fEffects[PlayerOptions::EFFECT_BOUNCE_Z_PERIOD]*60) ) ) ) );
 
-		fZPos += fEffects[PlayerOptions::EFFECT_BOUNCE_Z] * ARROW_SIZE * 0.5f * fBounceAmt;
+			pOut[i] += fEffects[PlayerOptions::EFFECT_BOUNCE_Z] * ARROW_SIZE * 0.5f * fBounceAmt;
+		}
 	}
+}
 
+float ArrowEffects::GetZPos( const PlayerState* pPlayerState, int iCol, float fYOffset)
+{
+	float fZPos;
+	GetZPosBatch( pPlayerState, iCol, &fYOffset, &fZPos, 1 );
 	return fZPos;
 }
 
@@ -1335,7 +1656,38 @@ bool ArrowEffects::NeedZBuffer()
 	return false;
 }
 
-float ArrowEffects::GetZoom( const PlayerState* pPlayerState, float fYOffset, int iCol )
+static void GetZoomVariableBatch( const float *pYOffset, float *pZoom, std::size_t iCount )
+{
+	if( curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_INNER] != 0 || curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_OUTER] != 0 )
+	{
+		const float fPulseInner = ArrowEffects::GetPulseInner();
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			float sine = RageFastSin(((pYOffset[i]+(100.0f*(curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_OFFSET])))/(0.4f*(ARROW_SIZE+(curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_PERIOD]*ARROW_SIZE)))));
+
+			pZoom[i] *= (sine*(curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_OUTER]*0.5f))+fPulseInner;
+		}
+	}
+	if( curr_options->m_fEffects[PlayerOptions::EFFECT_SHRINK_TO_MULT] !=0 )
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			if( pYOffset[i] >= 0 )
+				pZoom[i] *= 1/(1+(pYOffset[i]*(curr_options->m_fEffects[PlayerOptions::EFFECT_SHRINK_TO_MULT]/100.0f)));
+		}
+	}
+
+	if( curr_options->m_fEffects[PlayerOptions::EFFECT_SHRINK_TO_LINEAR] !=0 )
+	{
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			if( pYOffset[i] >= 0 )
+				pZoom[i] += pYOffset[i]*(0.5f*curr_options->m_fEffects[PlayerOptions::EFFECT_SHRINK_TO_LINEAR]/ARROW_SIZE);
+		}
+	}
+}
+
+static void GetZoomBatch( const PlayerState* pPlayerState, int iCol, const float *pYOffset, float *pOut, std::size_t iCount )
 {
 	float fZoom = 1.0f;
 	// Design change:  Instead of having a flag in the style that toggles a
@@ -1343,37 +1695,37 @@ float ArrowEffects::GetZoom( const PlayerState* pPlayerState, float fYOffset, in
 	// calculates a zoom factor to apply to the notefield and puts it in the
 	// PlayerState. -Kyz
 	fZoom*= pPlayerState->m_NotefieldZoom;
+	for( std::size_t i = 0; i < iCount; ++i )
+		pOut[i] = fZoom;
 
-	fZoom = GetZoomVariable( fYOffset, iCol, fZoom);
+	GetZoomVariableBatch( pYOffset, pOut, iCount );
 
 	float fTinyPercent = curr_options->m_fEffects[PlayerOptions::EFFECT_TINY];
 	if( fTinyPercent != 0 )
 	{
 		fTinyPercent = std::pow( 0.5f, fTinyPercent );
-		fZoom *= fTinyPercent;
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] *= fTinyPercent;
 	}
 	if( curr_options->m_fTiny[iCol] != 0 )
 	{
 		fTinyPercent = std::pow( 0.5f, curr_options->m_fTiny[iCol] );
-		fZoom *= fTinyPercent;
+		for( std::size_t i = 0; i < iCount; ++i )
+			pOut[i] *= fTinyPercent;
 	}
+}
+
+float ArrowEffects::GetZoom( const PlayerState* pPlayerState, float fYOffset, int iCol )
+{
+	float fZoom;
+	GetZoomBatch( pPlayerState, iCol, &fYOffset, &fZoom, 1 );
 	return fZoom;
 }
 
 float ArrowEffects::GetZoomVariable( float fYOffset, int iCol, float fCurZoom )
 {
 	float fZoom = fCurZoom;
-	if( curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_INNER] != 0 || curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_OUTER] != 0 )
-	{
-		float sine = RageFastSin(((fYOffset+(100.0f*(curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_OFFSET])))/(0.4f*(ARROW_SIZE+(curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_PERIOD]*ARROW_SIZE)))));
-
-		fZoom *= (sine*(curr_options->m_fEffects[PlayerOptions::EFFECT_PULSE_OUTER]*0.5f))+GetPulseInner();
-	}
-	if( curr_options->m_fEffects[PlayerOptions::EFFECT_SHRINK_TO_MULT] !=0 && fYOffset >= 0 )
-		fZoom *= 1/(1+(fYOffset*(curr_options->m_fEffects[PlayerOptions::EFFECT_SHRINK_TO_MULT]/100.0f)));
-
-	if( curr_options->m_fEffects[PlayerOptions::EFFECT_SHRINK_TO_LINEAR] !=0 && fYOffset >= 0 )
-		fZoom += fYOffset*(0.5f*curr_options->m_fEffects[PlayerOptions::EFFECT_SHRINK_TO_LINEAR]/ARROW_SIZE);
+	GetZoomVariableBatch( &fYOffset, &fZoom, 1 );
 	return fZoom;
 }
 
@@ -1391,6 +1743,54 @@ float ArrowEffects::GetPulseInner()
 	return fPulseInner;
 }
 
+void ArrowEffects::GetNoteBatch( const PlayerState* pPlayerState, int iCol, float fYReverseOffsetPixels, float fDrawDistanceBeforeTargetsPixels, float fFadeInPercentOfDrawFar, NoteBatch &batch )
+{
+	const std::size_t iCount = batch.size();
+	batch.x.resize( iCount );
+	batch.y.resize( iCount );
+	batch.z.resize( iCount );
+	batch.rot_x.resize( iCount );
+	batch.rot_y.resize( iCount );
+	batch.rot_z.resize( iCount );
+	batch.zoom.resize( iCount );
+	batch.alpha.resize( iCount );
+	batch.glow.resize( iCount );
+	batch.y_pos_no_reverse.resize( iCount );
+	batch.percent_visible.resize( iCount );
+	if( iCount == 0 )
+		return;
+
+	const float *pYOffset = batch.y_offset.data();
+
+	GetXPosBatch( pPlayerState, iCol, pYOffset, batch.x.data(), iCount );
+	GetYPosBatch( pPlayerState, iCol, pYOffset, fYReverseOffsetPixels, true, batch.y.data(), iCount );
+	GetZPosBatch( pPlayerState, iCol, pYOffset, batch.z.data(), iCount );
+	const float fMoveX = GetMoveX( iCol ), fMoveY = GetMoveY( iCol ), fMoveZ = GetMoveZ( iCol );
+	for( std::size_t i = 0; i < iCount; ++i )
+	{
+		batch.x[i] = fMoveX + batch.x[i];
+		batch.y[i] = fMoveY + batch.y[i];
+		batch.z[i] = fMoveZ + batch.z[i];
+	}
+
+	GetRotationsBatch( pPlayerState, iCol, batch );
+	GetZoomBatch( pPlayerState, iCol, pYOffset, batch.zoom.data(), iCount );
+
+	// Get the YPos without reverse (that is, factor in EFFECT_TIPSY).
+	GetYPosBatch( pPlayerState, iCol, pYOffset, fYReverseOffsetPixels, false, batch.y_pos_no_reverse.data(), iCount );
+	PercentVisibleArgs args;
+	PreparePercentVisible( args );
+	for( std::size_t i = 0; i < iCount; ++i )
+		batch.percent_visible[i] = GetPercentVisibleFromArgs( args, batch.y_pos_no_reverse[i], iCol, pYOffset[i] );
+
+	for( std::size_t i = 0; i < iCount; ++i )
+	{
+		batch.alpha[i] = GetAlphaFromPercentVisible( batch.percent_visible[i], batch.y_pos_no_reverse[i],
+			batch.percent_fade_to_fail[i], fDrawDistanceBeforeTargetsPixels, fFadeInPercentOfDrawFar );
+		batch.glow[i] = GetGlowFromPercentVisible( batch.percent_visible[i], batch.percent_fade_to_fail[i] );
+	}
+}
+
 static ThemeMetric<float>	FRAME_WIDTH_EFFECTS_PIXELS_PER_SECOND( "ArrowEffects", "FrameWidthEffectsPixelsPerSecond" );
 static ThemeMetric<float>	FRAME_WIDTH_EFFECTS_MIN_MULTIPLIER( "ArrowEffects", "FrameWidthEffectsMinMultiplier" );
 static ThemeMetric<float>	FRAME_WIDTH_EFFECTS_MAX_MULTIPLIER( "ArrowEffects", "FrameWidthEffectsMaxMultiplier" );
@@ -4,6 +4,9 @@
 #include "RageTypes.h"
 #include "PlayerNumber.h"
 
+#include <cstddef>
+#include <vector>
+
 class PlayerState;
 class PlayerOptions;
 /** @brief Functions that return properties of arrows based on Style and PlayerOptions. */
@@ -37,6 +40,55 @@ public:
 		ret.z= GetMoveZ(col) + GetZPos(player_state, col, y_offset);
 	}
 
+	// Several notes in one column, stored a field at a time, so that each
+	// effect can be applied to all of them in one loop.  Fill in the inputs
+	// with push_back, then call GetYOffsets and GetNoteBatch.  The results
+	// are the same as calling the single note functions for each note.
+	struct NoteBatch
+	{
+		// inputs
+		std::vector<float> beat;
+		std::vector<float> percent_fade_to_fail;
+		std::vector<char> hold_cap;
+		std::vector<char> hold_head;
+
+		// outputs
+		std::vector<float> y_offset;
+		std::vector<float> x, y, z;
+		std::vector<float> rot_x, rot_y, rot_z;
+		std::vector<float> zoom;
+		std::vector<float> alpha;
+		std::vector<float> glow;
+
+		// scratch space for GetYOffsets and GetNoteBatch
+		std::vector<float> note_seconds;
+		std::vector<float> y_pos_no_reverse;
+		std::vector<float> percent_visible;
+
+		void clear()
+		{
+			y_offset.clear();
+			beat.clear();
+			percent_fade_to_fail.clear();
+			hold_cap.clear();
+			hold_head.clear();
+		}
+		void push_back( float fBeat, float fPercentFadeToFail, bool bIsHoldCap, bool bIsHoldHead )
+		{
+			beat.push_back( fBeat );
+			percent_fade_to_fail.push_back( fPercentFadeToFail );
+			hold_cap.push_back( bIsHoldCap );
+			hold_head.push_back( bIsHoldHead );
+		}
+		std::size_t size() const { return beat.size(); }
+	};
+
+	// Fills in y_offset for every note in the batch, like GetYOffset.
+	static void GetYOffsets( const PlayerState* pPlayerState, int iCol, NoteBatch &batch );
+	// Fills in the position (with moves and reverse), rotation, zoom, alpha
+	// and glow of every note, from the y_offset already in the batch.
+	static void GetNoteBatch( const PlayerState* pPlayerState, int iCol, float fYReverseOffsetPixels, float fDrawDistanceBeforeTargetsPixels, float fFadeInPercentOfDrawFar, NoteBatch &batch );
+
 	/**
 	 * @brief Retrieve the actual display position.
 	 *
@@ -41,6 +41,7 @@ void Banner::Load( RageTextureID ID, bool bIsBanner )
 
 	m_fPercentScrolling = 0;
 	m_bScrolling = false;
+	m_sPendingCachedBanner = "";
 
 	TEXTUREMAN->DisableOddDimensionWarning();
 	TEXTUREMAN->VolatileTexture( ID );
@@ -70,6 +71,12 @@ void Banner::LoadFromCachedBanner( const RString &sPath )
 
 	if( TEXTUREMAN->IsTextureRegistered(ID) )
 		Load( ID );
+	else if( bLowRes && IMAGECACHE->IsImagePending(sPath) )
+	{
+		/* Show the fallback until the image cache has loaded it. */
+		LoadFallback();
+		m_sPendingCachedBanner = sPath;
+	}
 	else if( IsAFile(sPath) )
 		Load( sPath );
 	else
@@ -80,6 +87,9 @@ void Banner::Update( float fDeltaTime )
 {
 	Sprite::Update( fDeltaTime );
 
+	if( !m_sPendingCachedBanner.empty() && !IMAGECACHE->IsImagePending(m_sPendingCachedBanner) )
+		LoadFromCachedBanner( RString(m_sPendingCachedBanner) );
+
 	if( m_bScrolling )
 	{
 		m_fPercentScrolling += fDeltaTime/(float)SCROLL_SPEED_DIVISOR;
@@ -56,6 +56,8 @@ public:
 protected:
 	bool m_bScrolling;
 	float m_fPercentScrolling;
+	/* The cached banner we're waiting on the image cache for, if any. */
+	RString m_sPendingCachedBanner;
 };
 
 #endif
@@ -0,0 +1,260 @@
+#include "global.h"
+#include "Benchmark.h"
+#include "FrameProfiler.h"
+#include "GameCommand.h"
+#include "GamePreferences.h"
+#include "GameState.h"
+#include "JsonUtil.h"
+#include "PrefsManager.h"
+#include "RageLog.h"
+#include "RageTimer.h"
+#include "RageUtil.h"
+#include "ScreenGameplay.h"
+#include "ScreenManager.h"
+#include "arch/ArchHooks/ArchHooks.h"
+#include "json/json.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+#include <vector>
+
+#if defined(WITH_BENCHMARK_ALLOCATION_COUNT)
+/* Count allocations while a benchmark is measuring.  Replacing the global
+ * operator new is the only portable way to see all of them; the array and
+ * nothrow forms call this one.  This costs an atomic load on every
+ * allocation, so it's only built in with WITH_BENCHMARK_ALLOCATION_COUNT. */
+static std::atomic<bool> g_bCountAllocations( false );
+static std::atomic<std::uint64_t> g_iAllocations( 0 );
+
+void *operator new( std::size_t iSize )
+{
+	if( g_bCountAllocations.load(std::memory_order_relaxed) )
+		g_iAllocations.fetch_add( 1, std::memory_order_relaxed );
+	void *p = std::malloc( iSize != 0? iSize: 1 );
+	if( p == nullptr )
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete( void *p ) noexcept
+{
+	std::free( p );
+}
+
+void operator delete( void *p, std::size_t ) noexcept
+{
+	std::free( p );
+}
+#endif
+
+namespace
+{
+	RString g_sSong;
+	RString g_sStyle = "single";
+	RString g_sSteps = "Hard";
+	RString g_sMods;
+	RString g_sOutputPath = "/Logs/Benchmark.json";
+
+	bool g_bMeasuring = false;
+	bool g_bFinished = false;
+	RageTimer g_FrameTimer;
+	RageTimer g_RunTimer;
+	std::clock_t g_iStartClock;
+#if defined(WITH_BENCHMARK_ALLOCATION_COUNT)
+	std::uint64_t g_iLastAllocations;
+#endif
+	std::vector<float> g_vFrameSeconds;
+	std::vector<std::uint32_t> g_vFrameAllocations;
+	std::uint32_t g_iProfileCursor = 0;
+	std::vector<FrameProfiler::ScopeTotals> g_vScopeTotals;
+	bool g_bLostScopes = false;
+
+	/* v must be sorted. */
+	template<class T>
+	T Percentile( const std::vector<T> &v, float fPercent )
+	{
+		if( v.empty() )
+			return T();
+		std::size_t i = std::size_t( (v.size() - 1) * fPercent / 100 );
+		return v[i];
+	}
+
+	void BeginMeasuring()
+	{
+		g_bMeasuring = true;
+		g_FrameTimer.Touch();
+		g_RunTimer.Touch();
+		g_iStartClock = std::clock();
+
+		/* Skip the scopes recorded while loading. */
+		std::vector<FrameProfiler::ScopeTotals> vDiscard;
+		FrameProfiler::AddTotals( g_iProfileCursor, vDiscard );
+
+#if defined(WITH_BENCHMARK_ALLOCATION_COUNT)
+		g_iLastAllocations = g_iAllocations.load();
+		g_bCountAllocations.store( true );
+#endif
+	}
+
+	void WriteReport()
+	{
+		const double fWallSeconds = g_RunTimer.Ago();
+		const double fCpuSeconds = double( std::clock() - g_iStartClock ) / CLOCKS_PER_SEC;
+		const unsigned iFrames = g_vFrameSeconds.size();
+
+		std::vector<float> vSortedSeconds = g_vFrameSeconds;
+		std::sort( vSortedSeconds.begin(), vSortedSeconds.end() );
+		std::vector<std::uint32_t> vSortedAllocations = g_vFrameAllocations;
+		std::sort( vSortedAllocations.begin(), vSortedAllocations.end() );
+
+		double fTotalFrameSeconds = 0;
+		for( float f : g_vFrameSeconds )
+			fTotalFrameSeconds += f;
+		std::uint64_t iTotalAllocations = 0;
+		for( std::uint32_t i : g_vFrameAllocations )
+			iTotalAllocations += i;
+
+		Json::Value root;
+		root["Song"] = g_sSong;
+		root["Style"] = g_sStyle;
+		root["Steps"] = g_sSteps;
+		root["Mods"] = g_sMods;
+		root["UpdateSeconds"] = PREFSMAN->m_fConstantUpdateDeltaSeconds.Get();
+		root["Frames"] = iFrames;
+		root["WallSeconds"] = fWallSeconds;
+		root["CpuSeconds"] = fCpuSeconds;
+		root["FramesPerSecond"] = fWallSeconds > 0? iFrames / fWallSeconds: 0;
+
+		Json::Value &frame = root["FrameMs"];
+		frame["Mean"] = iFrames? fTotalFrameSeconds * 1000 / iFrames: 0;
+		frame["P50"] = Percentile( vSortedSeconds, 50 ) * 1000;
+		frame["P95"] = Percentile( vSortedSeconds, 95 ) * 1000;
+		frame["P99"] = Percentile( vSortedSeconds, 99 ) * 1000;
+		frame["Max"] = vSortedSeconds.empty()? 0: vSortedSeconds.back() * 1000;
+
+#if defined(WITH_BENCHMARK_ALLOCATION_COUNT)
+		Json::Value &allocations = root["Allocations"];
+		allocations["Total"] = Json::UInt64( iTotalAllocations );
+		allocations["PerFrame"] = iFrames? double(iTotalAllocations) / iFrames: 0;
+		allocations["P99"] = Percentile( vSortedAllocations, 99 );
+		allocations["Max"] = vSortedAllocations.empty()? 0: vSortedAllocations.back();
+#endif
+
+		/* Slowest first.  Scopes nest, so these don't add up to the frame time. */
+		std::sort( g_vScopeTotals.begin(), g_vScopeTotals.end(),
+			[]( const FrameProfiler::ScopeTotals &a, const FrameProfiler::ScopeTotals &b ) { return a.m_iTotalUsecs > b.m_iTotalUsecs; } );
+		Json::Value &scopes = root["Scopes"];
+		scopes = Json::Value( Json::arrayValue );
+		for( const FrameProfiler::ScopeTotals &t : g_vScopeTotals )
+		{
+			Json::Value scope;
+			scope["Name"] = t.m_sName;
+			scope["Calls"] = t.m_iCalls;
+			scope["TotalMs"] = t.m_iTotalUsecs / 1000.0;
+			scope["MsPerFrame"] = iFrames? t.m_iTotalUsecs / 1000.0 / iFrames: 0;
+			scope["MaxMs"] = t.m_iMaxUsecs / 1000.0;
+			scopes.append( scope );
+		}
+		root["ScopesComplete"] = !g_bLostScopes;
+
+		if( !JsonUtil::WriteFile(root, g_sOutputPath, false) )
+			LOG->Warn( "Benchmark: couldn't write \"%s\"", g_sOutputPath.c_str() );
+
+		RString sAllocations;
+#if defined(WITH_BENCHMARK_ALLOCATION_COUNT)
+		sAllocations = ssprintf( ", %.1f allocations per frame", iFrames? double(iTotalAllocations) / iFrames: 0 );
+#endif
+		LOG->Info( "Benchmark: %u frames in %.2fs (%.1f fps, %.2fs CPU), p99 frame %.2fms%s; wrote %s",
+			iFrames, fWallSeconds, fWallSeconds > 0? iFrames / fWallSeconds: 0, fCpuSeconds,
+			Percentile(vSortedSeconds, 99) * 1000, sAllocations.c_str(),
+			g_sOutputPath.c_str() );
+	}
+}
+
+bool Benchmark::IsEnabled()
+{
+	static const bool bEnabled = GetCommandlineArgument( "benchmark", &g_sSong );
+	return bEnabled;
+}
+
+void Benchmark::ApplyPreferences()
+{
+	GetCommandlineArgument( "style", &g_sStyle );
+	GetCommandlineArgument( "steps", &g_sSteps );
+	GetCommandlineArgument( "mods", &g_sMods );
+	GetCommandlineArgument( "benchmark-out", &g_sOutputPath );
+
+	PREFSMAN->m_sVideoRenderers.Set( "null" );
+	PREFSMAN->m_bShowLoadingWindow.Set( false );
+	IPreference *pSoundDrivers = IPreference::GetPreferenceByName( "SoundDrivers" );
+	ASSERT( pSoundDrivers != nullptr );
+	pSoundDrivers->FromString( "Null" );
+
+	/* Play the song at 60 updates a second of game time, however fast frames
+	 * actually go.  The null sound driver follows the same clock. */
+	if( PREFSMAN->m_fConstantUpdateDeltaSeconds <= 0 )
+		PREFSMAN->m_fConstantUpdateDeltaSeconds.Set( 1/60.0f );
+
+	FrameProfiler::SetEnabled( true );
+}
+
+void Benchmark::Start()
+{
+	GAMESTATE->JoinPlayer( PLAYER_1 );
+
+	GameCommand cmd;
+	cmd.Load( 0, ParseCommands(ssprintf("playmode,regular;style,%s;song,%s;steps,%s;screen,ScreenGameplay",
+		g_sStyle.c_str(), g_sSong.c_str(), g_sSteps.c_str())) );
+	RString sWhy;
+	if( cmd.m_bInvalid )
+		RageException::Throw( "Invalid benchmark: %s", cmd.m_sInvalidReason.c_str() );
+	if( !cmd.IsPlayable(&sWhy) )
+		RageException::Throw( "Invalid benchmark: %s", sWhy.c_str() );
+
+	GamePreferences::m_AutoPlay.Set( PC_AUTOPLAY );
+	cmd.ApplyToAllPlayers();
+	if( !g_sMods.empty() )
+		GAMESTATE->ApplyPreferredModifiers( PLAYER_1, g_sMods );
+
+	LOG->Info( "Benchmark: playing %s, %s %s, mods \"%s\"",
+		g_sSong.c_str(), g_sStyle.c_str(), g_sSteps.c_str(), g_sMods.c_str() );
+}
+
+void Benchmark::Update()
+{
+	if( g_bFinished )
+		return;
+
+	const bool bGameplay = dynamic_cast<ScreenGameplay *>( SCREENMAN->GetTopScreen() ) != nullptr;
+	if( !g_bMeasuring )
+	{
+		/* Start with the first frame after gameplay is loaded. */
+		if( bGameplay )
+			BeginMeasuring();
+		return;
+	}
+
+	if( !bGameplay )
+	{
+#if defined(WITH_BENCHMARK_ALLOCATION_COUNT)
+		g_bCountAllocations.store( false );
+#endif
+		g_bFinished = true;
+		WriteReport();
+		ArchHooks::SetUserQuit();
+		return;
+	}
+
+	g_vFrameSeconds.push_back( g_FrameTimer.GetDeltaTime() );
+#if defined(WITH_BENCHMARK_ALLOCATION_COUNT)
+	const std::uint64_t iAllocations = g_iAllocations.load();
+	g_vFrameAllocations.push_back( std::uint32_t(iAllocations - g_iLastAllocations) );
+	g_iLastAllocations = iAllocations;
+#endif
+	if( !FrameProfiler::AddTotals(g_iProfileCursor, g_vScopeTotals) )
+		g_bLostScopes = true;
+}
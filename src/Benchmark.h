@@ -0,0 +1,27 @@
+/* Benchmark - Play a chart unattended and measure each frame. */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/** @brief Autoplay one chart with the null renderer and sound driver at a
+ * fixed timestep, and write what the frames cost to a JSON file.
+ *
+ * This is started with --benchmark=Group/Song, and optionally --style=,
+ * --steps=, --mods= and --benchmark-out=. */
+namespace Benchmark
+{
+	/* Whether --benchmark was given. */
+	bool IsEnabled();
+
+	/* Override the preferences the run needs.  Call this after preferences
+	 * are read; preferences aren't saved during a benchmark. */
+	void ApplyPreferences();
+
+	/* Go to gameplay, instead of the initial screen. */
+	void Start();
+
+	/* Call once a frame.  This quits once gameplay is over. */
+	void Update();
+};
+
+#endif
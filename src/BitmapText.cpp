@@ -12,6 +12,8 @@
 
 #include <cmath>
 #include <cstddef>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 
@@ -33,6 +35,40 @@ REGISTER_ACTOR_CLASS( BitmapText );
 
 static std::vector<RageColor> RAINBOW_COLORS;
 
+/* Laying out text looks up every glyph and builds its quads.  Music wheels
+ * show the same titles over and over, in many BitmapTexts, so keep recent
+ * layouts and copy them instead. */
+namespace
+{
+	struct TextLayout
+	{
+		std::vector<std::wstring> m_wTextLines;
+		std::vector<int> m_iLineWidths;
+		RageVector2 m_Size;
+		std::vector<RageSpriteVertex> m_aVertices;
+		std::vector<FontPageTextures*> m_vpFontPageTextures;
+	};
+	const std::size_t MAX_CACHED_LAYOUTS = 1024;
+	std::unordered_map<std::string, TextLayout> g_TextLayouts;
+
+	std::string GetTextLayoutKey( const Font *pFont, const RString &sText, int iWrapWidthPixels, float fHorizAlign, int iVertSpacing )
+	{
+		struct
+		{
+			unsigned iFont;
+			int iWrapWidthPixels;
+			float fHorizAlign;
+			int iVertSpacing;
+		} params = { pFont->GetLoadSerial(), iWrapWidthPixels, fHorizAlign, iVertSpacing };
+
+		std::string sKey;
+		sKey.reserve( sizeof(params) + sText.size() );
+		sKey.append( reinterpret_cast<const char *>(&params), sizeof(params) );
+		sKey.append( sText );
+		return sKey;
+	}
+}
+
 BitmapText::BitmapText()
 {
 	// Loading these theme metrics is slow, so only do it every 20th time.
@@ -481,6 +517,25 @@ void BitmapText::SetText( const RString& _sText, const RString& _sAlternateText,
 
 void BitmapText::SetTextInternal()
 {
+	// Distorted layouts are random, so don't reuse them.
+	std::string sLayoutKey;
+	if( m_pFont != nullptr && !m_bUsingDistortion )
+	{
+		sLayoutKey = GetTextLayoutKey( m_pFont, m_sText, m_iWrapWidthPixels, m_fHorizAlign, m_iVertSpacing );
+		std::unordered_map<std::string, TextLayout>::const_iterator it = g_TextLayouts.find( sLayoutKey );
+		if( it != g_TextLayouts.end() )
+		{
+			const TextLayout &layout = it->second;
+			m_wTextLines = layout.m_wTextLines;
+			m_iLineWidths = layout.m_iLineWidths;
+			m_size = layout.m_Size;
+			m_aVertices = layout.m_aVertices;
+			m_vpFontPageTextures = layout.m_vpFontPageTextures;
+			UpdateBaseZoom();
+			return;
+		}
+	}
+
 	// Break the string into lines.
 
 	m_wTextLines.clear();
@@ -540,6 +595,21 @@ void BitmapText::SetTextInternal()
 	}
 
 	BuildChars();
+
+	// With no lines, BuildChars leaves the height alone; that isn't worth caching.
+	if( !sLayoutKey.empty() && !m_wTextLines.empty() )
+	{
+		if( g_TextLayouts.size() >= MAX_CACHED_LAYOUTS )
+			g_TextLayouts.clear();
+
+		TextLayout &layout = g_TextLayouts[sLayoutKey];
+		layout.m_wTextLines = m_wTextLines;
+		layout.m_iLineWidths = m_iLineWidths;
+		layout.m_Size = m_size;
+		layout.m_aVertices = m_aVertices;
+		layout.m_vpFontPageTextures = m_vpFontPageTextures;
+	}
+
 	UpdateBaseZoom();
 }
 
@@ -126,6 +126,8 @@ source_group("Data Structures\\\\Score Keepers"
 list(APPEND SM_DATA_SONG_SRC
             "Song.cpp"
             "SongCacheIndex.cpp"
+            "SongCacheRecord.cpp"
+            "SongDirWatcher.cpp"
             "SongOptions.cpp"
             "SongPosition.cpp"
             "SongUtil.cpp")
@@ -133,6 +135,8 @@ list(APPEND SM_DATA_SONG_SRC
 list(APPEND SM_DATA_SONG_HPP
             "Song.h"
             "SongCacheIndex.h"
+            "SongCacheRecord.h"
+            "SongDirWatcher.h"
             "SongOptions.h"
             "SongPosition.h"
             "SongUtil.h")
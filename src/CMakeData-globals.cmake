@@ -1,14 +1,20 @@
 list(APPEND SMDATA_GLOBAL_FILES_SRC
+            "Benchmark.cpp"
+            "FrameProfiler.cpp"
             "GameLoop.cpp"
             "global.cpp"
+            "InputLatency.cpp"
             "SpecialFiles.cpp"
             "StepMania.cpp" # TODO: Refactor into separate main project.
             "${SM_GENERATED_SRC_DIR}/verstub.cpp")
 
 list(APPEND SMDATA_GLOBAL_FILES_HPP
             "${SM_GENERATED_SRC_DIR}/config.hpp"
+            "Benchmark.h"
+            "FrameProfiler.h"
             "GameLoop.h"
             "global.h"
+            "InputLatency.h"
             "ProductInfo.h" # TODO: Have this be auto-generated.
             "SpecialFiles.h"
             "StdString.h" # TODO: Remove the need for this file, transition to
@@ -155,6 +155,7 @@ list(APPEND SMDATA_RAGE_SOUND_SRC
             "RageSound.cpp"
             "RageSoundManager.cpp"
             "RageSoundMixBuffer.cpp"
+            "RageSoundMixKernels.cpp"
             "RageSoundPosMap.cpp"
             "RageSoundReader.cpp"
             "RageSoundReader_Chain.cpp"
@@ -178,6 +179,7 @@ list(APPEND SMDATA_RAGE_SOUND_HPP
             "RageSound.h"
             "RageSoundManager.h"
             "RageSoundMixBuffer.h"
+            "RageSoundMixKernels.h"
             "RageSoundPosMap.h"
             "RageSoundReader.h"
             "RageSoundReader_Chain.h"
@@ -51,6 +51,15 @@ void FadingBanner::UpdateInternal( float fDeltaTime )
 	}
 
 	m_bSkipNextBannerUpdate = false;
+
+	/* Fade in a cached banner once the image cache has loaded it. */
+	if( !m_sPendingBanner.empty() && !IMAGECACHE->IsImagePending(m_sPendingBanner) )
+	{
+		RageTextureID ID = IMAGECACHE->LoadCachedImage( "Banner", m_sPendingBanner );
+		m_sPendingBanner = "";
+		if( TEXTUREMAN->IsTextureRegistered(ID) )
+			Load( ID );
+	}
 }
 
 void FadingBanner::DrawPrimitives()
@@ -94,6 +103,8 @@ void FadingBanner::Load( RageTextureID ID, bool bLowResToHighRes )
  * corresponding high-res banner. */
 void FadingBanner::BeforeChange( bool bLowResToHighRes )
 {
+	m_sPendingBanner = "";
+
 	RString sCommand;
 	if( bLowResToHighRes )
 		sCommand = "FadeFromCached";
@@ -140,6 +151,17 @@ bool FadingBanner::LoadFromCachedBanner( const RString &path )
 		ID = IMAGECACHE->LoadCachedImage( "Banner", path );
 	}
 
+	if( !TEXTUREMAN->IsTextureRegistered(ID) && bLowRes && IMAGECACHE->IsImagePending(path) )
+	{
+		/* The image cache is still loading it.  Show the fallback banner (or
+		 * keep the one that's there, if we're moving fast) until it's ready;
+		 * UpdateInternal will fade it in. */
+		if( !m_bMovingFast )
+			LoadFallback();
+		m_sPendingBanner = path;
+		return true;
+	}
+
 	if( !TEXTUREMAN->IsTextureRegistered(ID) )
 	{
 		/* Oops. We couldn't load a banner quickly. We can load the actual
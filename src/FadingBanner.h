@@ -52,6 +52,9 @@ protected:
 
 	bool	m_bMovingFast;
 	bool	m_bSkipNextBannerUpdate;
+
+	/* The cached banner we're waiting on the image cache for, if any. */
+	RString	m_sPendingBanner;
 };
 
 #endif
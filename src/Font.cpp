@@ -11,6 +11,7 @@
 #include "FontCharAliases.h"
 #include "arch/Dialog/Dialog.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <vector>
@@ -279,7 +280,10 @@ std::size_t Font::GetGlyphsThatFit(const std::wstring& line, int* width) const
 Font::Font(): m_iRefCount(1), path(""), m_apPages(), m_pDefault(nullptr),
 	m_iCharToGlyph(), m_bRightToLeft(false), m_bDistanceField(false),
 	// strokes aren't shown by default, hence the Color.
-	m_DefaultStrokeColor(RageColor(0,0,0,0)), m_sChars("") {}
+	m_DefaultStrokeColor(RageColor(0,0,0,0)), m_sChars(""), m_iLoadSerial(0)
+{
+	BuildGlyphTable();
+}
 Font::~Font()
 {
 	Unload();
@@ -293,6 +297,7 @@ void Font::Unload()
 	m_apPages.clear();
 
 	m_iCharToGlyph.clear();
+	BuildGlyphTable();
 	m_pDefault = nullptr;
 
 	/* Don't clear the refcount. We've unloaded, but that doesn't mean things
@@ -364,8 +369,12 @@ const glyph &Font::GetGlyph( wchar_t c ) const
 	}
 
 	// Fast path:
-	if( c < (int) ARRAYLEN(m_iCharToGlyphCache) && m_iCharToGlyphCache[c] )
-		return *m_iCharToGlyphCache[c];
+	if( c <= 0xFFFF )
+	{
+		const glyph *pGlyph = m_apGlyphTable[(m_iGlyphBlocks[c >> 8] << 8) | (c & 0xFF)];
+		if( pGlyph != nullptr )
+			return *pGlyph;
+	}
 
 	// Try the regular character.
 	std::map<wchar_t, glyph*>::const_iterator it = m_iCharToGlyph.find(c);
@@ -456,6 +465,62 @@ RString Font::GetPageNameFromFileName( const RString &sFilename )
 	return sFilename.substr( begin, end-begin+1 );
 }
 
+void Font::GetTextureIDs( const RString &sIniPath, std::vector<RageTextureID> &vIDsOut )
+{
+	std::vector<RString> vsLoadStack;
+	GetTextureIDsRecursive( sIniPath, vIDsOut, vsLoadStack );
+}
+
+// Mirrors the import and page handling in Load() and FontPage::Load().
+void Font::GetTextureIDsRecursive( const RString &sIniPath, std::vector<RageTextureID> &vIDsOut, std::vector<RString> &vsLoadStack )
+{
+	if( std::find(vsLoadStack.begin(), vsLoadStack.end(), sIniPath) != vsLoadStack.end() )
+		return;
+	vsLoadStack.push_back( sIniPath );
+
+	IniFile ini;
+	ini.ReadFile( sIniPath );
+	ini.RenameKey("Char Widths", "main");
+
+	std::vector<RString> ImportList;
+	if( vsLoadStack.size() == 1 )
+		ImportList.push_back("Common default");
+	RString imports;
+	ini.GetValue( "main", "import", imports );
+	split(imports, ",", ImportList, true);
+	for( unsigned i = 0; i < ImportList.size(); ++i )
+	{
+		RString sPath = THEME->GetPathF( "", ImportList[i], true );
+		if( !sPath.empty() )
+			GetTextureIDsRecursive( sPath, vIDsOut, vsLoadStack );
+	}
+
+	std::vector<RString> asTexturePaths;
+	GetFontPaths( sIniPath, asTexturePaths );
+	for( unsigned i = 0; i < asTexturePaths.size(); ++i )
+	{
+		const RString &sTexturePath = asTexturePaths[i];
+		if( sTexturePath.find("-stroke") != std::string::npos )
+			continue;
+
+		RString sHints = "default";
+		ini.GetValue( "common", "TextureHints", sHints );
+		ini.GetValue( GetPageNameFromFileName(sTexturePath), "TextureHints", sHints );
+
+		RageTextureID ID( sTexturePath );
+		if( sHints != "default" )
+			ID.AdditionalTextureHints = sHints;
+		vIDsOut.push_back( ID );
+
+		if( ID.filename.find("]") != std::string::npos )
+		{
+			ID.filename.Replace( "]", "-stroke]" );
+			if( IsAFile(ID.filename) )
+				vIDsOut.push_back( ID );
+		}
+	}
+}
+
 void Font::LoadFontPageSettings( FontPageSettings &cfg, IniFile &ini, const RString &sTexturePath, const RString &sPageName, RString sChars )
 {
 	cfg.m_sTexturePath = sTexturePath;
@@ -902,14 +967,35 @@ void Font::Load( const RString &sIniPath, RString sChars )
 	LoadStack.pop_back();
 
 	if( LoadStack.empty() )
+		BuildGlyphTable();
+}
+
+void Font::BuildGlyphTable()
+{
+	std::map<wchar_t,glyph*>::const_iterator mapDefault = m_iCharToGlyph.find( FONT_DEFAULT_GLYPH );
+	const glyph *pDefault = mapDefault != m_iCharToGlyph.end()? mapDefault->second: nullptr;
+
+	// Block 0 is for blocks with no characters.
+	m_apGlyphTable.assign( 256, pDefault );
+	memset( m_iGlyphBlocks, 0, sizeof(m_iGlyphBlocks) );
+
+	for( std::map<wchar_t,glyph*>::const_iterator it = m_iCharToGlyph.begin(); it != m_iCharToGlyph.end(); ++it )
 	{
-		// Cache ASCII glyphs.
-		ZERO( m_iCharToGlyphCache );
-		std::map<wchar_t,glyph*>::iterator it;
-		for( it = m_iCharToGlyph.begin(); it != m_iCharToGlyph.end(); ++it )
-			if( it->first < (int) ARRAYLEN(m_iCharToGlyphCache) )
-				m_iCharToGlyphCache[it->first] = it->second;
+		const int c = it->first;
+		if( c < 0 || c > 0xFFFF )
+			continue;
+
+		std::uint16_t &iBlock = m_iGlyphBlocks[c >> 8];
+		if( iBlock == 0 )
+		{
+			iBlock = std::uint16_t( m_apGlyphTable.size() >> 8 );
+			m_apGlyphTable.insert( m_apGlyphTable.end(), 256, pDefault );
+		}
+		m_apGlyphTable[(iBlock << 8) | (c & 0xFF)] = it->second;
 	}
+
+	static unsigned s_iLoadSerial = 0;
+	m_iLoadSerial = ++s_iLoadSerial;
 }
 
 /*
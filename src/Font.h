@@ -8,6 +8,7 @@
 #include "RageTypes.h"
 
 #include <cstddef>
+#include <cstdint>
 #include <map>
 #include <vector>
 
@@ -190,6 +191,19 @@ public:
 	bool IsDistanceField() const { return m_bDistanceField; };
 	const RageColor &GetDefaultStrokeColor() const { return m_DefaultStrokeColor; };
 
+	/** @brief A number that changes whenever any font's glyphs change, for
+	 * caching things that depend on them. */
+	unsigned GetLoadSerial() const { return m_iLoadSerial; }
+
+	/**
+	 * @brief Find the texture IDs Load() would use for a font, including its imports.
+	 *
+	 * This reads only the INI, so the textures can be prefetched before the
+	 * font itself is loaded.
+	 * @param sIniPath the font's INI.
+	 * @param vIDsOut the page and stroke textures are appended here. */
+	static void GetTextureIDs( const RString &sIniPath, std::vector<RageTextureID> &vIDsOut );
+
 private:
 	/** @brief List of pages and fonts that we use (and are responsible for freeing). */
 	std::vector<FontPage *> m_apPages;
@@ -203,8 +217,15 @@ private:
 
 	/** @brief Map from characters to glyphs. */
 	std::map<wchar_t,glyph*> m_iCharToGlyph;
-	/** @brief Each glyph is part of one of the pages[]. */
-	glyph *m_iCharToGlyphCache[128];
+	/**
+	 * @brief The glyph for each character in the BMP, or the default glyph.
+	 *
+	 * This is m_iCharToGlyph in blocks of 256 characters: the glyph for c is
+	 * block m_iGlyphBlocks[c >> 8], entry c & 0xFF.  Blocks with no
+	 * characters all share the same block. */
+	std::vector<const glyph *> m_apGlyphTable;
+	std::uint16_t m_iGlyphBlocks[256];
+	void BuildGlyphTable();
 
 	/**
 	 * @brief True for Hebrew, Arabic, Urdu fonts.
@@ -220,9 +241,12 @@ private:
 	/** @brief We keep this around only for reloading. */
 	RString m_sChars;
 
+	unsigned m_iLoadSerial;
+
 	void LoadFontPageSettings( FontPageSettings &cfg, IniFile &ini, const RString &sTexturePath, const RString &PageName, RString sChars );
 	static void GetFontPaths( const RString &sFontOrTextureFilePath, std::vector<RString> &sTexturePaths );
-	RString GetPageNameFromFileName( const RString &sFilename );
+	static RString GetPageNameFromFileName( const RString &sFilename );
+	static void GetTextureIDsRecursive( const RString &sIniPath, std::vector<RageTextureID> &vIDsOut, std::vector<RString> &vsLoadStack );
 
 	Font(const Font& rhs);
 	Font& operator=(const Font& rhs);
@@ -68,10 +68,8 @@ And here's one for a kanji page:
 
  */
 
-static void InitCharAliases()
+static void InitCharAliasesOnce()
 {
-	if(!CharAliases.empty())
-		return;
 
 	CharAliases["default"]		= FONT_DEFAULT_GLYPH;	// ?
 	CharAliases["invalid"]		= INVALID_CHAR;			// 0xFFFD
@@ -369,6 +367,14 @@ static void InitCharAliases()
 	}
 }
 
+static void InitCharAliases()
+{
+	// Titles can be substituted from several song loading threads at once;
+	// the static initializer makes sure the tables are only built once.
+	static const bool bInitialized = ( InitCharAliasesOnce(), true );
+	(void) bInitialized;
+}
+
 // Replace all &markers; and &#NNNN;s with UTF-8.
 void FontCharAliases::ReplaceMarkers( RString &sText )
 {
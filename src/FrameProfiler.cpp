@@ -0,0 +1,372 @@
+#include "global.h"
+#include "FrameProfiler.h"
+#include "Preference.h"
+#include "RageFile.h"
+#include "RageThreads.h"
+#include "RageTimer.h"
+#include "RageUtil.h"
+#include "LuaManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <set>
+
+static Preference<bool> g_bFrameProfiler( "FrameProfiler", false );
+
+/* Keep this many of the most recent scopes.  At a few hundred scopes a frame,
+ * this is a few seconds of frames. */
+static const unsigned NUM_EVENTS = 65536;
+
+namespace
+{
+	/* m_iSequence is one more than the event's index once it's written, and
+	 * 0 while it's being written. */
+	struct Event
+	{
+		std::atomic<std::uint32_t> m_iSequence;
+		std::atomic<const char *> m_sName;
+		std::atomic<std::uint64_t> m_iStartUsecs;
+		std::atomic<std::uint32_t> m_iDurationUsecs;
+		std::atomic<std::uint32_t> m_iFrame;
+		std::atomic<std::uint64_t> m_iThreadID;
+		std::atomic<int> m_iDepth;
+	};
+	Event g_Events[NUM_EVENTS];
+	std::atomic<std::uint32_t> g_iNextEvent;
+	std::atomic<std::uint32_t> g_iFrame;
+
+	thread_local int g_iDepth = 0;
+
+	/* A copy of an event that was completely written. */
+	struct EventCopy
+	{
+		const char *m_sName;
+		std::uint64_t m_iStartUsecs;
+		std::uint32_t m_iDurationUsecs;
+		std::uint32_t m_iFrame;
+		std::uint64_t m_iThreadID;
+		int m_iDepth;
+	};
+
+	/* Copy out the recorded events, oldest first, skipping any that are being
+	 * overwritten, or were cleared by Reset. */
+	void CopyEvents( std::vector<EventCopy> &out )
+	{
+		const std::uint32_t iEnd = g_iNextEvent;
+		const std::uint32_t iBegin = iEnd > NUM_EVENTS? iEnd - NUM_EVENTS: 0;
+		out.reserve( iEnd - iBegin );
+		for( std::uint32_t i = iBegin; i != iEnd; ++i )
+		{
+			const Event &e = g_Events[i % NUM_EVENTS];
+			if( e.m_iSequence.load(std::memory_order_acquire) != i + 1 )
+				continue;
+
+			EventCopy c;
+			c.m_sName = e.m_sName.load( std::memory_order_relaxed );
+			c.m_iStartUsecs = e.m_iStartUsecs.load( std::memory_order_relaxed );
+			c.m_iDurationUsecs = e.m_iDurationUsecs.load( std::memory_order_relaxed );
+			c.m_iFrame = e.m_iFrame.load( std::memory_order_relaxed );
+			c.m_iThreadID = e.m_iThreadID.load( std::memory_order_relaxed );
+			c.m_iDepth = e.m_iDepth.load( std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_acquire );
+			if( e.m_iSequence.load(std::memory_order_relaxed) != i + 1 )
+				continue;
+			out.push_back( c );
+		}
+	}
+
+	struct NameLess
+	{
+		bool operator()( const char *a, const char *b ) const { return std::strcmp( a, b ) < 0; }
+	};
+}
+
+bool FrameProfiler::IsEnabled()
+{
+	return g_bFrameProfiler;
+}
+
+void FrameProfiler::SetEnabled( bool b )
+{
+	g_bFrameProfiler.Set( b );
+}
+
+void FrameProfiler::BeginFrame()
+{
+	++g_iFrame;
+}
+
+std::uint64_t FrameProfiler::BeginScope()
+{
+	++g_iDepth;
+	return RageTimer::GetUsecsSinceStart();
+}
+
+void FrameProfiler::EndScope( const char *sName, std::uint64_t iStartUsecs )
+{
+	const std::uint64_t iEndUsecs = RageTimer::GetUsecsSinceStart();
+	--g_iDepth;
+
+	const std::uint32_t iIndex = g_iNextEvent++;
+	Event &e = g_Events[iIndex % NUM_EVENTS];
+	e.m_iSequence.store( 0, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	e.m_sName.store( sName, std::memory_order_relaxed );
+	e.m_iStartUsecs.store( iStartUsecs, std::memory_order_relaxed );
+	e.m_iDurationUsecs.store( std::uint32_t(iEndUsecs - iStartUsecs), std::memory_order_relaxed );
+	e.m_iFrame.store( g_iFrame.load(std::memory_order_relaxed), std::memory_order_relaxed );
+	e.m_iThreadID.store( RageThread::GetCurrentThreadID(), std::memory_order_relaxed );
+	e.m_iDepth.store( g_iDepth, std::memory_order_relaxed );
+	e.m_iSequence.store( iIndex + 1, std::memory_order_release );
+}
+
+void FrameProfiler::GetSlowestScopes( float fSeconds, unsigned iMax, std::vector<ScopeStats> &out )
+{
+	out.clear();
+
+	std::vector<EventCopy> vEvents;
+	CopyEvents( vEvents );
+
+	const std::uint64_t iNowUsecs = RageTimer::GetUsecsSinceStart();
+	const std::uint64_t iWindowUsecs = std::uint64_t( fSeconds * 1000000 );
+	const std::uint64_t iSinceUsecs = iNowUsecs > iWindowUsecs? iNowUsecs - iWindowUsecs: 0;
+
+	struct Totals
+	{
+		ScopeStats m_Stats;
+		std::uint64_t m_iTotalUsecs;
+		std::uint32_t m_iFrame;
+		std::uint64_t m_iFrameUsecs;
+		std::uint64_t m_iMaxFrameUsecs;
+	};
+	std::map<const char *, Totals, NameLess> mapTotals;
+	std::uint32_t iFirstFrame = 0, iLastFrame = 0;
+	bool bAny = false;
+
+	for( const EventCopy &e : vEvents )
+	{
+		if( e.m_iStartUsecs + e.m_iDurationUsecs < iSinceUsecs )
+			continue;
+
+		if( !bAny )
+			iFirstFrame = e.m_iFrame;
+		iLastFrame = std::max( iLastFrame, e.m_iFrame );
+		bAny = true;
+
+		auto it = mapTotals.find( e.m_sName );
+		if( it == mapTotals.end() )
+		{
+			Totals t;
+			t.m_Stats.m_sName = e.m_sName;
+			t.m_Stats.m_iDepth = e.m_iDepth;
+			t.m_Stats.m_iCalls = 0;
+			t.m_iTotalUsecs = 0;
+			t.m_iFrame = e.m_iFrame;
+			t.m_iFrameUsecs = 0;
+			t.m_iMaxFrameUsecs = 0;
+			it = mapTotals.insert( std::make_pair(e.m_sName, t) ).first;
+		}
+
+		Totals &t = it->second;
+		if( t.m_iFrame != e.m_iFrame )
+		{
+			t.m_iMaxFrameUsecs = std::max( t.m_iMaxFrameUsecs, t.m_iFrameUsecs );
+			t.m_iFrame = e.m_iFrame;
+			t.m_iFrameUsecs = 0;
+		}
+		t.m_Stats.m_iDepth = std::min( t.m_Stats.m_iDepth, e.m_iDepth );
+		++t.m_Stats.m_iCalls;
+		t.m_iTotalUsecs += e.m_iDurationUsecs;
+		t.m_iFrameUsecs += e.m_iDurationUsecs;
+	}
+
+	const unsigned iFrames = bAny? iLastFrame - iFirstFrame + 1: 1;
+	for( auto &it : mapTotals )
+	{
+		Totals &t = it.second;
+		t.m_Stats.m_fMeanMs = t.m_iTotalUsecs / 1000.0f / iFrames;
+		t.m_Stats.m_fMaxMs = std::max( t.m_iMaxFrameUsecs, t.m_iFrameUsecs ) / 1000.0f;
+		out.push_back( t.m_Stats );
+	}
+
+	std::sort( out.begin(), out.end(), []( const ScopeStats &a, const ScopeStats &b ) { return a.m_fMaxMs > b.m_fMaxMs; } );
+	if( out.size() > iMax )
+		out.resize( iMax );
+}
+
+bool FrameProfiler::AddTotals( std::uint32_t &iCursor, std::vector<ScopeTotals> &vTotals )
+{
+	const std::uint32_t iEnd = g_iNextEvent;
+	bool bComplete = true;
+	if( iEnd - iCursor > NUM_EVENTS )
+	{
+		iCursor = iEnd - NUM_EVENTS;
+		bComplete = false;
+	}
+
+	for( ; iCursor != iEnd; ++iCursor )
+	{
+		const Event &e = g_Events[iCursor % NUM_EVENTS];
+		if( e.m_iSequence.load(std::memory_order_acquire) != iCursor + 1 )
+			continue;
+		const char *sName = e.m_sName.load( std::memory_order_relaxed );
+		const std::uint32_t iDurationUsecs = e.m_iDurationUsecs.load( std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_acquire );
+		if( e.m_iSequence.load(std::memory_order_relaxed) != iCursor + 1 )
+			continue;
+
+		/* There are only a few dozen distinct scopes, so a linear search is
+		 * fine.  Names are usually the same literal, so compare pointers first. */
+		auto it = std::find_if( vTotals.begin(), vTotals.end(), [sName]( const ScopeTotals &t ) {
+			return t.m_sName == sName || std::strcmp( t.m_sName, sName ) == 0;
+		} );
+		if( it == vTotals.end() )
+		{
+			ScopeTotals t;
+			t.m_sName = sName;
+			t.m_iCalls = 0;
+			t.m_iTotalUsecs = 0;
+			t.m_iMaxUsecs = 0;
+			vTotals.push_back( t );
+			it = vTotals.end() - 1;
+		}
+		++it->m_iCalls;
+		it->m_iTotalUsecs += iDurationUsecs;
+		it->m_iMaxUsecs = std::max( it->m_iMaxUsecs, iDurationUsecs );
+	}
+	return bComplete;
+}
+
+void FrameProfiler::Reset()
+{
+	for( Event &e : g_Events )
+		e.m_iSequence = 0;
+}
+
+static RString JsonString( const RString &s )
+{
+	RString sRet = "\"";
+	for( char c : s )
+	{
+		if( c == '"' || c == '\\' )
+			sRet += '\\';
+		if( (unsigned char) c < 0x20 )
+			continue;
+		sRet += c;
+	}
+	return sRet + "\"";
+}
+
+bool FrameProfiler::WriteChromeTrace( const RString &sPath, RString &sError )
+{
+	std::vector<EventCopy> vEvents;
+	CopyEvents( vEvents );
+
+	RageFile f;
+	if( !f.Open(sPath, RageFile::WRITE) )
+	{
+		sError = f.GetError();
+		return false;
+	}
+
+	f.PutLine( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+
+	/* Name each thread that recorded a scope. */
+	std::set<std::uint64_t> setThreads;
+	for( const EventCopy &e : vEvents )
+		setThreads.insert( e.m_iThreadID );
+	RString sSeparator = "";
+	for( std::uint64_t iThreadID : setThreads )
+	{
+		f.PutLine( sSeparator + ssprintf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%llu,\"args\":{\"name\":%s}}",
+			(unsigned long long) iThreadID, JsonString(RageThread::GetThreadNameByID(iThreadID)).c_str()) );
+		sSeparator = ",";
+	}
+
+	for( const EventCopy &e : vEvents )
+	{
+		f.PutLine( sSeparator + ssprintf("{\"name\":%s,\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%llu,\"dur\":%u,\"args\":{\"frame\":%u}}",
+			JsonString(e.m_sName).c_str(), (unsigned long long) e.m_iThreadID,
+			(unsigned long long) e.m_iStartUsecs, e.m_iDurationUsecs, e.m_iFrame) );
+		sSeparator = ",";
+	}
+
+	f.PutLine( "]}" );
+
+	if( f.Flush() == -1 )
+	{
+		sError = f.GetError();
+		return false;
+	}
+	return true;
+}
+
+// lua start
+#include "LuaBinding.h"
+
+namespace
+{
+	int IsEnabled( lua_State *L )
+	{
+		lua_pushboolean( L, FrameProfiler::IsEnabled() );
+		return 1;
+	}
+
+	int SetEnabled( lua_State *L )
+	{
+		FrameProfiler::SetEnabled( BArg(1) );
+		return 0;
+	}
+
+	// ( float fSeconds, int iMax ): { { Name, Depth, Calls, Mean, Max }, ... }, in milliseconds
+	int GetSlowestScopes( lua_State *L )
+	{
+		std::vector<FrameProfiler::ScopeStats> vStats;
+		FrameProfiler::GetSlowestScopes( FArg(1), std::max(IArg(2), 0), vStats );
+
+		lua_createtable( L, vStats.size(), 0 );
+		for( unsigned i = 0; i < vStats.size(); ++i )
+		{
+			const FrameProfiler::ScopeStats &stats = vStats[i];
+			lua_createtable( L, 0, 5 );
+			lua_pushstring( L, stats.m_sName );	lua_setfield( L, -2, "Name" );
+			lua_pushinteger( L, stats.m_iDepth );	lua_setfield( L, -2, "Depth" );
+			lua_pushinteger( L, stats.m_iCalls );	lua_setfield( L, -2, "Calls" );
+			lua_pushnumber( L, stats.m_fMeanMs );	lua_setfield( L, -2, "Mean" );
+			lua_pushnumber( L, stats.m_fMaxMs );	lua_setfield( L, -2, "Max" );
+			lua_rawseti( L, -2, i+1 );
+		}
+		return 1;
+	}
+
+	int Reset( lua_State *L )
+	{
+		FrameProfiler::Reset();
+		return 0;
+	}
+
+	// ( string sPath ): bool
+	int WriteChromeTrace( lua_State *L )
+	{
+		RString sError;
+		const bool bOK = FrameProfiler::WriteChromeTrace( SArg(1), sError );
+		if( !bOK )
+			LuaHelpers::ReportScriptErrorFmt( "FrameProfiler.WriteChromeTrace: %s", sError.c_str() );
+		lua_pushboolean( L, bOK );
+		return 1;
+	}
+
+	const luaL_Reg FrameProfilerTable[] =
+	{
+		LIST_METHOD( IsEnabled ),
+		LIST_METHOD( SetEnabled ),
+		LIST_METHOD( GetSlowestScopes ),
+		LIST_METHOD( Reset ),
+		LIST_METHOD( WriteChromeTrace ),
+		{ nullptr, nullptr }
+	};
+}
+
+LUA_REGISTER_NAMESPACE( FrameProfiler )
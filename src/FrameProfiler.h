@@ -0,0 +1,89 @@
+/* FrameProfiler - Times the parts of each frame. */
+
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <cstdint>
+#include <vector>
+
+/** @brief Time named scopes and keep the most recent ones in a ring buffer,
+ * to find what a slow frame spent its time on.  This does nothing unless the
+ * FrameProfiler preference is set. */
+namespace FrameProfiler
+{
+	bool IsEnabled();
+	void SetEnabled( bool b );
+
+	/* Start a new frame.  Scopes are tagged with the frame they end in. */
+	void BeginFrame();
+
+	/* Use FrameProfileScope instead of calling these.  Scope names aren't
+	 * copied, so they must be string literals.  These may be called from any
+	 * thread. */
+	std::uint64_t BeginScope();
+	void EndScope( const char *sName, std::uint64_t iStartUsecs );
+
+	/* The time spent in a scope over recent frames, in milliseconds. */
+	struct ScopeStats
+	{
+		const char *m_sName;
+		int m_iDepth;		// how deeply it's nested, in the shallowest call
+		unsigned m_iCalls;
+		float m_fMeanMs;	// per frame
+		float m_fMaxMs;		// in one frame
+	};
+
+	/* Get the scopes that ended in the last fSeconds, slowest frame first. */
+	void GetSlowestScopes( float fSeconds, unsigned iMax, std::vector<ScopeStats> &out );
+
+	/* The time spent in a scope over any number of frames. */
+	struct ScopeTotals
+	{
+		const char *m_sName;
+		unsigned m_iCalls;
+		std::uint64_t m_iTotalUsecs;
+		std::uint32_t m_iMaxUsecs;	// in one call
+	};
+
+	/* Add the scopes that ended since iCursor to vTotals, and move iCursor
+	 * past them.  Call this at least every few frames; returns false if scopes
+	 * were overwritten before they were counted. */
+	bool AddTotals( std::uint32_t &iCursor, std::vector<ScopeTotals> &vTotals );
+
+	/* Forget all recorded scopes. */
+	void Reset();
+
+	/* Write the recorded scopes as a Chrome trace, which can be loaded in
+	 * chrome://tracing or Perfetto. */
+	bool WriteChromeTrace( const RString &sPath, RString &sError );
+};
+
+/** @brief Time the enclosing block. */
+class FrameProfileScope
+{
+public:
+	FrameProfileScope( const char *sName )
+	{
+		m_sName = FrameProfiler::IsEnabled()? sName: nullptr;
+		if( m_sName != nullptr )
+			m_iStartUsecs = FrameProfiler::BeginScope();
+	}
+	~FrameProfileScope()
+	{
+		if( m_sName != nullptr )
+			FrameProfiler::EndScope( m_sName, m_iStartUsecs );
+	}
+
+private:
+	FrameProfileScope( const FrameProfileScope & ) = delete;
+	FrameProfileScope &operator=( const FrameProfileScope & ) = delete;
+
+	const char *m_sName;
+	std::uint64_t m_iStartUsecs;
+};
+
+#define PROFILE_SCOPE_NAME2( line ) FrameProfileScope_##line
+#define PROFILE_SCOPE_NAME( line ) PROFILE_SCOPE_NAME2( line )
+#define PROFILE_SCOPE( sName ) FrameProfileScope PROFILE_SCOPE_NAME(__LINE__)( sName )
+
+#endif
@@ -1,5 +1,7 @@
 #include "global.h"
 #include "GameLoop.h"
+#include "Benchmark.h"
+#include "FrameProfiler.h"
 #include "RageLog.h"
 #include "RageTextureManager.h"
 #include "RageSoundManager.h"
@@ -18,6 +20,7 @@
 #include "InputMapper.h"
 #include "RageFileManager.h"
 #include "LightsManager.h"
+#include "MessageManager.h"
 #include "RageTimer.h"
 #include "RageInput.h"
 
@@ -32,10 +35,6 @@ static RageTimer g_GameplayTimer;
 
 static Preference<bool> g_bNeverBoostAppPriority( "NeverBoostAppPriority", false );
 
-/* experimental: force a specific update rate. This prevents big  animation
- * jumps on frame skips. 0 to disable. */
-static Preference<float> g_fConstantUpdateDeltaSeconds( "ConstantUpdateDeltaSeconds", 0 );
-
 void HandleInputEvents( float fDeltaTime );
 
 static float g_fUpdateRate = 1;
@@ -263,32 +262,62 @@ void GameLoop::UpdateAllButDraw(bool bRunningFromVBLANK)
 	// Update our stuff
 	float fDeltaTime = g_GameplayTimer.GetDeltaTime();
 
-	if (g_fConstantUpdateDeltaSeconds > 0)
-		fDeltaTime = g_fConstantUpdateDeltaSeconds;
+	if (PREFSMAN->m_fConstantUpdateDeltaSeconds > 0)
+		fDeltaTime = PREFSMAN->m_fConstantUpdateDeltaSeconds;
 
 	CheckGameLoopTimerSkips(fDeltaTime);
 
 	fDeltaTime *= g_fUpdateRate;
 
+	PROFILE_SCOPE( "Update" );
+
 	// Update SOUNDMAN early (before any RageSound::GetPosition calls), to flush position data.
-	SOUNDMAN->Update();
+	{
+		PROFILE_SCOPE( "SOUNDMAN" );
+		SOUNDMAN->Update();
+	}
 
 	/* Update song beat information -before- calling update on all the classes that
 	* depend on it. If you don't do this first, the classes are all acting on old
 	* information and will lag. (but no longer fatally, due to timestamping -glenn) */
-	SOUND->Update(fDeltaTime);
-	TEXTUREMAN->Update(fDeltaTime);
-	GAMESTATE->Update(fDeltaTime);
-	SCREENMAN->Update(fDeltaTime);
-	MEMCARDMAN->Update();
+	{
+		PROFILE_SCOPE( "SOUND" );
+		SOUND->Update(fDeltaTime);
+	}
+	{
+		PROFILE_SCOPE( "TEXTUREMAN" );
+		TEXTUREMAN->Update(fDeltaTime);
+	}
+	{
+		PROFILE_SCOPE( "GAMESTATE" );
+		GAMESTATE->Update(fDeltaTime);
+	}
+	{
+		PROFILE_SCOPE( "MESSAGEMAN" );
+		MESSAGEMAN->FlushDeferred();
+	}
+	{
+		PROFILE_SCOPE( "SCREENMAN" );
+		SCREENMAN->Update(fDeltaTime);
+	}
+	{
+		PROFILE_SCOPE( "MEMCARDMAN" );
+		MEMCARDMAN->Update();
+	}
 
 	/* Important: Process input AFTER updating game logic, or input will be
 	* acting on song beat from last frame */
-	HandleInputEvents(fDeltaTime);
+	{
+		PROFILE_SCOPE( "Input" );
+		HandleInputEvents(fDeltaTime);
+	}
 
 	//bandaid for low max audio sample counter
 	SOUNDMAN->low_sample_count_workaround();
-	LIGHTSMAN->Update(fDeltaTime);
+	{
+		PROFILE_SCOPE( "LIGHTSMAN" );
+		LIGHTSMAN->Update(fDeltaTime);
+	}
 
 }
 
@@ -316,6 +345,9 @@ void GameLoop::RunGameLoop()
 
 		CheckFocus();
 
+		FrameProfiler::BeginFrame();
+		PROFILE_SCOPE( "Frame" );
+
 		UpdateAllButDraw(false);
 		
 		// This loop runs every frame, so the input devices will be checked every 500 frames.
@@ -326,7 +358,13 @@ void GameLoop::RunGameLoop()
 		}
 		CheckInputDevicesCounter++;
 		
-		SCREENMAN->Draw();
+		{
+			PROFILE_SCOPE( "Draw" );
+			SCREENMAN->Draw();
+		}
+
+		if( Benchmark::IsEnabled() )
+			Benchmark::Update();
 	}
 
 	// If we ended mid-game, finish up.
@@ -42,8 +42,11 @@ class GameState
 {
 	/** @brief The player number used with Styles where one player controls both sides. */
 	PlayerNumber	masterPlayerNumber;
-	/** @brief The TimingData that is used for processing certain functions. */
-	TimingData * processedTiming;
+	/** @brief The TimingData that is used for processing certain functions.
+	 *
+	 * This is per thread so that radar values can be calculated while songs
+	 * are loaded on several threads at once. */
+	static thread_local TimingData * processedTiming;
 public:
 	/** @brief Set up the GameState with initial values. */
 	GameState();
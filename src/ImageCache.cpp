@@ -22,6 +22,7 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <thread>
 
 static Preference<bool> g_bPalettedImageCache( "PalettedImageCache", false );
 
@@ -38,10 +39,16 @@ static Preference<bool> g_bPalettedImageCache( "PalettedImageCache", false );
  * CacheImage only if needed.  This will not do a date/size check; call CacheImage
  * directly if you need that.
  *
+ * CacheImage, LoadImage and Demand only queue the work; decoding, scaling and
+ * loading happen in worker threads, so neither loading songs nor the music
+ * wheel waits on them.
+ *
  * Call LoadCachedImage to load a image into a texture and retrieve an ID
  * for it.  You can check if the image was actually preloaded by calling
  * TEXTUREMAN->IsTextureRegistered() on the ID; it might not be if the image cache
- * is missing or disabled.
+ * is missing or disabled, or if the image hasn't been loaded yet.  In that case,
+ * it's queued ahead of everything else, and IsImagePending is true until it's
+ * done; show a placeholder and call LoadCachedImage again.
  *
  * Note that each cache entries has two hashes.  The cache path is based soley
  * on the pathname; this way, loading the cache doesn't have to do a stat on every
@@ -54,52 +61,75 @@ ImageCache *IMAGECACHE; // global and accessible from anywhere in our program
 
 static std::map<RString, RageSurface*> g_ImagePathToImage;
 static int g_iDemandRefcount = 0;
+/* Images that couldn't be loaded or cached, so LoadCachedImage doesn't keep
+ * queueing them. */
+static std::set<RString> g_FailedImages;
+
+/* Bound the jobs queued while loading songs, so the loading threads can't get
+ * far ahead of the image workers. */
+static const unsigned MAX_QUEUED_JOBS = 64;
 
 RString ImageCache::GetImageCachePath( RString sImageDir ,RString sImagePath )
 {
 	return SongCacheIndex::GetCacheFilePath( sImageDir, sImagePath );
 }
 
-/* If in on-demand mode, load all cached images.  This must be fast, so
- * cache files will not be created if they don't exist; that should be done
- * by CacheImage or LoadImage on startup. */
+/* If in on-demand mode, load all cached images in the background.  This
+ * must be fast, so cache files will not be created if they don't exist; that
+ * should be done by CacheImage or LoadImage on startup. */
 void ImageCache::Demand( RString sImageDir )
 {
-	++g_iDemandRefcount;
-	if( g_iDemandRefcount > 1 )
-		return;
-
-	if( PREFSMAN->m_ImageCache != IMGCACHE_LOW_RES_LOAD_ON_DEMAND )
-		return;
-
-	FOREACH_CONST_Child( &ImageData, p )
+	std::vector<RString> asToLoad;
 	{
-		RString sImagePath = p->GetName();
+		LockMut( ImageCacheLock );
+		++g_iDemandRefcount;
+		if( g_iDemandRefcount > 1 )
+			return;
 
-		if( g_ImagePathToImage.find(sImagePath) != g_ImagePathToImage.end() )
-			continue; /* already loaded */
+		if( PREFSMAN->m_ImageCache != IMGCACHE_LOW_RES_LOAD_ON_DEMAND )
+			return;
 
-		const RString sCachePath = GetImageCachePath(sImageDir,sImagePath);
-		RageSurface *pImage = RageSurfaceUtils::LoadSurface( sCachePath );
-		if( pImage == nullptr )
+		FOREACH_CONST_Child( &ImageData, p )
 		{
-			continue; /* doesn't exist */
+			if( g_ImagePathToImage.find(p->GetName()) == g_ImagePathToImage.end() )
+				asToLoad.push_back( p->GetName() );
 		}
-
-		g_ImagePathToImage[sImagePath] = pImage;
 	}
+
+	for( RString const &sImagePath : asToLoad )
+		QueueJob( sImageDir, sImagePath, JOB_LOAD, PRIORITY_DEMAND );
 }
 
 /* Release images loaded on demand. */
 void ImageCache::Undemand( RString sImageDir )
 {
-	--g_iDemandRefcount;
-	if( g_iDemandRefcount != 0 )
-		return;
+	{
+		LockMut( ImageCacheLock );
+		--g_iDemandRefcount;
+		if( g_iDemandRefcount != 0 )
+			return;
 
-	if( PREFSMAN->m_ImageCache != IMGCACHE_LOW_RES_LOAD_ON_DEMAND )
-		return;
+		if( PREFSMAN->m_ImageCache != IMGCACHE_LOW_RES_LOAD_ON_DEMAND )
+			return;
+	}
+
+	/* Drop the loads that haven't started.  Running ones will see the
+	 * refcount and throw their image away. */
+	{
+		LockMut( m_JobsEvent );
+		for( auto it = m_Jobs.begin(); it != m_Jobs.end(); )
+		{
+			if( it->type != JOB_LOAD )
+			{
+				++it;
+				continue;
+			}
+			m_setPending.erase( m_setPending.find(it->sImagePath) );
+			it = m_Jobs.erase( it );
+		}
+	}
 
+	LockMut( ImageCacheLock );
 	UnloadAllImages();
 }
 
@@ -115,42 +145,218 @@ void ImageCache::LoadImage( RString sImageDir, RString sImagePath )
 	    PREFSMAN->m_ImageCache != IMGCACHE_LOW_RES_LOAD_ON_DEMAND )
 		return;
 
-	/* Load it. */
-	const RString sCachePath = GetImageCachePath(sImageDir,sImagePath);
-
-	for( int tries = 0; tries < 2; ++tries )
 	{
+		LockMut( ImageCacheLock );
 		if( g_ImagePathToImage.find(sImagePath) != g_ImagePathToImage.end() )
 			return; /* already loaded */
+	}
 
-		CHECKPOINT_M( ssprintf( "ImageCache::LoadImage: %s", sCachePath.c_str() ) );
-		RageSurface *pImage = RageSurfaceUtils::LoadSurface( sCachePath );
-		if( pImage == nullptr )
-		{
-			if( tries == 0 )
-			{
-				/* The file doesn't exist.  It's possible that the image cache file is
-				 * missing, so try to create it.  Don't do this first, for efficiency. */
-				//LOG->Trace( "Cached image load of '%s' ('%s') failed, trying to cache ...", sImagePath.c_str(), sCachePath.c_str() );
+	QueueJob( sImageDir, sImagePath, JOB_LOAD_OR_CACHE, PRIORITY_BACKGROUND );
+}
 
-				/* Skip the up-to-date check; it failed to load, so it can't be up
-				 * to date. */
-				CacheImageInternal( sImageDir, sImagePath );
+/* Load a cache file into memory, if it isn't already.  Return false if it
+ * couldn't be loaded.  If bOnDemand, the image is only wanted until Undemand,
+ * and false is also returned if that was called while it was loading. */
+bool ImageCache::LoadCacheFile( const RString &sImageDir, const RString &sImagePath, bool bOnDemand )
+{
+	{
+		LockMut( ImageCacheLock );
+		if( g_ImagePathToImage.find(sImagePath) != g_ImagePathToImage.end() )
+			return true; /* already loaded */
+	}
+
+	const RString sCachePath = GetImageCachePath(sImageDir,sImagePath);
+	CHECKPOINT_M( ssprintf( "ImageCache::LoadCacheFile: %s", sCachePath.c_str() ) );
+	RageSurface *pImage = RageSurfaceUtils::LoadSurface( sCachePath );
+	if( pImage == nullptr )
+	{
+		//LOG->Trace( "Cached image load of '%s' ('%s') failed", sImagePath.c_str(), sCachePath.c_str() );
+		return false;
+	}
+
+	LockMut( ImageCacheLock );
+	if( bOnDemand && g_iDemandRefcount == 0 &&
+	    PREFSMAN->m_ImageCache == IMGCACHE_LOW_RES_LOAD_ON_DEMAND )
+	{
+		delete pImage; /* Undemand was called while we were loading it */
+		return false;
+	}
+
+	if( g_ImagePathToImage.find(sImagePath) != g_ImagePathToImage.end() )
+		delete pImage; /* another thread loaded it first */
+	else
+		g_ImagePathToImage[sImagePath] = pImage;
+	return true;
+}
+
+bool ImageCache::IsImagePending( const RString &sImagePath )
+{
+	LockMut( m_JobsEvent );
+	return m_setPending.find( sImagePath ) != m_setPending.end();
+}
+
+void ImageCache::QueueJob( const RString &sImageDir, const RString &sImagePath, JobType type, JobPriority pri )
+{
+	LockMut( m_JobsEvent );
+	if( m_bShutdown )
+		return;
+
+	/* If it's already queued, do the more thorough of the two jobs, and move
+	 * it to the front if this one is urgent. */
+	if( m_setPending.find(sImagePath) != m_setPending.end() )
+	{
+		for( auto it = m_Jobs.begin(); it != m_Jobs.end(); ++it )
+		{
+			if( it->sImagePath != sImagePath )
 				continue;
+
+			Job job = *it;
+			job.type = std::max( job.type, type );
+			if( pri == PRIORITY_URGENT )
+			{
+				m_Jobs.erase( it );
+				m_Jobs.push_front( job );
 			}
 			else
+				*it = job;
+			return;
+		}
+
+		/* It's running.  Loading it again would do nothing. */
+		if( type == JOB_LOAD )
+			return;
+	}
+
+	if( pri == PRIORITY_BACKGROUND )
+	{
+		while( m_Jobs.size() >= MAX_QUEUED_JOBS && !m_bShutdown )
+			m_JobsEvent.Wait();
+		if( m_bShutdown )
+			return;
+	}
+
+	Job job = { sImageDir, sImagePath, type };
+	if( pri == PRIORITY_URGENT )
+		m_Jobs.push_front( job );
+	else
+		m_Jobs.push_back( job );
+	m_setPending.insert( sImagePath );
+	m_JobsEvent.Broadcast();
+}
+
+void ImageCache::RunJob( const Job &job )
+{
+	bool bOK = false;
+	switch( job.type )
+	{
+	case JOB_LOAD:
+		bOK = LoadCacheFile( job.sImageDir, job.sImagePath, true );
+		break;
+
+	case JOB_LOAD_OR_CACHE:
+		bOK = LoadCacheFile( job.sImageDir, job.sImagePath, false );
+		if( !bOK )
+		{
+			/* The file doesn't exist.  It's possible that the image cache file is
+			 * missing, so try to create it.  Don't do this first, for efficiency.
+			 * Skip the up-to-date check; it failed to load, so it can't be up
+			 * to date. */
+			bOK = CacheImageInternal( job.sImageDir, job.sImagePath ) &&
+				LoadCacheFile( job.sImageDir, job.sImagePath, false );
+		}
+		break;
+
+	case JOB_CACHE:
+	{
+		CHECKPOINT_M( job.sImagePath );
+		if( !DoesFileExist(job.sImagePath) )
+			break;
+
+		const RString sCachePath = GetImageCachePath( job.sImageDir, job.sImagePath );
+
+		/* Check the full file hash.  If it's the loaded and identical, don't recache. */
+		if( DoesFileExist(sCachePath) )
+		{
+			bool bCacheUpToDate = PREFSMAN->m_bFastLoad;
+			if( !bCacheUpToDate )
 			{
-				//LOG->Trace( "Cached image load of '%s' ('%s') failed", sImagePath.c_str(), sCachePath.c_str() );
-				return;
+				unsigned CurFullHash;
+				const unsigned FullHash = GetHashForFile( job.sImagePath );
+				LockMut( ImageCacheLock );
+				if( ImageData.GetValue( job.sImagePath, "FullHash", CurFullHash ) && CurFullHash == FullHash )
+					bCacheUpToDate = true;
+			}
+
+			if( bCacheUpToDate )
+			{
+				/* It's identical.  Just load it, if in preload. */
+				if( PREFSMAN->m_ImageCache == IMGCACHE_LOW_RES_PRELOAD )
+					bOK = LoadCacheFile( job.sImageDir, job.sImagePath, false );
+				else
+					bOK = true;
+				break;
 			}
 		}
 
-		g_ImagePathToImage[sImagePath] = pImage;
+		/* The cache file doesn't exist, or is out of date.  Cache it.  This
+		 * will also load the cache into memory if in PRELOAD. */
+		bOK = CacheImageInternal( job.sImageDir, job.sImagePath );
+		break;
+	}
+	}
+
+	LockMut( ImageCacheLock );
+	if( bOK )
+		g_FailedImages.erase( job.sImagePath );
+	else if( job.type != JOB_LOAD || g_iDemandRefcount != 0 )
+		g_FailedImages.insert( job.sImagePath );
+	/* Otherwise, it was thrown away by Undemand; the next Demand loads it. */
+}
+
+void ImageCache::WorkerMain()
+{
+	m_JobsEvent.Lock();
+	while( !m_bShutdown )
+	{
+		if( m_Jobs.empty() )
+		{
+			m_JobsEvent.Wait();
+			continue;
+		}
+
+		Job job = m_Jobs.front();
+		m_Jobs.pop_front();
+		++m_iRunningJobs;
+		/* There's room in the queue now. */
+		m_JobsEvent.Broadcast();
+		m_JobsEvent.Unlock();
+
+		RunJob( job );
+
+		m_JobsEvent.Lock();
+		--m_iRunningJobs;
+		auto it = m_setPending.find( job.sImagePath );
+		if( it != m_setPending.end() )
+			m_setPending.erase( it );
+
+		/* Once everything's done, save the index if it changed. */
+		if( m_Jobs.empty() && m_iRunningJobs == 0 && !delay_save_cache )
+		{
+			m_JobsEvent.Unlock();
+			{
+				LockMut( ImageCacheLock );
+				if( m_bIndexChanged )
+					WriteToDisk();
+			}
+			m_JobsEvent.Lock();
+		}
 	}
+	m_JobsEvent.Unlock();
 }
 
 void ImageCache::OutputStats() const
 {
+	LockMut( const_cast<RageMutex &>(ImageCacheLock) );
 	int iTotalSize = 0;
 	for (auto const &it : g_ImagePathToImage)
 	{
@@ -172,13 +378,37 @@ void ImageCache::UnloadAllImages()
 }
 
 ImageCache::ImageCache()
-	: delay_save_cache(false)
+	: delay_save_cache(false), ImageCacheLock("ImageCache"), m_bIndexChanged(false),
+	m_JobsEvent("ImageCacheJobs"), m_iRunningJobs(0), m_bShutdown(false)
 {
 	ReadFromDisk();
+
+	/* Leave most of the CPU to the song loading threads. */
+	const int iThreads = clamp( (int) std::thread::hardware_concurrency() / 2, 1, 4 );
+	for( int i = 0; i < iThreads; ++i )
+	{
+		m_Workers.emplace_back( new RageThread );
+		m_Workers.back()->SetName( ssprintf("Image cache thread %i", i) );
+		m_Workers.back()->Create( StartWorker, this );
+	}
 }
 
 ImageCache::~ImageCache()
 {
+	/* Finish the images in progress, and drop the rest; anything that wasn't
+	 * cached will be cached next time. */
+	{
+		LockMut( m_JobsEvent );
+		m_bShutdown = true;
+		m_Jobs.clear();
+		m_setPending.clear();
+		m_JobsEvent.Broadcast();
+	}
+	for( std::unique_ptr<RageThread> &worker : m_Workers )
+		worker->Wait();
+
+	if( m_bIndexChanged )
+		WriteToDisk();
 	UnloadAllImages();
 }
 
@@ -285,13 +515,28 @@ RageTextureID ImageCache::LoadCachedImage( RString sImageDir, RString sImagePath
 	if(sImageDir == "Banner")
 		ID = Sprite::SongBannerTexture(ID);
 
+	LockMut( ImageCacheLock );
+
 	/* It's not in a texture.  Do we have it loaded? */
 	if( g_ImagePathToImage.find(sImagePath) == g_ImagePathToImage.end() )
 	{
-		/* Oops, the image is missing.  Warn and continue. */
-		if(PREFSMAN->m_ImageCache != IMGCACHE_OFF)
+		/* Not yet.  Load it ahead of everything else, unless we already tried
+		 * and failed. */
+		if( g_FailedImages.find(sImagePath) != g_FailedImages.end() )
+			return ID;
+
+		switch( PREFSMAN->m_ImageCache )
 		{
-			LOG->Warn( "Image cache for '%s' wasn't loaded", sImagePath.c_str() );
+		case IMGCACHE_LOW_RES_PRELOAD:
+			QueueJob( sImageDir, sImagePath, JOB_LOAD_OR_CACHE, PRIORITY_URGENT );
+			break;
+		case IMGCACHE_LOW_RES_LOAD_ON_DEMAND:
+			/* Outside of Demand, it would only be thrown away. */
+			if( g_iDemandRefcount != 0 )
+				QueueJob( sImageDir, sImagePath, JOB_LOAD, PRIORITY_URGENT );
+			break;
+		default:
+			break;
 		}
 		return ID;
 	}
@@ -341,47 +586,17 @@ void ImageCache::CacheImage( RString sImageDir, RString sImagePath )
 	    PREFSMAN->m_ImageCache != IMGCACHE_LOW_RES_LOAD_ON_DEMAND )
 		return;
 
-	CHECKPOINT_M( sImagePath );
-	if( !DoesFileExist(sImagePath) )
-		return;
-
-	const RString sCachePath = GetImageCachePath(sImageDir, sImagePath);
-
-	/* Check the full file hash.  If it's the loaded and identical, don't recache. */
-	if( DoesFileExist(sCachePath) )
-	{
-		bool bCacheUpToDate = PREFSMAN->m_bFastLoad;
-		if( !bCacheUpToDate )
-		{
-			unsigned CurFullHash;
-			const unsigned FullHash = GetHashForFile( sImagePath );
-			if( ImageData.GetValue( sImagePath, "FullHash", CurFullHash ) && CurFullHash == FullHash )
-				bCacheUpToDate = true;
-		}
-
-		if( bCacheUpToDate )
-		{
-			/* It's identical.  Just load it, if in preload. */
-			if( PREFSMAN->m_ImageCache == IMGCACHE_LOW_RES_PRELOAD )
-				LoadImage( sImageDir, sImagePath );
-
-			return;
-		}
-	}
-
-	/* The cache file doesn't exist, or is out of date.  Cache it.  This
-	 * will also load the cache into memory if in PRELOAD. */
-	CacheImageInternal( sImageDir, sImagePath );
+	QueueJob( sImageDir, sImagePath, JOB_CACHE, PRIORITY_BACKGROUND );
 }
 
-void ImageCache::CacheImageInternal( RString sImageDir, RString sImagePath )
+bool ImageCache::CacheImageInternal( RString sImageDir, RString sImagePath )
 {
 	RString sError;
 	RageSurface *pImage = RageSurfaceUtils::LoadFile( sImagePath, sError );
 	if( pImage == nullptr )
 	{
 		LOG->UserLog( "Cache file", sImagePath, "couldn't be loaded: %s", sError.c_str() );
-		return;
+		return false;
 	}
 
 	const int iSourceWidth = pImage->w, iSourceHeight = pImage->h;
@@ -439,35 +654,45 @@ void ImageCache::CacheImageInternal( RString sImageDir, RString sImagePath )
 
 	const RString sCachePath = GetImageCachePath(sImageDir,sImagePath);
 	RageSurfaceUtils::SaveSurface( pImage, sCachePath );
+	const unsigned FullHash = GetHashForFile( sImagePath );
 
-	/* If an old image is loaded, free it. */
-	if( g_ImagePathToImage.find(sImagePath) != g_ImagePathToImage.end() )
+	LockMut( ImageCacheLock );
+
+	/* If an old image is loaded, replace it in place; an ImageTexture may
+	 * hold a reference to its pointer in the map. */
+	std::map<RString, RageSurface*>::iterator it = g_ImagePathToImage.find( sImagePath );
+	if( it != g_ImagePathToImage.end() )
 	{
-		RageSurface *oldimg = g_ImagePathToImage[sImagePath];
-		delete oldimg;
-		g_ImagePathToImage.erase(sImagePath);
+		delete it->second;
+		if( PREFSMAN->m_ImageCache == IMGCACHE_LOW_RES_PRELOAD )
+			it->second = pImage;
+		else
+			g_ImagePathToImage.erase( it );
 	}
-
-	if( PREFSMAN->m_ImageCache == IMGCACHE_LOW_RES_PRELOAD )
+	else if( PREFSMAN->m_ImageCache == IMGCACHE_LOW_RES_PRELOAD )
 	{
 		/* Keep it; we're just going to load it anyway. */
 		g_ImagePathToImage[sImagePath] = pImage;
 	}
-	else
+
+	if( PREFSMAN->m_ImageCache != IMGCACHE_LOW_RES_PRELOAD )
 		delete pImage;
 
-	/* Remember the original size. */
+	/* Remember the original size.  The index is written once the queue is
+	 * empty. */
 	ImageData.SetValue( sImagePath, "Path", sCachePath );
 	ImageData.SetValue( sImagePath, "Width", iSourceWidth );
 	ImageData.SetValue( sImagePath, "Height", iSourceHeight );
-	ImageData.SetValue( sImagePath, "FullHash", GetHashForFile( sImagePath ) );
-	if (!delay_save_cache)
-		WriteToDisk();
+	ImageData.SetValue( sImagePath, "FullHash", FullHash );
+	m_bIndexChanged = true;
+	return true;
 }
 
 void ImageCache::WriteToDisk()
 {
+	LockMut( ImageCacheLock );
 	ImageData.WriteFile(IMAGE_CACHE_INDEX);
+	m_bIndexChanged = false;
 }
 
 
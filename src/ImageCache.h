@@ -4,6 +4,13 @@
 #include "IniFile.h"
 
 #include "RageTexture.h"
+#include "RageThreads.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <set>
+#include <vector>
 
 class LoadingWindow;
 /** @brief Maintains a cache of reduced-quality images. */
@@ -22,16 +29,60 @@ public:
 	void Demand( RString sImageDir );
 	void Undemand( RString sImageDir );
 
+	/* Return true if the image is queued or being loaded in the background.
+	 * LoadCachedImage has no texture for it until this returns false. */
+	bool IsImagePending( const RString &sImagePath );
+
 	void OutputStats() const;
 
-	bool delay_save_cache;
+	std::atomic<bool> delay_save_cache;
 
 private:
+	/* Each job does everything the ones before it do. */
+	enum JobType
+	{
+		JOB_LOAD,		// load the cache file, if it exists
+		JOB_LOAD_OR_CACHE,	// load the cache file, creating it if it doesn't exist
+		JOB_CACHE		// create the cache file if it's out of date, then load it
+	};
+	enum JobPriority
+	{
+		PRIORITY_BACKGROUND,	// wait for room in the queue
+		PRIORITY_DEMAND,	// queue without waiting
+		PRIORITY_URGENT		// queue at the front, without waiting
+	};
+	struct Job
+	{
+		RString sImageDir, sImagePath;
+		JobType type;
+	};
+
 	static RString GetImageCachePath( RString sImageDir, RString sImagePath );
 	void UnloadAllImages();
-	void CacheImageInternal( RString sImageDir, RString sImagePath );
+	bool CacheImageInternal( RString sImageDir, RString sImagePath );
+	bool LoadCacheFile( const RString &sImageDir, const RString &sImagePath, bool bOnDemand );
+	void QueueJob( const RString &sImageDir, const RString &sImagePath, JobType type, JobPriority pri );
+	void RunJob( const Job &job );
+	void WorkerMain();
+	static int StartWorker( void *p ) { ((ImageCache *) p)->WorkerMain(); return 0; }
 
 	IniFile ImageData;
+	/* Guards ImageData and the loaded images; songs may be loaded from
+	 * several threads at once. */
+	RageMutex ImageCacheLock;
+	bool m_bIndexChanged;
+
+	/* Images are decoded, scaled and loaded by these threads.  Textures are
+	 * only created from the loaded images by LoadCachedImage, in the main
+	 * thread. */
+	std::vector<std::unique_ptr<RageThread>> m_Workers;
+	/* Guards the jobs below; signalled when a job is queued or taken. */
+	RageEvent m_JobsEvent;
+	std::deque<Job> m_Jobs;
+	/* The paths of queued and running jobs. */
+	std::multiset<RString> m_setPending;
+	int m_iRunningJobs;
+	bool m_bShutdown;
 };
 
 extern ImageCache *IMAGECACHE; // global and accessible from anywhere in our program
@@ -8,6 +8,7 @@
 #include "Preference.h"
 #include "GameInput.h"
 #include "InputMapper.h"
+#include "InputLatency.h"
 // for mouse stuff: -aj
 #include "PrefsManager.h"
 #include "ScreenDimensions.h"
@@ -217,6 +218,8 @@ void InputFilter::ButtonPressed( const DeviceInput &di )
 	{
 		bs.m_BeingHeld = Down;
 		bs.m_BeingHeldTime = di.ts;
+		if( Down )
+			InputLatency::Record( InputLatencyStage_InputFilter, di.ts );
 	}
 
 	// Try to report presses immediately.
@@ -459,6 +462,15 @@ void InputFilter::GetInputEvents( std::vector<InputEvent> &array )
 	array.clear();
 	LockMut(*queuemutex);
 	array.swap( queue );
+
+	if( InputLatency::IsEnabled() )
+	{
+		for( InputEvent const &ie : array )
+		{
+			if( ie.type == IET_FIRST_PRESS )
+				InputLatency::Record( InputLatencyStage_GetInputEvents, ie.di.ts );
+		}
+	}
 }
 
 void InputFilter::GetPressedButtons( std::vector<DeviceInput> &array ) const
@@ -0,0 +1,258 @@
+#include "global.h"
+#include "InputLatency.h"
+#include "Preference.h"
+#include "RageFile.h"
+#include "RageLog.h"
+#include "RageTimer.h"
+#include "RageUtil.h"
+#include "LuaManager.h"
+
+#include <atomic>
+#include <cstdint>
+
+static Preference<bool> g_bInputLatencyStats( "InputLatencyStats", false );
+
+static const char *InputLatencyStageNames[] = {
+	"InputFilter",
+	"GetInputEvents",
+	"HandleInputEvents",
+	"ScreenInput",
+	"PlayerStep",
+};
+XToString( InputLatencyStage );
+LuaXType( InputLatencyStage );
+
+/* Delays are kept in 0.1ms buckets, up to 100ms; anything longer goes in
+ * the last one. */
+static const int BUCKET_USECS = 100;
+static const int NUM_BUCKETS = 1001;
+
+/* Keep this many of the most recent traces for WriteCSV. */
+static const unsigned NUM_TRACES = 8192;
+
+namespace
+{
+	struct Histogram
+	{
+		std::atomic<std::uint32_t> m_aiBuckets[NUM_BUCKETS];
+		std::atomic<std::uint64_t> m_iTotalUsecs;
+		std::atomic<std::uint32_t> m_iMaxUsecs;
+	};
+	Histogram g_Histograms[NUM_InputLatencyStage];
+
+	/* m_iSequence is one more than the trace's index once it's written, and
+	 * 0 while it's being written. */
+	struct Trace
+	{
+		std::atomic<std::uint32_t> m_iSequence;
+		std::atomic<std::uint64_t> m_iPressedUsecs;
+		std::atomic<std::uint32_t> m_iDelayUsecs;
+		std::atomic<int> m_Stage;
+	};
+	Trace g_Traces[NUM_TRACES];
+	std::atomic<std::uint32_t> g_iNextTrace;
+}
+
+bool InputLatency::IsEnabled()
+{
+	return g_bInputLatencyStats;
+}
+
+void InputLatency::SetEnabled( bool b )
+{
+	g_bInputLatencyStats.Set( b );
+}
+
+void InputLatency::Record( InputLatencyStage s, const RageTimer &tmPressed )
+{
+	if( !g_bInputLatencyStats )
+		return;
+
+	/* A stamp from the future means the driver's clock doesn't match ours;
+	 * count it as no delay. */
+	const float fAgo = tmPressed.Ago();
+	const std::uint32_t iUsecs = fAgo > 0? std::uint32_t( fAgo * 1000000 ): 0;
+
+	Histogram &h = g_Histograms[s];
+	++h.m_aiBuckets[ std::min<std::uint32_t>(iUsecs / BUCKET_USECS, NUM_BUCKETS-1) ];
+	h.m_iTotalUsecs += iUsecs;
+
+	std::uint32_t iMax = h.m_iMaxUsecs;
+	while( iUsecs > iMax && !h.m_iMaxUsecs.compare_exchange_weak(iMax, iUsecs) )
+		;
+
+	const std::uint32_t iIndex = g_iNextTrace++;
+	Trace &t = g_Traces[iIndex % NUM_TRACES];
+	t.m_iSequence.store( 0, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	t.m_iPressedUsecs.store( tmPressed.m_secs * 1000000 + tmPressed.m_us, std::memory_order_relaxed );
+	t.m_iDelayUsecs.store( iUsecs, std::memory_order_relaxed );
+	t.m_Stage.store( s, std::memory_order_relaxed );
+	t.m_iSequence.store( iIndex + 1, std::memory_order_release );
+}
+
+void InputLatency::GetStats( InputLatencyStage s, Stats &out )
+{
+	const Histogram &h = g_Histograms[s];
+
+	std::uint32_t aiBuckets[NUM_BUCKETS];
+	std::uint32_t iCount = 0;
+	for( int i = 0; i < NUM_BUCKETS; ++i )
+	{
+		aiBuckets[i] = h.m_aiBuckets[i];
+		iCount += aiBuckets[i];
+	}
+
+	out.m_iCount = iCount;
+	out.m_fMean = out.m_fMedian = out.m_f95 = out.m_f99 = out.m_fMax = 0;
+	if( iCount == 0 )
+		return;
+
+	/* Use the top of the bucket each percentile falls in. */
+	auto Percentile = [&]( float fPercentile )
+	{
+		const std::uint32_t iWanted = std::uint32_t( fPercentile * (iCount-1) ) + 1;
+		std::uint32_t iSeen = 0;
+		int i = 0;
+		while( (iSeen += aiBuckets[i]) < iWanted )
+			++i;
+		return (i+1) * BUCKET_USECS / 1000.0f;
+	};
+
+	out.m_fMean = h.m_iTotalUsecs / 1000.0f / iCount;
+	out.m_fMedian = Percentile( 0.5f );
+	out.m_f95 = Percentile( 0.95f );
+	out.m_f99 = Percentile( 0.99f );
+	out.m_fMax = h.m_iMaxUsecs / 1000.0f;
+}
+
+void InputLatency::Reset()
+{
+	for( Histogram &h : g_Histograms )
+	{
+		for( std::atomic<std::uint32_t> &iBucket : h.m_aiBuckets )
+			iBucket = 0;
+		h.m_iTotalUsecs = 0;
+		h.m_iMaxUsecs = 0;
+	}
+
+	for( Trace &t : g_Traces )
+		t.m_iSequence = 0;
+}
+
+void InputLatency::LogStats()
+{
+	FOREACH_ENUM( InputLatencyStage, s )
+	{
+		Stats stats;
+		GetStats( s, stats );
+		if( stats.m_iCount == 0 )
+			continue;
+
+		LOG->Info( "Input latency to %s: %u presses, mean %.2fms, median %.1fms, 95%% %.1fms, 99%% %.1fms, max %.2fms",
+			InputLatencyStageToString(s).c_str(), stats.m_iCount, stats.m_fMean,
+			stats.m_fMedian, stats.m_f95, stats.m_f99, stats.m_fMax );
+	}
+}
+
+bool InputLatency::WriteCSV( const RString &sPath, RString &sError )
+{
+	RageFile f;
+	if( !f.Open(sPath, RageFile::WRITE) )
+	{
+		sError = f.GetError();
+		return false;
+	}
+
+	f.PutLine( "pressed_us,stage,delay_us" );
+
+	const std::uint32_t iEnd = g_iNextTrace;
+	const std::uint32_t iBegin = iEnd > NUM_TRACES? iEnd - NUM_TRACES: 0;
+	for( std::uint32_t i = iBegin; i != iEnd; ++i )
+	{
+		const Trace &t = g_Traces[i % NUM_TRACES];
+
+		/* Skip traces that are being overwritten, or were cleared by Reset. */
+		if( t.m_iSequence.load(std::memory_order_acquire) != i + 1 )
+			continue;
+		const std::uint64_t iPressedUsecs = t.m_iPressedUsecs.load( std::memory_order_relaxed );
+		const std::uint32_t iDelayUsecs = t.m_iDelayUsecs.load( std::memory_order_relaxed );
+		const InputLatencyStage s = (InputLatencyStage) t.m_Stage.load( std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_acquire );
+		if( t.m_iSequence.load(std::memory_order_relaxed) != i + 1 )
+			continue;
+
+		f.PutLine( ssprintf("%llu,%s,%u", (unsigned long long) iPressedUsecs,
+			InputLatencyStageToString(s).c_str(), iDelayUsecs) );
+	}
+
+	if( f.Flush() == -1 )
+	{
+		sError = f.GetError();
+		return false;
+	}
+	return true;
+}
+
+// lua start
+#include "LuaBinding.h"
+
+namespace
+{
+	int IsEnabled( lua_State *L )
+	{
+		lua_pushboolean( L, InputLatency::IsEnabled() );
+		return 1;
+	}
+
+	int SetEnabled( lua_State *L )
+	{
+		InputLatency::SetEnabled( BArg(1) );
+		return 0;
+	}
+
+	// ( InputLatencyStage s ): { Count, Mean, Median, P95, P99, Max }, in milliseconds
+	int GetStats( lua_State *L )
+	{
+		InputLatency::Stats stats;
+		InputLatency::GetStats( Enum::Check<InputLatencyStage>(L, 1), stats );
+
+		lua_createtable( L, 0, 6 );
+		lua_pushinteger( L, stats.m_iCount );	lua_setfield( L, -2, "Count" );
+		lua_pushnumber( L, stats.m_fMean );	lua_setfield( L, -2, "Mean" );
+		lua_pushnumber( L, stats.m_fMedian );	lua_setfield( L, -2, "Median" );
+		lua_pushnumber( L, stats.m_f95 );	lua_setfield( L, -2, "P95" );
+		lua_pushnumber( L, stats.m_f99 );	lua_setfield( L, -2, "P99" );
+		lua_pushnumber( L, stats.m_fMax );	lua_setfield( L, -2, "Max" );
+		return 1;
+	}
+
+	int Reset( lua_State *L )
+	{
+		InputLatency::Reset();
+		return 0;
+	}
+
+	// ( string sPath ): bool
+	int WriteCSV( lua_State *L )
+	{
+		RString sError;
+		const bool bOK = InputLatency::WriteCSV( SArg(1), sError );
+		if( !bOK )
+			LuaHelpers::ReportScriptErrorFmt( "InputLatency.WriteCSV: %s", sError.c_str() );
+		lua_pushboolean( L, bOK );
+		return 1;
+	}
+
+	const luaL_Reg InputLatencyTable[] =
+	{
+		LIST_METHOD( IsEnabled ),
+		LIST_METHOD( SetEnabled ),
+		LIST_METHOD( GetStats ),
+		LIST_METHOD( Reset ),
+		LIST_METHOD( WriteCSV ),
+		{ nullptr, nullptr }
+	};
+}
+
+LUA_REGISTER_NAMESPACE( InputLatency )
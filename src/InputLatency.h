@@ -0,0 +1,58 @@
+/* InputLatency - Measures how long presses take to get through the input path. */
+
+#ifndef INPUT_LATENCY_H
+#define INPUT_LATENCY_H
+
+#include "EnumHelper.h"
+
+class RageTimer;
+
+/** @brief The places a press is timed, in the order it reaches them.  Each is
+ * measured from the time the input driver stamped the press with. */
+enum InputLatencyStage
+{
+	InputLatencyStage_InputFilter,		// InputFilter::ButtonPressed
+	InputLatencyStage_GetInputEvents,	// InputFilter::GetInputEvents
+	InputLatencyStage_HandleInputEvents,	// HandleInputEvents, sending it to the screen
+	InputLatencyStage_ScreenInput,		// ScreenGameplay::Input
+	InputLatencyStage_PlayerStep,		// Player::Step
+	NUM_InputLatencyStage,
+	InputLatencyStage_Invalid
+};
+const RString& InputLatencyStageToString( InputLatencyStage s );
+LuaDeclareType( InputLatencyStage );
+
+/** @brief Trace presses through the input path, keeping the distribution of
+ * the delay to each stage and the most recent traces.  This does nothing
+ * unless the InputLatencyStats preference is set. */
+namespace InputLatency
+{
+	bool IsEnabled();
+	void SetEnabled( bool b );
+
+	/* Record that a press stamped tmPressed has reached the stage.  This may be
+	 * called from any thread. */
+	void Record( InputLatencyStage s, const RageTimer &tmPressed );
+
+	/* The distribution of a stage's delays, in milliseconds.  Percentiles are
+	 * rounded up to 0.1ms. */
+	struct Stats
+	{
+		unsigned m_iCount;
+		float m_fMean, m_fMedian, m_f95, m_f99, m_fMax;
+	};
+	void GetStats( InputLatencyStage s, Stats &out );
+
+	/* Forget all recorded presses. */
+	void Reset();
+
+	/* Log the distribution of each stage.  Presses are kept until Reset. */
+	void LogStats();
+
+	/* Write the most recent traces to a CSV file, one row per stage reached:
+	 * the press time in microseconds, the stage, and the delay in microseconds.
+	 * Rows for the same press have the same press time. */
+	bool WriteCSV( const RString &sPath, RString &sError );
+};
+
+#endif
@@ -13,9 +13,15 @@
 #include "GameManager.h"
 #include "CommonMetrics.h"
 #include "Style.h"
+#include "RageLog.h"
+#include "RageThreads.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
 
@@ -24,6 +30,9 @@ static Preference<RString> g_sLightsDriver( "LightsDriver", "" ); // "" == DEFAU
 Preference<float>	g_fLightsFalloffSeconds( "LightsFalloffSeconds", 0.1f );
 Preference<float>	g_fLightsAheadSeconds( "LightsAheadSeconds", 0.05f );
 static Preference<bool>	g_bBlinkGameplayButtonLightsOnNote( "BlinkGameplayButtonLightsOnNote", false );
+/* How many times a second the output thread writes to lights drivers.  0 sets
+ * them from the game thread every frame instead. */
+static Preference<float>	g_fLightsOutputRate( "LightsOutputRate", 60 );
 
 static ThemeMetric<RString> GAME_BUTTONS_TO_SHOW( "LightsManager", "GameButtonsToShow" );
 
@@ -102,6 +111,180 @@ static void GetUsedGameInputs( std::vector<GameInput> &vGameInputsOut )
 		vGameInputsOut.push_back( input );
 }
 
+/* Drivers that talk to hardware can block in Set, so they're written from
+ * their own thread.  The game thread publishes each frame's state into a
+ * triple buffer, so neither thread ever waits for the other; the output thread
+ * writes only the newest state, and only when it's changed. */
+class LightsOutputThread
+{
+public:
+	LightsOutputThread( const std::vector<LightsDriver *> &vpDrivers, float fRate );
+	~LightsOutputThread();
+
+	void Publish( const LightsState &ls );
+	void GetStats( LightsOutputStats &out ) const;
+
+private:
+	static int StartThread( void *p ) { static_cast<LightsOutputThread *>(p)->ThreadMain(); return 0; }
+	void ThreadMain();
+	bool Take( LightsState &out, std::uint64_t &iPublishedUsecs );
+
+	std::vector<LightsDriver *> m_vpDrivers;
+	unsigned m_iSleepUsecs;
+	RageThread m_Thread;
+	std::atomic<bool> m_bShutdown;
+
+	// m_iReady has this set until the state it points to is taken.
+	static const int NEW_STATE = 4;
+	LightsState m_States[3];
+	std::uint64_t m_iPublishedUsecs[3];
+	std::atomic<int> m_iReady;
+	int m_iWriting;		// only used by the game thread
+	int m_iReading;		// only used by the output thread
+
+	std::atomic<unsigned> m_iPublished;
+	std::atomic<unsigned> m_iWritten;
+	std::atomic<unsigned> m_iCoalesced;
+	std::atomic<unsigned> m_iUnchanged;
+	std::atomic<std::uint64_t> m_iTotalWriteUsecs;
+	std::atomic<std::uint32_t> m_iMaxWriteUsecs;
+	std::atomic<std::uint64_t> m_iTotalLatencyUsecs;
+	std::atomic<std::uint32_t> m_iMaxLatencyUsecs;
+};
+
+LightsOutputThread::LightsOutputThread( const std::vector<LightsDriver *> &vpDrivers, float fRate )
+{
+	m_vpDrivers = vpDrivers;
+
+	/* The coin counter is pulsed for 100ms at a time, so writing less often
+	 * than this could miss a pulse. */
+	fRate = std::max( fRate, 20.0f );
+	m_iSleepUsecs = unsigned( 1000000 / fRate );
+
+	ZERO( m_States );
+	ZERO( m_iPublishedUsecs );
+	m_iReady = 0;
+	m_iWriting = 1;
+	m_iReading = 2;
+
+	m_iPublished = 0;
+	m_iWritten = 0;
+	m_iCoalesced = 0;
+	m_iUnchanged = 0;
+	m_iTotalWriteUsecs = 0;
+	m_iMaxWriteUsecs = 0;
+	m_iTotalLatencyUsecs = 0;
+	m_iMaxLatencyUsecs = 0;
+
+	m_bShutdown = false;
+	m_Thread.SetName( "Lights output thread" );
+	m_Thread.Create( StartThread, this );
+}
+
+LightsOutputThread::~LightsOutputThread()
+{
+	m_bShutdown = true;
+	m_Thread.Wait();
+
+	LightsOutputStats stats;
+	GetStats( stats );
+	LOG->Info( "Lights output: %u states published, %u written, %u coalesced, %u unchanged; write %.2fms mean, %.2fms max",
+		stats.m_iPublished, stats.m_iWritten, stats.m_iCoalesced, stats.m_iUnchanged,
+		stats.m_fMeanWriteMs, stats.m_fMaxWriteMs );
+}
+
+void LightsOutputThread::Publish( const LightsState &ls )
+{
+	m_States[m_iWriting] = ls;
+	m_iPublishedUsecs[m_iWriting] = RageTimer::GetUsecsSinceStart();
+	++m_iPublished;
+
+	const int iOld = m_iReady.exchange( m_iWriting | NEW_STATE, std::memory_order_acq_rel );
+	if( iOld & NEW_STATE )
+		++m_iCoalesced;
+	m_iWriting = iOld & ~NEW_STATE;
+}
+
+bool LightsOutputThread::Take( LightsState &out, std::uint64_t &iPublishedUsecs )
+{
+	if( !(m_iReady.load(std::memory_order_relaxed) & NEW_STATE) )
+		return false;
+
+	m_iReading = m_iReady.exchange( m_iReading, std::memory_order_acq_rel ) & ~NEW_STATE;
+	out = m_States[m_iReading];
+	iPublishedUsecs = m_iPublishedUsecs[m_iReading];
+	return true;
+}
+
+/* LightsState has padding after m_bCoinCounter, so compare the fields
+ * rather than the bytes. */
+static bool SameLightsState( const LightsState &a, const LightsState &b )
+{
+	return !memcmp( a.m_bCabinetLights, b.m_bCabinetLights, sizeof(a.m_bCabinetLights) ) &&
+		!memcmp( a.m_bGameButtonLights, b.m_bGameButtonLights, sizeof(a.m_bGameButtonLights) ) &&
+		a.m_bCoinCounter == b.m_bCoinCounter &&
+		a.m_LightsMode == b.m_LightsMode &&
+		a.m_pInputScheme == b.m_pInputScheme;
+}
+
+static void RecordMax( std::atomic<std::uint32_t> &iMax, std::uint32_t iValue )
+{
+	std::uint32_t iOld = iMax.load( std::memory_order_relaxed );
+	while( iValue > iOld && !iMax.compare_exchange_weak(iOld, iValue, std::memory_order_relaxed) )
+		;
+}
+
+void LightsOutputThread::ThreadMain()
+{
+	LightsState lastWritten;
+	bool bWroteAny = false;
+
+	while( !m_bShutdown )
+	{
+		LightsState ls;
+		std::uint64_t iPublishedUsecs;
+		if( Take(ls, iPublishedUsecs) )
+		{
+			if( bWroteAny && SameLightsState(ls, lastWritten) )
+			{
+				++m_iUnchanged;
+			}
+			else
+			{
+				const std::uint64_t iStartUsecs = RageTimer::GetUsecsSinceStart();
+				for( LightsDriver *pDriver : m_vpDrivers )
+					pDriver->Set( &ls );
+				const std::uint64_t iEndUsecs = RageTimer::GetUsecsSinceStart();
+
+				lastWritten = ls;
+				bWroteAny = true;
+
+				++m_iWritten;
+				m_iTotalWriteUsecs += iEndUsecs - iStartUsecs;
+				RecordMax( m_iMaxWriteUsecs, std::uint32_t(iEndUsecs - iStartUsecs) );
+				m_iTotalLatencyUsecs += iEndUsecs - iPublishedUsecs;
+				RecordMax( m_iMaxLatencyUsecs, std::uint32_t(iEndUsecs - iPublishedUsecs) );
+			}
+		}
+
+		usleep( m_iSleepUsecs );
+	}
+}
+
+void LightsOutputThread::GetStats( LightsOutputStats &out ) const
+{
+	out.m_iPublished = m_iPublished;
+	out.m_iWritten = m_iWritten;
+	out.m_iCoalesced = m_iCoalesced;
+	out.m_iUnchanged = m_iUnchanged;
+
+	const unsigned iWritten = std::max( out.m_iWritten, 1u );
+	out.m_fMeanWriteMs = m_iTotalWriteUsecs / 1000.0f / iWritten;
+	out.m_fMaxWriteMs = m_iMaxWriteUsecs / 1000.0f;
+	out.m_fMeanLatencyMs = m_iTotalLatencyUsecs / 1000.0f / iWritten;
+	out.m_fMaxLatencyMs = m_iMaxLatencyUsecs / 1000.0f;
+}
+
 LightsManager*	LIGHTSMAN = nullptr;	// global and accessible from anywhere in our program
 
 LightsManager::LightsManager()
@@ -119,11 +302,31 @@ LightsManager::LightsManager()
 		sDriver = DEFAULT_LIGHTS_DRIVER;
 	LightsDriver::Create( sDriver, m_vpDrivers );
 
+	m_pOutputThread = nullptr;
+	if( g_fLightsOutputRate > 0 )
+	{
+		std::vector<LightsDriver *> vpThreadDrivers;
+		for( LightsDriver *pDriver : m_vpDrivers )
+		{
+			if( pDriver->SetFromGameThread() )
+				m_vpGameThreadDrivers.push_back( pDriver );
+			else
+				vpThreadDrivers.push_back( pDriver );
+		}
+		if( !vpThreadDrivers.empty() )
+			m_pOutputThread = new LightsOutputThread( vpThreadDrivers, g_fLightsOutputRate );
+		else
+			m_vpGameThreadDrivers.clear();
+	}
+	if( m_pOutputThread == nullptr )
+		m_vpGameThreadDrivers = m_vpDrivers;
+
 	SetLightsMode( LIGHTSMODE_ATTRACT );
 }
 
 LightsManager::~LightsManager()
 {
+	SAFE_DELETE( m_pOutputThread );
 	for (LightsDriver *iter : m_vpDrivers)
 	{
 		SAFE_DELETE( iter );
@@ -186,6 +389,8 @@ void LightsManager::Update( float fDeltaTime )
 	{
 		ZERO( m_LightsState.m_bCabinetLights );
 		ZERO( m_LightsState.m_bGameButtonLights );
+		m_LightsState.m_LightsMode = m_LightsMode;
+		m_LightsState.m_pInputScheme = INPUTMAPPER->GetInputScheme();
 	}
 
 	{
@@ -455,8 +660,10 @@ void LightsManager::Update( float fDeltaTime )
 	}
 
 	// apply new light values we set above
-	for (LightsDriver *iter : m_vpDrivers)
+	for (LightsDriver *iter : m_vpGameThreadDrivers)
 		iter->Set( &m_LightsState );
+	if( m_pOutputThread != nullptr )
+		m_pOutputThread->Publish( m_LightsState );
 }
 
 void LightsManager::BlinkCabinetLight( CabinetLight cl )
@@ -529,8 +736,21 @@ bool LightsManager::IsEnabled() const
 	return m_vpDrivers.size() >= 1 || PREFSMAN->m_bDebugLights;
 }
 
+bool LightsManager::GetOutputStats( LightsOutputStats &out ) const
+{
+	if( m_pOutputThread == nullptr )
+		return false;
+	m_pOutputThread->GetStats( out );
+	return true;
+}
+
 void LightsManager::TurnOffAllLights()
 {
+	/* This is only done at shutdown.  Stop the output thread, so the drivers
+	 * aren't set from both threads at once. */
+	SAFE_DELETE( m_pOutputThread );
+	m_vpGameThreadDrivers = m_vpDrivers;
+
 	for(LightsDriver *iter : m_vpDrivers)
 		iter->Reset();
 }
@@ -47,6 +47,7 @@ enum LightsMode
 const RString& LightsModeToString( LightsMode lm );
 LuaDeclareType( LightsMode );
 
+class InputScheme;
 struct LightsState
 {
 	bool m_bCabinetLights[NUM_CabinetLight];
@@ -54,9 +55,29 @@ struct LightsState
 
 	// This isn't actually a light, but it's typically implemented in the same way.
 	bool m_bCoinCounter;
+
+	/* Copied from the game thread, so drivers set from the lights output
+	 * thread don't have to read LIGHTSMAN or GAMESTATE.  m_pInputScheme is
+	 * null when the state doesn't come from LightsManager::Update. */
+	LightsMode m_LightsMode;
+	const InputScheme *m_pInputScheme;
+};
+
+/** @brief How the lights output thread is keeping up. */
+struct LightsOutputStats
+{
+	unsigned m_iPublished;	// states sent by the game thread
+	unsigned m_iWritten;	// states written to the drivers
+	unsigned m_iCoalesced;	// replaced by a newer state before they were written
+	unsigned m_iUnchanged;	// not written, because they matched the last write
+	float m_fMeanWriteMs;	// time spent in the drivers per write
+	float m_fMaxWriteMs;
+	float m_fMeanLatencyMs;	// from being sent to being written
+	float m_fMaxLatencyMs;
 };
 
 class LightsDriver;
+class LightsOutputThread;
 /** @brief Control lights. */
 class LightsManager
 {
@@ -85,6 +106,9 @@ public:
 	CabinetLight	GetFirstLitCabinetLight();
 	GameInput	GetFirstLitGameButtonLight();
 
+	/* Returns false if drivers are being set from the game thread. */
+	bool GetOutputStats( LightsOutputStats &out ) const;
+
 private:
 	void ChangeTestCabinetLight( int iDir );
 	void ChangeTestGameButtonLight( int iDir );
@@ -95,6 +119,9 @@ private:
 	float m_fSecsLeftInActorLightBlink[NUM_CabinetLight];	// duration to "power" an actor light
 
 	std::vector<LightsDriver*> m_vpDrivers;
+	// Drivers that are set from the game thread, even when m_pOutputThread exists.
+	std::vector<LightsDriver*> m_vpGameThreadDrivers;
+	LightsOutputThread *m_pOutputThread;
 	LightsMode m_LightsMode;
 	LightsState m_LightsState;
 
@@ -896,6 +896,17 @@ bool LuaHelpers::RunExpression( Lua *L, const RString &sExpression, const RStrin
 }
 
 void LuaHelpers::ParseCommandList( Lua *L, const RString &sCommands, const RString &sName, bool bLegacy )
+{
+	RString sLuaFunction = CommandListToScript( sCommands, bLegacy );
+
+	RString sError;
+	if( !LuaHelpers::RunScript(L, sLuaFunction, sName, sError, 0, 1) )
+		LOG->Warn( "Compiling \"%s\": %s", sLuaFunction.c_str(), sError.c_str() );
+
+	// The function is now on the stack.
+}
+
+RString LuaHelpers::CommandListToScript( const RString &sCommands, bool bLegacy )
 {
 	RString sLuaFunction;
 	if( sCommands.size() > 0 && sCommands[0] == '\033' )
@@ -976,11 +987,7 @@ void LuaHelpers::ParseCommandList( Lua *L, const RString &sCommands, const RStri
 		sLuaFunction = s.str();
 	}
 
-	RString sError;
-	if( !LuaHelpers::RunScript(L, sLuaFunction, sName, sError, 0, 1) )
-		LOG->Warn( "Compiling \"%s\": %s", sLuaFunction.c_str(), sError.c_str() );
-
-	// The function is now on the stack.
+	return sLuaFunction;
 }
 
 /* Like luaL_typerror, but without the special case for argument 1 being "self"
@@ -114,6 +114,8 @@ namespace LuaHelpers
 	void ReadArrayFromTableB( Lua *L, std::vector<bool> &aOut );
 
 	void ParseCommandList( lua_State *L, const RString &sCommands, const RString &sName, bool bLegacy );
+	// The script ParseCommandList runs; it returns the command function.
+	RString CommandListToScript( const RString &sCommands, bool bLegacy );
 
 	XNode *GetLuaInformation();
 
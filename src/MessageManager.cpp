@@ -5,9 +5,16 @@
 #include "EnumHelper.h"
 #include "LuaManager.h"
 #include "RageLog.h"
+#include "RageTimer.h"
+#include "FrameProfiler.h"
 
-#include <set>
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <thread>
+#include <unordered_map>
 
 MessageManager*	MESSAGEMAN = nullptr;	// global and accessible from anywhere in our program
 
@@ -90,14 +97,160 @@ static const char *MessageIDNames[] = {
 };
 XToString( MessageID );
 
+/* Nearly everything is done on the game thread, so it doesn't lock g_Mutex
+ * unless another thread is using MessageManager at the same time.  Other
+ * threads lock g_Mutex, then wait for the game thread to leave. */
 static RageMutex g_Mutex( "MessageManager" );
+static thread_local bool g_bGameThread = false;
+static std::atomic<int> g_iGameThreadDepth( 0 );
+static std::atomic<int> g_iOtherThreads( 0 );
 
-typedef std::set<IMessageSubscriber*> SubscribersSet;
-static std::map<RString,SubscribersSet> g_MessageToSubscribers;
+namespace
+{
+	class MessageLock
+	{
+	public:
+		MessageLock()
+		{
+			m_bLocked = false;
+			if( g_bGameThread )
+			{
+				// If we're already inside, we already own the tables.
+				if( g_iGameThreadDepth++ > 0 || g_iOtherThreads == 0 )
+					return;
+
+				--g_iGameThreadDepth;
+				g_Mutex.Lock();
+				++g_iGameThreadDepth;
+				m_bLocked = true;
+			}
+			else
+			{
+				g_Mutex.Lock();
+				++g_iOtherThreads;
+				while( g_iGameThreadDepth != 0 )
+					std::this_thread::yield();
+			}
+		}
+
+		~MessageLock()
+		{
+			if( g_bGameThread )
+			{
+				--g_iGameThreadDepth;
+				if( m_bLocked )
+					g_Mutex.Unlock();
+			}
+			else
+			{
+				--g_iOtherThreads;
+				g_Mutex.Unlock();
+			}
+		}
+
+	private:
+		bool m_bLocked;
+	};
+
+	/* Message names are interned, and MessageIDs are interned first, so a
+	 * MessageID is its own index. */
+	struct MessageEntry
+	{
+		RString m_sName;
+		std::vector<IMessageSubscriber *> m_vpSubscribers;
+		bool m_bQueued;		// in g_vDeferredIDs
+		unsigned m_iBroadcasts;
+		unsigned m_iCoalesced;
+		std::uint64_t m_iDispatchUsecs;
+	};
+
+	// A deque, so entries don't move when a handler interns a new name.
+	std::deque<MessageEntry> g_Messages;
+	std::unordered_map<std::string, int> g_MessageNameToID;
+	std::vector<int> g_vDeferredIDs;
+
+	/* Subscribers removed while a broadcast is running are set to null, and
+	 * removed once the outermost broadcast finishes. */
+	int g_iBroadcastDepth = 0;
+	std::vector<int> g_vIDsWithRemovedSubscribers;
+
+	int AddMessage( const RString &sName )
+	{
+		MessageEntry entry;
+		entry.m_sName = sName;
+		entry.m_bQueued = false;
+		entry.m_iBroadcasts = 0;
+		entry.m_iCoalesced = 0;
+		entry.m_iDispatchUsecs = 0;
+		g_Messages.push_back( entry );
+
+		const int iID = g_Messages.size() - 1;
+		g_MessageNameToID[sName] = iID;
+		return iID;
+	}
+
+	// Call these with a MessageLock.
+	void AddMessageIDs()
+	{
+		if( !g_Messages.empty() )
+			return;
+		FOREACH_ENUM( MessageID, m )
+			AddMessage( MessageIDToString(m) );
+	}
+
+	int InternMessageName( const RString &sName )
+	{
+		AddMessageIDs();
+		auto it = g_MessageNameToID.find( sName );
+		if( it != g_MessageNameToID.end() )
+			return it->second;
+		return AddMessage( sName );
+	}
+
+	MessageEntry &GetMessage( MessageID m )
+	{
+		AddMessageIDs();
+		return g_Messages[m];
+	}
+
+	void RemoveNullSubscribers()
+	{
+		for( int iID : g_vIDsWithRemovedSubscribers )
+		{
+			std::vector<IMessageSubscriber *> &subs = g_Messages[iID].m_vpSubscribers;
+			subs.erase( std::remove(subs.begin(), subs.end(), nullptr), subs.end() );
+		}
+		g_vIDsWithRemovedSubscribers.clear();
+	}
+
+	void Dispatch( MessageEntry &entry, const Message &msg )
+	{
+		++entry.m_iBroadcasts;
+		const bool bTime = FrameProfiler::IsEnabled();
+		const std::uint64_t iStartUsecs = bTime? RageTimer::GetUsecsSinceStart(): 0;
+
+		/* Subscribers added by a handler don't get this message.  Index the
+		 * vector each time, since handlers may add to it. */
+		++g_iBroadcastDepth;
+		const std::size_t iCount = entry.m_vpSubscribers.size();
+		for( std::size_t i = 0; i < iCount; ++i )
+		{
+			IMessageSubscriber *pSubscriber = entry.m_vpSubscribers[i];
+			if( pSubscriber != nullptr )
+				pSubscriber->HandleMessage( msg );
+		}
+		if( --g_iBroadcastDepth == 0 && !g_vIDsWithRemovedSubscribers.empty() )
+			RemoveNullSubscribers();
+
+		if( bTime )
+			entry.m_iDispatchUsecs += RageTimer::GetUsecsSinceStart() - iStartUsecs;
+	}
+}
 
 Message::Message( const RString &s )
 {
 	m_sName = s;
+	m_iID = -1;
 	m_pParams = new LuaTable;
 	m_bBroadcast = false;
 }
@@ -105,6 +258,7 @@ Message::Message( const RString &s )
 Message::Message(const MessageID id)
 {
 	m_sName= MessageIDToString(id);
+	m_iID = id;
 	m_pParams = new LuaTable;
 	m_bBroadcast = false;
 }
@@ -112,6 +266,7 @@ Message::Message(const MessageID id)
 Message::Message( const RString &s, const LuaReference &params )
 {
 	m_sName = s;
+	m_iID = -1;
 	m_bBroadcast = false;
 	Lua *L = LUA->Get();
 	m_pParams = new LuaTable; // XXX: creates an extra table
@@ -157,6 +312,7 @@ void Message::SetParamFromStack( lua_State *L, const RString &sName )
 MessageManager::MessageManager()
 {
 	m_Logging= false;
+	g_bGameThread = true;
 	// Register with Lua.
 	{
 		Lua *L = LUA->Get();
@@ -173,36 +329,53 @@ MessageManager::~MessageManager()
 	LUA->UnsetGlobal( "MESSAGEMAN" );
 }
 
-void MessageManager::Subscribe( IMessageSubscriber* pSubscriber, const RString& sMessage )
+static void Subscribe( IMessageSubscriber* pSubscriber, MessageEntry &entry )
 {
-	LockMut(g_Mutex);
-
-	SubscribersSet& subs = g_MessageToSubscribers[sMessage];
+	std::vector<IMessageSubscriber *> &subs = entry.m_vpSubscribers;
 #ifdef DEBUG
-	SubscribersSet::iterator iter = subs.find(pSubscriber);
-	ASSERT_M( iter == subs.end(), ssprintf("already subscribed to '%s'",sMessage.c_str()) );
+	ASSERT_M( std::find(subs.begin(), subs.end(), pSubscriber) == subs.end(), ssprintf("already subscribed to '%s'",entry.m_sName.c_str()) );
 #endif
-	subs.insert( pSubscriber );
+	subs.push_back( pSubscriber );
+}
+
+static void Unsubscribe( IMessageSubscriber* pSubscriber, int iID )
+{
+	std::vector<IMessageSubscriber *> &subs = g_Messages[iID].m_vpSubscribers;
+	std::vector<IMessageSubscriber *>::iterator iter = std::find( subs.begin(), subs.end(), pSubscriber );
+	ASSERT( iter != subs.end() );
+	if( g_iBroadcastDepth == 0 )
+	{
+		subs.erase( iter );
+		return;
+	}
+
+	*iter = nullptr;
+	g_vIDsWithRemovedSubscribers.push_back( iID );
+}
+
+void MessageManager::Subscribe( IMessageSubscriber* pSubscriber, const RString& sMessage )
+{
+	MessageLock lock;
+	::Subscribe( pSubscriber, g_Messages[InternMessageName(sMessage)] );
 }
 
 void MessageManager::Subscribe( IMessageSubscriber* pSubscriber, MessageID m )
 {
-	Subscribe( pSubscriber, MessageIDToString(m) );
+	MessageLock lock;
+	::Subscribe( pSubscriber, GetMessage(m) );
 }
 
 void MessageManager::Unsubscribe( IMessageSubscriber* pSubscriber, const RString& sMessage )
 {
-	LockMut(g_Mutex);
-
-	SubscribersSet& subs = g_MessageToSubscribers[sMessage];
-	SubscribersSet::iterator iter = subs.find(pSubscriber);
-	ASSERT( iter != subs.end() );
-	subs.erase( iter );
+	MessageLock lock;
+	::Unsubscribe( pSubscriber, InternMessageName(sMessage) );
 }
 
 void MessageManager::Unsubscribe( IMessageSubscriber* pSubscriber, MessageID m )
 {
-	Unsubscribe( pSubscriber, MessageIDToString(m) );
+	MessageLock lock;
+	AddMessageIDs();
+	::Unsubscribe( pSubscriber, m );
 }
 
 void MessageManager::Broadcast( Message &msg ) const
@@ -213,35 +386,145 @@ void MessageManager::Broadcast( Message &msg ) const
 	}
 	msg.SetBroadcast(true);
 
-	LockMut(g_Mutex);
+	MessageLock lock;
+	/* Message(MessageID) sets the ID without interning anything, so make sure
+	 * the MessageID entries exist before indexing. */
+	if( msg.m_iID < 0 )
+		msg.m_iID = InternMessageName( msg.GetName() );
+	else
+		AddMessageIDs();
+	Dispatch( g_Messages[msg.m_iID], msg );
+}
+
+void MessageManager::Broadcast( const RString& sMessage ) const
+{
+	ASSERT( !sMessage.empty() );
 
-	std::map<RString, SubscribersSet>::const_iterator iter = g_MessageToSubscribers.find( msg.GetName() );
-	if( iter == g_MessageToSubscribers.end() )
+	/* Most engine messages have no subscribers.  Don't build a Message for
+	 * them, since that creates a Lua table. */
+	MessageLock lock;
+	const int iID = InternMessageName( sMessage );
+	MessageEntry &entry = g_Messages[iID];
+	if( entry.m_vpSubscribers.empty() && !m_Logging )
+	{
+		++entry.m_iBroadcasts;
 		return;
+	}
+
+	Message msg(sMessage);
+	msg.m_iID = iID;
+	Broadcast( msg );
+}
 
-	for (IMessageSubscriber *subscriber : iter->second)
+void MessageManager::Broadcast( MessageID m ) const
+{
+	MessageLock lock;
+	MessageEntry &entry = GetMessage( m );
+	if( entry.m_vpSubscribers.empty() && !m_Logging )
 	{
-		subscriber->HandleMessage( msg );
+		++entry.m_iBroadcasts;
+		return;
 	}
+
+	Message msg( m );
+	Broadcast( msg );
 }
 
-void MessageManager::Broadcast( const RString& sMessage ) const
+void MessageManager::BroadcastDeferred( const RString& sMessage )
 {
 	ASSERT( !sMessage.empty() );
-	Message msg(sMessage);
-	Broadcast( msg );
+
+	MessageLock lock;
+	const int iID = InternMessageName( sMessage );
+	MessageEntry &entry = g_Messages[iID];
+	if( entry.m_bQueued )
+	{
+		++entry.m_iCoalesced;
+		return;
+	}
+
+	entry.m_bQueued = true;
+	g_vDeferredIDs.push_back( iID );
 }
 
-void MessageManager::Broadcast( MessageID m ) const
+void MessageManager::BroadcastDeferred( MessageID m )
+{
+	BroadcastDeferred( MessageIDToString(m) );
+}
+
+void MessageManager::FlushDeferred()
 {
-	Broadcast( MessageIDToString(m) );
+	std::vector<int> vIDs;
+	{
+		MessageLock lock;
+		vIDs.swap( g_vDeferredIDs );
+		for( int iID : vIDs )
+			g_Messages[iID].m_bQueued = false;
+	}
+
+	// Anything queued by these handlers is sent next frame.
+	for( int iID : vIDs )
+	{
+		if( iID < NUM_MessageID )
+		{
+			Broadcast( (MessageID) iID );
+			continue;
+		}
+
+		RString sName;
+		{
+			MessageLock lock;
+			sName = g_Messages[iID].m_sName;
+		}
+		Broadcast( sName );
+	}
+}
+
+bool MessageManager::HasSubscribers( const RString &sMessage ) const
+{
+	MessageLock lock;
+	const std::vector<IMessageSubscriber *> &subs = g_Messages[InternMessageName(sMessage)].m_vpSubscribers;
+	return std::find_if( subs.begin(), subs.end(), []( const IMessageSubscriber *p ) { return p != nullptr; } ) != subs.end();
 }
 
 bool MessageManager::IsSubscribedToMessage( IMessageSubscriber* pSubscriber, const RString &sMessage ) const
 {
-	SubscribersSet& subs = g_MessageToSubscribers[sMessage];
-	return subs.find( pSubscriber ) != subs.end();
-}	
+	MessageLock lock;
+	const std::vector<IMessageSubscriber *> &subs = g_Messages[InternMessageName(sMessage)].m_vpSubscribers;
+	return std::find( subs.begin(), subs.end(), pSubscriber ) != subs.end();
+}
+
+void MessageManager::GetStats( std::vector<MessageStats> &out ) const
+{
+	out.clear();
+
+	MessageLock lock;
+	for( const MessageEntry &entry : g_Messages )
+	{
+		if( entry.m_iBroadcasts == 0 && entry.m_iCoalesced == 0 )
+			continue;
+
+		MessageStats stats;
+		stats.m_sName = entry.m_sName;
+		stats.m_iSubscribers = std::count_if( entry.m_vpSubscribers.begin(), entry.m_vpSubscribers.end(),
+			[]( const IMessageSubscriber *p ) { return p != nullptr; } );
+		stats.m_iBroadcasts = entry.m_iBroadcasts;
+		stats.m_iCoalesced = entry.m_iCoalesced;
+		stats.m_fDispatchMs = entry.m_iDispatchUsecs / 1000.0f;
+		out.push_back( stats );
+	}
+}
+
+void MessageManager::ResetStats()
+{
+	MessageLock lock;
+	for( MessageEntry &entry : g_Messages )
+	{
+		entry.m_iBroadcasts = 0;
+		entry.m_iCoalesced = 0;
+		entry.m_iDispatchUsecs = 0;
+	}
+}
 
 void IMessageSubscriber::ClearMessages( const RString sMessage )
 {
@@ -299,6 +582,13 @@ public:
 		if( !lua_istable(L, 2) && !lua_isnoneornil(L, 2) )
 			luaL_typerror( L, 2, "table or nil" );
 
+		// Don't build a parameter table if nobody's listening.
+		if( !p->HasSubscribers(SArg(1)) )
+		{
+			p->Broadcast( SArg(1) );
+			COMMON_RETURN_SELF;
+		}
+
 		LuaReference ParamTable;
 		lua_pushvalue( L, 2 );
 		ParamTable.SetFromStack( L );
@@ -307,16 +597,49 @@ public:
 		p->Broadcast( msg );
 		COMMON_RETURN_SELF;
 	}
+	static int BroadcastDeferred( T* p, lua_State *L )
+	{
+		p->BroadcastDeferred( SArg(1) );
+		COMMON_RETURN_SELF;
+	}
 	static int SetLogging(T* p, lua_State *L)
 	{
 		p->SetLogging(lua_toboolean(L, -1));
 		COMMON_RETURN_SELF;
 	}
+	// { { Name, Subscribers, Broadcasts, Coalesced, DispatchMs }, ... }
+	static int GetStats( T* p, lua_State *L )
+	{
+		std::vector<MessageManager::MessageStats> vStats;
+		p->GetStats( vStats );
+
+		lua_createtable( L, vStats.size(), 0 );
+		for( unsigned i = 0; i < vStats.size(); ++i )
+		{
+			const MessageManager::MessageStats &stats = vStats[i];
+			lua_createtable( L, 0, 5 );
+			lua_pushstring( L, stats.m_sName );	lua_setfield( L, -2, "Name" );
+			lua_pushinteger( L, stats.m_iSubscribers );	lua_setfield( L, -2, "Subscribers" );
+			lua_pushinteger( L, stats.m_iBroadcasts );	lua_setfield( L, -2, "Broadcasts" );
+			lua_pushinteger( L, stats.m_iCoalesced );	lua_setfield( L, -2, "Coalesced" );
+			lua_pushnumber( L, stats.m_fDispatchMs );	lua_setfield( L, -2, "DispatchMs" );
+			lua_rawseti( L, -2, i+1 );
+		}
+		return 1;
+	}
+	static int ResetStats( T* p, lua_State *L )
+	{
+		p->ResetStats();
+		COMMON_RETURN_SELF;
+	}
 
 	LunaMessageManager()
 	{
 		ADD_METHOD( Broadcast );
+		ADD_METHOD( BroadcastDeferred );
 		ADD_METHOD( SetLogging );
+		ADD_METHOD( GetStats );
+		ADD_METHOD( ResetStats );
 	}
 };
 
@@ -99,7 +99,7 @@ struct Message
 	Message( const RString &s, const LuaReference &params );
 	~Message();
 
-	void SetName( const RString &sName ) { m_sName = sName; }
+	void SetName( const RString &sName ) { m_sName = sName; m_iID = -1; }
 	RString GetName() const { return m_sName; }
 
 	bool IsBroadcast() const { return m_bBroadcast; }
@@ -141,10 +141,13 @@ struct Message
 	}
 
 	bool operator==( const RString &s ) const { return m_sName == s; }
-	bool operator==( MessageID id ) const { return MessageIDToString(id) == m_sName; }
+	bool operator==( MessageID id ) const { return m_iID >= 0? m_iID == id: MessageIDToString(id) == m_sName; }
 
 private:
+	friend class MessageManager;
+
 	RString m_sName;
+	int m_iID;	// the interned name, or -1 if it hasn't been looked up yet
 	LuaTable *m_pParams;
 	bool m_bBroadcast;
 
@@ -201,12 +204,34 @@ public:
 	void Broadcast( Message &msg ) const;
 	void Broadcast( const RString& sMessage ) const;
 	void Broadcast( MessageID m ) const;
+
+	/* Broadcast a message without parameters at the start of the next frame.
+	 * A message queued more than once in a frame is only sent once.  These
+	 * may be called from any thread. */
+	void BroadcastDeferred( const RString& sMessage );
+	void BroadcastDeferred( MessageID m );
+	void FlushDeferred();
+
+	bool HasSubscribers( const RString &sMessage ) const;
 	bool IsSubscribedToMessage( IMessageSubscriber* pSubscriber, const RString &sMessage ) const;
 	inline bool IsSubscribedToMessage( IMessageSubscriber* pSubscriber, MessageID message ) const { return IsSubscribedToMessage( pSubscriber, MessageIDToString(message) ); }
 
 	void SetLogging(bool set) { m_Logging= set; }
 	bool m_Logging;
 
+	/* Dispatch counts for each message.  Time spent in handlers is only
+	 * measured while the frame profiler is on. */
+	struct MessageStats
+	{
+		RString m_sName;
+		unsigned m_iSubscribers;
+		unsigned m_iBroadcasts;
+		unsigned m_iCoalesced;	// deferred broadcasts merged into another
+		float m_fDispatchMs;
+	};
+	void GetStats( std::vector<MessageStats> &out ) const;
+	void ResetStats();
+
 	// Lua
 	void PushSelf( lua_State *L );
 };
@@ -223,7 +248,7 @@ private:
 public:
 	explicit BroadcastOnChange( MessageID m ) { mSendWhenChanged = m; }
 	const T Get() const { return val; }
-	void Set( T t ) { val = t; MESSAGEMAN->Broadcast( MessageIDToString(mSendWhenChanged) ); }
+	void Set( T t ) { val = t; MESSAGEMAN->Broadcast( mSendWhenChanged ); }
 	operator T () const { return val; }
 	bool operator == ( const T &other ) const { return val == other; }
 	bool operator != ( const T &other ) const { return val != other; }
@@ -263,7 +288,7 @@ private:
 public:
 	explicit BroadcastOnChangePtr( MessageID m ) { mSendWhenChanged = m; val = nullptr; }
 	T* Get() const { return val; }
-	void Set( T* t ) { val = t; if(MESSAGEMAN) MESSAGEMAN->Broadcast( MessageIDToString(mSendWhenChanged) ); }
+	void Set( T* t ) { val = t; if(MESSAGEMAN) MESSAGEMAN->Broadcast( mSendWhenChanged ); }
 	/* This is only intended to be used for setting temporary values; always
 	 * restore the original value when finished, so listeners don't get confused
 	 * due to missing a message. */
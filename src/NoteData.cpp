@@ -12,21 +12,42 @@
 #include "GameState.h" // blame radar calculations.
 #include "RageUtil_AutoPtr.h"
 
+#include <algorithm>
+#include <climits>
 #include <cstddef>
 #include <vector>
 
 
 REGISTER_CLASS_TRAITS( NoteData, new NoteData(*pCopy) )
 
+// The row index only has room for this many tracks.
+static const int MAX_INDEXED_TRACKS = 32;
+
+/* The index is dropped by edits, and rebuilding it costs about as much as a
+ * walk over every track.  Don't rebuild it until this many queries in a row
+ * have had to do without it. */
+static const int ROW_INDEX_REBUILD_AFTER = 8;
+
+static inline bool TrackInMask( std::uint32_t iTracks, int iTrack )
+{
+	return iTrack >= MAX_INDEXED_TRACKS || (iTracks & (1u << iTrack));
+}
+
 void NoteData::Init()
 {
 	m_TapNotes = std::vector<TrackMap>();	// ensure that the memory is freed
+	m_RowIndexRows = std::vector<int>();
+	m_RowIndexTracks = std::vector<std::uint32_t>();
+	m_bRowIndexValid = true;
+	m_iRowIndexMisses = 0;
 }
 
 void NoteData::SetNumTracks( int iNewNumTracks )
 {
 	ASSERT( iNewNumTracks > 0 );
 
+	if( iNewNumTracks < GetNumTracks() || iNewNumTracks > MAX_INDEXED_TRACKS )
+		InvalidateRowIndex();
 	m_TapNotes.resize( iNewNumTracks );
 }
 
@@ -47,6 +68,8 @@ void NoteData::ClearRangeForTrack( int rowBegin, int rowEnd, int iTrack )
 	// Optimization: if the range encloses everything, just clear the whole maps.
 	if( rowBegin == 0 && rowEnd == MAX_NOTE_ROW )
 	{
+		if( !m_TapNotes[iTrack].empty() )
+			InvalidateRowIndex();
 		m_TapNotes[iTrack].clear();
 		return;
 	}
@@ -110,6 +133,8 @@ void NoteData::ClearRangeForTrack( int rowBegin, int rowEnd, int iTrack )
 		GetTapNoteRangeInclusive( iTrack, rowBegin, rowEnd, lBegin, lEnd );
 	}
 
+	if( lBegin != lEnd )
+		InvalidateRowIndex();
 	m_TapNotes[iTrack].erase( lBegin, lEnd );
 }
 
@@ -123,6 +148,10 @@ void NoteData::ClearAll()
 {
 	for( int t=0; t<GetNumTracks(); t++ )
 		m_TapNotes[t].clear();
+	m_RowIndexRows.clear();
+	m_RowIndexTracks.clear();
+	m_bRowIndexValid = true;
+	m_iRowIndexMisses = 0;
 }
 
 /* Copy [rowFromBegin,rowFromEnd) from pFrom to this. (Note that this does
@@ -177,8 +206,11 @@ void NoteData::CopyAll( const NoteData& from )
 
 bool NoteData::IsRowEmpty( int row ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
+	if( iTracks == 0 )
+		return true;
 	for( int t=0; t<GetNumTracks(); t++ )
-		if( GetTapNote(t, row).type != TapNoteType_Empty )
+		if( TrackInMask(iTracks, t) && GetTapNote(t, row).type != TapNoteType_Empty )
 			return false;
 	return true;
 }
@@ -195,25 +227,28 @@ bool NoteData::IsRangeEmpty( int track, int rowBegin, int rowEnd ) const
 
 int NoteData::GetNumTapNonEmptyTracks( int row ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	int iNum = 0;
 	for( int t=0; t<GetNumTracks(); t++ )
-		if( GetTapNote(t, row).type != TapNoteType_Empty )
+		if( TrackInMask(iTracks, t) && GetTapNote(t, row).type != TapNoteType_Empty )
 			iNum++;
 	return iNum;
 }
 
 void NoteData::GetTapNonEmptyTracks( int row, std::set<int>& addTo ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	for( int t=0; t<GetNumTracks(); t++ )
-		if( GetTapNote(t, row).type != TapNoteType_Empty )
+		if( TrackInMask(iTracks, t) && GetTapNote(t, row).type != TapNoteType_Empty )
 			addTo.insert(t);
 }
 
 bool NoteData::GetTapFirstNonEmptyTrack( int row, int &iNonEmptyTrackOut ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	for( int t=0; t<GetNumTracks(); t++ )
 	{
-		if( GetTapNote( t, row ).type != TapNoteType_Empty )
+		if( TrackInMask(iTracks, t) && GetTapNote( t, row ).type != TapNoteType_Empty )
 		{
 			iNonEmptyTrackOut = t;
 			return true;
@@ -224,9 +259,10 @@ bool NoteData::GetTapFirstNonEmptyTrack( int row, int &iNonEmptyTrackOut ) const
 
 bool NoteData::GetTapFirstEmptyTrack( int row, int &iEmptyTrackOut ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	for( int t=0; t<GetNumTracks(); t++ )
 	{
-		if( GetTapNote( t, row ).type == TapNoteType_Empty )
+		if( !TrackInMask(iTracks, t) || GetTapNote( t, row ).type == TapNoteType_Empty )
 		{
 			iEmptyTrackOut = t;
 			return true;
@@ -237,9 +273,10 @@ bool NoteData::GetTapFirstEmptyTrack( int row, int &iEmptyTrackOut ) const
 
 bool NoteData::GetTapLastEmptyTrack( int row, int &iEmptyTrackOut ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	for( int t=GetNumTracks()-1; t>=0; t-- )
 	{
-		if( GetTapNote( t, row ).type == TapNoteType_Empty )
+		if( !TrackInMask(iTracks, t) || GetTapNote( t, row ).type == TapNoteType_Empty )
 		{
 			iEmptyTrackOut = t;
 			return true;
@@ -251,8 +288,11 @@ bool NoteData::GetTapLastEmptyTrack( int row, int &iEmptyTrackOut ) const
 int NoteData::GetNumTracksWithTap( int row ) const
 {
 	int iNum = 0;
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	for( int t=0; t<GetNumTracks(); t++ )
 	{
+		if( !TrackInMask(iTracks, t) )
+			continue;
 		const TapNote &tn = GetTapNote( t, row );
 		if( tn.type == TapNoteType_Tap || tn.type == TapNoteType_Lift )
 			iNum++;
@@ -263,8 +303,11 @@ int NoteData::GetNumTracksWithTap( int row ) const
 int NoteData::GetNumTracksWithTapOrHoldHead( int row ) const
 {
 	int iNum = 0;
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	for( int t=0; t<GetNumTracks(); t++ )
 	{
+		if( !TrackInMask(iTracks, t) )
+			continue;
 		const TapNote &tn = GetTapNote( t, row );
 		if( tn.type == TapNoteType_Tap || tn.type == TapNoteType_Lift || tn.type == TapNoteType_HoldHead )
 			iNum++;
@@ -280,8 +323,11 @@ void NoteData::LogNonEmptyRows() {
 
 int NoteData::GetFirstTrackWithTap( int row ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	for( int t=0; t<GetNumTracks(); t++ )
 	{
+		if( !TrackInMask(iTracks, t) )
+			continue;
 		const TapNote &tn = GetTapNote( t, row );
 		if( tn.type == TapNoteType_Tap || tn.type == TapNoteType_Lift )
 			return t;
@@ -291,8 +337,11 @@ int NoteData::GetFirstTrackWithTap( int row ) const
 
 int NoteData::GetFirstTrackWithTapOrHoldHead( int row ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	for( int t=0; t<GetNumTracks(); t++ )
 	{
+		if( !TrackInMask(iTracks, t) )
+			continue;
 		const TapNote &tn = GetTapNote( t, row );
 		if( tn.type == TapNoteType_Tap || tn.type == TapNoteType_Lift || tn.type == TapNoteType_HoldHead )
 			return t;
@@ -302,8 +351,11 @@ int NoteData::GetFirstTrackWithTapOrHoldHead( int row ) const
 
 int NoteData::GetLastTrackWithTapOrHoldHead( int row ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	for( int t=GetNumTracks()-1; t>=0; t-- )
 	{
+		if( !TrackInMask(iTracks, t) )
+			continue;
 		const TapNote &tn = GetTapNote( t, row );
 		if( tn.type == TapNoteType_Tap || tn.type == TapNoteType_Lift || tn.type == TapNoteType_HoldHead )
 			return t;
@@ -526,10 +578,11 @@ int NoteData::GetNumTapNotesNoTiming( int iStartIndex, int iEndIndex ) const
 
 int NoteData::GetNumTapNotesInRow( int iRow ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( iRow );
 	int iNumNotes = 0;
 	for( int t=0; t<GetNumTracks(); t++ )
 	{
-		if (this->IsTap(GetTapNote(t, iRow), iRow))
+		if( TrackInMask(iTracks, t) && this->IsTap(GetTapNote(t, iRow), iRow) )
 			iNumNotes++;
 	}
 	return iNumNotes;
@@ -571,9 +624,12 @@ int NoteData::GetNumRowsWithTapOrHoldHead( int iStartIndex, int iEndIndex ) cons
 
 bool NoteData::RowNeedsAtLeastSimultaneousPresses( int iMinSimultaneousPresses, const int row ) const
 {
+	const std::uint32_t iTracks = GetTracksAtRow( row );
 	int iNumNotesThisIndex = 0;
 	for( int t=0; t<GetNumTracks(); t++ )
 	{
+		if( !TrackInMask(iTracks, t) )
+			continue;
 		const TapNote &tn = GetTapNote(t, row);
 		switch( tn.type )
 		{
@@ -632,9 +688,12 @@ int NoteData::GetNumRowsWithSimultaneousTaps( int iMinTaps, int iStartIndex, int
 	{
 		if (!GAMESTATE->GetProcessedTimingData()->IsJudgableAtRow(r))
 			continue;
+		const std::uint32_t iTracks = GetTracksAtRow( r );
 		int iNumNotesThisIndex = 0;
 		for( int t=0; t<GetNumTracks(); t++ )
 		{
+			if( !TrackInMask(iTracks, t) )
+				continue;
 			const TapNote &tn = GetTapNote(t, r);
 			if (tn.type != TapNoteType_Mine &&     // mines don't count.
 				tn.type != TapNoteType_Empty &&
@@ -921,6 +980,7 @@ void NoteData::LoadTransformed( const NoteData& in, int iNewNumTracks, const int
 	Init();
 
 	SetNumTracks( iNewNumTracks );
+	InvalidateRowIndex();
 
 	// copy tracks
 	for( int t=0; t<GetNumTracks(); t++ )
@@ -938,6 +998,7 @@ void NoteData::LoadTransformed( const NoteData& in, int iNewNumTracks, const int
 void NoteData::MoveTapNoteTrack( int dest, int src )
 {
 	if(dest == src) return;
+	InvalidateRowIndex();
 	m_TapNotes[dest] = m_TapNotes[src];
 	m_TapNotes[src].clear();
 }
@@ -957,12 +1018,17 @@ void NoteData::SetTapNote( int track, int row, const TapNote& t )
 	{
 		TrackMap &trackMap = m_TapNotes[track];
 		// remove the element at this position (if any).
-		// This will return either 0 or 1.
-		trackMap.erase( row );
+		TrackMap::iterator it = trackMap.find( row );
+		if( it != trackMap.end() )
+			RemoveTapNote( track, it );
 	}
 	else
 	{
-		m_TapNotes[track][row] = t;
+		std::pair<TrackMap::iterator, bool> ret = m_TapNotes[track].insert( TrackMap::value_type(row, t) );
+		if( ret.second )
+			AddToRowIndex( track, row );
+		else
+			ret.first->second = t;
 	}
 }
 
@@ -975,8 +1041,7 @@ void NoteData::GetTracksHeldAtRow( int row, std::set<int>& addTo )
 
 int NoteData::GetNumTracksHeldAtRow( int row )
 {
-	static std::set<int> viTracks;
-	viTracks.clear();
+	std::set<int> viTracks;
 	GetTracksHeldAtRow( row, viTracks );
 	return viTracks.size();
 }
@@ -1136,6 +1201,15 @@ void NoteData::GetTapNoteRangeExclusive( int iTrack, int iStartRow, int iEndRow,
 
 bool NoteData::GetNextTapNoteRowForAllTracks( int &rowInOut ) const
 {
+	if( UseRowIndex() )
+	{
+		std::vector<int>::const_iterator it = std::upper_bound( m_RowIndexRows.begin(), m_RowIndexRows.end(), rowInOut );
+		if( it == m_RowIndexRows.end() )
+			return false;
+		rowInOut = *it;
+		return true;
+	}
+
 	int iClosestNextRow = MAX_NOTE_ROW;
 	bool bAnyHaveNextNote = false;
 	for( int t=0; t<GetNumTracks(); t++ )
@@ -1162,6 +1236,15 @@ bool NoteData::GetNextTapNoteRowForAllTracks( int &rowInOut ) const
 
 bool NoteData::GetPrevTapNoteRowForAllTracks( int &rowInOut ) const
 {
+	if( UseRowIndex() )
+	{
+		std::vector<int>::const_iterator it = std::lower_bound( m_RowIndexRows.begin(), m_RowIndexRows.end(), rowInOut );
+		if( it == m_RowIndexRows.begin() )
+			return false;
+		rowInOut = *--it;
+		return true;
+	}
+
 	int iClosestPrevRow = 0;
 	bool bAnyHavePrevNote = false;
 	for( int t=0; t<GetNumTracks(); t++ )
@@ -1186,6 +1269,131 @@ bool NoteData::GetPrevTapNoteRowForAllTracks( int &rowInOut ) const
 	}
 }
 
+bool NoteData::UseRowIndex() const
+{
+	if( GetNumTracks() > MAX_INDEXED_TRACKS )
+		return false;
+	if( m_bRowIndexValid )
+		return true;
+	if( ++m_iRowIndexMisses < ROW_INDEX_REBUILD_AFTER )
+		return false;
+	BuildRowIndex();
+	return true;
+}
+
+void NoteData::BuildRowIndex() const
+{
+	m_RowIndexRows.clear();
+	m_RowIndexTracks.clear();
+
+	// Merge the tracks' rows in order.
+	std::vector<TrackMap::const_iterator> vIters;
+	for( int t=0; t<GetNumTracks(); t++ )
+		vIters.push_back( m_TapNotes[t].begin() );
+
+	for(;;)
+	{
+		int iRow = INT_MAX;
+		for( int t=0; t<GetNumTracks(); t++ )
+			if( vIters[t] != m_TapNotes[t].end() )
+				iRow = std::min( iRow, vIters[t]->first );
+		if( iRow == INT_MAX )
+			break;
+
+		std::uint32_t iTracks = 0;
+		for( int t=0; t<GetNumTracks(); t++ )
+		{
+			if( vIters[t] != m_TapNotes[t].end() && vIters[t]->first == iRow )
+			{
+				iTracks |= 1u << t;
+				++vIters[t];
+			}
+		}
+		m_RowIndexRows.push_back( iRow );
+		m_RowIndexTracks.push_back( iTracks );
+	}
+
+	m_bRowIndexValid = true;
+	m_iRowIndexMisses = 0;
+}
+
+void NoteData::InvalidateRowIndex()
+{
+	m_bRowIndexValid = false;
+	m_iRowIndexMisses = 0;
+}
+
+void NoteData::AddToRowIndex( int iTrack, int iRow )
+{
+	if( !m_bRowIndexValid )
+	{
+		// Still being edited; hold off on rebuilding.
+		m_iRowIndexMisses = 0;
+		return;
+	}
+	if( iTrack >= MAX_INDEXED_TRACKS )
+	{
+		InvalidateRowIndex();
+		return;
+	}
+
+	// Loading adds notes in order, so this is usually an append.
+	if( m_RowIndexRows.empty() || iRow > m_RowIndexRows.back() )
+	{
+		m_RowIndexRows.push_back( iRow );
+		m_RowIndexTracks.push_back( 1u << iTrack );
+		return;
+	}
+
+	std::vector<int>::iterator it = std::lower_bound( m_RowIndexRows.begin(), m_RowIndexRows.end(), iRow );
+	if( *it == iRow )
+		m_RowIndexTracks[it - m_RowIndexRows.begin()] |= 1u << iTrack;
+	else
+		InvalidateRowIndex();
+}
+
+void NoteData::RemoveFromRowIndex( int iTrack, int iRow )
+{
+	if( !m_bRowIndexValid )
+	{
+		m_iRowIndexMisses = 0;
+		return;
+	}
+	if( iTrack >= MAX_INDEXED_TRACKS )
+	{
+		InvalidateRowIndex();
+		return;
+	}
+
+	std::vector<int>::iterator it = std::lower_bound( m_RowIndexRows.begin(), m_RowIndexRows.end(), iRow );
+	ASSERT( it != m_RowIndexRows.end() && *it == iRow );
+	const std::size_t iPos = it - m_RowIndexRows.begin();
+	m_RowIndexTracks[iPos] &= ~(1u << iTrack);
+	if( m_RowIndexTracks[iPos] != 0 )
+		return;
+
+	if( iPos+1 == m_RowIndexRows.size() )
+	{
+		m_RowIndexRows.pop_back();
+		m_RowIndexTracks.pop_back();
+	}
+	else
+	{
+		InvalidateRowIndex();
+	}
+}
+
+std::uint32_t NoteData::GetTracksAtRow( int iRow ) const
+{
+	if( !UseRowIndex() )
+		return ~0u;
+
+	std::vector<int>::const_iterator it = std::lower_bound( m_RowIndexRows.begin(), m_RowIndexRows.end(), iRow );
+	if( it == m_RowIndexRows.end() || *it != iRow )
+		return 0;
+	return m_RowIndexTracks[it - m_RowIndexRows.begin()];
+}
+
 XNode* NoteData::CreateNode() const
 {
 	XNode *p = new XNode( "NoteData" );
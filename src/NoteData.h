@@ -3,6 +3,7 @@
 
 #include "NoteTypes.h"
 
+#include <cstdint>
 #include <map>
 #include <set>
 #include <iterator>
@@ -36,7 +37,7 @@ public:
 	typedef std::map<int,TapNote>::reverse_iterator reverse_iterator;
 	typedef std::map<int,TapNote>::const_reverse_iterator const_reverse_iterator;
 
-	NoteData(): m_TapNotes() {}
+	NoteData(): m_TapNotes(), m_bRowIndexValid(true), m_iRowIndexMisses(0) {}
 
 	iterator begin( int iTrack )					{ return m_TapNotes[iTrack].begin(); }
 	const_iterator begin( int iTrack ) const			{ return m_TapNotes[iTrack].begin(); }
@@ -53,6 +54,10 @@ public:
 	void swap( NoteData &nd )
 	{
 		m_TapNotes.swap(nd.m_TapNotes);
+		m_RowIndexRows.swap(nd.m_RowIndexRows);
+		m_RowIndexTracks.swap(nd.m_RowIndexTracks);
+		std::swap(m_bRowIndexValid, nd.m_bRowIndexValid);
+		std::swap(m_iRowIndexMisses, nd.m_iRowIndexMisses);
 		m_atis.swap(nd.m_atis);
 		m_const_atis.swap(nd.m_const_atis);
 	}
@@ -112,6 +117,31 @@ private:
 	// Any blank space in the map is defined to be empty.
 	std::vector<TrackMap>	m_TapNotes;
 
+	/* A flat index of the rows that have notes on any track, for queries
+	 * that look at every track at once.  m_RowIndexRows is sorted, and
+	 * m_RowIndexTracks has a bit set for each track with a note on the row
+	 * at the same position.  The maps above are still the real storage, so
+	 * iterators and references into them work as before.
+	 *
+	 * Appending notes and changing existing rows keep the index up to date.
+	 * Anything that would insert or remove a row in the middle drops it
+	 * instead, and it's rebuilt once queries stop being interleaved with
+	 * edits.  Since const queries may rebuild it, a NoteData mustn't be read
+	 * from two threads at once. */
+	mutable std::vector<int> m_RowIndexRows;
+	mutable std::vector<std::uint32_t> m_RowIndexTracks;
+	mutable bool m_bRowIndexValid;
+	mutable int m_iRowIndexMisses;
+
+	bool UseRowIndex() const;
+	void BuildRowIndex() const;
+	void InvalidateRowIndex();
+	void AddToRowIndex( int iTrack, int iRow );
+	void RemoveFromRowIndex( int iTrack, int iRow );
+	/* Return a mask of the tracks that may have a note at iRow.  Tracks not
+	 * in the mask are empty; if the index can't be used, every bit is set. */
+	std::uint32_t GetTracksAtRow( int iRow ) const;
+
 	/**
 	 * @brief Determine whether this note is for Player 1 or Player 2.
 	 * @param track the track/column the note is in.
@@ -192,7 +222,7 @@ public:
 
 	inline iterator FindTapNote( unsigned iTrack, int iRow )	{ return m_TapNotes[iTrack].find( iRow ); }
 	inline const_iterator FindTapNote( unsigned iTrack, int iRow ) const { return m_TapNotes[iTrack].find( iRow ); }
-	void RemoveTapNote( unsigned iTrack, iterator it )		{ m_TapNotes[iTrack].erase( it ); }
+	void RemoveTapNote( unsigned iTrack, iterator it )		{ RemoveFromRowIndex( iTrack, it->first ); m_TapNotes[iTrack].erase( it ); }
 
 	/**
 	 * @brief Return an iterator range for [rowBegin,rowEnd).
@@ -25,6 +25,8 @@
 
 
 static Preference<bool> g_bRenderEarlierNotesOnTop( "RenderEarlierNotesOnTop", false );
+// Draw taps that share a texture and render state with one call.
+static Preference<bool> g_bBatchNoteRendering( "BatchNoteRendering", true );
 
 static const double PI_180= PI / 180.0;
 static const double PI_180R= 180.0 / PI;
@@ -548,19 +550,52 @@ bool NoteDisplay::DrawTapsInRange(const NoteFieldRenderArgs& field_args,
 {
 	bool any_upcoming= false;
 
-	auto loop_body = [this, &field_args, &column_args, &any_upcoming](const NoteData::TrackMap::const_iterator& tapit)
+	// TRICKY: If boomerang is on, then all notes in the range
+	// [first_row,last_row] aren't necessarily visible.
+	// Test every note to make sure it's on screen before drawing.
+	// This is the same test as IsOnScreen, done for the whole column at once.
+	m_TapBatch.clear();
+	for(const NoteData::TrackMap::const_iterator& tapit : tap_set)
 	{
-		int tap_row= tapit->first;
-		const TapNote& tn= tapit->second;
+		m_TapBatch.push_back(NoteRowToBeat(tapit->first), -1, false, false);
+	}
+	ArrowEffects::GetYOffsets(m_pPlayerState, column_args.column, m_TapBatch);
 
-		// TRICKY: If boomerang is on, then all notes in the range
-		// [first_row,last_row] aren't necessarily visible.
-		// Test every note to make sure it's on screen before drawing.
-		if(!IsOnScreen(NoteRowToBeat(tap_row), column_args.column,
-				field_args.draw_pixels_after_targets, field_args.draw_pixels_before_targets))
+	m_VisibleTapBatch.clear();
+	m_viVisibleTaps.clear();
+	for(std::size_t i= 0; i < tap_set.size(); ++i)
+	{
+		const float y_offset= m_TapBatch.y_offset[i];
+		if(y_offset > field_args.draw_pixels_before_targets ||
+			y_offset < field_args.draw_pixels_after_targets)
+		{
+			continue; // off screen
+		}
+
+		int tap_row= tap_set[i]->first;
+		const TapNote& tn= tap_set[i]->second;
+		bool in_selection_range = false;
+		if(*field_args.selection_begin_marker != -1 && *field_args.selection_end_marker != -1)
 		{
-			return; // skip
+			in_selection_range = *field_args.selection_begin_marker <= tap_row &&
+				tap_row < *field_args.selection_end_marker;
 		}
+		m_VisibleTapBatch.push_back(NoteRowToVisibleBeat(m_pPlayerState, tap_row),
+			in_selection_range ? field_args.selection_glow : field_args.fail_fade,
+			tn.type == TapNoteType_HoldHead || tn.type == TapNoteType_HoldTail,
+			tn.type == TapNoteType_HoldHead);
+		m_VisibleTapBatch.y_offset.push_back(y_offset);
+		m_viVisibleTaps.push_back(i);
+	}
+	ArrowEffects::GetNoteBatch(m_pPlayerState, column_args.column,
+		m_fYReverseOffsetPixels, field_args.draw_pixels_before_targets,
+		field_args.fade_before_targets, m_VisibleTapBatch);
+
+	auto loop_body = [this, &field_args, &column_args, &any_upcoming, &tap_set](std::size_t visible_index)
+	{
+		const NoteData::TrackMap::const_iterator& tapit= tap_set[m_viVisibleTaps[visible_index]];
+		int tap_row= tapit->first;
+		const TapNote& tn= tapit->second;
 
 		// Hm, this assert used to pass the first and last rows to draw, when it
 		// was in NoteField, but those aren't available here.
@@ -605,38 +640,53 @@ bool NoteDisplay::DrawTapsInRange(const NoteFieldRenderArgs& field_args,
 			}
 		}
 
-		bool in_selection_range = false;
-		if(*field_args.selection_begin_marker != -1 && *field_args.selection_end_marker != -1)
-		{
-			in_selection_range = *field_args.selection_begin_marker <= tap_row &&
-				tap_row < *field_args.selection_end_marker;
-		}
-
 		bool is_addition = (tn.source == TapNoteSource_Addition);
 		DrawTap(tn, field_args, column_args,
-			NoteRowToVisibleBeat(m_pPlayerState, tap_row),
+			m_VisibleTapBatch.beat[visible_index],
 			hold_begins_on_this_beat, roll_begins_on_this_beat,
-			is_addition,
-			in_selection_range ? field_args.selection_glow : field_args.fail_fade);
+			is_addition, m_VisibleTapBatch.percent_fade_to_fail[visible_index],
+			&m_VisibleTapBatch, visible_index);
 
 		any_upcoming |= NoteRowToBeat(tap_row) >
 			m_pPlayerState->GetDisplayedPosition().m_fSongBeat;
 
 		if(!PREFSMAN->m_FastNoteRendering)
 		{
+			// Quads that don't use the Z buffer can stay in the batch.
+			if(DISPLAY->QuadBatchUsesZBuffer())
+			{
+				DISPLAY->FlushQuadBatch();
+			}
 			DISPLAY->ClearZBuffer();
 		}
 	};
 
+	const bool batch_quads= g_bBatchNoteRendering.Get();
+	if(batch_quads)
+	{
+		DISPLAY->BeginQuadBatch();
+	}
+
 	if (g_bRenderEarlierNotesOnTop.Get())
 	{
 		// draw notes from closest to furthest
-		std::for_each(tap_set.rbegin(), tap_set.rend(), loop_body);
+		for(std::size_t i= m_viVisibleTaps.size(); i-- > 0; )
+		{
+			loop_body(i);
+		}
 	}
 	else
 	{
 		// draw notes from furthest to closest
-		std::for_each(tap_set.begin(), tap_set.end(), loop_body);
+		for(std::size_t i= 0; i < m_viVisibleTaps.size(); ++i)
+		{
+			loop_body(i);
+		}
+	}
+
+	if(batch_quads)
+	{
+		DISPLAY->EndQuadBatch();
 	}
 
 	return any_upcoming;
@@ -715,14 +765,6 @@ Sprite *NoteDisplay::GetHoldSprite( NoteColorSprite ncs[NUM_HoldType][NUM_Active
 	return pSpriteOut;
 }
 
-static float ArrowGetAlphaOrGlow( bool bGlow, const PlayerState* pPlayerState, int iCol, float fYOffset, float fPercentFadeToFail, float fYReverseOffsetPixels, float fDrawDistanceBeforeTargetsPixels, float fFadeInPercentOfDrawFar )
-{
-	if( bGlow )
-		return ArrowEffects::GetGlow(pPlayerState, iCol, fYOffset, fPercentFadeToFail, fYReverseOffsetPixels, fDrawDistanceBeforeTargetsPixels, fFadeInPercentOfDrawFar);
-	else
-		return ArrowEffects::GetAlpha(pPlayerState, iCol, fYOffset, fPercentFadeToFail, fYReverseOffsetPixels, fDrawDistanceBeforeTargetsPixels, fFadeInPercentOfDrawFar);
-}
-
 struct StripBuffer
 {
 	enum { size = 512 };
@@ -848,24 +890,46 @@ void NoteDisplay::DrawHoldPart(std::vector<Sprite*> &vpSpr,
 	// pos_z_vec will be used later to orient the hold.  Read below. -Kyz
 	static const RageVector3 pos_z_vec(0.0f, 0.0f, 1.0f);
 	static const RageVector3 pos_y_vec(0.0f, 1.0f, 0.0f);
-	StripBuffer queue;
-	for(float fY = y_start_pos; !last_vert_set; fY += part_args.y_step)
+
+	// Each row of the strip is a note in a batch, so ArrowEffects can work
+	// out the whole hold part at once.
+	ArrowEffects::NoteBatch &batch= m_HoldBatch;
+	batch.clear();
+	m_vHoldY.clear();
+	for(float fY = y_start_pos; ; fY += part_args.y_step)
 	{
-		if(fY >= y_end_pos)
+		const bool last= fY >= y_end_pos;
+		if(last)
 		{
 			fY = y_end_pos;
-			last_vert_set = true;
 		}
 
-		const float fYOffset= ArrowEffects::GetYOffsetFromYPos(column_args.column, fY, m_fYReverseOffsetPixels);
-
-		ae_zoom = ArrowEffects::GetZoom(m_pPlayerState, fYOffset, column_args.column);
-
 		float cur_beat= part_args.top_beat;
 		if(part_args.top_beat != part_args.bottom_beat)
 		{
 			cur_beat= SCALE(fY, part_args.y_top, part_args.y_bottom, part_args.top_beat, part_args.bottom_beat);
 		}
+		batch.push_back(cur_beat, part_args.percent_fade_to_fail, false, false);
+		batch.y_offset.push_back(ArrowEffects::GetYOffsetFromYPos(column_args.column, fY, m_fYReverseOffsetPixels));
+		m_vHoldY.push_back(fY);
+		if(last)
+		{
+			break;
+		}
+	}
+	ArrowEffects::GetNoteBatch(m_pPlayerState, column_args.column,
+		m_fYReverseOffsetPixels, field_args.draw_pixels_before_targets,
+		field_args.fade_before_targets, batch);
+
+	StripBuffer queue;
+	for(std::size_t i= 0; !last_vert_set; ++i)
+	{
+		const float fY= m_vHoldY[i];
+		last_vert_set= i + 1 == batch.size();
+
+		const float fYOffset= batch.y_offset[i];
+		ae_zoom = batch.zoom[i];
+		const float cur_beat= batch.beat[i];
 
 		// Fun times ahead with vector math.  If the notes are being moved by the
 		// position spline, the vectors used to position the edges of the strip
@@ -899,22 +963,26 @@ void NoteDisplay::DrawHoldPart(std::vector<Sprite*> &vpSpr,
 		// maintain the old behavior of how holds are drawn when they wave back
 		// and forth. -Kyz
 		RageVector3 render_forward(0.0f, 1.0f, 0.0f);
-		column_args.spae_pos_for_beat(m_pPlayerState, cur_beat,
-			fYOffset, m_fYReverseOffsetPixels, sp_pos, ae_pos);
 		// fX and fZ are sp_pos.x + ae_pos.x and sp_pos.z + ae_pos.z. -Kyz
 		// fY is the actual y position that should be used, not whatever spae
 		// fetched from ArrowEffects. -Kyz
 		switch(column_args.pos_handler->m_spline_mode)
 		{
 			case NCSM_Disabled:
+				ae_pos.x= batch.x[i];
 				ae_pos.y= fY + ArrowEffects::GetMoveY(column_args.column);
+				ae_pos.z= batch.z[i];
 				break;
 			case NCSM_Offset:
+				ae_pos.x= batch.x[i];
 				ae_pos.y= fY + ArrowEffects::GetMoveY(column_args.column);
+				ae_pos.z= batch.z[i];
+				column_args.pos_handler->EvalForBeat(column_args.song_beat, cur_beat, sp_pos);
 				column_args.pos_handler->EvalDerivForBeat(column_args.song_beat, cur_beat, sp_pos_forward);
 				RageVec3Normalize(&sp_pos_forward, &sp_pos_forward);
 				break;
 			case NCSM_Position:
+				column_args.pos_handler->EvalForBeat(column_args.song_beat, cur_beat, sp_pos);
 				ae_pos.y= 0.0f;
 				render_forward.y= 0.0f;
 				column_args.pos_handler->EvalDerivForBeat(column_args.song_beat, cur_beat, sp_pos_forward);
@@ -960,10 +1028,10 @@ void NoteDisplay::DrawHoldPart(std::vector<Sprite*> &vpSpr,
 		{
 			case NCSM_Disabled:
 				// XXX: Actor rotations use degrees, Math uses radians. Convert here.
-				ae_rot.y= ArrowEffects::GetRotationY(m_pPlayerState, fYOffset, column_args.column) * -PI_180;
+				ae_rot.y= batch.rot_y[i] * -PI_180;
 				break;
 			case NCSM_Offset:
-				ae_rot.y= ArrowEffects::GetRotationY(m_pPlayerState, fYOffset, column_args.column) * -PI_180;
+				ae_rot.y= batch.rot_y[i] * -PI_180;
 				column_args.rot_handler->EvalForBeat(column_args.song_beat, cur_beat, sp_rot);
 				break;
 			case NCSM_Position:
@@ -1016,7 +1084,7 @@ void NoteDisplay::DrawHoldPart(std::vector<Sprite*> &vpSpr,
 		float fTexCoordTop		= SCALE(fDistFromTop, 0, unzoomed_frame_height, rect.top, rect.bottom * fVariableZoom);
 		fTexCoordTop += add_to_tex_coord;
 
-		const float fAlpha		= ArrowGetAlphaOrGlow(glow, m_pPlayerState, column_args.column, fYOffset, part_args.percent_fade_to_fail, m_fYReverseOffsetPixels, field_args.draw_pixels_before_targets, field_args.fade_before_targets);
+		const float fAlpha		= glow ? batch.glow[i] : batch.alpha[i];
 		const RageColor color= RageColor(
 			column_args.diffuse.r * color_scale,
 			column_args.diffuse.g * color_scale,
@@ -1050,7 +1118,11 @@ void NoteDisplay::DrawHoldPart(std::vector<Sprite*> &vpSpr,
 			}
 			queue.Init();
 			bAllAreTransparent = true;
-			fY -= part_args.y_step;
+			// Start the next strip on the row this one ended with.
+			if(!last_vert_set)
+			{
+				--i;
+			}
 		}
 		first_vert_set= false;
 	}
@@ -1263,10 +1335,65 @@ void NoteDisplay::DrawHold(const TapNote& tn,
 	}
 }
 
+// Same as spae_pos_for_beat, spae_zoom_for_beat and the rotation in
+// DrawActor, but with the ArrowEffects values taken from a NoteBatch.
+static void draw_actor_from_batch(const NoteColumnRenderArgs& column_args,
+	float spline_beat, const ArrowEffects::NoteBatch& batch, std::size_t i,
+	RageVector3& sp_pos, RageVector3& ae_pos,
+	RageVector3& sp_rot, RageVector3& ae_rot,
+	RageVector3& sp_zoom, RageVector3& ae_zoom)
+{
+	switch(column_args.pos_handler->m_spline_mode)
+	{
+		case NCSM_Disabled:
+			ae_pos= RageVector3(batch.x[i], batch.y[i], batch.z[i]);
+			break;
+		case NCSM_Offset:
+			ae_pos= RageVector3(batch.x[i], batch.y[i], batch.z[i]);
+			column_args.pos_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_pos);
+			break;
+		case NCSM_Position:
+			column_args.pos_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_pos);
+			break;
+		default:
+			break;
+	}
+	switch(column_args.rot_handler->m_spline_mode)
+	{
+		case NCSM_Disabled:
+			ae_rot= RageVector3(batch.rot_x[i], batch.rot_y[i], batch.rot_z[i]);
+			break;
+		case NCSM_Offset:
+			ae_rot= RageVector3(batch.rot_x[i], batch.rot_y[i], batch.rot_z[i]);
+			column_args.rot_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_rot);
+			break;
+		case NCSM_Position:
+			column_args.rot_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_rot);
+			break;
+		default:
+			break;
+	}
+	switch(column_args.zoom_handler->m_spline_mode)
+	{
+		case NCSM_Disabled:
+			ae_zoom.x= ae_zoom.y= ae_zoom.z= batch.zoom[i];
+			break;
+		case NCSM_Offset:
+			ae_zoom.x= ae_zoom.y= ae_zoom.z= batch.zoom[i];
+			column_args.zoom_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_zoom);
+			break;
+		case NCSM_Position:
+			column_args.zoom_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_zoom);
+			break;
+		default:
+			break;
+	}
+}
+
 void NoteDisplay::DrawActor(const TapNote& tn, Actor* pActor, NotePart part,
 	const NoteFieldRenderArgs& field_args, const NoteColumnRenderArgs& column_args, float fYOffset, float fBeat,
 	bool bIsAddition, float fPercentFadeToFail, float fColorScale,
-	bool is_being_held)
+	bool is_being_held, const ArrowEffects::NoteBatch *batch, std::size_t batch_index)
 {
 	if (tn.type == TapNoteType_AutoKeysound && !GAMESTATE->m_bInStepEditor) return;
 	if(fYOffset < field_args.draw_pixels_after_targets ||
@@ -1277,8 +1404,10 @@ void NoteDisplay::DrawActor(const TapNote& tn, Actor* pActor, NotePart part,
 	float spline_beat= fBeat;
 	if(is_being_held) { spline_beat= column_args.song_beat; }
 
-	const float fAlpha= ArrowEffects::GetAlpha(m_pPlayerState, column_args.column, fYOffset, fPercentFadeToFail, m_fYReverseOffsetPixels, field_args.draw_pixels_before_targets, field_args.fade_before_targets);
-	const float fGlow= ArrowEffects::GetGlow(m_pPlayerState, column_args.column, fYOffset, fPercentFadeToFail, m_fYReverseOffsetPixels, field_args.draw_pixels_before_targets, field_args.fade_before_targets);
+	const float fAlpha= batch != nullptr ? batch->alpha[batch_index] :
+		ArrowEffects::GetAlpha(m_pPlayerState, column_args.column, fYOffset, fPercentFadeToFail, m_fYReverseOffsetPixels, field_args.draw_pixels_before_targets, field_args.fade_before_targets);
+	const float fGlow= batch != nullptr ? batch->glow[batch_index] :
+		ArrowEffects::GetGlow(m_pPlayerState, column_args.column, fYOffset, fPercentFadeToFail, m_fYReverseOffsetPixels, field_args.draw_pixels_before_targets, field_args.fade_before_targets);
 	const RageColor diffuse	= RageColor(
 		column_args.diffuse.r * fColorScale,
 		column_args.diffuse.g * fColorScale,
@@ -1315,29 +1444,39 @@ void NoteDisplay::DrawActor(const TapNote& tn, Actor* pActor, NotePart part,
 	RageVector3 ae_pos;
 	RageVector3 ae_rot;
 	RageVector3 ae_zoom;
-	column_args.spae_pos_for_beat(m_pPlayerState, spline_beat,
-		fYOffset, m_fYReverseOffsetPixels, sp_pos, ae_pos);
-
-	switch(column_args.rot_handler->m_spline_mode)
+	if(batch != nullptr)
 	{
-		case NCSM_Disabled:
-			ae_rot.x= ArrowEffects::GetRotationX(m_pPlayerState, fYOffset, bIsHoldCap, column_args.column);
-			ae_rot.y= ArrowEffects::GetRotationY(m_pPlayerState, fYOffset, column_args.column);
-			ae_rot.z= ArrowEffects::GetRotationZ(m_pPlayerState, fBeat, bIsHoldHead, column_args.column);
-			break;
-		case NCSM_Offset:
-			ae_rot.x= ArrowEffects::GetRotationX(m_pPlayerState, fYOffset, bIsHoldCap, column_args.column);
-			ae_rot.y= ArrowEffects::GetRotationY(m_pPlayerState, fYOffset, column_args.column);
-			ae_rot.z= ArrowEffects::GetRotationZ(m_pPlayerState, fBeat, bIsHoldHead, column_args.column);
-			column_args.rot_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_rot);
-			break;
-		case NCSM_Position:
-			column_args.rot_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_rot);
-			break;
-		default:
-			break;
+		// The ArrowEffects part was worked out for the whole column in
+		// GetNoteBatch, so only the splines are left.
+		draw_actor_from_batch(column_args, spline_beat, *batch, batch_index,
+			sp_pos, ae_pos, sp_rot, ae_rot, sp_zoom, ae_zoom);
+	}
+	else
+	{
+		column_args.spae_pos_for_beat(m_pPlayerState, spline_beat,
+			fYOffset, m_fYReverseOffsetPixels, sp_pos, ae_pos);
+
+		switch(column_args.rot_handler->m_spline_mode)
+		{
+			case NCSM_Disabled:
+				ae_rot.x= ArrowEffects::GetRotationX(m_pPlayerState, fYOffset, bIsHoldCap, column_args.column);
+				ae_rot.y= ArrowEffects::GetRotationY(m_pPlayerState, fYOffset, column_args.column);
+				ae_rot.z= ArrowEffects::GetRotationZ(m_pPlayerState, fBeat, bIsHoldHead, column_args.column);
+				break;
+			case NCSM_Offset:
+				ae_rot.x= ArrowEffects::GetRotationX(m_pPlayerState, fYOffset, bIsHoldCap, column_args.column);
+				ae_rot.y= ArrowEffects::GetRotationY(m_pPlayerState, fYOffset, column_args.column);
+				ae_rot.z= ArrowEffects::GetRotationZ(m_pPlayerState, fBeat, bIsHoldHead, column_args.column);
+				column_args.rot_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_rot);
+				break;
+			case NCSM_Position:
+				column_args.rot_handler->EvalForBeat(column_args.song_beat, spline_beat, sp_rot);
+				break;
+			default:
+				break;
+		}
+		column_args.spae_zoom_for_beat(m_pPlayerState, spline_beat, sp_zoom, ae_zoom, column_args.column, fYOffset);
 	}
-	column_args.spae_zoom_for_beat(m_pPlayerState, spline_beat, sp_zoom, ae_zoom, column_args.column, fYOffset);
 	column_args.SetPRZForActor(pActor, sp_pos, ae_pos, sp_rot, ae_rot, sp_zoom, ae_zoom);
 	// [AJ] this two lines (and how they're handled) piss off many people:
 	pActor->SetDiffuse( diffuse );
@@ -1373,6 +1512,12 @@ void NoteDisplay::DrawActor(const TapNote& tn, Actor* pActor, NotePart part,
 		DISPLAY->TextureTranslate( (bIsAddition ? cache->m_fAdditionTextureCoordOffset[part] : RageVector2(0,0)) + cache->m_fNoteColorTextureCoordSpacing[part]*color );
 	}
 
+	// Anything that can't go in the batch has to be drawn after what's
+	// already in it.
+	if(DISPLAY->IsBatchingQuads() && !pActor->CanDrawBatched())
+	{
+		DISPLAY->FlushQuadBatch();
+	}
 	pActor->Draw();
 
 	if( bNeedsTranslate )
@@ -1385,7 +1530,8 @@ void NoteDisplay::DrawTap(const TapNote& tn,
 	const NoteFieldRenderArgs& field_args,
 	const NoteColumnRenderArgs& column_args, float fBeat,
 	bool bOnSameRowAsHoldStart, bool bOnSameRowAsRollStart,
-	bool bIsAddition, float fPercentFadeToFail)
+	bool bIsAddition, float fPercentFadeToFail,
+	const ArrowEffects::NoteBatch *batch, std::size_t batch_index)
 {
 	Actor* pActor = nullptr;
 	NotePart part = NotePart_Tap;
@@ -1457,9 +1603,10 @@ void NoteDisplay::DrawTap(const TapNote& tn,
 		pActor->HandleMessage( msg );
 	}
 
-	const float fYOffset = ArrowEffects::GetYOffset( m_pPlayerState, column_args.column, fBeat );
+	const float fYOffset = batch != nullptr ? batch->y_offset[batch_index] :
+		ArrowEffects::GetYOffset( m_pPlayerState, column_args.column, fBeat );
 	// this is the line that forces the (1,1,1,x) part of the noteskin diffuse -aj
-	DrawActor(tn, pActor, part, field_args, column_args, fYOffset, fBeat, bIsAddition, fPercentFadeToFail, 1.0f, false);
+	DrawActor(tn, pActor, part, field_args, column_args, fYOffset, fBeat, bIsAddition, fPercentFadeToFail, 1.0f, false, batch, batch_index);
 
 	if( tn.type == TapNoteType_Attack )
 		pActor->PlayCommand( "UnsetAttack" );
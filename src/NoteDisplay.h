@@ -2,6 +2,7 @@
 #define NOTE_DISPLAY_H
 
 #include "ActorFrame.h"
+#include "ArrowEffects.h"
 #include "CubicSpline.h"
 #include "NoteData.h"
 #include "PlayerNumber.h"
@@ -206,11 +207,14 @@ public:
 	 * @param fReverseOffsetPixels How are the notes adjusted on Reverse?
 	 * @param fDrawDistanceAfterTargetsPixels how much to draw after the receptors.
 	 * @param fDrawDistanceBeforeTargetsPixels how much ot draw before the receptors.
-	 * @param fFadeInPercentOfDrawFar when to start fading in. */
+	 * @param fFadeInPercentOfDrawFar when to start fading in.
+	 * @param batch the arrow effects already worked out for this note, if any.
+	 * @param batch_index where this note is in the batch. */
 	void DrawTap(const TapNote& tn, const NoteFieldRenderArgs& field_args,
 		const NoteColumnRenderArgs& column_args, float fBeat,
 		bool bOnSameRowAsHoldStart,
-		bool bOnSameRowAsRollBeat, bool bIsAddition, float fPercentFadeToFail);
+		bool bOnSameRowAsRollBeat, bool bIsAddition, float fPercentFadeToFail,
+		const ArrowEffects::NoteBatch *batch = nullptr, std::size_t batch_index = 0);
 	void DrawHold(const TapNote& tn, const NoteFieldRenderArgs& field_args,
 		const NoteColumnRenderArgs& column_args, int iRow, bool bIsBeingHeld,
 		const HoldNoteResult &Result,
@@ -246,7 +250,8 @@ private:
 		const NoteFieldRenderArgs& field_args,
 		const NoteColumnRenderArgs& column_args, float fYOffset, float fBeat,
 		bool bIsAddition, float fPercentFadeToFail, float fColorScale,
-		bool is_being_held);
+		bool is_being_held,
+		const ArrowEffects::NoteBatch *batch = nullptr, std::size_t batch_index = 0);
 	void DrawHoldPart(std::vector<Sprite*> &vpSpr,
 		const NoteFieldRenderArgs& field_args,
 		const NoteColumnRenderArgs& column_args,
@@ -277,6 +282,16 @@ private:
 	NoteColorSprite		m_HoldBottomCap[NUM_HoldType][NUM_ActiveType];
 	NoteColorActor		m_HoldTail[NUM_HoldType][NUM_ActiveType];
 	float			m_fYReverseOffsetPixels;
+
+	// Scratch space for DrawTapsInRange: every tap in range, then the ones
+	// that are on screen, and where each of those is in tap_set.
+	ArrowEffects::NoteBatch m_TapBatch;
+	ArrowEffects::NoteBatch m_VisibleTapBatch;
+	std::vector<std::size_t> m_viVisibleTaps;
+	// Scratch space for DrawHoldPart: a row of the strip for each note, and
+	// the y position of each row.
+	ArrowEffects::NoteBatch m_HoldBatch;
+	std::vector<float> m_vHoldY;
 };
 
 // So, this is a bit screwy, and it's partly because routine forces rendering
@@ -19,6 +19,7 @@
 #include "Course.h"
 #include "NoteData.h"
 #include "RageDisplay.h"
+#include "FrameProfiler.h"
 
 #include <cfloat>
 #include <cmath>
@@ -774,6 +775,7 @@ void NoteField::CalcPixelsBeforeAndAfterTargets()
 
 void NoteField::DrawPrimitives()
 {
+	PROFILE_SCOPE( "NoteField draw" );
 	//LOG->Trace( "NoteField::DrawPrimitives()" );
 
 	// This should be filled in on the first update.
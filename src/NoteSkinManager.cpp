@@ -17,6 +17,7 @@
 
 #include <cstddef>
 #include <map>
+#include <set>
 #include <vector>
 
 
@@ -458,6 +459,33 @@ RString NoteSkinManager::GetPath( const RString &sButtonName, const RString &sEl
 	return sPath;
 }
 
+void NoteSkinManager::GetTexturePaths( const RString &sNoteSkin, std::vector<RString> &vsPathsOut )
+{
+	RString sNoteSkinName = sNoteSkin;
+	sNoteSkinName.MakeLower();
+	std::map<RString, NoteSkinData>::const_iterator iter = g_mapNameToData.find( sNoteSkinName );
+	if( iter == g_mapNameToData.end() )
+		return;
+
+	std::set<RString> setSeen;
+	for (RString const &directory : iter->second.vsDirSearchOrder)
+	{
+		std::vector<RString> vsFiles;
+		GetDirListing( directory + "*", vsFiles, false, false );
+		for (RString const &sFile : vsFiles)
+		{
+			RString sPath = directory + sFile;
+			if( ActorUtil::GetFileType(sPath) != FT_Bitmap )
+				continue;
+			RString sLower = sFile;
+			sLower.MakeLower();
+			if( !setSeen.insert(sLower).second )
+				continue;
+			vsPathsOut.push_back( sPath );
+		}
+	}
+}
+
 bool NoteSkinManager::PushActorTemplate( Lua *L, const RString &sButton, const RString &sElement, bool bSpriteOnly )
 {
 	std::map<RString, NoteSkinData>::const_iterator iter = g_mapNameToData.find( m_sCurrentNoteSkin );
@@ -35,6 +35,8 @@ public:
 	void SetPlayerNumber( PlayerNumber pn ) { m_PlayerNumber = pn; }
 	void SetGameController( GameController gc ) { m_GameController = gc; }
 	RString GetPath( const RString &sButtonName, const RString &sElement );
+	// Every image in the skin and its fallbacks, skipping ones a nearer dir overrides.
+	void GetTexturePaths( const RString &sNoteSkin, std::vector<RString> &vsPathsOut );
 	bool PushActorTemplate( Lua *L, const RString &sButton, const RString &sElement, bool bSpriteOnly );
 	Actor *LoadActor( const RString &sButton, const RString &sElement, Actor *pParent = nullptr, bool bSpriteOnly = false );
 
@@ -19,7 +19,8 @@
 
 Difficulty DwiCompatibleStringToDifficulty( const RString& sDC );
 
-static std::map<int,int> g_mapDanceNoteToNoteDataColumn;
+// Songs may be loaded on several threads at once, so each gets its own map.
+static thread_local std::map<int,int> g_mapDanceNoteToNoteDataColumn;
 
 /** @brief The different types of core DWI arrows and pads. */
 enum DanceNotes
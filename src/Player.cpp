@@ -40,6 +40,8 @@
 #include "GameCommand.h"
 #include "LocalizedString.h"
 #include "AdjustSync.h"
+#include "InputLatency.h"
+#include "FrameProfiler.h"
 
 #include <cmath>
 #include <cstddef>
@@ -268,7 +270,8 @@ Player::Player( NoteData &nd, bool bVisibleParts ) : m_NoteData(nd)
 	m_pPrimaryScoreKeeper = nullptr;
 	m_pSecondaryScoreKeeper = nullptr;
 	m_pInventory = nullptr;
-	m_pIterNeedsTapJudging = nullptr;
+	m_iJudgeIndexStartRow = 0;
+	m_iJudgeIndexRevision = 0;
 	m_pIterNeedsHoldJudging = nullptr;
 	m_pIterUncrossedRows = nullptr;
 	m_pIterUnjudgedRows = nullptr;
@@ -304,7 +307,6 @@ Player::~Player()
 	for( unsigned i = 0; i < m_vpHoldJudgment.size(); ++i )
 		SAFE_DELETE( m_vpHoldJudgment[i] );
 	SAFE_DELETE( m_pJudgedRows );
-	SAFE_DELETE( m_pIterNeedsTapJudging );
 	SAFE_DELETE( m_pIterNeedsHoldJudging );
 	SAFE_DELETE( m_pIterUncrossedRows );
 	SAFE_DELETE( m_pIterUnjudgedRows );
@@ -788,8 +790,8 @@ void Player::Load()
 	if( m_pPlayerStageStats )
 		SendComboMessages( m_pPlayerStageStats->m_iCurCombo, m_pPlayerStageStats->m_iCurMissCombo );
 
-	SAFE_DELETE( m_pIterNeedsTapJudging );
-	m_pIterNeedsTapJudging = new NoteData::all_tracks_iterator( m_NoteData.GetTapNoteRangeAllTracks(iNoteRow, MAX_NOTE_ROW) );
+	m_iJudgeIndexStartRow = iNoteRow;
+	BuildJudgeIndex();
 
 	SAFE_DELETE( m_pIterNeedsHoldJudging );
 	m_pIterNeedsHoldJudging = new NoteData::all_tracks_iterator( m_NoteData.GetTapNoteRangeAllTracks(iNoteRow, MAX_NOTE_ROW ) );
@@ -828,6 +830,7 @@ void Player::SendComboMessages( unsigned int iOldCombo, unsigned int iOldMissCom
 
 void Player::Update( float fDeltaTime )
 {
+	PROFILE_SCOPE( "Player update" );
 	const RageTimer now;
 	// Don't update if we haven't been loaded yet.
 	if( !m_bLoaded )
@@ -839,6 +842,7 @@ void Player::Update( float fDeltaTime )
 		return;
 
 	ActorFrame::Update( fDeltaTime );
+	CheckJudgeIndexTiming();
 
 	if(m_pPlayerState->m_mp != MultiPlayer_Invalid)
 	{
@@ -1039,48 +1043,42 @@ void Player::Update( float fDeltaTime )
 		const SongPosition songPosition = m_pPlayerState->m_Position;
 		const float musicPosition = songPosition.m_fMusicSeconds + (songPosition.m_LastBeatUpdate.Ago() * rate);
 		// We have to add 1 here, because GetBeatFromElapsedTime() can round down.
-		const int lastCheckRow = BeatToNoteRow(m_Timing->GetBeatFromElapsedTime(musicPosition + (largestWindow * rate)) + 1);
+		TimingData::GetBeatArgs lastCheckBeat;
+		lastCheckBeat.elapsed_time = musicPosition + (largestWindow * rate);
+		m_Timing->GetBeatAndBPSFromElapsedTime(lastCheckBeat, m_HeldMissCursor);
+		const int lastCheckRow = BeatToNoteRow(lastCheckBeat.beat + 1);
 
 		// The button being held only counts for the first unjudged
-		// note on a track (== column/arrow direction), so we have to
-		// keep track for which tracks we have already seen an unjudged
-		// note.
-		std::vector<bool> seenTracks(m_NoteData.GetNumTracks(), false);
-
-		for(auto iter = *m_pIterNeedsTapJudging; !iter.IsAtEnd() && iter.Row() <= lastCheckRow; ++iter)
+		// note on a track (== column/arrow direction).  The judge index
+		// has each note's time, and leaves out warp and fake segments.
+		const float fOffsetSeconds = m_Timing->m_fBeat0OffsetInSeconds + rate * PREFSMAN->m_fGlobalOffsetSeconds;
+		for( std::size_t track = 0; track < m_vJudgeIndex.size(); ++track )
 		{
-			TapNote &tn = *iter;
-			const int row = iter.Row();
-			const int track = iter.Track();
-
-			// Skip over warp and fake segments
-			if (!m_Timing->IsJudgableAtRow(row))
-				continue;
-
-			// Held misses only apply to tap notes
-			if (tn.type != TapNoteType_Tap && tn.type != TapNoteType_HoldHead)
-				continue;
-
-			const float notePosition = m_Timing->GetElapsedTimeFromBeat(NoteRowToBeat(row));
-			const float offset = std::abs((notePosition - musicPosition) / rate);
+			const std::vector<JudgeIndexNote> &vNotes = m_vJudgeIndex[track];
+			for( std::size_t i = m_viNextUnjudged[track]; i < vNotes.size() && vNotes[i].iRow <= lastCheckRow; ++i )
+			{
+				TapNote &tn = *vNotes[i].pTN;
 
-			// Skip if we are outside of the largest timing window
-			if (offset > largestWindow)
-				continue;
+				// Held misses only apply to tap notes
+				if (tn.type != TapNoteType_Tap && tn.type != TapNoteType_HoldHead)
+					continue;
 
-			// Skip the note if there is an earlier note on the same track that still awaits judgement
-			if (seenTracks[track])
-			    continue;
+				const float notePosition = vNotes[i].fSeconds - fOffsetSeconds;
+				const float offset = std::abs((notePosition - musicPosition) / rate);
 
-			seenTracks[track] = true;
+				// Skip if we are outside of the largest timing window
+				if (offset > largestWindow)
+					continue;
 
-			if (!tn.result.bHeld)
-			{
-				PlayerNumber pn = m_pPlayerState->m_PlayerNumber;
-				std::vector<GameInput> input;
-				GAMESTATE->GetCurrentStyle(pn)->StyleInputToGameInput(track, pn, input);
+				if (!tn.result.bHeld)
+				{
+					PlayerNumber pn = m_pPlayerState->m_PlayerNumber;
+					std::vector<GameInput> input;
+					GAMESTATE->GetCurrentStyle(pn)->StyleInputToGameInput(track, pn, input);
 
-				tn.result.bHeld = INPUTMAPPER->IsBeingPressed(input, m_pPlayerState->m_mp);
+					tn.result.bHeld = INPUTMAPPER->IsBeingPressed(input, m_pPlayerState->m_mp);
+				}
+				break;
 			}
 		}
 	}
@@ -1613,6 +1611,8 @@ void Player::ApplyWaitingTransforms()
 
 		NoteDataUtil::TransformNoteData(m_NoteData, *m_Timing, po, GAMESTATE->GetCurrentStyle(GetPlayerState()->m_PlayerNumber)->m_StepsType, BeatToNoteRow(fStartBeat), BeatToNoteRow(fEndBeat));
 	}
+	if( !m_pPlayerState->m_ModsToApply.empty() )
+		BuildJudgeIndex();
 	m_pPlayerState->m_ModsToApply.clear();
 }
 
@@ -1891,6 +1891,89 @@ int Player::GetClosestNoteDirectional( int col, int iStartRow, int iEndRow, bool
 	return -1;
 }
 
+void Player::BuildJudgeIndex()
+{
+	m_iJudgeIndexRevision = m_Timing->GetRevision();
+	const int iNumTracks = m_NoteData.GetNumTracks();
+	m_vJudgeIndex.resize( iNumTracks );
+	m_viNextUnjudged.assign( iNumTracks, 0 );
+
+	for( int t = 0; t < iNumTracks; ++t )
+	{
+		std::vector<JudgeIndexNote> &vNotes = m_vJudgeIndex[t];
+		vNotes.clear();
+
+		TimingData::LookupCursor cursor;
+		for( NoteData::iterator iter = m_NoteData.begin(t); iter != m_NoteData.end(t); ++iter )
+		{
+			const int iRow = iter->first;
+			TapNote &tn = iter->second;
+			// unsure if autoKeysounds should be excluded. -Wolfman2000
+			if( tn.type == TapNoteType_Empty || tn.type == TapNoteType_AutoKeysound )
+				continue;
+			if( !m_Timing->IsJudgableAtRow(iRow) )
+				continue;
+
+			if( iRow < m_iJudgeIndexStartRow )
+				++m_viNextUnjudged[t];
+
+			/* Keep the time without the song offset, which can be adjusted
+			 * during gameplay. */
+			JudgeIndexNote note;
+			note.iRow = iRow;
+			note.fSeconds = m_Timing->GetElapsedTimeFromBeatNoOffset( NoteRowToBeat(iRow), cursor ) + m_Timing->m_fBeat0OffsetInSeconds;
+			note.pTN = &tn;
+			vNotes.push_back( note );
+		}
+	}
+}
+
+/* Autosync and the sync overlay can change the tempo during the song, which
+ * moves the notes the index has times for.  Judged notes stay judged, so
+ * rebuilding the index only costs the lookups. */
+void Player::CheckJudgeIndexTiming()
+{
+	if( m_iJudgeIndexRevision != m_Timing->GetRevision() )
+		BuildJudgeIndex();
+}
+
+/* Like GetClosestNote( col, iNoteRow, iMaxRowsAhead, iMaxRowsBehind, false ),
+ * but using the judge index.  Presses mostly land near the first unjudged
+ * note, so this usually only looks at a note or two. */
+const Player::JudgeIndexNote *Player::GetClosestUnjudgedNote( int col, int iNoteRow, int iMaxRowsAhead, int iMaxRowsBehind )
+{
+	if( col < 0 || col >= (int) m_vJudgeIndex.size() )
+		return nullptr;
+
+	const std::vector<JudgeIndexNote> &vNotes = m_vJudgeIndex[col];
+	std::size_t &iNext = m_viNextUnjudged[col];
+
+	// Skip notes judged since we last looked, so the next search doesn't.
+	while( iNext < vNotes.size() && vNotes[iNext].pTN->result.tns != TNS_None )
+		++iNext;
+
+	const int iStartRow = iNoteRow - iMaxRowsBehind;
+	const int iEndRow = iNoteRow + iMaxRowsAhead;
+	const JudgeIndexNote *pPrev = nullptr;
+	for( std::size_t i = iNext; i < vNotes.size() && vNotes[i].iRow < iEndRow; ++i )
+	{
+		const JudgeIndexNote &note = vNotes[i];
+		if( note.iRow < iStartRow || note.pTN->result.tns != TNS_None )
+			continue;
+		if( note.iRow < iNoteRow )
+		{
+			pPrev = &note;
+			continue;
+		}
+
+		// This is the next note.  Figure out whether it or the previous one is closer.
+		if( pPrev != nullptr && note.iRow-iNoteRow > iNoteRow-pPrev->iRow )
+			return pPrev;
+		return &note;
+	}
+	return pPrev;
+}
+
 // Find the closest note to fBeat.
 int Player::GetClosestNote( int col, int iNoteRow, int iMaxRowsAhead, int iMaxRowsBehind, bool bAllowGraded ) const
 {
@@ -2078,9 +2161,13 @@ void Player::PlayKeysound( const TapNote &tn, TapNoteScore score )
 
 void Player::Step( int col, int row, const RageTimer &tm, bool bHeld, bool bRelease )
 {
+	PROFILE_SCOPE( "Player step" );
 	if( IsOniDead() )
 		return;
 
+	if( !bHeld && !bRelease && m_pPlayerState->m_PlayerController == PC_HUMAN )
+		InputLatency::Record( InputLatencyStage_PlayerStep, tm );
+
 	// Do everything that depends on a RageTimer here;
 	// set your breakpoints somewhere after this block.
 	const float fLastBeatUpdate = m_pPlayerState->m_Position.m_LastBeatUpdate.Ago();
@@ -2228,8 +2315,13 @@ void Player::Step( int col, int row, const RageTimer &tm, bool bHeld, bool bRele
 		iSongRow - BeatToNoteRow( m_Timing->GetBeatFromElapsedTime( m_pPlayerState->m_Position.m_fMusicSeconds - StepSearchDistance ) )
 	) + ROWS_PER_BEAT;
 	int iRowOfOverlappingNoteOrRow = row;
+	const JudgeIndexNote *pIndexNote = nullptr;
 	if( row == -1 )
-		iRowOfOverlappingNoteOrRow = GetClosestNote( col, iSongRow, iStepSearchRows, iStepSearchRows, false );
+	{
+		CheckJudgeIndexTiming();
+		pIndexNote = GetClosestUnjudgedNote( col, iSongRow, iStepSearchRows, iStepSearchRows );
+		iRowOfOverlappingNoteOrRow = pIndexNote != nullptr? pIndexNote->iRow: -1;
+	}
 
 	// calculate TapNoteScore
 	TapNoteScore score = TNS_None;
@@ -2240,7 +2332,12 @@ void Player::Step( int col, int row, const RageTimer &tm, bool bHeld, bool bRele
 		float fNoteOffset = 0.0f;
 		// we need this later if we are autosyncing
 		const float fStepBeat = NoteRowToBeat( iRowOfOverlappingNoteOrRow );
-		const float fStepSeconds = m_Timing->GetElapsedTimeFromBeat(fStepBeat);
+		float fStepSeconds;
+		if( pIndexNote != nullptr )
+			fStepSeconds = pIndexNote->fSeconds - m_Timing->m_fBeat0OffsetInSeconds
+				- GAMESTATE->m_SongOptions.GetCurrent().m_fMusicRate * PREFSMAN->m_fGlobalOffsetSeconds;
+		else
+			fStepSeconds = m_Timing->GetElapsedTimeFromBeat(fStepBeat);
 
 		if( row == -1 )
 		{
@@ -2267,9 +2364,16 @@ void Player::Step( int col, int row, const RageTimer &tm, bool bHeld, bool bRele
 
 		TapNote tnDummy = TAP_ORIGINAL_TAP;
 		TapNote *pTN = nullptr;
-		NoteData::iterator iter = m_NoteData.FindTapNote( col, iRowOfOverlappingNoteOrRow );
-		DEBUG_ASSERT( iter!= m_NoteData.end(col) );
-		pTN = &iter->second;
+		if( pIndexNote != nullptr )
+		{
+			pTN = pIndexNote->pTN;
+		}
+		else
+		{
+			NoteData::iterator iter = m_NoteData.FindTapNote( col, iRowOfOverlappingNoteOrRow );
+			DEBUG_ASSERT( iter!= m_NoteData.end(col) );
+			pTN = &iter->second;
+		}
 
 		switch( m_pPlayerState->m_PlayerController )
 		{
@@ -2626,6 +2730,7 @@ void Player::Step( int col, int row, const RageTimer &tm, bool bHeld, bool bRele
 
 void Player::UpdateTapNotesMissedOlderThan( float fMissIfOlderThanSeconds )
 {
+	PROFILE_SCOPE( "Judge misses" );
 	//LOG->Trace( "Steps::UpdateTapNotesMissedOlderThan(%f)", fMissIfOlderThanThisBeat );
 	int iMissIfOlderThanThisRow;
 	const float fEarliestTime = m_pPlayerState->m_Position.m_fMusicSeconds - fMissIfOlderThanSeconds;
@@ -2645,36 +2750,37 @@ void Player::UpdateTapNotesMissedOlderThan( float fMissIfOlderThanSeconds )
 		}
 	}
 
-	NoteData::all_tracks_iterator &iter = *m_pIterNeedsTapJudging;
-
-	for( ; !iter.IsAtEnd() && iter.Row() < iMissIfOlderThanThisRow; ++iter )
+	// The judge index leaves out notes in WarpSegments and FakeSegments.
+	CheckJudgeIndexTiming();
+	for( std::size_t iTrack = 0; iTrack < m_vJudgeIndex.size(); ++iTrack )
 	{
-		TapNote &tn = *iter;
-
-		if( !NeedsTapJudging(tn) )
-			continue;
+		const std::vector<JudgeIndexNote> &vNotes = m_vJudgeIndex[iTrack];
+		std::size_t &i = m_viNextUnjudged[iTrack];
+		for( ; i < vNotes.size() && vNotes[i].iRow < iMissIfOlderThanThisRow; ++i )
+		{
+			TapNote &tn = *vNotes[i].pTN;
 
-		// Ignore all notes in WarpSegments or FakeSegments.
-		if (!m_Timing->IsJudgableAtRow(iter.Row()))
-			continue;
+			if( !NeedsTapJudging(tn) )
+				continue;
 
-		if( tn.type == TapNoteType_Mine )
-		{
-			tn.result.tns = TNS_AvoidMine;
-			/* The only real way to tell if a mine has been scored is if it has disappeared
-			 * but this only works for hit mines so update the scores for avoided mines here. */
-			if( m_pPrimaryScoreKeeper )
-				m_pPrimaryScoreKeeper->HandleTapScore( tn );
-			if( m_pSecondaryScoreKeeper )
-				m_pSecondaryScoreKeeper->HandleTapScore( tn );
-		}
-		else
-		{
-			if (tn.result.earlyTns != TNS_None) {
-				tn.result.tns = tn.result.earlyTns;
-				tn.result.fTapNoteOffset = tn.result.fEarlyTapNoteOffset;
-			} else {
-				tn.result.tns = TNS_Miss;
+			if( tn.type == TapNoteType_Mine )
+			{
+				tn.result.tns = TNS_AvoidMine;
+				/* The only real way to tell if a mine has been scored is if it has disappeared
+				 * but this only works for hit mines so update the scores for avoided mines here. */
+				if( m_pPrimaryScoreKeeper )
+					m_pPrimaryScoreKeeper->HandleTapScore( tn );
+				if( m_pSecondaryScoreKeeper )
+					m_pSecondaryScoreKeeper->HandleTapScore( tn );
+			}
+			else
+			{
+				if (tn.result.earlyTns != TNS_None) {
+					tn.result.tns = tn.result.earlyTns;
+					tn.result.fTapNoteOffset = tn.result.fEarlyTapNoteOffset;
+				} else {
+					tn.result.tns = TNS_Miss;
+				}
 			}
 		}
 	}
@@ -2682,8 +2788,12 @@ void Player::UpdateTapNotesMissedOlderThan( float fMissIfOlderThanSeconds )
 
 void Player::UpdateJudgedRows()
 {
+	PROFILE_SCOPE( "Judge rows" );
 	// Look ahead far enough to catch any rows judged early.
-	const int iEndRow = BeatToNoteRow( m_Timing->GetBeatFromElapsedTime( m_pPlayerState->m_Position.m_fMusicSeconds + GetMaxStepDistanceSeconds() ) );
+	TimingData::GetBeatArgs endBeat;
+	endBeat.elapsed_time = m_pPlayerState->m_Position.m_fMusicSeconds + GetMaxStepDistanceSeconds();
+	m_Timing->GetBeatAndBPSFromElapsedTime( endBeat, m_JudgedRowsCursor );
+	const int iEndRow = BeatToNoteRow( endBeat.beat );
 	bool bAllJudged = true;
 	const bool bSeparately = GAMESTATE->GetCurrentGame()->m_bCountNotesSeparately;
 
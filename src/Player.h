@@ -173,6 +173,17 @@ protected:
 
 	RString ApplyRandomAttack();
 
+	/* A note a step can hit, as kept in m_vJudgeIndex. */
+	struct JudgeIndexNote
+	{
+		int iRow;
+		float fSeconds;	// from beat 0, before the song and global offsets
+		TapNote *pTN;
+	};
+	void BuildJudgeIndex();
+	void CheckJudgeIndexTiming();
+	const JudgeIndexNote *GetClosestUnjudgedNote( int col, int iNoteRow, int iMaxRowsAhead, int iMaxRowsBehind );
+
 	inline void HideNote( int col, int row )
 	{
 		NoteData::iterator iter = m_NoteData.FindTapNote( col, row );
@@ -187,6 +198,9 @@ protected:
 	/** @brief The player's present stage stats. */
 	PlayerStageStats	*m_pPlayerStageStats;
 	TimingData      *m_Timing;
+	// For the lookups ahead of the song position made every frame.
+	TimingData::LookupCursor	m_HeldMissCursor;
+	TimingData::LookupCursor	m_JudgedRowsCursor;
 	float			m_fNoteFieldHeight;
 
 	bool			m_bPaused;
@@ -214,11 +228,18 @@ protected:
 	Inventory		*m_pInventory;
 
 	int			m_iFirstUncrossedRow;	// used by hold checkpoints logic
-	NoteData::all_tracks_iterator *m_pIterNeedsTapJudging;
 	NoteData::all_tracks_iterator *m_pIterNeedsHoldJudging;
 	NoteData::all_tracks_iterator *m_pIterUncrossedRows;
 	NoteData::all_tracks_iterator *m_pIterUnjudgedRows;
 	NoteData::all_tracks_iterator *m_pIterUnjudgedMineRows;
+	/* The judgable notes in each column, in row order, so stepping and
+	 * missing don't have to search m_NoteData.  Everything in a column before
+	 * m_viNextUnjudged has been judged, or came before m_iJudgeIndexStartRow.
+	 * Rebuilt whenever m_NoteData is transformed. */
+	std::vector<std::vector<JudgeIndexNote>> m_vJudgeIndex;
+	std::vector<std::size_t>	m_viNextUnjudged;
+	int			m_iJudgeIndexStartRow;
+	unsigned int	m_iJudgeIndexRevision;	// m_Timing's revision when the index was built
 	unsigned int	m_iLastSeenCombo;
 	bool	m_bSeenComboYet;
 	JudgedRows		*m_pJudgedRows;
@@ -1,5 +1,6 @@
 #include "global.h"
 #include "PrefsManager.h"
+#include "Benchmark.h"
 #include "IniFile.h"
 #include "LuaManager.h"
 #include "Preference.h"
@@ -188,6 +189,8 @@ PrefsManager::PrefsManager() :
 	m_ImageCache			( "ImageCache",			IMGCACHE_LOW_RES_PRELOAD ),
 	m_bFastLoad			( "FastLoad",			true ),
 	m_NeverCacheList		( "NeverCacheList", ""),
+	m_iSongLoadThreads		( "SongLoadThreads",		0 ),
+	m_bWatchSongFolders		( "WatchSongFolders",		true ),
 
 	m_bOnlyDedicatedMenuButtons	( "OnlyDedicatedMenuButtons",	false ),
 	m_bMenuTimer			( "MenuTimer",			false ),
@@ -317,6 +320,7 @@ PrefsManager::PrefsManager() :
 	m_bShowLogOutput		( "ShowLogOutput",	false ),
 #endif
 	m_bLogSkips			( "LogSkips",		false ),
+	m_fConstantUpdateDeltaSeconds	( "ConstantUpdateDeltaSeconds",	0 ),
 	m_bLogCheckpoints		( "LogCheckpoints",	false ),
 	m_bShowLoadingWindow		( "ShowLoadingWindow",	true ),
 	m_bPseudoLocalize		( "PseudoLocalize",	false ),
@@ -516,6 +520,10 @@ void PrefsManager::TranslateDeprecatedFlags()
 
 void PrefsManager::SavePrefsToDisk()
 {
+	// Don't keep the preferences a benchmark overrides.
+	if( Benchmark::IsEnabled() )
+		return;
+
 	IniFile ini;
 	SavePrefsToIni( ini );
 	ini.WriteFile( SpecialFiles::PREFERENCES_INI_PATH );
@@ -187,6 +187,12 @@ public:
 	Preference<ImageCacheMode>		m_ImageCache;
 	Preference<bool>	m_bFastLoad;
 	Preference<RString> m_NeverCacheList;
+	// Number of threads used to load song directories.  0 picks one per core,
+	// 1 loads everything on the main thread like before.
+	Preference<int>		m_iSongLoadThreads;
+	// Watch song folders for changes where the OS supports it (inotify), so
+	// reloading songs only looks at folders that changed.
+	Preference<bool>	m_bWatchSongFolders;
 
 	Preference<bool>	m_bOnlyDedicatedMenuButtons;
 	Preference<bool>	m_bMenuTimer;
@@ -339,6 +345,9 @@ public:
 	Preference<bool>	m_bForceLogFlush;
 	Preference<bool>	m_bShowLogOutput;
 	Preference<bool>	m_bLogSkips;
+	/* Force a specific update rate.  This prevents big animation jumps on
+	 * frame skips, and makes runs repeatable.  0 to disable. */
+	Preference<float>	m_fConstantUpdateDeltaSeconds;
 	Preference<bool>	m_bLogCheckpoints;
 	Preference<bool>	m_bShowLoadingWindow;
 	Preference<bool>	m_bPseudoLocalize;
@@ -41,12 +41,31 @@ static void GetResolutionFromFileName( RString sPath, int &iWidth, int &iHeight
 	iHeight = maybe_height;
 }
 
+/* An image loaded and converted for a texture, ready to be uploaded. */
+struct RageBitmapTexturePrep
+{
+	RageTextureID actualID;
+	RageSurface *pImg;
+	RagePixelFormat pixfmt;
+	RString sHintString;
+	RString sWarning;
+	int iSourceWidth, iSourceHeight;
+	int iImageWidth, iImageHeight;
+	int iTextureWidth, iTextureHeight;
+};
+
 RageBitmapTexture::RageBitmapTexture( RageTextureID name ) :
 	RageTexture( name ), m_uTexHandle(0)
 {
 	Create();
 }
 
+RageBitmapTexture::RageBitmapTexture( RageTextureID name, RageBitmapTexturePrep *pPrep ) :
+	RageTexture( name ), m_uTexHandle(0)
+{
+	Create( pPrep, true );
+}
+
 RageBitmapTexture::~RageBitmapTexture()
 {
 	Destroy();
@@ -68,31 +87,36 @@ void RageBitmapTexture::Reload()
  * Dither forces dithering when loading 16-bit textures.
  * Stretch forces the loaded image to fill the texture completely.
  */
-void RageBitmapTexture::Create()
+void RageBitmapTexture::GetPrepareCaps( PrepareCaps &out )
 {
-	RageTextureID actualID = GetID();
+	out.iMaxTextureSize = DISPLAY->GetMaxTextureSize();
+	out.bHighResolutionTextures = StepMania::GetHighResolutionTextures();
+	FOREACH_ENUM( RagePixelFormat, pf )
+	{
+		out.abSupportsFormat[pf] = DISPLAY->SupportsTextureFormat( pf );
+		out.apFormatDesc[pf] = DISPLAY->GetPixelFormatDesc( pf );
+	}
+}
+
+RageBitmapTexturePrep *RageBitmapTexture::Prepare( const RageTextureID &ID, const PrepareCaps &caps, RageSurface *pImg )
+{
+	RageBitmapTexturePrep *pPrep = new RageBitmapTexturePrep;
+	RageTextureID &actualID = pPrep->actualID;
+	actualID = ID;
 
 	ASSERT( actualID.filename != "" );
 
 	/* Load the image into a RageSurface. */
 	RString error;
-	RageSurface *pImg = nullptr;
-	if(actualID.filename == TEXTUREMAN->GetScreenTextureID().filename)
-	{
-		pImg= TEXTUREMAN->GetScreenSurface();
-	}
-	else
-	{
+	if( pImg == nullptr )
 		pImg= RageSurfaceUtils::LoadFile(actualID.filename, error);
-	}
 
 	/* Tolerate corrupt/unknown images. */
 	if( pImg == nullptr )
 	{
-		RString warning = ssprintf("RageBitmapTexture: Couldn't load %s: %s",
+		/* Warn in Create, since this may not be the main thread. */
+		pPrep->sWarning = ssprintf("RageBitmapTexture: Couldn't load %s: %s",
 			actualID.filename.c_str(), error.c_str());
-		LOG->Warn("%s", warning.c_str());
-		Dialog::OK(warning, "missing_texture");
 		pImg = RageSurfaceUtils::MakeDummySurface( 64, 64 );
 		ASSERT( pImg != nullptr );
 	}
@@ -111,7 +135,8 @@ void RageBitmapTexture::Create()
 	}
 
 	// look in the file name for a format hints
-	RString sHintString = GetID().filename + actualID.AdditionalTextureHints;
+	RString &sHintString = pPrep->sHintString;
+	sHintString = ID.filename + actualID.AdditionalTextureHints;
 	sHintString.MakeLower();
 
 	if( sHintString.find("32bpp") != std::string::npos )			actualID.iColorDepth = 32;
@@ -137,57 +162,57 @@ void RageBitmapTexture::Create()
 		actualID.iGrayscaleBits = -1;
 
 	/* Cap the max texture size to the hardware max. */
-	actualID.iMaxSize = std::min( actualID.iMaxSize, DISPLAY->GetMaxTextureSize() );
+	actualID.iMaxSize = std::min( actualID.iMaxSize, caps.iMaxTextureSize );
 
 	/* Save information about the source. */
-	m_iSourceWidth = pImg->w;
-	m_iSourceHeight = pImg->h;
+	pPrep->iSourceWidth = pImg->w;
+	pPrep->iSourceHeight = pImg->h;
 
 	/* in-game image dimensions are the same as the source graphic */
-	m_iImageWidth = m_iSourceWidth;
-	m_iImageHeight = m_iSourceHeight;
+	pPrep->iImageWidth = pPrep->iSourceWidth;
+	pPrep->iImageHeight = pPrep->iSourceHeight;
 
 	/* if "doubleres" (high resolution) and we're not allowing high res textures, then image dimensions are half of the source */
 	if( sHintString.find("doubleres") != std::string::npos )
 	{
-		if( !StepMania::GetHighResolutionTextures() )
+		if( !caps.bHighResolutionTextures )
 		{
-			m_iImageWidth = m_iImageWidth / 2;
-			m_iImageHeight = m_iImageHeight / 2;
+			pPrep->iImageWidth = pPrep->iImageWidth / 2;
+			pPrep->iImageHeight = pPrep->iImageHeight / 2;
 		}
 	}
 
 	/* image size cannot exceed max size */
-	m_iImageWidth = std::min( m_iImageWidth, actualID.iMaxSize );
-	m_iImageHeight = std::min( m_iImageHeight, actualID.iMaxSize );
+	pPrep->iImageWidth = std::min( pPrep->iImageWidth, actualID.iMaxSize );
+	pPrep->iImageHeight = std::min( pPrep->iImageHeight, actualID.iMaxSize );
 
 	/* Texture dimensions need to be a power of two; jump to the next. */
-	m_iTextureWidth = power_of_two(m_iImageWidth);
-	m_iTextureHeight = power_of_two(m_iImageHeight);
+	pPrep->iTextureWidth = power_of_two(pPrep->iImageWidth);
+	pPrep->iTextureHeight = power_of_two(pPrep->iImageHeight);
 
 	/* If we're under 8x8, increase it, to avoid filtering problems on odd hardware. */
-	if( m_iTextureWidth < 8 || m_iTextureHeight < 8 )
+	if( pPrep->iTextureWidth < 8 || pPrep->iTextureHeight < 8 )
 	{
 		actualID.bStretch = true;
-		m_iTextureWidth = std::max( 8, m_iTextureWidth );
-		m_iTextureHeight = std::max( 8, m_iTextureHeight );
+		pPrep->iTextureWidth = std::max( 8, pPrep->iTextureWidth );
+		pPrep->iTextureHeight = std::max( 8, pPrep->iTextureHeight );
 	}
 
-	ASSERT_M( m_iTextureWidth <= actualID.iMaxSize, ssprintf("w %i, %i", m_iTextureWidth, actualID.iMaxSize) );
-	ASSERT_M( m_iTextureHeight <= actualID.iMaxSize, ssprintf("h %i, %i", m_iTextureHeight, actualID.iMaxSize) );
+	ASSERT_M( pPrep->iTextureWidth <= actualID.iMaxSize, ssprintf("w %i, %i", pPrep->iTextureWidth, actualID.iMaxSize) );
+	ASSERT_M( pPrep->iTextureHeight <= actualID.iMaxSize, ssprintf("h %i, %i", pPrep->iTextureHeight, actualID.iMaxSize) );
 
 	if( actualID.bStretch )
 	{
 		/* The hints asked for the image to be stretched to the texture size,
 		 * probably for tiling. */
-		m_iImageWidth = m_iTextureWidth;
-		m_iImageHeight = m_iTextureHeight;
+		pPrep->iImageWidth = pPrep->iTextureWidth;
+		pPrep->iImageHeight = pPrep->iTextureHeight;
 	}
 
-	if( pImg->w != m_iImageWidth || pImg->h != m_iImageHeight )
-		RageSurfaceUtils::Zoom( pImg, m_iImageWidth, m_iImageHeight );
+	if( pImg->w != pPrep->iImageWidth || pImg->h != pPrep->iImageHeight )
+		RageSurfaceUtils::Zoom( pImg, pPrep->iImageWidth, pPrep->iImageHeight );
 
-	if( actualID.iGrayscaleBits != -1 && DISPLAY->SupportsTextureFormat(RagePixelFormat_PAL) )
+	if( actualID.iGrayscaleBits != -1 && caps.abSupportsFormat[RagePixelFormat_PAL] )
 	{
 		RageSurface *pGrayscale = RageSurfaceUtils::PalettizeToGrayscale( pImg, actualID.iGrayscaleBits, actualID.iAlphaBits );
 
@@ -199,7 +224,7 @@ void RageBitmapTexture::Create()
 	RagePixelFormat pixfmt;
 
 	// If the source is palleted, always load as paletted if supported.
-	if( pImg->format->BitsPerPixel == 8 && DISPLAY->SupportsTextureFormat(RagePixelFormat_PAL) )
+	if( pImg->format->BitsPerPixel == 8 && caps.abSupportsFormat[RagePixelFormat_PAL] )
 	{
 		pixfmt = RagePixelFormat_PAL;
 	}
@@ -236,10 +261,10 @@ void RageBitmapTexture::Create()
 	}
 
 	// Make we're using a supported format. Every card supports either RGBA8 or RGBA4.
-	if( !DISPLAY->SupportsTextureFormat(pixfmt) )
+	if( !caps.abSupportsFormat[pixfmt] )
 	{
 		pixfmt = RagePixelFormat_RGBA8;
-		if( !DISPLAY->SupportsTextureFormat(pixfmt) )
+		if( !caps.abSupportsFormat[pixfmt] )
 			pixfmt = RagePixelFormat_RGBA4;
 	}
 
@@ -252,7 +277,7 @@ void RageBitmapTexture::Create()
 		(pixfmt==RagePixelFormat_RGBA4 || pixfmt==RagePixelFormat_RGB5A1) )
 	{
 		// Dither down to the destination format.
-		const RageDisplay::RagePixelFormatDesc *pfd = DISPLAY->GetPixelFormatDesc(pixfmt);
+		const RageDisplay::RagePixelFormatDesc *pfd = caps.apFormatDesc[pixfmt];
 		RageSurface *dst = CreateSurface( pImg->w, pImg->h, pfd->bpp,
 			pfd->masks[0], pfd->masks[1], pfd->masks[2], pfd->masks[3] );
 
@@ -267,10 +292,64 @@ void RageBitmapTexture::Create()
 	RageSurfaceUtils::FixHiddenAlpha( pImg );
 
 	/* Scale up to the texture size, if needed. */
-	RageSurfaceUtils::ConvertSurface( pImg, m_iTextureWidth, m_iTextureHeight,
+	RageSurfaceUtils::ConvertSurface( pImg, pPrep->iTextureWidth, pPrep->iTextureHeight,
 		pImg->fmt.BitsPerPixel, pImg->fmt.Mask[0], pImg->fmt.Mask[1], pImg->fmt.Mask[2], pImg->fmt.Mask[3] );
 
-	m_uTexHandle = DISPLAY->CreateTexture( pixfmt, pImg, actualID.bMipMaps );
+	pPrep->pImg = pImg;
+	pPrep->pixfmt = pixfmt;
+	return pPrep;
+}
+
+void RageBitmapTexture::DeletePrep( RageBitmapTexturePrep *pPrep )
+{
+	if( pPrep == nullptr )
+		return;
+	delete pPrep->pImg;
+	delete pPrep;
+}
+
+void RageBitmapTexture::Create()
+{
+	PrepareCaps caps;
+	GetPrepareCaps( caps );
+
+	RageSurface *pImg = nullptr;
+	if( GetID().filename == TEXTUREMAN->GetScreenTextureID().filename )
+		pImg = TEXTUREMAN->GetScreenSurface();
+
+	Create( Prepare(GetID(), caps, pImg), false );
+}
+
+void RageBitmapTexture::Create( RageBitmapTexturePrep *pPrep, bool bAsync )
+{
+	if( !pPrep->sWarning.empty() )
+	{
+		LOG->Warn( "%s", pPrep->sWarning.c_str() );
+		Dialog::OK( pPrep->sWarning, "missing_texture" );
+	}
+
+	const RageTextureID &actualID = pPrep->actualID;
+	const RString &sHintString = pPrep->sHintString;
+	const RagePixelFormat pixfmt = pPrep->pixfmt;
+	RageSurface *pImg = pPrep->pImg;
+	pPrep->pImg = nullptr;
+
+	m_iSourceWidth = pPrep->iSourceWidth;
+	m_iSourceHeight = pPrep->iSourceHeight;
+	m_iImageWidth = pPrep->iImageWidth;
+	m_iImageHeight = pPrep->iImageHeight;
+	m_iTextureWidth = pPrep->iTextureWidth;
+	m_iTextureHeight = pPrep->iTextureHeight;
+
+	m_uTexHandle = 0;
+	if( bAsync )
+	{
+		m_uTexHandle = DISPLAY->CreateTextureAsync( pixfmt, pImg, actualID.bMipMaps );
+		if( m_uTexHandle != 0 )
+			pImg = nullptr; // the display owns it now
+	}
+	if( m_uTexHandle == 0 )
+		m_uTexHandle = DISPLAY->CreateTexture( pixfmt, pImg, actualID.bMipMaps );
 
 	CreateFrameRects();
 
@@ -341,6 +420,18 @@ void RageBitmapTexture::Create()
 	//	actualID.filename.c_str(), GetTextureWidth(), GetTextureHeight(),
 	//	sProperties.c_str(), m_iSourceWidth, m_iSourceHeight,
 	//	m_iImageWidth, m_iImageHeight );
+
+	DeletePrep( pPrep );
+}
+
+bool RageBitmapTexture::IsPending() const
+{
+	return DISPLAY->IsTexturePending( m_uTexHandle );
+}
+
+void RageBitmapTexture::FinishPending()
+{
+	DISPLAY->FinishPendingTexture( m_uTexHandle );
 }
 
 void RageBitmapTexture::Destroy()
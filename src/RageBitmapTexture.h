@@ -4,21 +4,47 @@
 #define RAGEBITMAPTEXTURE_H
 
 #include "RageTexture.h"
+#include "RageDisplay.h"
 
 #include <cstddef>
 
+struct RageBitmapTexturePrep;
+
 class RageBitmapTexture : public RageTexture
 {
 public:
 	RageBitmapTexture( RageTextureID name );
+	/* Create the texture from an image loaded by Prepare, and upload it over
+	 * the next few frames if the display supports it.  Takes ownership of pPrep. */
+	RageBitmapTexture( RageTextureID name, RageBitmapTexturePrep *pPrep );
 	virtual ~RageBitmapTexture();
 	/* only called by RageTextureManager::InvalidateTextures */
 	virtual void Invalidate() { m_uTexHandle = 0; /* don't Destroy() */}
 	virtual void Reload();
 	virtual std::uintptr_t GetTexHandle() const { return m_uTexHandle; };	// accessed by RageDisplay
+	virtual bool IsPending() const;
+	virtual void FinishPending();
+
+	/* What Prepare needs to know about the renderer and preferences.  Get it
+	 * with GetPrepareCaps on the main thread. */
+	struct PrepareCaps
+	{
+		int iMaxTextureSize;
+		bool bHighResolutionTextures;
+		bool abSupportsFormat[NUM_RagePixelFormat];
+		const RageDisplay::RagePixelFormatDesc *apFormatDesc[NUM_RagePixelFormat];
+	};
+	static void GetPrepareCaps( PrepareCaps &out );
+
+	/* Load and convert the image for a texture.  This touches neither the
+	 * renderer nor Lua, so it may be called from any thread.  If pImg is set,
+	 * it's used instead of loading the file, and Prepare takes ownership. */
+	static RageBitmapTexturePrep *Prepare( const RageTextureID &ID, const PrepareCaps &caps, RageSurface *pImg = nullptr );
+	static void DeletePrep( RageBitmapTexturePrep *pPrep );
 
 private:
 	void Create();	// called by constructor and Reload
+	void Create( RageBitmapTexturePrep *pPrep, bool bAsync );
 	void Destroy();
 	std::uintptr_t m_uTexHandle;	// treat as unsigned in OpenGL, IDirect3DTexture9* for D3D
 };
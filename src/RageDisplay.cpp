@@ -24,15 +24,17 @@
 // Statistics stuff
 RageTimer	g_LastCheckTimer;
 int		g_iNumVerts;
-int		g_iFPS, g_iVPF, g_iCFPS;
+int		g_iFPS, g_iVPF, g_iDPF, g_iCFPS;
 
 int RageDisplay::GetFPS() const { return g_iFPS; }
 int RageDisplay::GetVPF() const { return g_iVPF; }
+int RageDisplay::GetDPF() const { return g_iDPF; }
 int RageDisplay::GetCumFPS() const { return g_iCFPS; }
 
 static int g_iFramesRenderedSinceLastCheck,
 	   g_iFramesRenderedSinceLastReset,
 	   g_iVertsRenderedSinceLastCheck,
+	   g_iDrawsSinceLastCheck,
 	   g_iNumChecksSinceLastReset;
 static RageTimer g_LastFrameEndedAt( RageZeroTimer );
 
@@ -143,7 +145,9 @@ void RageDisplay::ProcessStatsOnFlip()
 		g_iCFPS = g_iFramesRenderedSinceLastReset / g_iNumChecksSinceLastReset;
 		g_iCFPS = std::lrint( g_iCFPS / fActualTime );
 		g_iVPF = g_iVertsRenderedSinceLastCheck / g_iFramesRenderedSinceLastCheck;
+		g_iDPF = g_iDrawsSinceLastCheck / g_iFramesRenderedSinceLastCheck;
 		g_iFramesRenderedSinceLastCheck = g_iVertsRenderedSinceLastCheck = 0;
+		g_iDrawsSinceLastCheck = 0;
 		if( LOG_FPS )
 		{
 			RString sStats = GetStats();
@@ -155,10 +159,11 @@ void RageDisplay::ProcessStatsOnFlip()
 
 void RageDisplay::ResetStats()
 {
-	g_iFPS = g_iVPF = 0;
+	g_iFPS = g_iVPF = g_iDPF = 0;
 	g_iFramesRenderedSinceLastCheck = g_iFramesRenderedSinceLastReset = 0;
 	g_iNumChecksSinceLastReset = 0;
 	g_iVertsRenderedSinceLastCheck = 0;
+	g_iDrawsSinceLastCheck = 0;
 	g_LastCheckTimer.GetDeltaTime();
 }
 
@@ -167,9 +172,9 @@ RString RageDisplay::GetStats() const
 	RString s;
 	// If FPS == 0, we don't have stats yet.
 	if( !GetFPS() )
-		s = "-- FPS\n-- av FPS\n-- VPF";
+		s = "-- FPS\n-- av FPS\n-- VPF\n-- DPF";
 
-	s = ssprintf( "%i FPS\n%i av FPS\n%i VPF", GetFPS(), GetCumFPS(), GetVPF() );
+	s = ssprintf( "%i FPS\n%i av FPS\n%i VPF\n%i DPF", GetFPS(), GetCumFPS(), GetVPF(), GetDPF() );
 
 //	#if defined(_WINDOWS)
 	s += "\n"+this->GetApiDescription();
@@ -196,6 +201,7 @@ void RageDisplay::BeginConcurrentRendering()
 }
 
 void RageDisplay::StatsAddVerts( int iNumVertsRendered ) { g_iVertsRenderedSinceLastCheck += iNumVertsRendered; }
+void RageDisplay::StatsAddDraw() { ++g_iDrawsSinceLastCheck; }
 
 /* Draw a line as a quad.  GL_LINES with SmoothLines off can draw line
  * ends at odd angles--they're forced to axis-alignment regardless of the
@@ -845,6 +851,7 @@ void RageDisplay::DrawQuads( const RageSpriteVertex v[], int iNumVerts )
 	this->DrawQuadsInternal(v,iNumVerts);
 
 	StatsAddVerts(iNumVerts);
+	StatsAddDraw();
 }
 
 void RageDisplay::DrawQuadStrip( const RageSpriteVertex v[], int iNumVerts )
@@ -857,6 +864,7 @@ void RageDisplay::DrawQuadStrip( const RageSpriteVertex v[], int iNumVerts )
 	this->DrawQuadStripInternal(v,iNumVerts);
 
 	StatsAddVerts(iNumVerts);
+	StatsAddDraw();
 }
 
 void RageDisplay::DrawFan( const RageSpriteVertex v[], int iNumVerts )
@@ -866,6 +874,7 @@ void RageDisplay::DrawFan( const RageSpriteVertex v[], int iNumVerts )
 	this->DrawFanInternal(v,iNumVerts);
 
 	StatsAddVerts(iNumVerts);
+	StatsAddDraw();
 }
 
 void RageDisplay::DrawStrip( const RageSpriteVertex v[], int iNumVerts )
@@ -875,6 +884,7 @@ void RageDisplay::DrawStrip( const RageSpriteVertex v[], int iNumVerts )
 	this->DrawStripInternal(v,iNumVerts);
 
 	StatsAddVerts(iNumVerts);
+	StatsAddDraw();
 }
 
 void RageDisplay::DrawTriangles( const RageSpriteVertex v[], int iNumVerts )
@@ -887,6 +897,7 @@ void RageDisplay::DrawTriangles( const RageSpriteVertex v[], int iNumVerts )
 	this->DrawTrianglesInternal(v,iNumVerts);
 
 	StatsAddVerts(iNumVerts);
+	StatsAddDraw();
 }
 
 void RageDisplay::DrawCompiledGeometry( const RageCompiledGeometry *p, int iMeshIndex, const std::vector<msMesh> &vMeshes )
@@ -894,6 +905,7 @@ void RageDisplay::DrawCompiledGeometry( const RageCompiledGeometry *p, int iMesh
 	this->DrawCompiledGeometryInternal( p, iMeshIndex );
 
 	StatsAddVerts( vMeshes[iMeshIndex].Triangles.size() );
+	StatsAddDraw();
 }
 
 void RageDisplay::DrawLineStrip( const RageSpriteVertex v[], int iNumVerts, float LineWidth )
@@ -925,6 +937,7 @@ void RageDisplay::DrawSymmetricQuadStrip( const RageSpriteVertex v[], int iNumVe
 	this->DrawSymmetricQuadStripInternal( v, iNumVerts );
 
 	StatsAddVerts( iNumVerts );
+	StatsAddDraw();
 }
 
 void RageDisplay::DrawCircle( const RageSpriteVertex &v, float radius )
@@ -932,6 +945,106 @@ void RageDisplay::DrawCircle( const RageSpriteVertex &v, float radius )
 	this->DrawCircleInternal( v, radius );
 }
 
+bool RageQuadBatchState::operator==( const RageQuadBatchState &other ) const
+{
+#define COMPARE(x) if( x != other.x ) return false
+	COMPARE( m_iTexture );
+	COMPARE( m_TextureMode );
+	COMPARE( m_EffectMode );
+	COMPARE( m_BlendMode );
+	COMPARE( m_ZTestMode );
+	COMPARE( m_CullMode );
+	COMPARE( m_fZBias );
+	COMPARE( m_bZWrite );
+	COMPARE( m_bTextureWrapping );
+	COMPARE( m_bTextureFiltering );
+#undef COMPARE
+	return true;
+}
+
+static bool g_bBatchingQuads = false;
+static RageQuadBatchState g_QuadBatchState;
+static std::vector<RageSpriteVertex> g_vQuadBatch;
+
+void RageDisplay::BeginQuadBatch()
+{
+	ASSERT( !g_bBatchingQuads );
+	g_bBatchingQuads = true;
+}
+
+void RageDisplay::EndQuadBatch()
+{
+	ASSERT( g_bBatchingQuads );
+	FlushQuadBatch();
+	g_bBatchingQuads = false;
+}
+
+bool RageDisplay::IsBatchingQuads() const
+{
+	return g_bBatchingQuads;
+}
+
+bool RageDisplay::QuadBatchUsesZBuffer() const
+{
+	return !g_vQuadBatch.empty() &&
+		(g_QuadBatchState.m_bZWrite || g_QuadBatchState.m_ZTestMode != ZTEST_OFF);
+}
+
+void RageDisplay::AddQuadsToBatch( const RageQuadBatchState &state, const RageSpriteVertex v[], int iNumVerts )
+{
+	ASSERT( g_bBatchingQuads );
+	ASSERT( (iNumVerts%4) == 0 );
+
+	if( !g_vQuadBatch.empty() && state != g_QuadBatchState )
+		FlushQuadBatch();
+	g_QuadBatchState = state;
+
+	/* Apply the world and texture matrices now, since they're different for
+	 * each actor; the batch is drawn with both set to identity. */
+	const RageMatrix *pWorld = GetWorldTop();
+	const RageMatrix *pTexture = GetTextureTop();
+	for( int i = 0; i < iNumVerts; ++i )
+	{
+		RageSpriteVertex vert = v[i];
+		RageVec3TransformCoord( &vert.p, &v[i].p, pWorld );
+		RageVector3 t( v[i].t.x, v[i].t.y, 0 );
+		RageVec3TransformCoord( &t, &t, pTexture );
+		vert.t = RageVector2( t.x, t.y );
+		g_vQuadBatch.push_back( vert );
+	}
+}
+
+void RageDisplay::FlushQuadBatch()
+{
+	if( g_vQuadBatch.empty() )
+		return;
+
+	// Same order as Actor::SetGlobalRenderStates and Sprite::DrawTexture.
+	const RageQuadBatchState &state = g_QuadBatchState;
+	SetBlendMode( state.m_BlendMode );
+	SetZWrite( state.m_bZWrite );
+	SetZTestMode( state.m_ZTestMode );
+	SetZBias( state.m_fZBias );
+	SetCullMode( state.m_CullMode );
+	ClearAllTextures();
+	SetTexture( TextureUnit_1, state.m_iTexture );
+	SetTextureWrapping( TextureUnit_1, state.m_bTextureWrapping );
+	SetTextureFiltering( TextureUnit_1, state.m_bTextureFiltering );
+	SetEffectMode( state.m_EffectMode );
+	SetTextureMode( TextureUnit_1, state.m_TextureMode );
+
+	g_WorldStack.Push();
+	g_WorldStack.LoadIdentity();
+	g_TextureStack.Push();
+	g_TextureStack.LoadIdentity();
+	DrawQuads( g_vQuadBatch.data(), g_vQuadBatch.size() );
+	g_TextureStack.Pop();
+	g_WorldStack.Pop();
+
+	SetEffectMode( EffectMode_Normal );
+	g_vQuadBatch.clear();
+}
+
 void RageDisplay::FrameLimitBeforeVsync( int iFPS )
 {
 	ASSERT( iFPS != 0 );
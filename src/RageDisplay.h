@@ -210,6 +210,25 @@ struct RageTextureLock
 	virtual void Unlock( RageSurface *pSurface, bool bChanged = true ) = 0;
 };
 
+/* The texture and render state of a batch of quads.  Quads added with the
+ * same state are drawn together; see RageDisplay::BeginQuadBatch. */
+struct RageQuadBatchState
+{
+	std::uintptr_t m_iTexture;
+	TextureMode m_TextureMode;
+	EffectMode m_EffectMode;
+	BlendMode m_BlendMode;
+	ZTestMode m_ZTestMode;
+	CullMode m_CullMode;
+	float m_fZBias;
+	bool m_bZWrite;
+	bool m_bTextureWrapping;
+	bool m_bTextureFiltering;
+
+	bool operator==( const RageQuadBatchState &other ) const;
+	bool operator!=( const RageQuadBatchState &other ) const { return !(*this == other); }
+};
+
 class RageDisplay
 {
 	friend class RageTexture;
@@ -270,6 +289,20 @@ public:
 		int xoffset, int yoffset, int width, int height
 		) = 0;
 	virtual void DeleteTexture( std::uintptr_t iTexHandle ) = 0;
+	/* Like CreateTexture, but the pixels are uploaded a piece at a time by
+	 * UploadPendingTextures, so large textures don't stall a frame.  On success,
+	 * this takes ownership of img.  Returns 0 if not supported for this texture;
+	 * img is untouched, and CreateTexture should be used instead. */
+	virtual std::uintptr_t CreateTextureAsync(
+		RagePixelFormat /* pixfmt */,
+		RageSurface* /* img */,
+		bool /* bGenerateMipMaps */ ) { return 0; }
+	/* Upload about iMaxBytes of pending texture data.  Call once per frame. */
+	virtual void UploadPendingTextures( int /* iMaxBytes */ ) { }
+	/* Return true if the texture hasn't been completely uploaded yet. */
+	virtual bool IsTexturePending( std::uintptr_t /* iTexHandle */ ) const { return false; }
+	/* Upload the rest of the texture now, regardless of the budget. */
+	virtual void FinishPendingTexture( std::uintptr_t /* iTexHandle */ ) { }
 	/* Return an object to lock pixels for streaming. If not supported, returns nullptr.
 	 * Delete the object normally. */
 	virtual RageTextureLock *CreateTextureLock() { return nullptr; }
@@ -349,6 +382,19 @@ public:
 
 	void DrawQuad( const RageSpriteVertex v[] ) { DrawQuads(v,4); } /* alias. upper-left, upper-right, lower-left, lower-right */
 
+	/* Between BeginQuadBatch and EndQuadBatch, quads passed to AddQuadsToBatch
+	 * are moved into world space and kept, and drawn in one call when the state
+	 * changes or the batch ends.  The caller must not draw anything else or
+	 * change render state in between without calling FlushQuadBatch first.
+	 * Sprite adds its quads to the batch when one is open. */
+	void BeginQuadBatch();
+	void EndQuadBatch();
+	bool IsBatchingQuads() const;
+	void AddQuadsToBatch( const RageQuadBatchState &state, const RageSpriteVertex v[], int iNumVerts );
+	void FlushQuadBatch();
+	// True if quads waiting in the batch read or write the Z buffer.
+	bool QuadBatchUsesZBuffer() const;
+
 	// hacks for cell-shaded models
 	virtual void SetPolygonMode( PolygonMode ) {}
 	virtual void SetLineWidth( float ) {}
@@ -391,11 +437,13 @@ public:
 	// Statistics
 	int GetFPS() const;
 	int GetVPF() const;
+	int GetDPF() const; // draw calls per frame
 	int GetCumFPS() const; // average FPS since last reset
 	virtual void ResetStats();
 	virtual void ProcessStatsOnFlip();
 	virtual RString GetStats() const;
 	void StatsAddVerts( int iNumVertsRendered );
+	void StatsAddDraw();
 
 	// World matrix stack functions.
 	void PushMatrix();
@@ -16,12 +16,15 @@ using namespace RageDisplay_Legacy_Helpers;
 #include "EnumHelper.h"
 #include "DisplaySpec.h"
 #include "LocalizedString.h"
+#include "FrameProfiler.h"
 
 #include "arch/LowLevelWindow/LowLevelWindow.h"
 
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <list>
 #include <set>
 #include <vector>
 
@@ -410,6 +413,7 @@ static GLhandleARB g_hHardMixShader = 0;
 static GLhandleARB g_hOverlayShader = 0;
 static GLhandleARB g_hScreenShader = 0;
 static GLhandleARB g_hYUYV422Shader = 0;
+static GLhandleARB g_hYUV420PShader = 0;
 static GLhandleARB g_gShellShader = 0;
 static GLhandleARB g_gCelShader = 0;
 static GLhandleARB g_gDistanceFieldShader = 0;
@@ -438,6 +442,7 @@ void InitShaders()
 	g_hOverlayShader		= LoadShader( GL_FRAGMENT_SHADER_ARB, "Data/Shaders/GLSL/Overlay.frag", asDefines );
 	g_hScreenShader		= LoadShader( GL_FRAGMENT_SHADER_ARB, "Data/Shaders/GLSL/Screen.frag", asDefines );
 	g_hYUYV422Shader		= LoadShader( GL_FRAGMENT_SHADER_ARB, "Data/Shaders/GLSL/YUYV422.frag", asDefines );
+	g_hYUV420PShader		= LoadShader( GL_FRAGMENT_SHADER_ARB, "Data/Shaders/GLSL/YUV420P.frag", asDefines );
 
 	// Bind attributes.
 	if (g_bTextureMatrixShader)
@@ -566,8 +571,13 @@ RString RageDisplay_Legacy::Init( const VideoModeParams &p, bool bAllowUnacceler
 	return RString();
 }
 
+static void DeleteStreamingBuffer();
+static void DeleteTextureUploads();
+
 RageDisplay_Legacy::~RageDisplay_Legacy()
 {
+	DeleteStreamingBuffer();
+	DeleteTextureUploads();
 	delete g_pWind;
 }
 
@@ -1489,22 +1499,230 @@ void RageDisplay_Legacy::DeleteCompiledGeometry( RageCompiledGeometry* p )
 	delete p;
 }
 
-void RageDisplay_Legacy::DrawQuadsInternal( const RageSpriteVertex v[], int iNumVerts )
+/* Dynamic geometry (sprites, text, notes) is streamed through a single vertex
+ * buffer used as a ring: each draw appends its vertices after the last one's.
+ * When the ring fills up, it's orphaned, so the driver gives us fresh storage
+ * instead of making us wait for the GPU to finish reading the old contents.
+ * Since nothing already written is ever overwritten until then, appends don't
+ * need to synchronize, and we don't need fences. */
+struct StreamVertex
+{
+	float p[3];
+	float n[3];
+	GLubyte c[4]; // r, g, b, a
+	float t[2];
+};
+
+static const int STREAM_BUFFER_BYTES = 4*1024*1024;
+
+/* Quads are drawn as indexed triangles.  This many quads fit in 16-bit indices. */
+static const int MAX_STREAM_QUADS = 65536/4;
+
+class StreamingVertexBuffer: public InvalidateObject
 {
+public:
+	StreamingVertexBuffer(): m_nVertices(0), m_nQuadIndices(0), m_iOffset(0) { }
+	~StreamingVertexBuffer()
+	{
+		if (m_nVertices)
+			glDeleteBuffersARB( 1, &m_nVertices );
+		if (m_nQuadIndices)
+			glDeleteBuffersARB( 1, &m_nQuadIndices );
+	}
+
+	void Invalidate()
+	{
+		/* The context is gone, and our buffers with it. */
+		m_nVertices = 0;
+		m_nQuadIndices = 0;
+		m_iOffset = 0;
+	}
+
+	/* Append the vertices to the ring and point the vertex arrays at them.
+	 * Returns false if there are too many to fit. */
+	bool Upload( const RageSpriteVertex v[], int iNumVerts )
+	{
+		const int iBytes = iNumVerts * sizeof(StreamVertex);
+		if (iBytes > STREAM_BUFFER_BYTES)
+			return false;
+
+		if (!m_nVertices)
+		{
+			glGenBuffersARB( 1, &m_nVertices );
+			glBindBufferARB( GL_ARRAY_BUFFER_ARB, m_nVertices );
+			glBufferDataARB( GL_ARRAY_BUFFER_ARB, STREAM_BUFFER_BYTES, nullptr, GL_STREAM_DRAW_ARB );
+			m_iOffset = 0;
+		}
+		else
+		{
+			glBindBufferARB( GL_ARRAY_BUFFER_ARB, m_nVertices );
+			if (m_iOffset + iBytes > STREAM_BUFFER_BYTES)
+			{
+				glBufferDataARB( GL_ARRAY_BUFFER_ARB, STREAM_BUFFER_BYTES, nullptr, GL_STREAM_DRAW_ARB );
+				m_iOffset = 0;
+			}
+		}
+
+		StreamVertex *pDest = nullptr;
+		if (GLEW_ARB_map_buffer_range)
+			pDest = (StreamVertex *) glMapBufferRange( GL_ARRAY_BUFFER_ARB, m_iOffset, iBytes,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+		if (pDest)
+		{
+			Convert( v, iNumVerts, pDest );
+			glUnmapBufferARB( GL_ARRAY_BUFFER_ARB );
+		}
+		else
+		{
+			m_vScratch.resize( iNumVerts );
+			Convert( v, iNumVerts, m_vScratch.data() );
+			glBufferSubDataARB( GL_ARRAY_BUFFER_ARB, m_iOffset, iBytes, m_vScratch.data() );
+		}
+
+		SetPointers( m_iOffset );
+		m_iOffset += iBytes;
+		return true;
+	}
+
+	/* Bind the index buffer for drawing up to MAX_STREAM_QUADS quads as
+	 * triangles. */
+	void BindQuadIndices()
+	{
+		if (m_nQuadIndices)
+		{
+			glBindBufferARB( GL_ELEMENT_ARRAY_BUFFER_ARB, m_nQuadIndices );
+			return;
+		}
+
+		std::vector<std::uint16_t> vIndices( MAX_STREAM_QUADS*6 );
+		for( int i = 0; i < MAX_STREAM_QUADS; ++i )
+		{
+			// { 0, 1, 2 } { 0, 2, 3 }
+			vIndices[i*6+0] = i*4+0;
+			vIndices[i*6+1] = i*4+1;
+			vIndices[i*6+2] = i*4+2;
+			vIndices[i*6+3] = i*4+0;
+			vIndices[i*6+4] = i*4+2;
+			vIndices[i*6+5] = i*4+3;
+		}
+
+		glGenBuffersARB( 1, &m_nQuadIndices );
+		glBindBufferARB( GL_ELEMENT_ARRAY_BUFFER_ARB, m_nQuadIndices );
+		glBufferDataARB( GL_ELEMENT_ARRAY_BUFFER_ARB, vIndices.size()*sizeof(std::uint16_t), vIndices.data(), GL_STATIC_DRAW_ARB );
+	}
+
+private:
+	static void Convert( const RageSpriteVertex v[], int iNumVerts, StreamVertex *pDest )
+	{
+		for( int i = 0; i < iNumVerts; ++i )
+		{
+			StreamVertex &d = pDest[i];
+			d.p[0] = v[i].p[0];
+			d.p[1] = v[i].p[1];
+			d.p[2] = v[i].p[2];
+			d.n[0] = v[i].n[0];
+			d.n[1] = v[i].n[1];
+			d.n[2] = v[i].n[2];
+			d.c[0] = v[i].c.r;
+			d.c[1] = v[i].c.g;
+			d.c[2] = v[i].c.b;
+			d.c[3] = v[i].c.a;
+			d.t[0] = v[i].t[0];
+			d.t[1] = v[i].t[1];
+		}
+	}
+
+	static void SetPointers( int iOffset )
+	{
+		const GLsizei iStride = sizeof(StreamVertex);
+
+		glEnableClientState( GL_VERTEX_ARRAY );
+		glVertexPointer( 3, GL_FLOAT, iStride, BUFFER_OFFSET(iOffset + offsetof(StreamVertex, p)) );
+
+		glEnableClientState( GL_COLOR_ARRAY );
+		glColorPointer( 4, GL_UNSIGNED_BYTE, iStride, BUFFER_OFFSET(iOffset + offsetof(StreamVertex, c)) );
+
+		glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+		glTexCoordPointer( 2, GL_FLOAT, iStride, BUFFER_OFFSET(iOffset + offsetof(StreamVertex, t)) );
+
+		if (GLEW_ARB_multitexture)
+		{
+			glClientActiveTextureARB( GL_TEXTURE1_ARB );
+			glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+			glTexCoordPointer( 2, GL_FLOAT, iStride, BUFFER_OFFSET(iOffset + offsetof(StreamVertex, t)) );
+			glClientActiveTextureARB( GL_TEXTURE0_ARB );
+		}
+
+		glEnableClientState( GL_NORMAL_ARRAY );
+		glNormalPointer( GL_FLOAT, iStride, BUFFER_OFFSET(iOffset + offsetof(StreamVertex, n)) );
+	}
+
+	GLuint m_nVertices;
+	GLuint m_nQuadIndices;
+	int m_iOffset;
+	std::vector<StreamVertex> m_vScratch;
+};
+
+static StreamingVertexBuffer *g_pStreamingBuffer = nullptr;
+
+static StreamingVertexBuffer *GetStreamingBuffer()
+{
+	if (!GLEW_ARB_vertex_buffer_object)
+		return nullptr;
+	if (g_pStreamingBuffer == nullptr)
+		g_pStreamingBuffer = new StreamingVertexBuffer;
+	return g_pStreamingBuffer;
+}
+
+static void DeleteStreamingBuffer()
+{
+	delete g_pStreamingBuffer;
+	g_pStreamingBuffer = nullptr;
+}
+
+/* Point the vertex arrays at v: in the streaming buffer if we have one, or in
+ * client memory if not. */
+static void StreamVertices( const RageSpriteVertex v[], int iNumVerts )
+{
+	StreamingVertexBuffer *pBuffer = GetStreamingBuffer();
+	if (pBuffer != nullptr && pBuffer->Upload( v, iNumVerts ))
+		return;
+
 	TurnOffHardwareVBO();
+	SetupVertices( v, iNumVerts );
+}
+
+void RageDisplay_Legacy::DrawQuadsInternal( const RageSpriteVertex v[], int iNumVerts )
+{
 	SendCurrentMatrices();
 
-	SetupVertices( v, iNumVerts );
-	glDrawArrays( GL_QUADS, 0, iNumVerts );
+	StreamingVertexBuffer *pBuffer = GetStreamingBuffer();
+	if (pBuffer == nullptr)
+	{
+		TurnOffHardwareVBO();
+		SetupVertices( v, iNumVerts );
+		glDrawArrays( GL_QUADS, 0, iNumVerts );
+		return;
+	}
+
+	/* The indices are relative to the start of each upload, so draw in pieces
+	 * no larger than the index buffer. */
+	pBuffer->BindQuadIndices();
+	for( int iStart = 0; iStart < iNumVerts; iStart += MAX_STREAM_QUADS*4 )
+	{
+		const int iVerts = std::min( iNumVerts - iStart, MAX_STREAM_QUADS*4 );
+		pBuffer->Upload( v + iStart, iVerts );
+		glDrawElements( GL_TRIANGLES, iVerts/4*6, GL_UNSIGNED_SHORT, BUFFER_OFFSET(0) );
+	}
 }
 
 void RageDisplay_Legacy::DrawQuadStripInternal( const RageSpriteVertex v[], int iNumVerts )
 {
-	TurnOffHardwareVBO();
 	SendCurrentMatrices();
 
-	SetupVertices( v, iNumVerts );
-	glDrawArrays( GL_QUAD_STRIP, 0, iNumVerts );
+	/* A triangle strip over the same vertices covers the same quads. */
+	StreamVertices( v, iNumVerts );
+	glDrawArrays( GL_TRIANGLE_STRIP, 0, iNumVerts );
 }
 
 void RageDisplay_Legacy::DrawSymmetricQuadStripInternal( const RageSpriteVertex v[], int iNumVerts )
@@ -1535,10 +1753,11 @@ void RageDisplay_Legacy::DrawSymmetricQuadStripInternal( const RageSpriteVertex
 		vIndices[i*12+11] = i*3+5;
 	}
 
-	TurnOffHardwareVBO();
 	SendCurrentMatrices();
 
-	SetupVertices( v, iNumVerts );
+	StreamVertices( v, iNumVerts );
+	if (GLEW_ARB_vertex_buffer_object)
+		glBindBufferARB( GL_ELEMENT_ARRAY_BUFFER_ARB, 0 );
 	glDrawElements(
 		GL_TRIANGLES,
 		iNumIndices,
@@ -1548,28 +1767,25 @@ void RageDisplay_Legacy::DrawSymmetricQuadStripInternal( const RageSpriteVertex
 
 void RageDisplay_Legacy::DrawFanInternal( const RageSpriteVertex v[], int iNumVerts )
 {
-	TurnOffHardwareVBO();
 	SendCurrentMatrices();
 
-	SetupVertices( v, iNumVerts );
+	StreamVertices( v, iNumVerts );
 	glDrawArrays( GL_TRIANGLE_FAN, 0, iNumVerts );
 }
 
 void RageDisplay_Legacy::DrawStripInternal( const RageSpriteVertex v[], int iNumVerts )
 {
-	TurnOffHardwareVBO();
 	SendCurrentMatrices();
 
-	SetupVertices( v, iNumVerts );
+	StreamVertices( v, iNumVerts );
 	glDrawArrays( GL_TRIANGLE_STRIP, 0, iNumVerts );
 }
 
 void RageDisplay_Legacy::DrawTrianglesInternal( const RageSpriteVertex v[], int iNumVerts )
 {
-	TurnOffHardwareVBO();
 	SendCurrentMatrices();
 
-	SetupVertices( v, iNumVerts );
+	StreamVertices( v, iNumVerts );
 	glDrawArrays( GL_TRIANGLES, 0, iNumVerts );
 }
 
@@ -1583,8 +1799,6 @@ void RageDisplay_Legacy::DrawCompiledGeometryInternal( const RageCompiledGeometr
 
 void RageDisplay_Legacy::DrawLineStripInternal( const RageSpriteVertex v[], int iNumVerts, float fLineWidth )
 {
-	TurnOffHardwareVBO();
-
 	if (!GetActualVideoModeParams().bSmoothLines)
 	{
 		/* Fall back on the generic polygon-based line strip. */
@@ -1624,9 +1838,10 @@ void RageDisplay_Legacy::DrawLineStripInternal( const RageSpriteVertex v[], int
 	glLineWidth( fLineWidth );
 
 	/* Draw the line loop: */
-	SetupVertices( v, iNumVerts );
+	StreamVertices( v, iNumVerts );
 	glDrawArrays( GL_LINE_STRIP, 0, iNumVerts );
 	StatsAddVerts(iNumVerts);
+	StatsAddDraw();
 
 	glDisable( GL_LINE_SMOOTH );
 
@@ -1650,9 +1865,10 @@ void RageDisplay_Legacy::DrawLineStripInternal( const RageSpriteVertex v[], int
 
 	glEnable( GL_POINT_SMOOTH );
 
-	SetupVertices( v, iNumVerts );
+	StreamVertices( v, iNumVerts );
 	glDrawArrays( GL_POINTS, 0, iNumVerts );
 	StatsAddVerts(iNumVerts);
+	StatsAddDraw();
 
 	glDisable( GL_POINT_SMOOTH );
 }
@@ -1812,6 +2028,9 @@ void RageDisplay_Legacy::SetEffectMode( EffectMode effect )
 		case EffectMode_YUYV422:
 			hShader = g_hYUYV422Shader;
 			break;
+		case EffectMode_YUV420P:
+			hShader = g_hYUV420PShader;
+			break;
 		case EffectMode_DistanceField:
 			hShader = g_gDistanceFieldShader;
 		default:
@@ -1834,6 +2053,16 @@ void RageDisplay_Legacy::SetEffectMode( EffectMode effect )
 		glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &iWidth );
 		glUniform1iARB( iTextureWidthUniform, iWidth );
 	}
+	else if (effect == EffectMode_YUV420P)
+	{
+		GLint iTextureWidthUniform = glGetUniformLocationARB( hShader, "TextureWidth" );
+		GLint iTextureHeightUniform = glGetUniformLocationARB( hShader, "TextureHeight" );
+		GLint iWidth, iHeight;
+		glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &iWidth );
+		glGetTexLevelParameteriv( GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &iHeight );
+		glUniform1iARB( iTextureWidthUniform, iWidth );
+		glUniform1iARB( iTextureHeightUniform, iHeight );
+	}
 
 	DebugAssertNoGLError();
 }
@@ -1860,6 +2089,8 @@ bool RageDisplay_Legacy::IsEffectModeSupported( EffectMode effect )
 			return g_hScreenShader != 0;
 		case EffectMode_YUYV422:
 			return g_hYUYV422Shader != 0;
+		case EffectMode_YUV420P:
+			return g_hYUV420PShader != 0;
 		case EffectMode_DistanceField:
 			return g_gDistanceFieldShader != 0;
 		default:
@@ -2115,11 +2346,15 @@ void RageDisplay_Legacy::EndConcurrentRendering()
 	g_pWind->EndConcurrentRendering();
 }
 
+static void CancelPendingTexture( std::uintptr_t iTexture );
+
 void RageDisplay_Legacy::DeleteTexture( std::uintptr_t iTexture )
 {
 	if (iTexture == 0)
 		return;
 
+	CancelPendingTexture( iTexture );
+
 	if (g_mapRenderTargets.find(iTexture) != g_mapRenderTargets.end())
 	{
 		delete g_mapRenderTargets[iTexture];
@@ -2200,11 +2435,40 @@ void SetPixelMapForSurface( int glImageFormat, int glTexFormat, const RageSurfac
 	DebugAssertNoGLError();
 }
 
+/* Allocate a texture object, bind it to texture unit 1 and set up its
+ * parameters. */
+std::uintptr_t RageDisplay_Legacy::CreateTextureObject()
+{
+	SetTextureUnit( TextureUnit_1 );
+
+	// allocate OpenGL texture resource
+	std::uintptr_t iTexHandle;
+	glGenTextures( 1, reinterpret_cast<GLuint*>(&iTexHandle) );
+	ASSERT( iTexHandle != 0 );
+
+	glBindTexture( GL_TEXTURE_2D, static_cast<GLuint>(iTexHandle) );
+
+	if (g_pWind->GetActualVideoModeParams().bAnisotropicFiltering &&
+		GLEW_EXT_texture_filter_anisotropic )
+	{
+		GLfloat fLargestSupportedAnisotropy;
+		glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &fLargestSupportedAnisotropy );
+		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, fLargestSupportedAnisotropy );
+	}
+
+	SetTextureFiltering( TextureUnit_1, true );
+	SetTextureWrapping( TextureUnit_1, false );
+
+	return iTexHandle;
+}
+
 std::uintptr_t RageDisplay_Legacy::CreateTexture(
 	RagePixelFormat pixfmt,
 	RageSurface* pImg,
 	bool bGenerateMipMaps )
 {
+	PROFILE_SCOPE( "CreateTexture" );
+
 	ASSERT( pixfmt < NUM_RagePixelFormat );
 
 
@@ -2242,25 +2506,7 @@ std::uintptr_t RageDisplay_Legacy::CreateTexture(
 		}
 	}
 
-	SetTextureUnit( TextureUnit_1 );
-
-	// allocate OpenGL texture resource
-	std::uintptr_t iTexHandle;
-	glGenTextures( 1, reinterpret_cast<GLuint*>(&iTexHandle) );
-	ASSERT( iTexHandle != 0 );
-
-	glBindTexture( GL_TEXTURE_2D, static_cast<GLuint>(iTexHandle) );
-
-	if (g_pWind->GetActualVideoModeParams().bAnisotropicFiltering &&
-		GLEW_EXT_texture_filter_anisotropic )
-	{
-		GLfloat fLargestSupportedAnisotropy;
-		glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &fLargestSupportedAnisotropy );
-		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, fLargestSupportedAnisotropy );
-	}
-
-	SetTextureFiltering( TextureUnit_1, true );
-	SetTextureWrapping( TextureUnit_1, false );
+	std::uintptr_t iTexHandle = CreateTextureObject();
 
 	glPixelStorei( GL_UNPACK_ROW_LENGTH, pImg->pitch / pImg->format->BytesPerPixel );
 
@@ -2410,6 +2656,224 @@ private:
 	std::uintptr_t m_iTexHandle;
 };
 
+/* Textures created with CreateTextureAsync are uploaded through a pixel buffer
+ * object a band of rows at a time, under a per-frame byte budget.  The copy into
+ * the PBO is the only work done in the frame; the driver transfers it to the
+ * texture asynchronously. */
+struct PendingTextureUpload
+{
+	std::uintptr_t iTexHandle;
+	RageSurface *pImg;
+	GLenum glImageFormat;
+	GLenum glImageType;
+	int iNextRow;
+};
+
+class TextureUploadQueue: public InvalidateObject
+{
+public:
+	TextureUploadQueue(): m_iBuffer(0) { }
+	~TextureUploadQueue()
+	{
+		Clear();
+		if (m_iBuffer)
+			glDeleteBuffersARB( 1, &m_iBuffer );
+	}
+
+	/* This is called when our OpenGL context is invalidated.  The textures
+	 * are gone, and will be reloaded by their owners. */
+	void Invalidate()
+	{
+		Clear();
+		m_iBuffer = 0;
+	}
+
+	void Add( const PendingTextureUpload &upload ) { m_Pending.push_back( upload ); }
+
+	std::list<PendingTextureUpload>::iterator Find( std::uintptr_t iTexHandle )
+	{
+		for (auto it = m_Pending.begin(); it != m_Pending.end(); ++it)
+			if (it->iTexHandle == iTexHandle)
+				return it;
+		return m_Pending.end();
+	}
+
+	bool IsPending( std::uintptr_t iTexHandle ) const
+	{
+		for (const PendingTextureUpload &upload : m_Pending)
+			if (upload.iTexHandle == iTexHandle)
+				return true;
+		return false;
+	}
+
+	void Cancel( std::uintptr_t iTexHandle )
+	{
+		auto it = Find( iTexHandle );
+		if (it == m_Pending.end())
+			return;
+		delete it->pImg;
+		m_Pending.erase( it );
+	}
+
+	void Upload( int iMaxBytes )
+	{
+		int iBytes = 0;
+		while (!m_Pending.empty() && iBytes < iMaxBytes)
+		{
+			PendingTextureUpload &upload = m_Pending.front();
+			const int iPitch = upload.pImg->pitch;
+			const int iRows = clamp( (iMaxBytes - iBytes) / iPitch, 1, upload.pImg->h - upload.iNextRow );
+			UploadRows( upload, iRows );
+			iBytes += iRows * iPitch;
+
+			if (upload.iNextRow == upload.pImg->h)
+			{
+				delete upload.pImg;
+				m_Pending.pop_front();
+			}
+		}
+	}
+
+	void Finish( std::uintptr_t iTexHandle )
+	{
+		auto it = Find( iTexHandle );
+		if (it == m_Pending.end())
+			return;
+		UploadRows( *it, it->pImg->h - it->iNextRow );
+		delete it->pImg;
+		m_Pending.erase( it );
+	}
+
+private:
+	void Clear()
+	{
+		for (PendingTextureUpload &upload : m_Pending)
+			delete upload.pImg;
+		m_Pending.clear();
+	}
+
+	void UploadRows( PendingTextureUpload &upload, int iRows )
+	{
+		const RageSurface *pImg = upload.pImg;
+		const int iSize = iRows * pImg->pitch;
+		const std::uint8_t *pSource = pImg->pixels + upload.iNextRow * pImg->pitch;
+
+		if (!m_iBuffer)
+			glGenBuffersARB( 1, &m_iBuffer );
+		glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, m_iBuffer );
+
+		/* Orphan the last band, so we don't wait for it to be read. */
+		glBufferDataARB( GL_PIXEL_UNPACK_BUFFER_ARB, iSize, nullptr, GL_STREAM_DRAW_ARB );
+		const GLvoid *pPixels = BUFFER_OFFSET(0);
+		void *pBufferMemory = glMapBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY );
+		if (pBufferMemory)
+		{
+			memcpy( pBufferMemory, pSource, iSize );
+			if (!glUnmapBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB ))
+				pBufferMemory = nullptr;
+		}
+		if (!pBufferMemory)
+		{
+			/* Mapping failed, or the buffer was lost; upload from our copy. */
+			glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+			pPixels = pSource;
+		}
+
+		SetTextureUnit( TextureUnit_1 );
+		glBindTexture( GL_TEXTURE_2D, static_cast<GLuint>(upload.iTexHandle) );
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, pImg->pitch / pImg->format->BytesPerPixel );
+		glTexSubImage2D( GL_TEXTURE_2D, 0,
+			0, upload.iNextRow,
+			pImg->w, iRows,
+			upload.glImageFormat, upload.glImageType, pPixels );
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+
+		glBindBufferARB( GL_PIXEL_UNPACK_BUFFER_ARB, 0 );
+		upload.iNextRow += iRows;
+	}
+
+	std::list<PendingTextureUpload> m_Pending;
+	GLuint m_iBuffer;
+};
+
+static TextureUploadQueue *g_pTextureUploads = nullptr;
+
+static void DeleteTextureUploads()
+{
+	delete g_pTextureUploads;
+	g_pTextureUploads = nullptr;
+}
+
+static void CancelPendingTexture( std::uintptr_t iTexture )
+{
+	if (g_pTextureUploads)
+		g_pTextureUploads->Cancel( iTexture );
+}
+
+std::uintptr_t RageDisplay_Legacy::CreateTextureAsync(
+	RagePixelFormat pixfmt,
+	RageSurface* pImg,
+	bool bGenerateMipMaps )
+{
+	ASSERT( pixfmt < NUM_RagePixelFormat );
+
+	/* Mipmaps are built from the whole image at once, and paletted images need
+	 * the pixel map set when they're uploaded; load those synchronously. */
+	if (!GLEW_ARB_pixel_buffer_object || bGenerateMipMaps ||
+		pixfmt == RagePixelFormat_PAL || pImg->format->BytesPerPixel == 1 ||
+		pImg->pixels == nullptr)
+		return 0;
+
+	bool bFreeImg;
+	RageSurface *pOriginal = pImg;
+	RagePixelFormat SurfacePixFmt = GetImgPixelFormat( pImg, bFreeImg, pImg->w, pImg->h, false );
+	ASSERT( SurfacePixFmt != RagePixelFormat_Invalid );
+	if (bFreeImg)
+		delete pOriginal;
+
+	GLenum glTexFormat = g_GLPixFmtInfo[pixfmt].internalfmt;
+
+	/* Allocate the texture now, so it has its final size; the contents come
+	 * later. */
+	std::uintptr_t iTexHandle = CreateTextureObject();
+	DebugFlushGLErrors();
+	glTexImage2D(
+		GL_TEXTURE_2D, 0, glTexFormat,
+		power_of_two(pImg->w), power_of_two(pImg->h), 0,
+		g_GLPixFmtInfo[SurfacePixFmt].format, g_GLPixFmtInfo[SurfacePixFmt].type, nullptr );
+	DebugAssertNoGLError();
+
+	if (g_pTextureUploads == nullptr)
+		g_pTextureUploads = new TextureUploadQueue;
+
+	PendingTextureUpload upload;
+	upload.iTexHandle = iTexHandle;
+	upload.pImg = pImg;
+	upload.glImageFormat = g_GLPixFmtInfo[SurfacePixFmt].format;
+	upload.glImageType = g_GLPixFmtInfo[SurfacePixFmt].type;
+	upload.iNextRow = 0;
+	g_pTextureUploads->Add( upload );
+
+	return iTexHandle;
+}
+
+void RageDisplay_Legacy::UploadPendingTextures( int iMaxBytes )
+{
+	if (g_pTextureUploads)
+		g_pTextureUploads->Upload( iMaxBytes );
+}
+
+bool RageDisplay_Legacy::IsTexturePending( std::uintptr_t iTexHandle ) const
+{
+	return g_pTextureUploads && g_pTextureUploads->IsPending( iTexHandle );
+}
+
+void RageDisplay_Legacy::FinishPendingTexture( std::uintptr_t iTexHandle )
+{
+	if (g_pTextureUploads)
+		g_pTextureUploads->Finish( iTexHandle );
+}
+
 RageTextureLock *RageDisplay_Legacy::CreateTextureLock()
 {
 	if (!GLEW_ARB_pixel_buffer_object)
@@ -2423,6 +2887,8 @@ void RageDisplay_Legacy::UpdateTexture(
 	RageSurface* pImg,
 	int iXOffset, int iYOffset, int iWidth, int iHeight )
 {
+	PROFILE_SCOPE( "UpdateTexture" );
+
 	glBindTexture( GL_TEXTURE_2D, static_cast<GLuint>(iTexHandle) );
 
 	bool bFreeImg;
@@ -65,6 +65,13 @@ public:
 		int xoffset, int yoffset, int width, int height
 		);
 	void DeleteTexture( std::uintptr_t iTexHandle );
+	std::uintptr_t CreateTextureAsync(
+		RagePixelFormat pixfmt,
+		RageSurface* img,
+		bool bGenerateMipMaps );
+	void UploadPendingTextures( int iMaxBytes );
+	bool IsTexturePending( std::uintptr_t iTexHandle ) const;
+	void FinishPendingTexture( std::uintptr_t iTexHandle );
 	bool UseOffscreenRenderTarget();
 	RageSurface *GetTexture( std::uintptr_t iTexture );
 	RageTextureLock *CreateTextureLock();
@@ -133,6 +140,7 @@ protected:
 	RageSurface* CreateScreenshot();
 	RagePixelFormat GetImgPixelFormat( RageSurface* &img, bool &FreeImg, int width, int height, bool bPalettedTexture );
 	bool SupportsSurfaceFormat( RagePixelFormat pixfmt );
+	std::uintptr_t CreateTextureObject();
 
 	void SendCurrentMatrices();
 
@@ -22,6 +22,9 @@ public:
 	virtual int GetFileHash( const RString &sPath );
 	virtual int GetPathValue( const RString &sPath );
 	virtual void FlushDirCache( const RString &sPath );
+	/* Optional: flush the cache of only one directory, and its subdirectories
+	 * if bRecursive.  By default, this flushes everything. */
+	virtual void FlushDir( const RString &sPath, bool /* bRecursive */ ) { FlushDirCache( sPath ); }
 	virtual void CacheFile( const RString & /* sPath */ ) { }
 	virtual bool Move( const RString & /* sOldPath */, const RString & /* sNewPath */ ) { return false; }
 	virtual bool Remove( const RString & /* sPath */ ) { return false; }
@@ -224,6 +224,11 @@ bool RageFileDriverDirect::Remount( const RString &sPath )
 	return true;
 }
 
+void RageFileDriverDirect::FlushDir( const RString &sPath, bool bRecursive )
+{
+	FDB->FlushDir( sPath, bRecursive );
+}
+
 /* The DIRRO driver is just like DIR, except writes are disallowed. */
 RageFileDriverDirectReadOnly::RageFileDriverDirectReadOnly( const RString &sRoot ):
 	RageFileDriverDirect( sRoot ) { }
@@ -16,6 +16,7 @@ public:
 	bool Move( const RString &sOldPath, const RString &sNewPath );
 	bool Remove( const RString &sPath );
 	bool Remount( const RString &sPath );
+	void FlushDir( const RString &sPath, bool bRecursive );
 
 private:
 	RString m_sRoot;
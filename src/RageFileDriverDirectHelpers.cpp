@@ -160,31 +160,18 @@ void DirectFilenameDB::CacheFile( const RString &sPath )
 {
 	CHECKPOINT_M( root+sPath );
 	RString sDir = Dirname( sPath );
-	FileSet *pFileSet = GetFileSet( sDir, false );
-	if( pFileSet == nullptr )
-	{
-		// This directory isn't cached so do nothing.
-		m_Mutex.Unlock(); // Locked by GetFileSet()
-		return;
-	}
-	while( !pFileSet->m_bFilled )
-		m_Mutex.Wait();
 
 #if defined(WIN32)
 	// There is almost surely a better way to do this
 	WIN32_FIND_DATA fd;
 	HANDLE hFind = DoFindFirstFile( root+sPath, &fd );
 	if( hFind == INVALID_HANDLE_VALUE )
-	{
-		m_Mutex.Unlock(); // Locked by GetFileSet()
 		return;
-	}
 	File f( fd.cFileName );
 	f.dir = !!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
 	f.size = fd.nFileSizeLow;
 	f.hash = fd.ftLastWriteTime.dwLowDateTime;
 
-	pFileSet->files.insert( f );
 	FindClose( hFind );
 #else
 	File f( Basename(sPath) );
@@ -204,10 +191,10 @@ void DirectFilenameDB::CacheFile( const RString &sPath )
 		f.size = (int)st.st_size;
 		f.hash = st.st_mtime;
 	}
-
-	pFileSet->files.insert(f);
 #endif
-	m_Mutex.Unlock(); // Locked by GetFileSet()
+
+	// If this directory isn't cached, this does nothing.
+	UpdateCachedFile( sDir, f );
 }
 
 void DirectFilenameDB::PopulateFileSet( FileSet &fs, const RString &path )
@@ -854,6 +854,22 @@ void RageFileManager::FlushDirCache( const RString &sPath_ )
 	}
 }
 
+void RageFileManager::FlushDir( const RString &sPath_, bool bRecursive )
+{
+	RString sPath = sPath_;
+
+	LockMut( *g_Mutex );
+
+	NormalizePath( sPath );
+	for( unsigned i = 0; i < g_pDrivers.size(); ++i )
+	{
+		const RString &path = g_pDrivers[i]->GetPath( sPath );
+		if( path.size() == 0 )
+			continue;
+		g_pDrivers[i]->m_pDriver->FlushDir( path, bRecursive );
+	}
+}
+
 RageFileManager::FileType RageFileManager::GetFileType( const RString &sPath_ )
 {
 	RString sPath = sPath_;
@@ -964,6 +980,46 @@ RString RageFileManager::ResolvePath(const RString &path)
 	return resolvedPath;
 }
 
+bool RageFileManager::GetOsPaths( const RString &sPath_, std::vector<RString> &asOut )
+{
+	RString sPath = sPath_;
+	NormalizePath( sPath );
+
+	std::vector<LoadedDriver *> apDriverList;
+	ReferenceAllDrivers( apDriverList );
+
+	bool bRet = true;
+	for( unsigned i = 0; i < apDriverList.size(); ++i )
+	{
+		const LoadedDriver *pDriver = apDriverList[i];
+		const RString sDriverPath = pDriver->GetPath( sPath );
+		if( sDriverPath.empty() )
+			continue;
+
+		if( pDriver->m_sType.CompareNoCase("dir") && pDriver->m_sType.CompareNoCase("dirro") )
+		{
+			/* Packages are mounted over "/", but most of them don't have
+			 * anything here.  (Asking a zip is cheap; asking a directory
+			 * would mean listing it.) */
+			if( pDriver->m_pDriver->GetFileType(sDriverPath) == RageFileManager::TYPE_NONE )
+				continue;
+			bRet = false;
+			break;
+		}
+
+		RString sRoot = pDriver->m_sRoot;
+		if( sRoot.Right(1) == "/" )
+			sRoot.erase( sRoot.size()-1 );
+		RString sOsPath = sRoot + sDriverPath;
+		if( sOsPath.size() > 1 && sOsPath.Right(1) == "/" )
+			sOsPath.erase( sOsPath.size()-1 );
+		asOut.push_back( sOsPath );
+	}
+
+	UnreferenceAllDrivers( apDriverList );
+	return bRet;
+}
+
 static bool SortBySecond( const std::pair<int, int> &a, const std::pair<int, int> &b )
 {
 	return a.second < b.second;
@@ -53,6 +53,16 @@ public:
 	 * @return the absolute path. */
 	RString ResolvePath(const RString &path);
 
+	/**
+	 * @brief Get the OS path of a VFS path in every directory mounted over it.
+	 *
+	 * The paths are returned whether or not anything exists there.
+	 * @param sPath the VFS path.
+	 * @param asOut the OS paths, without trailing slashes.
+	 * @return false if the path also exists in a mount that isn't a plain
+	 * directory (a zip, say), so its OS paths don't tell the whole story. */
+	bool GetOsPaths( const RString &sPath, std::vector<RString> &asOut );
+
 	bool Mount( const RString &sType, const RString &sRealPath, const RString &sMountPoint );
 	void Unmount( const RString &sType, const RString &sRoot, const RString &sMountPoint );
 
@@ -68,6 +78,10 @@ public:
 	void GetLoadedDrivers( std::vector<DriverLocation> &asMounts );
 
 	void FlushDirCache( const RString &sPath = RString() );
+	/* Forget the cached listing of a single directory, or of everything
+	 * under it if bRecursive, leaving the rest of the cache alone.  Drivers
+	 * that can't do that flush everything. */
+	void FlushDir( const RString &sPath, bool bRecursive = false );
 
 	/* Used only by RageFile: */
 	RageFileBasic *Open( const RString &sPath, int iMode, int &iError );
@@ -18,6 +18,7 @@
 #include "LocalizedString.h"
 #include "Preference.h"
 #include "RageSoundReader_PostBuffering.h"
+#include "RageSoundMixKernels.h"
 
 #include "arch/Sound/RageSoundDriver.h"
 
@@ -43,6 +44,7 @@ RageSoundManager::RageSoundManager(): m_pDriver(nullptr),
 static LocalizedString COULDNT_FIND_SOUND_DRIVER( "RageSoundManager", "Couldn't find a sound driver that works" );
 void RageSoundManager::Init()
 {
+	LOG->Info( "Sound mixing kernels: %s", RageSoundMixKernels::Get().m_szName );
 	m_pDriver = RageSoundDriver::Create( g_sSoundDrivers );
 	if( m_pDriver == nullptr )
 		RageException::Throw( "%s", COULDNT_FIND_SOUND_DRIVER.GetValue().c_str() );
@@ -133,6 +135,14 @@ void RageSoundManager::Update()
 		m_pDriver->Update();
 }
 
+bool RageSoundManager::GetMixingStats( RageSoundMixingStats &out ) const
+{
+	if( m_pDriver == nullptr )
+		return false;
+	m_pDriver->GetMixingStats( out );
+	return true;
+}
+
 float RageSoundManager::GetPlayLatency() const
 {
 	if( m_pDriver == nullptr )
@@ -16,6 +16,7 @@ struct RageSoundParams;
 class RageSoundReader;
 class RageSoundReader_Preload;
 class RageTimer;
+struct RageSoundMixingStats;
 
 class RageSoundManager
 {
@@ -42,6 +43,7 @@ public:
 	std::int64_t GetPosition( RageTimer *pTimer ) const;	/* used by RageSound */
 	float GetPlayLatency() const;
 	int GetDriverSampleRate() const;
+	bool GetMixingStats( RageSoundMixingStats &out ) const;
 
 	RageSoundReader *GetLoadedSound( const RString &sPath );
 	void AddLoadedSound( const RString &sPath, RageSoundReader_Preload *pSound );
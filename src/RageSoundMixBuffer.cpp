@@ -1,5 +1,6 @@
 #include "global.h"
 #include "RageSoundMixBuffer.h"
+#include "RageSoundMixKernels.h"
 #include "RageUtil.h"
 
 #include <cmath>
@@ -65,24 +66,16 @@ void RageSoundMixBuffer::write( const float *pBuf, unsigned iSize, int iSourceSt
 
 	// Scale volume and add.
 	float *pDestBuf = m_pMixbuf+m_iOffset;
-
-	while( iSize )
-	{
-		*pDestBuf += *pBuf;
-		pBuf += iSourceStride;
-		pDestBuf += iDestStride;
-		--iSize;
-	}
+	const RageSoundMixKernels &kernels = RageSoundMixKernels::Get();
+	if( iSourceStride == 1 && iDestStride == 1 )
+		kernels.Add( pDestBuf, pBuf, iSize );
+	else
+		kernels.AddStrided( pDestBuf, pBuf, iSize, iSourceStride, iDestStride );
 }
 
 void RageSoundMixBuffer::read( std::int16_t *pBuf )
 {
-	for( unsigned iPos = 0; iPos < m_iBufUsed; ++iPos )
-	{
-		float iOut = m_pMixbuf[iPos];
-		iOut = clamp( iOut, -1.0f, +1.0f );
-		pBuf[iPos] = static_cast<int>((iOut * 32767) + 0.5);
-	}
+	RageSoundMixKernels::Get().ToInt16( pBuf, m_pMixbuf, m_iBufUsed );
 	m_iBufUsed = 0;
 }
 
@@ -94,9 +87,7 @@ void RageSoundMixBuffer::read( float *pBuf )
 
 void RageSoundMixBuffer::read_deinterlace( float **pBufs, int channels )
 {
-	for( unsigned i = 0; i < m_iBufUsed / channels; ++i )
-		for( int ch = 0; ch < channels; ++ch )
-			pBufs[ch][i] = m_pMixbuf[channels * i + ch];
+	RageSoundMixKernels::Get().Deinterlace( pBufs, m_pMixbuf, m_iBufUsed / channels, channels );
 	m_iBufUsed = 0;
 }
 
@@ -0,0 +1,327 @@
+#include "global.h"
+#include "RageSoundMixKernels.h"
+#include "RageUtil.h"
+
+#include <atomic>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MIX_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_SSE2
+#define TARGET_AVX2
+#else
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MIX_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+/* Scalar versions.  These define the results the others have to match. */
+static void AddScalar( float *pDest, const float *pSrc, unsigned iSize )
+{
+	for( unsigned i = 0; i < iSize; ++i )
+		pDest[i] += pSrc[i];
+}
+
+static void AddStridedScalar( float *pDest, const float *pSrc, unsigned iSize, int iSourceStride, int iDestStride )
+{
+	while( iSize )
+	{
+		*pDest += *pSrc;
+		pSrc += iSourceStride;
+		pDest += iDestStride;
+		--iSize;
+	}
+}
+
+static void ToInt16Scalar( std::int16_t *pDest, const float *pSrc, unsigned iSize )
+{
+	for( unsigned i = 0; i < iSize; ++i )
+	{
+		float fOut = clamp( pSrc[i], -1.0f, +1.0f );
+		pDest[i] = static_cast<int>((fOut * 32767) + 0.5);
+	}
+}
+
+static void DeinterlaceScalar( float **pDest, const float *pSrc, unsigned iFrames, int iChannels )
+{
+	for( unsigned i = 0; i < iFrames; ++i )
+		for( int ch = 0; ch < iChannels; ++ch )
+			pDest[ch][i] = pSrc[iChannels * i + ch];
+}
+
+static const RageSoundMixKernels g_Scalar =
+{
+	"scalar", AddScalar, AddStridedScalar, ToInt16Scalar, DeinterlaceScalar
+};
+
+#if defined(MIX_KERNELS_X86)
+TARGET_SSE2 static void AddSSE2( float *pDest, const float *pSrc, unsigned iSize )
+{
+	unsigned i = 0;
+	for( ; i + 4 <= iSize; i += 4 )
+		_mm_storeu_ps( pDest+i, _mm_add_ps(_mm_loadu_ps(pDest+i), _mm_loadu_ps(pSrc+i)) );
+	AddScalar( pDest+i, pSrc+i, iSize-i );
+}
+
+/* Strides of 2 and 1 are the common case for channel splitting.  Leave the last
+ * few samples to the scalar loop, so we never touch memory past the last sample
+ * of a strided buffer. */
+TARGET_SSE2 static void AddStridedSSE2( float *pDest, const float *pSrc, unsigned iSize, int iSourceStride, int iDestStride )
+{
+	unsigned i = 0;
+	if( iSourceStride == 1 && iDestStride == 1 )
+	{
+		AddSSE2( pDest, pSrc, iSize );
+		return;
+	}
+	else if( iSourceStride == 2 && iDestStride == 1 )
+	{
+		for( ; i + 5 <= iSize; i += 4 )
+		{
+			__m128 a = _mm_loadu_ps( pSrc + i*2 );
+			__m128 b = _mm_loadu_ps( pSrc + i*2 + 4 );
+			__m128 evens = _mm_shuffle_ps( a, b, _MM_SHUFFLE(2,0,2,0) );
+			_mm_storeu_ps( pDest+i, _mm_add_ps(_mm_loadu_ps(pDest+i), evens) );
+		}
+	}
+	else if( iSourceStride == 1 && iDestStride == 2 )
+	{
+		/* Adding -0 leaves every value unchanged, including the sign of zeroes. */
+		const __m128 zero = _mm_set1_ps( -0.0f );
+		for( ; i + 5 <= iSize; i += 4 )
+		{
+			__m128 s = _mm_loadu_ps( pSrc+i );
+			float *p = pDest + i*2;
+			_mm_storeu_ps( p, _mm_add_ps(_mm_loadu_ps(p), _mm_unpacklo_ps(s, zero)) );
+			_mm_storeu_ps( p+4, _mm_add_ps(_mm_loadu_ps(p+4), _mm_unpackhi_ps(s, zero)) );
+		}
+	}
+	AddStridedScalar( pDest + i*iDestStride, pSrc + i*iSourceStride, iSize-i, iSourceStride, iDestStride );
+}
+
+/* The scalar version adds 0.5 as a double, so do the same here; rounding in
+ * single precision could change the result near powers of two. */
+TARGET_SSE2 static inline __m128i ToInt32SSE2( __m128 v )
+{
+	v = _mm_min_ps( _mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f) );
+	v = _mm_mul_ps( v, _mm_set1_ps(32767.0f) );
+	const __m128d half = _mm_set1_pd( 0.5 );
+	__m128i lo = _mm_cvttpd_epi32( _mm_add_pd(_mm_cvtps_pd(v), half) );
+	__m128i hi = _mm_cvttpd_epi32( _mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), half) );
+	return _mm_unpacklo_epi64( lo, hi );
+}
+
+TARGET_SSE2 static void ToInt16SSE2( std::int16_t *pDest, const float *pSrc, unsigned iSize )
+{
+	unsigned i = 0;
+	for( ; i + 8 <= iSize; i += 8 )
+	{
+		__m128i a = ToInt32SSE2( _mm_loadu_ps(pSrc+i) );
+		__m128i b = ToInt32SSE2( _mm_loadu_ps(pSrc+i+4) );
+		_mm_storeu_si128( (__m128i *) (pDest+i), _mm_packs_epi32(a, b) );
+	}
+	ToInt16Scalar( pDest+i, pSrc+i, iSize-i );
+}
+
+TARGET_SSE2 static void DeinterlaceSSE2( float **pDest, const float *pSrc, unsigned iFrames, int iChannels )
+{
+	if( iChannels != 2 )
+	{
+		DeinterlaceScalar( pDest, pSrc, iFrames, iChannels );
+		return;
+	}
+
+	float *pLeft = pDest[0], *pRight = pDest[1];
+	unsigned i = 0;
+	for( ; i + 4 <= iFrames; i += 4 )
+	{
+		__m128 a = _mm_loadu_ps( pSrc + i*2 );
+		__m128 b = _mm_loadu_ps( pSrc + i*2 + 4 );
+		_mm_storeu_ps( pLeft+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0)) );
+		_mm_storeu_ps( pRight+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1)) );
+	}
+	for( ; i < iFrames; ++i )
+	{
+		pLeft[i] = pSrc[i*2];
+		pRight[i] = pSrc[i*2+1];
+	}
+}
+
+static const RageSoundMixKernels g_SSE2 =
+{
+	"SSE2", AddSSE2, AddStridedSSE2, ToInt16SSE2, DeinterlaceSSE2
+};
+
+TARGET_AVX2 static void AddAVX2( float *pDest, const float *pSrc, unsigned iSize )
+{
+	unsigned i = 0;
+	for( ; i + 8 <= iSize; i += 8 )
+		_mm256_storeu_ps( pDest+i, _mm256_add_ps(_mm256_loadu_ps(pDest+i), _mm256_loadu_ps(pSrc+i)) );
+	AddScalar( pDest+i, pSrc+i, iSize-i );
+}
+
+TARGET_AVX2 static void AddStridedAVX2( float *pDest, const float *pSrc, unsigned iSize, int iSourceStride, int iDestStride )
+{
+	if( iSourceStride == 1 && iDestStride == 1 )
+		AddAVX2( pDest, pSrc, iSize );
+	else
+		AddStridedSSE2( pDest, pSrc, iSize, iSourceStride, iDestStride );
+}
+
+TARGET_AVX2 static void ToInt16AVX2( std::int16_t *pDest, const float *pSrc, unsigned iSize )
+{
+	const __m256 lowest = _mm256_set1_ps( -1.0f ), highest = _mm256_set1_ps( 1.0f );
+	const __m256 scale = _mm256_set1_ps( 32767.0f );
+	const __m256d half = _mm256_set1_pd( 0.5 );
+
+	unsigned i = 0;
+	for( ; i + 8 <= iSize; i += 8 )
+	{
+		__m256 v = _mm256_loadu_ps( pSrc+i );
+		v = _mm256_min_ps( _mm256_max_ps(v, lowest), highest );
+		v = _mm256_mul_ps( v, scale );
+		__m128i lo = _mm256_cvttpd_epi32( _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), half) );
+		__m128i hi = _mm256_cvttpd_epi32( _mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), half) );
+		_mm_storeu_si128( (__m128i *) (pDest+i), _mm_packs_epi32(lo, hi) );
+	}
+	ToInt16Scalar( pDest+i, pSrc+i, iSize-i );
+}
+
+static const RageSoundMixKernels g_AVX2 =
+{
+	"AVX2", AddAVX2, AddStridedAVX2, ToInt16AVX2, DeinterlaceSSE2
+};
+
+static bool CPUHasSSE2()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+	return true;
+#elif defined(_MSC_VER)
+	int regs[4];
+	__cpuid( regs, 1 );
+	return (regs[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports( "sse2" );
+#endif
+}
+
+static bool CPUHasAVX2()
+{
+#if defined(_MSC_VER)
+	int regs[4];
+	__cpuid( regs, 0 );
+	if( regs[0] < 7 )
+		return false;
+
+	// The OS has to save the AVX registers, too.
+	__cpuid( regs, 1 );
+	const bool bOSXSave = (regs[2] & (1 << 27)) != 0, bAVX = (regs[2] & (1 << 28)) != 0;
+	if( !bOSXSave || !bAVX || (_xgetbv(0) & 6) != 6 )
+		return false;
+
+	__cpuidex( regs, 7, 0 );
+	return (regs[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports( "avx2" );
+#endif
+}
+#endif
+
+#if defined(MIX_KERNELS_NEON)
+static void AddNEON( float *pDest, const float *pSrc, unsigned iSize )
+{
+	unsigned i = 0;
+	for( ; i + 4 <= iSize; i += 4 )
+		vst1q_f32( pDest+i, vaddq_f32(vld1q_f32(pDest+i), vld1q_f32(pSrc+i)) );
+	AddScalar( pDest+i, pSrc+i, iSize-i );
+}
+
+static void AddStridedNEON( float *pDest, const float *pSrc, unsigned iSize, int iSourceStride, int iDestStride )
+{
+	if( iSourceStride == 1 && iDestStride == 1 )
+		AddNEON( pDest, pSrc, iSize );
+	else
+		AddStridedScalar( pDest, pSrc, iSize, iSourceStride, iDestStride );
+}
+
+static void DeinterlaceNEON( float **pDest, const float *pSrc, unsigned iFrames, int iChannels )
+{
+	if( iChannels != 2 )
+	{
+		DeinterlaceScalar( pDest, pSrc, iFrames, iChannels );
+		return;
+	}
+
+	unsigned i = 0;
+	for( ; i + 4 <= iFrames; i += 4 )
+	{
+		float32x4x2_t v = vld2q_f32( pSrc + i*2 );
+		vst1q_f32( pDest[0]+i, v.val[0] );
+		vst1q_f32( pDest[1]+i, v.val[1] );
+	}
+	for( ; i < iFrames; ++i )
+	{
+		pDest[0][i] = pSrc[i*2];
+		pDest[1][i] = pSrc[i*2+1];
+	}
+}
+
+// XXX: ToInt16 is still scalar; it needs a double-precision add to match.
+static const RageSoundMixKernels g_NEON =
+{
+	"NEON", AddNEON, AddStridedNEON, ToInt16Scalar, DeinterlaceNEON
+};
+#endif
+
+void RageSoundMixKernels::GetAvailable( std::vector<const RageSoundMixKernels *> &vOut )
+{
+	vOut.push_back( &g_Scalar );
+#if defined(MIX_KERNELS_X86)
+	if( CPUHasSSE2() )
+		vOut.push_back( &g_SSE2 );
+	if( CPUHasAVX2() )
+		vOut.push_back( &g_AVX2 );
+#elif defined(MIX_KERNELS_NEON)
+	vOut.push_back( &g_NEON );
+#endif
+}
+
+/* The last of GetAvailable's list.  This doesn't allocate, since the mixing
+ * thread may be the first to ask. */
+static const RageSoundMixKernels *GetFastest()
+{
+#if defined(MIX_KERNELS_X86)
+	if( CPUHasAVX2() )
+		return &g_AVX2;
+	if( CPUHasSSE2() )
+		return &g_SSE2;
+#elif defined(MIX_KERNELS_NEON)
+	return &g_NEON;
+#endif
+	return &g_Scalar;
+}
+
+static std::atomic<const RageSoundMixKernels *> g_pKernels( nullptr );
+
+const RageSoundMixKernels &RageSoundMixKernels::Get()
+{
+	const RageSoundMixKernels *pKernels = g_pKernels.load( std::memory_order_acquire );
+	if( pKernels != nullptr )
+		return *pKernels;
+
+	/* If another thread got here first, it picked the same thing. */
+	pKernels = GetFastest();
+	g_pKernels.store( pKernels, std::memory_order_release );
+	return *pKernels;
+}
+
+void RageSoundMixKernels::Set( const RageSoundMixKernels &kernels )
+{
+	g_pKernels.store( &kernels, std::memory_order_release );
+}
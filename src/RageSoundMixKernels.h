@@ -0,0 +1,39 @@
+/* RageSoundMixKernels - The inner loops of RageSoundMixBuffer, for each instruction set. */
+
+#ifndef RAGE_SOUND_MIX_KERNELS_H
+#define RAGE_SOUND_MIX_KERNELS_H
+
+#include <cstdint>
+#include <vector>
+
+/* Every implementation gives bit-identical results to the scalar one, for
+ * any input that isn't NaN. */
+struct RageSoundMixKernels
+{
+	const char *m_szName;
+
+	// pDest[i] += pSrc[i]
+	void (*Add)( float *pDest, const float *pSrc, unsigned iSize );
+
+	// pDest[i*iDestStride] += pSrc[i*iSourceStride]
+	void (*AddStrided)( float *pDest, const float *pSrc, unsigned iSize, int iSourceStride, int iDestStride );
+
+	// Clamp to [-1,1] and scale to 16-bit.
+	void (*ToInt16)( std::int16_t *pDest, const float *pSrc, unsigned iSize );
+
+	// Split iFrames interleaved frames into one buffer per channel.
+	void (*Deinterlace)( float **pDest, const float *pSrc, unsigned iFrames, int iChannels );
+
+	/* Return the fastest kernels this CPU can run.  The CPU is checked the
+	 * first time this is called; RageSoundManager::Init does that before
+	 * anything is mixed. */
+	static const RageSoundMixKernels &Get();
+
+	/* Use the given kernels from now on.  This is for testing. */
+	static void Set( const RageSoundMixKernels &kernels );
+
+	/* List every set of kernels this CPU can run, starting with the scalar ones. */
+	static void GetAvailable( std::vector<const RageSoundMixKernels *> &vOut );
+};
+
+#endif
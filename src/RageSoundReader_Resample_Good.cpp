@@ -17,9 +17,24 @@
 #include <cstdint>
 #include <numeric>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RESAMPLE_NEON
+#include <arm_neon.h>
+#endif
+
 /* Filter length.  This must be a power of 2. */
 #define L 8
 
+static bool g_bVectorFilter = true;
+
+void RageSoundReader_Resample_Good::SetVectorFilter( bool bOn )
+{
+	g_bVectorFilter = bOn;
+}
+
 namespace
 {
 	float sincf( float f )
@@ -117,6 +132,63 @@ namespace
 	}
 }
 
+/*
+ * Filter one output frame: the dot product of a polyphase row with the last L
+ * input frames.  The SIMD and scalar versions add in the same order.
+ */
+static_assert( L == 8, "The filter kernels assume 8 taps." );
+
+static inline float FilterMono( const float *pIn, const float *pCoef )
+{
+#if defined(RESAMPLE_SSE2)
+	__m128 acc = _mm_add_ps( _mm_mul_ps(_mm_loadu_ps(pIn), _mm_loadu_ps(pCoef)),
+		_mm_mul_ps(_mm_loadu_ps(pIn+4), _mm_loadu_ps(pCoef+4)) );
+	acc = _mm_add_ps( acc, _mm_movehl_ps(acc, acc) );
+	acc = _mm_add_ss( acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1,1,1,1)) );
+	return _mm_cvtss_f32( acc );
+#elif defined(RESAMPLE_NEON)
+	float32x4_t acc = vaddq_f32( vmulq_f32(vld1q_f32(pIn), vld1q_f32(pCoef)),
+		vmulq_f32(vld1q_f32(pIn+4), vld1q_f32(pCoef+4)) );
+	float32x2_t half = vadd_f32( vget_low_f32(acc), vget_high_f32(acc) );
+	return vget_lane_f32( half, 0 ) + vget_lane_f32( half, 1 );
+#else
+	float acc[4];
+	for( int k = 0; k < 4; ++k )
+		acc[k] = pIn[k]*pCoef[k] + pIn[k+4]*pCoef[k+4];
+	return (acc[0] + acc[2]) + (acc[1] + acc[3]);
+#endif
+}
+
+/* pIn is L interleaved stereo frames, and pCoef is the row with each coefficient
+ * repeated, so one multiply covers two frames of both channels. */
+static inline void FilterStereo( const float *pIn, const float *pCoef, float *pOut )
+{
+#if defined(RESAMPLE_SSE2)
+	__m128 acc = _mm_mul_ps( _mm_loadu_ps(pIn), _mm_loadu_ps(pCoef) );
+	acc = _mm_add_ps( acc, _mm_mul_ps(_mm_loadu_ps(pIn+4), _mm_loadu_ps(pCoef+4)) );
+	acc = _mm_add_ps( acc, _mm_mul_ps(_mm_loadu_ps(pIn+8), _mm_loadu_ps(pCoef+8)) );
+	acc = _mm_add_ps( acc, _mm_mul_ps(_mm_loadu_ps(pIn+12), _mm_loadu_ps(pCoef+12)) );
+	// acc is left and right of the even frames, then of the odd frames.
+	acc = _mm_add_ps( acc, _mm_movehl_ps(acc, acc) );
+	_mm_storel_pi( (__m64 *) pOut, acc );
+#elif defined(RESAMPLE_NEON)
+	float32x4_t acc = vmulq_f32( vld1q_f32(pIn), vld1q_f32(pCoef) );
+	acc = vaddq_f32( acc, vmulq_f32(vld1q_f32(pIn+4), vld1q_f32(pCoef+4)) );
+	acc = vaddq_f32( acc, vmulq_f32(vld1q_f32(pIn+8), vld1q_f32(pCoef+8)) );
+	acc = vaddq_f32( acc, vmulq_f32(vld1q_f32(pIn+12), vld1q_f32(pCoef+12)) );
+	vst1_f32( pOut, vadd_f32(vget_low_f32(acc), vget_high_f32(acc)) );
+#else
+	float acc[4];
+	for( int k = 0; k < 4; ++k )
+		acc[k] = pIn[k]*pCoef[k];
+	for( int i = 4; i < L*2; i += 4 )
+		for( int k = 0; k < 4; ++k )
+			acc[k] += pIn[i+k]*pCoef[i+k];
+	pOut[0] = acc[0] + acc[2];
+	pOut[1] = acc[1] + acc[3];
+#endif
+}
+
 #if 0
 void RunFIRFilter( float *pIn, float *pOut, int iInputValues, float *pFIR, int iWinSize )
 {
@@ -169,40 +241,48 @@ struct PolyphaseFilter
 {
 	struct State
 	{
-		State( int iUpFactor ):
-			m_fBuf( L * 2 )
+		State( int iUpFactor, int iChannels ):
+			m_fBuf( L * 2 * iChannels )
 		{
 			m_iPolyIndex = iUpFactor-1;
 			m_iFilled = 0;
 			m_iBufNext = 0;
+			m_iChannels = iChannels;
 		}
 
 		int m_iPolyIndex;
 		int m_iFilled;
 
-		/* This buffer is duplicated.  If the circular buffer is size L, the actual buffer
-		 * is size L*2, and data at buf[N] is also at buf[N+L].  That way, we can access
-		 * up to buf[N*2-1] without having to wrap. */
+		/* This buffer holds interleaved frames, and is duplicated.  If the circular
+		 * buffer is L frames, the actual buffer is L*2 frames, and the frame at buf[N]
+		 * is also at buf[N+L].  That way, we can access up to frame N+L-1 without
+		 * having to wrap. */
 		AlignedBuffer<float> m_fBuf;
-		int m_iBufNext;
+		int m_iBufNext; // in frames
+		int m_iChannels;
 	};
 	friend struct State;
 
 	PolyphaseFilter( int iUpFactor ):
-		m_pPolyphase( L*iUpFactor )
+		m_pPolyphase( L*iUpFactor ),
+		m_pPolyphaseStereo( L*2*iUpFactor )
 	{
 		m_iUpFactor = iUpFactor;
 	}
 
 	void Generate( const float *pFIR );
-	int RunPolyphaseFilter( State &State, const float *pIn, int iSamplesIn, int iDownFactor,
-			float *pOut, int iSamplesOut, int iSampleStride ) const;
+	int RunPolyphaseFilter( State &State, const float *pIn, int iFramesIn, int iDownFactor,
+			float *pOut, int iFramesOut ) const;
 	int GetLatency() const { return L/2; }
 
 	int NumInputsForOutputSamples( const State &State, int iOut, int iDownFactor ) const;
 
 private:
+	void FilterFrame( const State &State, int iPolyIndex, float *pOut ) const;
+
 	AlignedBuffer<float> m_pPolyphase;
+	/* m_pPolyphase with each coefficient repeated, for FilterStereo. */
+	AlignedBuffer<float> m_pPolyphaseStereo;
 	int m_iUpFactor;
 };
 
@@ -256,6 +336,34 @@ void PolyphaseFilter::Generate( const float *pFIR )
 			iInputOffset %= iInputSize;
 		}
 	}
+
+	for( int i = 0; i < L*m_iUpFactor; ++i )
+		m_pPolyphaseStereo[i*2] = m_pPolyphaseStereo[i*2+1] = m_pPolyphase[i];
+}
+
+void PolyphaseFilter::FilterFrame( const State &State, int iPolyIndex, float *pOut ) const
+{
+	const int iChannels = State.m_iChannels;
+	const float *pInData = &State.m_fBuf[State.m_iBufNext*iChannels];
+	if( g_bVectorFilter && iChannels == 2 )
+	{
+		FilterStereo( pInData, &m_pPolyphaseStereo[iPolyIndex*L*2], pOut );
+		return;
+	}
+	if( g_bVectorFilter && iChannels == 1 )
+	{
+		*pOut = FilterMono( pInData, &m_pPolyphase[iPolyIndex*L] );
+		return;
+	}
+
+	const float *pCurPoly = &m_pPolyphase[iPolyIndex*L];
+	for( int c = 0; c < iChannels; ++c )
+	{
+		float fTot = 0;
+		for( int j = 0; j < L; ++j )
+			fTot += pInData[j*iChannels + c]*pCurPoly[j];
+		pOut[c] = fTot;
+	}
 }
 
 /*
@@ -284,15 +392,15 @@ void PolyphaseFilter::Generate( const float *pFIR )
  */
 int PolyphaseFilter::RunPolyphaseFilter(
 		State &State,
-		const float *pIn, int iSamplesIn, int iDownFactor,
-		float *pOut, int iSamplesOut,
-		int iSampleStride ) const
+		const float *pIn, int iFramesIn, int iDownFactor,
+		float *pOut, int iFramesOut ) const
 {
-	ASSERT( iSamplesIn >= 0 );
+	ASSERT( iFramesIn >= 0 );
 
+	const int iChannels = State.m_iChannels;
 	float *pOutOrig = pOut;
-	const float *pInEnd = pIn + iSamplesIn*iSampleStride;
-	const float *pOutEnd = pOut + iSamplesOut*iSampleStride;
+	const float *pInEnd = pIn + iFramesIn*iChannels;
+	const float *pOutEnd = pOut + iFramesOut*iChannels;
 
 	int iFilled = State.m_iFilled;
 	int iPolyIndex = State.m_iPolyIndex;
@@ -303,26 +411,29 @@ int PolyphaseFilter::RunPolyphaseFilter(
 			if( pIn == pInEnd )
 				break;
 
-			State.m_fBuf[State.m_iBufNext] = *pIn;
-			State.m_fBuf[State.m_iBufNext + L] = *pIn;
+			float *pBuf = &State.m_fBuf[State.m_iBufNext*iChannels];
+			if( iChannels == 2 )
+			{
+				pBuf[0] = pBuf[L*2] = pIn[0];
+				pBuf[1] = pBuf[L*2 + 1] = pIn[1];
+			}
+			else
+			{
+				for( int c = 0; c < iChannels; ++c )
+					pBuf[c] = pBuf[c + L*iChannels] = pIn[c];
+			}
 			++State.m_iBufNext;
 			State.m_iBufNext &= L-1;
 
-			pIn += iSampleStride;
+			pIn += iChannels;
 			++iFilled;
 			continue;
 		}
 
 		while( pOut != pOutEnd )
 		{
-			const float *pCurPoly = &m_pPolyphase[iPolyIndex*L];
-			const float *pInData = &State.m_fBuf[State.m_iBufNext];
-
-			float fTot = 0;
-			for( int j = 0; j < L; ++j )
-				fTot += pInData[j]*pCurPoly[j];
-			*pOut = fTot;
-			pOut += iSampleStride;
+			FilterFrame( State, iPolyIndex, pOut );
+			pOut += iChannels;
 
 			iPolyIndex += iDownFactor;
 			if( iPolyIndex >= m_iUpFactor )
@@ -336,7 +447,7 @@ int PolyphaseFilter::RunPolyphaseFilter(
 	State.m_iPolyIndex = iPolyIndex;
 
 	int iRetSamples = pOut - pOutOrig;
-	int iRetFrames = iRetSamples / iSampleStride;
+	int iRetFrames = iRetSamples / iChannels;
 	return iRetFrames;
 }
 
@@ -445,7 +556,8 @@ namespace PolyphaseFilterCache
 
 /*
  * Interface to PolyphaseFilter, providing a simple resampling interface.  This handles
- * reuse of PolyphaseFilters.  This does not handle delay, flushing, or multiple channels.
+ * reuse of PolyphaseFilters, and filters all channels of interleaved frames in one pass.
+ * This does not handle delay or flushing.
  */
 class RageSoundResampler_Polyphase
 {
@@ -453,7 +565,7 @@ public:
 	/* Note that going outside of [iMinDownFactor,iMaxDownFactor] while resampling isn't
 	 * fatal.  It'll only cause aliasing, by not having a LPF that's low enough, or cause
 	 * too much filtering, by not having a LPF that's high enough. */
-	RageSoundResampler_Polyphase( int iUpFactor, int iMinDownFactor, int iMaxDownFactor )
+	RageSoundResampler_Polyphase( int iUpFactor, int iMinDownFactor, int iMaxDownFactor, int iChannels )
 	{
 		/* Cache filters between iMinDownFactor and iMaxDownFactor.  Do them in
 		 * iFilterIncrement increments; we'll round down to the closest match
@@ -471,7 +583,7 @@ public:
 
 		SetDownFactor( iUpFactor );
 
-		m_pState = new PolyphaseFilter::State( iUpFactor );
+		m_pState = new PolyphaseFilter::State( iUpFactor, iChannels );
 	}
 
 	~RageSoundResampler_Polyphase()
@@ -481,19 +593,25 @@ public:
 
 	void SetDownFactor( int iDownFactor )
 	{
+		/* Rate mods set this on every read; only look up the filter, which locks
+		 * the cache, when the ratio changes. */
+		if( m_pPolyphase != nullptr && iDownFactor == m_iDownFactor )
+			return;
+
 		m_iDownFactor = iDownFactor;
 		m_pPolyphase = GetFilter( m_iDownFactor );
 	}
 
-	int Run( const float *pIn, int iSamplesIn, float *pOut, int iSamplesOut, int iSampleStride ) const
+	int Run( const float *pIn, int iFramesIn, float *pOut, int iFramesOut ) const
 	{
-		return m_pPolyphase->RunPolyphaseFilter( *m_pState, pIn, iSamplesIn, m_iDownFactor, pOut, iSamplesOut, iSampleStride );
+		return m_pPolyphase->RunPolyphaseFilter( *m_pState, pIn, iFramesIn, m_iDownFactor, pOut, iFramesOut );
 	}
 
 	void Reset()
 	{
+		int iChannels = m_pState->m_iChannels;
 		delete m_pState;
-		m_pState = new PolyphaseFilter::State( m_iUpFactor );
+		m_pState = new PolyphaseFilter::State( m_iUpFactor, iChannels );
 	}
 
 	int NumInputsForOutputSamples( int iOut ) const { return m_pPolyphase->NumInputsForOutputSamples(*m_pState, iOut, m_iDownFactor); }
@@ -540,7 +658,7 @@ private:
 int RageSoundReader_Resample_Good::GetNextSourceFrame() const
 {
 	std::int64_t iPosition = m_pSource->GetNextSourceFrame();
-	iPosition -= m_apResamplers[0]->GetFilled();
+	iPosition -= m_pResampler->GetFilled();
 
 	iPosition *= m_iSampleRate;
 	iPosition /= m_pSource->GetSampleRate();
@@ -571,14 +689,14 @@ RageSoundReader_Resample_Good::RageSoundReader_Resample_Good( RageSoundReader *p
 {
 	m_iSampleRate = iSampleRate;
 	m_fRate = -1;
+	m_pResampler = nullptr;
 	ReopenResampler();
 }
 
 /* Call this if the input position is changed or reset. */
 void RageSoundReader_Resample_Good::Reset()
 {
-	for( std::size_t iChannel = 0; iChannel < m_pSource->GetNumChannels(); ++iChannel )
-		m_apResamplers[iChannel]->Reset();
+	m_pResampler->Reset();
 }
 
 
@@ -604,35 +722,27 @@ void RageSoundReader_Resample_Good::GetFactors( int &iDownFactor, int &iUpFactor
 /* Call this if the sample factor changes. */
 void RageSoundReader_Resample_Good::ReopenResampler()
 {
-	for( std::size_t iChannel = 0; iChannel < m_apResamplers.size(); ++iChannel )
-		delete m_apResamplers[iChannel];
-	m_apResamplers.clear();
+	delete m_pResampler;
 
 	int iDownFactor, iUpFactor;
 	GetFactors( iDownFactor, iUpFactor );
 
-	for( std::size_t iChannel = 0; iChannel < m_pSource->GetNumChannels(); ++iChannel )
-	{
-		int iMinDownFactor = iDownFactor;
-		int iMaxDownFactor = iDownFactor;
-		if( m_fRate != -1 )
-			iMaxDownFactor *= 5;
+	int iMinDownFactor = iDownFactor;
+	int iMaxDownFactor = iDownFactor;
+	if( m_fRate != -1 )
+		iMaxDownFactor *= 5;
 
-		RageSoundResampler_Polyphase *p = new RageSoundResampler_Polyphase( iUpFactor, iMinDownFactor, iMaxDownFactor );
-		m_apResamplers.push_back( p );
-	}
+	m_pResampler = new RageSoundResampler_Polyphase( iUpFactor, iMinDownFactor, iMaxDownFactor, m_pSource->GetNumChannels() );
 
 	if( m_fRate != -1 )
 		iDownFactor = static_cast<int>((m_fRate * iDownFactor) + 0.5 );
 
-	for( std::size_t iChannel = 0; iChannel < m_apResamplers.size(); ++iChannel )
-		m_apResamplers[iChannel]->SetDownFactor( iDownFactor );
+	m_pResampler->SetDownFactor( iDownFactor );
 }
 
 RageSoundReader_Resample_Good::~RageSoundReader_Resample_Good()
 {
-	for( std::size_t iChannel = 0; iChannel < m_apResamplers.size(); ++iChannel )
-		delete m_apResamplers[iChannel];
+	delete m_pResampler;
 }
 
 /* iFrame is in the destination rate.  Seek the source in its own sample rate. */
@@ -645,35 +755,24 @@ int RageSoundReader_Resample_Good::SetPosition( int iFrame )
 
 int RageSoundReader_Resample_Good::Read( float *pBuf, int iFrames )
 {
-	int iChannels = m_apResamplers.size();
-
-	int iFramesRead = 0;
+	int iChannels = m_pSource->GetNumChannels();
 
 	/* If the ratio is 1:1, then we're effectively disabled, and we can read
 	 * directly into the buffer. */
 	int iDownFactor, iUpFactor;
 	GetFactors( iDownFactor, iUpFactor );
 
-	if( m_apResamplers[0]->GetFilled() == 0 && iDownFactor == iUpFactor && GetRate() == 1.0f )
+	if( m_pResampler->GetFilled() == 0 && iDownFactor == iUpFactor && GetRate() == 1.0f )
 		return m_pSource->Read( pBuf, iFrames );
 
-	{
-		int iFramesNeeded = m_apResamplers[0]->NumInputsForOutputSamples(iFrames);
-		float *pTmpBuf = (float *) alloca( iFramesNeeded * sizeof(float) * iChannels );
-		int iFramesIn = m_pSource->Read( pTmpBuf, iFramesNeeded );
-		if( iFramesIn < 0 )
-			return iFramesIn;
-
-		for( int iChannel = 0; iChannel < iChannels; ++iChannel )
-		{
-			int iGotFrames = m_apResamplers[iChannel]->Run( pTmpBuf + iChannel, iFramesIn, pBuf + iChannel, iFrames, iChannels );
-			ASSERT( iGotFrames <= iFrames );
-
-			if( iChannel == 0 )
-				iFramesRead += iGotFrames;
-		}
-	}
+	int iFramesNeeded = m_pResampler->NumInputsForOutputSamples(iFrames);
+	float *pTmpBuf = (float *) alloca( iFramesNeeded * sizeof(float) * iChannels );
+	int iFramesIn = m_pSource->Read( pTmpBuf, iFramesNeeded );
+	if( iFramesIn < 0 )
+		return iFramesIn;
 
+	int iFramesRead = m_pResampler->Run( pTmpBuf, iFramesIn, pBuf, iFrames );
+	ASSERT( iFramesRead <= iFrames );
 	return iFramesRead;
 }
 
@@ -704,8 +803,7 @@ void RageSoundReader_Resample_Good::SetRate( float fRatio )
 	/* Set m_fRate to the actual rate, after quantization by iUpFactor. */
 	m_fRate = float(iDownFactor) / iUpFactor;
 
-	for( std::size_t iChannel = 0; iChannel < m_apResamplers.size(); ++iChannel )
-		m_apResamplers[iChannel]->SetDownFactor( iDownFactor );
+	m_pResampler->SetDownFactor( iDownFactor );
 }
 
 float RageSoundReader_Resample_Good::GetRate() const
@@ -719,8 +817,7 @@ float RageSoundReader_Resample_Good::GetRate() const
 RageSoundReader_Resample_Good::RageSoundReader_Resample_Good( const RageSoundReader_Resample_Good &cpy ):
 	RageSoundReader_Filter(cpy)
 {
-	for( std::size_t i = 0; i < cpy.m_apResamplers.size(); ++i )
-		this->m_apResamplers.push_back( new RageSoundResampler_Polyphase(*cpy.m_apResamplers[i]) );
+	this->m_pResampler = new RageSoundResampler_Polyphase( *cpy.m_pResampler );
 	this->m_iSampleRate = cpy.m_iSampleRate;
 	this->m_fRate = cpy.m_fRate;
 }
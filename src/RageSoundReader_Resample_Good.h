@@ -37,12 +37,16 @@ public:
 
 	int GetSampleRate() const { return m_iSampleRate; }
 
+	/* Turn the SIMD mono and stereo filters on or off, to compare them against
+	 * the plain per-channel filter.  This is for testing. */
+	static void SetVectorFilter( bool bOn );
+
 private:
 	void Reset();
 	void ReopenResampler();
 	void GetFactors( int &iDownFactor, int &iUpFactor ) const;
 
-	std::vector<RageSoundResampler_Polyphase*> m_apResamplers; /* one per channel */
+	RageSoundResampler_Polyphase *m_pResampler; /* all channels */
 
 	int m_iSampleRate;
 	float m_fRate;
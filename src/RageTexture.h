@@ -20,6 +20,8 @@ public:
 	virtual void Reload() {}
 	virtual void Invalidate() { }	/* only called by RageTextureManager::InvalidateTextures */
 	virtual std::uintptr_t GetTexHandle() const = 0;	// accessed by RageDisplay
+	virtual bool IsPending() const { return false; }	// still being uploaded
+	virtual void FinishPending() { }	// finish uploading now
 
 	// movie texture/animated texture stuff
 	virtual void SetPosition( float /* fSeconds */ ) {} // seek
@@ -26,9 +26,14 @@
 #include "RageLog.h"
 #include "RageDisplay.h"
 #include "ActorUtil.h"
+#include "FrameProfiler.h"
 
 #include <cstdint>
+#include <deque>
 #include <map>
+#include <set>
+#include <utility>
+#include <vector>
 
 RageTextureManager*		TEXTUREMAN		= nullptr; // global and accessible from anywhere in our program
 
@@ -37,14 +42,53 @@ namespace
 	std::map<RageTextureID, RageTexture*> m_mapPathToTexture;
 	std::map<RageTextureID, RageTexture*> m_textures_to_update;
 	std::map<RageTexture*, RageTextureID> m_texture_ids_by_pointer;
+
+	/* Textures being prefetched, guarded by m_PrefetchEvent.  An ID stays in
+	 * m_setPrefetching until its texture is created by FinishPrefetches. */
+	struct PrefetchJob
+	{
+		RageTextureID ID;
+		RageBitmapTexture::PrepareCaps caps;
+	};
+	std::deque<PrefetchJob> m_PrefetchQueue;
+	std::vector<std::pair<RageTextureID, RageBitmapTexturePrep *>> m_PrefetchDone;
+	std::set<RageTextureID> m_setPrefetching;
+
+	// Textures referenced by HoldPrefetches.
+	std::set<RageTexture *> m_setHeldPrefetches;
 };
 
+/* The most prefetched texture data to upload each frame.  At 60 FPS, this is
+ * about 120 MB a second, which is plenty for banners and jackets, and small
+ * enough not to cause a skip. */
+static const int TEXTURE_UPLOAD_BYTES_PER_FRAME = 2*1024*1024;
+
 RageTextureManager::RageTextureManager():
 	m_iNoWarnAboutOddDimensions(0),
-	m_TexturePolicy(RageTextureID::TEX_DEFAULT) {}
+	m_TexturePolicy(RageTextureID::TEX_DEFAULT),
+	m_PrefetchEvent("TexturePrefetch"), m_bShutdown(false), m_bHoldPrefetches(false),
+	m_pLoadLog(nullptr)
+{
+	m_PrefetchThread.SetName( "Texture prefetch" );
+	m_PrefetchThread.Create( StartPrefetch, this );
+}
 
 RageTextureManager::~RageTextureManager()
 {
+	{
+		LockMut( m_PrefetchEvent );
+		m_bShutdown = true;
+		m_PrefetchQueue.clear();
+		m_PrefetchEvent.Broadcast();
+	}
+	m_PrefetchThread.Wait();
+
+	for( std::pair<RageTextureID, RageBitmapTexturePrep *> &done : m_PrefetchDone )
+		RageBitmapTexture::DeletePrep( done.second );
+	m_PrefetchDone.clear();
+	m_setPrefetching.clear();
+	ReleasePrefetches();
+
 	for (std::pair<RageTextureID const &, RageTexture *> i : m_mapPathToTexture)
 	{
 		RageTexture* pTexture = i.second;
@@ -58,6 +102,12 @@ RageTextureManager::~RageTextureManager()
 
 void RageTextureManager::Update( float fDeltaTime )
 {
+	FinishPrefetches();
+	{
+		PROFILE_SCOPE( "Texture uploads" );
+		DISPLAY->UploadPendingTextures( TEXTURE_UPLOAD_BYTES_PER_FRAME );
+	}
+
 	for(std::pair<RageTextureID const &, RageTexture *> i : m_textures_to_update)
 	{
 		RageTexture* pTexture = i.second;
@@ -146,13 +196,19 @@ RageTexture* RageTextureManager::LoadTextureInternal( RageTextureID ID )
 
 	AdjustTextureID(ID);
 
+	if( m_pLoadLog != nullptr )
+		m_pLoadLog->push_back( ID );
+
 	/* We could have two copies of the same bitmap if there are equivalent but
 	 * different paths, e.g. "Bitmaps\me.bmp" and "..\Rage PC Edition\Bitmaps\me.bmp". */
 	std::map<RageTextureID, RageTexture*>::iterator p = m_mapPathToTexture.find(ID);
 	if( p != m_mapPathToTexture.end() )
 	{
-		/* Found the texture.  Just increase the refcount and return it. */
+		/* Found the texture.  Just increase the refcount and return it.  If
+		 * it's still being uploaded, finish it now, since it's about to be used. */
 		RageTexture* pTexture = p->second;
+		if( pTexture->IsPending() )
+			pTexture->FinishPending();
 		pTexture->m_iRefCount++;
 		return pTexture;
 	}
@@ -170,7 +226,16 @@ RageTexture* RageTextureManager::LoadTextureInternal( RageTextureID ID )
 	}
 	else
 	{
-		pTexture = new RageBitmapTexture( ID );
+		RageBitmapTexturePrep *pPrep;
+		if( TakePrefetch(ID, pPrep) )
+		{
+			pTexture = new RageBitmapTexture( ID, pPrep );
+			pTexture->FinishPending();
+		}
+		else
+		{
+			pTexture = new RageBitmapTexture( ID );
+		}
 	}
 
 	m_mapPathToTexture[ID] = pTexture;
@@ -188,6 +253,155 @@ RageTexture* RageTextureManager::LoadTexture( RageTextureID ID )
 	return pTexture;
 }
 
+bool RageTextureManager::PrefetchTexture( RageTextureID ID )
+{
+	AdjustTextureID( ID );
+
+	if( ID.filename == g_sDefaultTextureName || ID.filename == g_ScreenTextureName ||
+		ActorUtil::GetFileType(ID.filename) != FT_Bitmap )
+		return false;
+
+	std::map<RageTextureID, RageTexture*>::const_iterator p = m_mapPathToTexture.find( ID );
+	if( p != m_mapPathToTexture.end() )
+	{
+		HoldPrefetch( p->second );
+		return true;
+	}
+
+	LockMut( m_PrefetchEvent );
+	if( m_setPrefetching.insert(ID).second )
+	{
+		PrefetchJob job;
+		job.ID = ID;
+		RageBitmapTexture::GetPrepareCaps( job.caps );
+		m_PrefetchQueue.push_back( job );
+		m_PrefetchEvent.Broadcast();
+	}
+	return true;
+}
+
+bool RageTextureManager::IsTexturePending( RageTextureID ID ) const
+{
+	AdjustTextureID( ID );
+
+	/* A texture loaded while it was being prefetched is done, even though its
+	 * prefetch hasn't been thrown away yet. */
+	std::map<RageTextureID, RageTexture*>::const_iterator p = m_mapPathToTexture.find( ID );
+	if( p != m_mapPathToTexture.end() )
+		return p->second->IsPending();
+
+	LockMut( m_PrefetchEvent );
+	return m_setPrefetching.find(ID) != m_setPrefetching.end();
+}
+
+/* Create textures for images the prefetch thread has finished loading.  Their
+ * pixels are uploaded over the next few frames. */
+void RageTextureManager::FinishPrefetches()
+{
+	std::vector<std::pair<RageTextureID, RageBitmapTexturePrep *>> vDone;
+	{
+		LockMut( m_PrefetchEvent );
+		vDone.swap( m_PrefetchDone );
+		for( std::pair<RageTextureID, RageBitmapTexturePrep *> &done : vDone )
+			m_setPrefetching.erase( done.first );
+	}
+
+	for( std::pair<RageTextureID, RageBitmapTexturePrep *> &done : vDone )
+	{
+		/* If it was loaded normally in the meantime, keep that one. */
+		if( m_mapPathToTexture.find(done.first) != m_mapPathToTexture.end() )
+		{
+			RageBitmapTexture::DeletePrep( done.second );
+			continue;
+		}
+
+		RageTexture *pTexture = new RageBitmapTexture( done.first, done.second );
+
+		/* Nobody is using it yet; it's freed like any other unused texture. */
+		pTexture->m_iRefCount = 0;
+		m_mapPathToTexture[done.first] = pTexture;
+		m_texture_ids_by_pointer[pTexture] = done.first;
+		HoldPrefetch( pTexture );
+	}
+}
+
+void RageTextureManager::HoldPrefetch( RageTexture *pTexture )
+{
+	if( m_bHoldPrefetches && m_setHeldPrefetches.insert(pTexture).second )
+		++pTexture->m_iRefCount;
+}
+
+/* Drop the references taken since HoldPrefetches.  Textures that still aren't
+ * used are freed like any other unreferenced texture. */
+void RageTextureManager::ReleasePrefetches()
+{
+	m_bHoldPrefetches = false;
+
+	std::set<RageTexture *> setHeld;
+	setHeld.swap( m_setHeldPrefetches );
+	for( RageTexture *pTexture : setHeld )
+		UnloadTexture( pTexture );
+}
+
+/* If ID has already been prefetched, take the image, so it isn't loaded
+ * twice.  If it's still queued, drop it; loading it now is quicker than
+ * waiting for the textures ahead of it.  Don't wait for one that's being
+ * loaded, since the caller is often running Lua and mustn't block on another
+ * thread while holding the Lua lock; load it again instead.  It stays in
+ * m_setPrefetching, and FinishPrefetches throws the late image away. */
+bool RageTextureManager::TakePrefetch( const RageTextureID &ID, RageBitmapTexturePrep *&pPrepOut )
+{
+	LockMut( m_PrefetchEvent );
+	if( m_setPrefetching.find(ID) == m_setPrefetching.end() )
+		return false;
+
+	for( std::deque<PrefetchJob>::iterator it = m_PrefetchQueue.begin(); it != m_PrefetchQueue.end(); ++it )
+	{
+		if( it->ID == ID )
+		{
+			m_PrefetchQueue.erase( it );
+			m_setPrefetching.erase( ID );
+			return false;
+		}
+	}
+
+	for( std::size_t i = 0; i < m_PrefetchDone.size(); ++i )
+	{
+		if( m_PrefetchDone[i].first == ID )
+		{
+			pPrepOut = m_PrefetchDone[i].second;
+			m_PrefetchDone.erase( m_PrefetchDone.begin() + i );
+			m_setPrefetching.erase( ID );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void RageTextureManager::PrefetchMain()
+{
+	m_PrefetchEvent.Lock();
+	while( !m_bShutdown )
+	{
+		if( m_PrefetchQueue.empty() )
+		{
+			m_PrefetchEvent.Wait();
+			continue;
+		}
+
+		PrefetchJob job = m_PrefetchQueue.front();
+		m_PrefetchQueue.pop_front();
+		m_PrefetchEvent.Unlock();
+
+		RageBitmapTexturePrep *pPrep = RageBitmapTexture::Prepare( job.ID, job.caps );
+
+		m_PrefetchEvent.Lock();
+		m_PrefetchDone.push_back( std::make_pair(job.ID, pPrep) );
+	}
+	m_PrefetchEvent.Unlock();
+}
+
 RageTexture* RageTextureManager::CopyTexture( RageTexture *pCopy )
 {
 	++pCopy->m_iRefCount;
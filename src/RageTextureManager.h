@@ -5,6 +5,11 @@
 
 #include "RageTexture.h"
 #include "RageSurface.h"
+#include "RageThreads.h"
+
+#include <vector>
+
+struct RageBitmapTexturePrep;
 
 struct RageTextureManagerPrefs
 {
@@ -62,6 +67,21 @@ public:
 
 	void RegisterTextureForUpdating(RageTextureID id, RageTexture* tex);
 
+	/* Load a bitmap texture in a background thread, and upload it over the next
+	 * few frames.  IsTexturePending is true until it's resident; LoadTexture will
+	 * then return it without stalling.  Returns false if the texture can't be
+	 * loaded this way; use LoadTexture. */
+	bool PrefetchTexture( RageTextureID ID );
+	bool IsTexturePending( RageTextureID ID ) const;
+
+	/* Until ReleasePrefetches, hold a reference to each texture prefetched,
+	 * so deleting the old screen doesn't free them before the new one uses them. */
+	void HoldPrefetches() { m_bHoldPrefetches = true; }
+	void ReleasePrefetches();
+
+	/* While set, the ID of every texture loaded is added to pLog. */
+	void SetLoadLog( std::vector<RageTextureID> *pLog ) { m_pLoadLog = pLog; }
+
 	bool SetPrefs( RageTextureManagerPrefs prefs );
 	RageTextureManagerPrefs GetPrefs() { return m_Prefs; };
 
@@ -92,10 +112,23 @@ private:
 	enum GCType { screen_changed, delayed_delete };
 	void GarbageCollect( GCType type );
 	RageTexture* LoadTextureInternal( RageTextureID ID );
+	void FinishPrefetches();
+	bool TakePrefetch( const RageTextureID &ID, RageBitmapTexturePrep *&pPrepOut );
+	void PrefetchMain();
+	void HoldPrefetch( RageTexture *pTexture );
+	static int StartPrefetch( void *p ) { ((RageTextureManager *) p)->PrefetchMain(); return 0; }
 
 	RageTextureManagerPrefs m_Prefs;
 	int m_iNoWarnAboutOddDimensions;
 	RageTextureID::TexPolicy m_TexturePolicy;
+
+	RageThread m_PrefetchThread;
+	/* Guards the prefetch queues; signalled when a texture is queued. */
+	mutable RageEvent m_PrefetchEvent;
+	bool m_bShutdown;
+	bool m_bHoldPrefetches;
+
+	std::vector<RageTextureID> *m_pLoadLog;
 };
 
 extern RageTextureManager*	TEXTUREMAN;	// global and accessible from anywhere in our program
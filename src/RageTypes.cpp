@@ -187,7 +187,8 @@ static const char *EffectModeNames[] =
 
 	"YUYV422",
 	/* Draws a graphic from a signed distance field. */
-	"DistanceField"
+	"DistanceField",
+	"YUV420P"
 };
 XToString( EffectMode );
 LuaXType( EffectMode );
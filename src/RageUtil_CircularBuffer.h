@@ -3,6 +3,8 @@
 #ifndef RAGE_UTIL_CIRCULAR_BUFFER
 #define RAGE_UTIL_CIRCULAR_BUFFER
 
+#include <atomic>
+
 /* Lock-free circular buffer.  This should be threadsafe if one thread is reading
  * and another is writing. */
 template<class T>
@@ -19,8 +21,10 @@ class CircBuf
 	unsigned size;
 	unsigned m_iBlockSize;
 
-	/* These are volatile to prevent reads and writes to them from being optimized. */
-	volatile unsigned read_pos, write_pos;
+	/* Each side publishes its position with a release store, and reads the other
+	 * side's with an acquire load, so the data written before an advance is
+	 * visible to the other thread once it sees the new position. */
+	std::atomic<unsigned> read_pos, write_pos;
 
 public:
 	CircBuf()
@@ -38,8 +42,12 @@ public:
 	{
 		std::swap( size, rhs.size );
 		std::swap( m_iBlockSize, rhs.m_iBlockSize );
-		std::swap( read_pos, rhs.read_pos );
-		std::swap( write_pos, rhs.write_pos );
+		unsigned iReadPos = read_pos;
+		read_pos = rhs.read_pos.load();
+		rhs.read_pos = iReadPos;
+		unsigned iWritePos = write_pos;
+		write_pos = rhs.write_pos.load();
+		rhs.write_pos = iWritePos;
 		std::swap( buf, rhs.buf );
 	}
 
@@ -53,8 +61,8 @@ public:
 	CircBuf( const CircBuf &cpy )
 	{
 		size = cpy.size;
-		read_pos = cpy.read_pos;
-		write_pos = cpy.write_pos;
+		read_pos = cpy.read_pos.load();
+		write_pos = cpy.write_pos.load();
 		m_iBlockSize = cpy.m_iBlockSize;
 		if( size )
 		{
@@ -70,8 +78,8 @@ public:
 	/* Return the number of elements available to read. */
 	unsigned num_readable() const
 	{
-		const int rpos = read_pos;
-		const int wpos = write_pos;
+		const int rpos = read_pos.load( std::memory_order_acquire );
+		const int wpos = write_pos.load( std::memory_order_acquire );
 		if( rpos < wpos )
 			/* The buffer looks like "eeeeDDDDeeee" (e = empty, D = data). */
 			return wpos - rpos;
@@ -86,8 +94,8 @@ public:
 	/* Return the number of writable elements. */
 	unsigned num_writable() const
 	{
-		const int rpos = read_pos;
-		const int wpos = write_pos;
+		const int rpos = read_pos.load( std::memory_order_acquire );
+		const int wpos = write_pos.load( std::memory_order_acquire );
 
 		int ret;
 		if( rpos < wpos )
@@ -138,19 +146,19 @@ public:
 	/* Indicate that n elements have been written. */
 	void advance_write_pointer( int n )
 	{
-		write_pos = (write_pos + n) % size;
+		write_pos.store( (write_pos.load(std::memory_order_relaxed) + n) % size, std::memory_order_release );
 	}
 	
 	/* Indicate that n elements have been read. */
 	void advance_read_pointer( int n )
 	{
-		read_pos = (read_pos + n) % size;
+		read_pos.store( (read_pos.load(std::memory_order_relaxed) + n) % size, std::memory_order_release );
 	}
 	
 	void get_write_pointers( T *pPointers[2], unsigned pSizes[2] )
 	{
-		const int rpos = read_pos;
-		const int wpos = write_pos;
+		const int rpos = read_pos.load( std::memory_order_acquire );
+		const int wpos = write_pos.load( std::memory_order_acquire );
 
 		if( rpos <= wpos )
 		{
@@ -191,8 +199,8 @@ public:
 
 	void get_read_pointers( T *pPointers[2], unsigned pSizes[2] )
 	{
-		const int rpos = read_pos;
-		const int wpos = write_pos;
+		const int rpos = read_pos.load( std::memory_order_acquire );
+		const int wpos = write_pos.load( std::memory_order_acquire );
 
 		if( rpos < wpos )
 		{
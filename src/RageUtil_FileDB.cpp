@@ -4,7 +4,9 @@
 #include "RageUtil.h"
 #include "RageLog.h"
 
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
 
@@ -122,46 +124,414 @@ static void SplitPath( RString sPath, RString &sDir, RString &sName )
 }
 
 
-RageFileManager::FileType FilenameDB::GetFileType( const RString &sPath )
+/* Loading songs, themes and noteskins from several threads at once should
+ * rarely put two of them in the same shard. */
+static const int NUM_SHARDS = 32;
+
+/* Each shard's table starts with this many buckets.  It grows by rebuilding. */
+static const unsigned INITIAL_BUCKETS = 16;
+
+/* A directory's key in the cache: its lowercased path, and a hash of that. */
+struct DirKey
+{
+	RString m_sLower;
+	std::uint64_t m_iHash;
+
+	bool operator==( const DirKey &rhs ) const { return m_iHash == rhs.m_iHash && m_sLower == rhs.m_sLower; }
+};
+
+/* Normalize sDir in place, and make its key. */
+static void MakeDirKey( RString &sDir, DirKey &key )
+{
+	sDir.Replace("\\", "/"); /* foo\bar -> foo/bar */
+	sDir.Replace("//", "/"); /* foo//bar -> foo/bar */
+
+	if( sDir == "" )
+		sDir = "/";
+
+	key.m_sLower = sDir;
+	key.m_sLower.MakeLower();
+
+	/* FNV-1a */
+	std::uint64_t iHash = 14695981039346656037ULL;
+	for( char c: key.m_sLower )
+	{
+		iHash ^= (unsigned char) c;
+		iHash *= 1099511628211ULL;
+	}
+	key.m_iHash = iHash;
+}
+
+/* A cached directory.  Once a node is in a table, only m_pFileSet changes.
+ * Flushing a directory just clears m_pFileSet; the node is dropped the next
+ * time the table is rebuilt. */
+struct DirNode
+{
+	DirNode( const DirKey &key, const FileSet *pFileSet, DirNode *pNext ):
+		m_Key( key ), m_pFileSet( pFileSet ), m_pNext( pNext ) { }
+
+	DirKey m_Key;
+	std::atomic<const FileSet *> m_pFileSet;
+	DirNode *m_pNext;
+};
+
+/* A hash table of directories.  Readers can search it while a writer, holding
+ * the shard's lock, adds to it. */
+struct DirTable
+{
+	DirTable( unsigned iBuckets ):
+		m_vBuckets( iBuckets ), m_iNodes( 0 )
+	{
+		for( std::atomic<DirNode *> &pBucket: m_vBuckets )
+			pBucket.store( nullptr, std::memory_order_relaxed );
+	}
+
+	~DirTable()
+	{
+		for( std::atomic<DirNode *> &pBucket: m_vBuckets )
+		{
+			DirNode *pNode = pBucket.load( std::memory_order_relaxed );
+			while( pNode != nullptr )
+			{
+				DirNode *pNext = pNode->m_pNext;
+				delete pNode;
+				pNode = pNext;
+			}
+		}
+	}
+
+	DirNode *Find( const DirKey &key )
+	{
+		DirNode *pNode = m_vBuckets[key.m_iHash % m_vBuckets.size()].load( std::memory_order_acquire );
+		for( ; pNode != nullptr; pNode = pNode->m_pNext )
+		{
+			if( pNode->m_Key == key )
+				return pNode;
+		}
+		return nullptr;
+	}
+
+	void Add( const DirKey &key, const FileSet *pFileSet )
+	{
+		std::atomic<DirNode *> &pBucket = m_vBuckets[key.m_iHash % m_vBuckets.size()];
+		DirNode *pNode = new DirNode( key, pFileSet, pBucket.load(std::memory_order_relaxed) );
+		pBucket.store( pNode, std::memory_order_release );
+		++m_iNodes;
+	}
+
+	bool IsFull() const { return m_iNodes >= m_vBuckets.size() * 2; }
+
+	/* Make a new table of the directories that are still cached, sized for them. */
+	DirTable *Rebuild() const
+	{
+		std::vector<const DirNode *> vpLive;
+		for( const std::atomic<DirNode *> &pBucket: m_vBuckets )
+		{
+			for( const DirNode *pNode = pBucket.load(std::memory_order_relaxed); pNode != nullptr; pNode = pNode->m_pNext )
+			{
+				if( pNode->m_pFileSet.load(std::memory_order_relaxed) != nullptr )
+					vpLive.push_back( pNode );
+			}
+		}
+
+		unsigned iBuckets = INITIAL_BUCKETS;
+		while( iBuckets < vpLive.size() )
+			iBuckets *= 2;
+
+		DirTable *pRet = new DirTable( iBuckets );
+		for( const DirNode *pNode: vpLive )
+			pRet->Add( pNode->m_Key, pNode->m_pFileSet.load(std::memory_order_relaxed) );
+		return pRet;
+	}
+
+	std::vector<std::atomic<DirNode *>> m_vBuckets;
+	unsigned m_iNodes; /* including flushed ones */
+};
+
+struct FilenameDBShard
+{
+	FilenameDBShard():
+		m_Lock( "FilenameDB" ), m_pTable( new DirTable(INITIAL_BUCKETS) ),
+		m_iReaders( 0 ), m_bRetired( false ), m_iFlushes( 0 ) { }
+
+	/* Held to change the shard.  It's broadcast when a directory has been read in. */
+	RageEvent m_Lock;
+
+	/* Replaced when the table is rebuilt, and when the cache is flushed. */
+	std::atomic<DirTable *> m_pTable;
+
+	/* The number of threads reading the shard.  FileSets and tables taken out
+	 * of it are only freed when this is zero. */
+	std::atomic<int> m_iReaders;
+	std::atomic<bool> m_bRetired;
+
+	/* The rest is protected by m_Lock. */
+	std::set<RString> m_setFilling; /* lowercased directories being read in */
+	int m_iFlushes;
+	std::vector<const FileSet *> m_vpRetiredFileSets;
+	std::vector<DirTable *> m_vpRetiredTables;
+};
+
+/*
+ * Readers count themselves in m_iReaders, then load the table and FileSet
+ * pointers; writers store new pointers, then check m_iReaders before freeing
+ * the old ones.  Both sides have to be seq_cst for that to work: a writer that
+ * sees no readers knows that any reader that starts later sees its changes.
+ */
+static DirTable *BeginRead( FilenameDBShard &s )
+{
+	s.m_iReaders.fetch_add( 1 );
+	return s.m_pTable.load();
+}
+
+/* Free what's been taken out of the shard, if nobody is reading it.  m_Lock
+ * must be held. */
+static void Reclaim( FilenameDBShard &s )
+{
+	if( !s.m_bRetired.load(std::memory_order_relaxed) || s.m_iReaders.load() != 0 )
+		return;
+
+	for( const FileSet *pFileSet: s.m_vpRetiredFileSets )
+		delete pFileSet;
+	for( DirTable *pTable: s.m_vpRetiredTables )
+		delete pTable;
+	s.m_vpRetiredFileSets.clear();
+	s.m_vpRetiredTables.clear();
+	s.m_bRetired.store( false, std::memory_order_relaxed );
+}
+
+/* Point key at pFileSet, or remove it if pFileSet is nullptr, and retire the
+ * FileSet it pointed at.  m_Lock must be held. */
+static void SetFileSet( FilenameDBShard &s, const DirKey &key, const FileSet *pFileSet )
+{
+	DirTable *pTable = s.m_pTable.load( std::memory_order_relaxed );
+	DirNode *pNode = pTable->Find( key );
+	if( pNode != nullptr )
+	{
+		const FileSet *pOld = pNode->m_pFileSet.exchange( pFileSet );
+		if( pOld != nullptr )
+		{
+			s.m_vpRetiredFileSets.push_back( pOld );
+			s.m_bRetired.store( true, std::memory_order_relaxed );
+		}
+		return;
+	}
+
+	if( pFileSet == nullptr )
+		return;
+
+	if( pTable->IsFull() )
+	{
+		DirTable *pNew = pTable->Rebuild();
+		s.m_pTable.store( pNew );
+		s.m_vpRetiredTables.push_back( pTable );
+		s.m_bRetired.store( true, std::memory_order_relaxed );
+		pTable = pNew;
+	}
+	pTable->Add( key, pFileSet );
+}
+
+FilenameDB::FilenameDB():
+	ExpireSeconds( -1 )
+{
+	m_pShards = new FilenameDBShard[NUM_SHARDS];
+}
+
+FilenameDB::~FilenameDB()
+{
+	FlushDirCache();
+
+	for( int i = 0; i < NUM_SHARDS; ++i )
+	{
+		FilenameDBShard &s = m_pShards[i];
+		ASSERT( s.m_iReaders.load() == 0 );
+		Reclaim( s );
+		delete s.m_pTable.load();
+	}
+	delete [] m_pShards;
+}
+
+FilenameDBShard &FilenameDB::GetShard( const DirKey &key, int &iShard ) const
+{
+	/* Use the high bits, so the shard doesn't decide the bucket. */
+	iShard = int( (key.m_iHash >> 32) % NUM_SHARDS );
+	return m_pShards[iShard];
+}
+
+bool FilenameDB::IsExpired( const FileSet &fs ) const
+{
+	return ExpireSeconds != -1 && fs.age.PeekDeltaTime() >= ExpireSeconds;
+}
+
+/* Look up a directory without taking any lock.  Only if it isn't cached do we
+ * lock its shard, to read it in. */
+const FileSet *FilenameDB::GetFileSet( const RString &sDir_, int &iShard )
+{
+	RString sDir = sDir_;
+	DirKey key;
+	MakeDirKey( sDir, key );
+	FilenameDBShard &s = GetShard( key, iShard );
+
+	for(;;)
+	{
+		DirNode *pNode = BeginRead( s )->Find( key );
+		const FileSet *pFileSet = pNode? pNode->m_pFileSet.load():nullptr;
+		if( pFileSet != nullptr && !IsExpired(*pFileSet) )
+			return pFileSet;
+		EndRead( iShard );
+
+		FillFileSet( s, key, sDir );
+	}
+}
+
+void FilenameDB::EndRead( int iShard )
+{
+	FilenameDBShard &s = m_pShards[iShard];
+
+	/* If we were the last reader, free anything that was waiting on us, unless
+	 * a writer has the shard; it'll do it. */
+	if( s.m_iReaders.fetch_sub(1) == 1 && s.m_bRetired.load(std::memory_order_relaxed) && s.m_Lock.TryLock() )
+	{
+		Reclaim( s );
+		s.m_Lock.Unlock();
+	}
+}
+
+/* sDir isn't cached, or has expired.  Read it in, or if another thread is
+ * already doing that, wait for it.  Either way, the caller looks it up again. */
+void FilenameDB::FillFileSet( FilenameDBShard &s, const DirKey &key, const RString &sDir )
+{
+	s.m_Lock.Lock();
+
+	DirNode *pNode = s.m_pTable.load( std::memory_order_relaxed )->Find( key );
+	const FileSet *pOld = pNode? pNode->m_pFileSet.load(std::memory_order_relaxed):nullptr;
+	if( pOld != nullptr && !IsExpired(*pOld) )
+	{
+		/* Someone else read it in since we looked. */
+		s.m_Lock.Unlock();
+		return;
+	}
+
+	if( s.m_setFilling.find(key.m_sLower) != s.m_setFilling.end() )
+	{
+		s.m_Lock.Wait();
+		s.m_Lock.Unlock();
+		return;
+	}
+
+	s.m_setFilling.insert( key.m_sLower );
+	const int iFlushes = s.m_iFlushes;
+
+	/* Unlock while we populate the directory.  This can take a while, and it
+	 * shouldn't hold up changes to other directories in the shard. */
+	s.m_Lock.Unlock();
+	FileSet *pNew = new FileSet;
+	PopulateFileSet( *pNew, sDir );
+	pNew->age.Touch();
+
+	s.m_Lock.Lock();
+	s.m_setFilling.erase( key.m_sLower );
+
+	/* If the cache was flushed while we were reading, what we read may already
+	 * be out of date.  Throw it away, and let the caller read it again. */
+	if( s.m_iFlushes == iFlushes )
+		SetFileSet( s, key, pNew );
+	else
+		delete pNew;
+
+	/* Wake up any other threads waiting for this directory. */
+	s.m_Lock.Broadcast();
+	Reclaim( s );
+	s.m_Lock.Unlock();
+}
+
+void FilenameDB::ChangeFileSet( const RString &sDir_, bool bCreate, const std::function<void(FileSet &)> &fn )
+{
+	RString sDir = sDir_;
+	DirKey key;
+	MakeDirKey( sDir, key );
+	int iShard;
+	FilenameDBShard &s = GetShard( key, iShard );
+
+	for(;;)
+	{
+		if( bCreate )
+		{
+			GetFileSet( sDir, iShard );
+			EndRead( iShard );
+		}
+
+		s.m_Lock.Lock();
+
+		/* If it's being read in, the change would be lost; wait for it. */
+		while( s.m_setFilling.find(key.m_sLower) != s.m_setFilling.end() )
+			s.m_Lock.Wait();
+
+		DirNode *pNode = s.m_pTable.load( std::memory_order_relaxed )->Find( key );
+		const FileSet *pOld = pNode? pNode->m_pFileSet.load(std::memory_order_relaxed):nullptr;
+		if( pOld == nullptr )
+		{
+			/* It isn't cached, or was flushed since we read it in. */
+			s.m_Lock.Unlock();
+			if( !bCreate )
+				return;
+			continue;
+		}
+
+		FileSet *pNew = new FileSet( *pOld );
+		fn( *pNew );
+		SetFileSet( s, key, pNew );
+		Reclaim( s );
+		s.m_Lock.Unlock();
+		return;
+	}
+}
+
+void FilenameDB::UpdateCachedFile( const RString &sDir, const File &f )
 {
-	ASSERT( !m_Mutex.IsLockedByThisThread() );
+	ChangeFileSet( sDir, false, [&]( FileSet &fs ) {
+		fs.files.erase( f );
+		fs.files.insert( f );
+	} );
+}
 
+RageFileManager::FileType FilenameDB::GetFileType( const RString &sPath )
+{
 	RString sDir, sName;
 	SplitPath( sPath, sDir, sName );
 
 	if( sName == "/" )
 		return RageFileManager::TYPE_DIR;
 
-	const FileSet *fs = GetFileSet( sDir );
+	int iShard;
+	const FileSet *fs = GetFileSet( sDir, iShard );
 	RageFileManager::FileType ret = fs->GetFileType( sName );
-	m_Mutex.Unlock(); /* locked by GetFileSet */
+	EndRead( iShard ); /* started by GetFileSet */
 	return ret;
 }
 
 
 int FilenameDB::GetFileSize( const RString &sPath )
 {
-	ASSERT( !m_Mutex.IsLockedByThisThread() );
-
 	RString sDir, sName;
 	SplitPath( sPath, sDir, sName );
 
-	const FileSet *fs = GetFileSet( sDir );
+	int iShard;
+	const FileSet *fs = GetFileSet( sDir, iShard );
 	int ret = fs->GetFileSize( sName );
-	m_Mutex.Unlock(); /* locked by GetFileSet */
+	EndRead( iShard ); /* started by GetFileSet */
 	return ret;
 }
 
 int FilenameDB::GetFileHash( const RString &sPath )
 {
-	ASSERT( !m_Mutex.IsLockedByThisThread() );
-
 	RString sDir, sName;
 	SplitPath( sPath, sDir, sName );
 
-	const FileSet *fs = GetFileSet( sDir );
+	int iShard;
+	const FileSet *fs = GetFileSet( sDir, iShard );
 	int ret = fs->GetFileHash( sName );
-	m_Mutex.Unlock(); /* locked by GetFileSet */
+	EndRead( iShard ); /* started by GetFileSet */
 	return ret;
 }
 
@@ -176,7 +546,6 @@ bool FilenameDB::ResolvePath( RString &sPath )
 
 	/* Resolve each component. */
 	RString ret = "";
-	const FileSet *fs = nullptr;
 
 	static const RString slash("/");
 	for(;;)
@@ -185,28 +554,23 @@ bool FilenameDB::ResolvePath( RString &sPath )
 		if( iBegin == (int) sPath.size() )
 			break;
 
-		if( fs == nullptr )
-			fs = GetFileSet( ret );
-		else
-			m_Mutex.Lock(); /* for access to fs */
-
 		RString p = sPath.substr( iBegin, iSize );
 		ASSERT_M( p.size() != 1 || p[0] != '.', sPath ); // no .
 		ASSERT_M( p.size() != 2 || p[0] != '.' || p[1] != '.', sPath ); // no ..
+
+		int iShard;
+		const FileSet *fs = GetFileSet( ret + "/", iShard );
 		std::set<File>::const_iterator it = fs->files.find( File(p) );
 
 		/* If there were no matches, the path isn't found. */
 		if( it == fs->files.end() )
 		{
-			m_Mutex.Unlock(); /* locked by GetFileSet */
+			EndRead( iShard ); /* started by GetFileSet */
 			return false;
 		}
 
 		ret += "/" + it->name;
-
-		fs = it->dirp;
-
-		m_Mutex.Unlock(); /* locked by GetFileSet */
+		EndRead( iShard ); /* started by GetFileSet */
 	}
 
 	if( sPath.size() && sPath[sPath.size()-1] == '/' )
@@ -218,20 +582,18 @@ bool FilenameDB::ResolvePath( RString &sPath )
 
 void FilenameDB::GetFilesMatching( const RString &sDir, const RString &sBeginning, const RString &sContaining, const RString &sEnding, std::vector<RString> &asOut, bool bOnlyDirs )
 {
-	ASSERT( !m_Mutex.IsLockedByThisThread() );
-
-	const FileSet *fs = GetFileSet( sDir );
+	int iShard;
+	const FileSet *fs = GetFileSet( sDir, iShard );
 	fs->GetFilesMatching( sBeginning, sContaining, sEnding, asOut, bOnlyDirs );
-	m_Mutex.Unlock(); /* locked by GetFileSet */
+	EndRead( iShard ); /* started by GetFileSet */
 }
 
 void FilenameDB::GetFilesEqualTo( const RString &sDir, const RString &sFile, std::vector<RString> &asOut, bool bOnlyDirs )
 {
-	ASSERT( !m_Mutex.IsLockedByThisThread() );
-
-	const FileSet *fs = GetFileSet( sDir );
+	int iShard;
+	const FileSet *fs = GetFileSet( sDir, iShard );
 	fs->GetFilesEqualTo( sFile, asOut, bOnlyDirs );
-	m_Mutex.Unlock(); /* locked by GetFileSet */
+	EndRead( iShard ); /* started by GetFileSet */
 }
 
 
@@ -261,124 +623,6 @@ void FilenameDB::GetFilesSimpleMatch( const RString &sDir, const RString &sMask,
 		sMask.substr(second_pos+1), asOut, bOnlyDirs );
 }
 
-/*
- * Get the FileSet for dir; if create is true, create the FileSet if necessary.
- *
- * We want to unlock the object while we populate FileSets, so m_Mutex should not
- * be locked when this is called.  It will be locked on return; the caller must
- * unlock it.
- */
-FileSet *FilenameDB::GetFileSet( const RString &sDir_, bool bCreate )
-{
-	RString sDir = sDir_;
-
-	/* Creating can take a long time; don't hold the lock if we might do that. */
-	if( bCreate && m_Mutex.IsLockedByThisThread() && LOG )
-		LOG->Warn( "FilenameDB::GetFileSet: m_Mutex was locked" );
-
-	/* Normalize the path. */
-	sDir.Replace("\\", "/"); /* foo\bar -> foo/bar */
-	sDir.Replace("//", "/"); /* foo//bar -> foo/bar */
-
-	if( sDir == "" )
-		sDir = "/";
-
-	RString sLower = sDir;
-	sLower.MakeLower();
-
-	m_Mutex.Lock();
-
-	for(;;)
-	{
-		/* Look for the directory. */
-		std::map<RString, FileSet*>::iterator i = dirs.find( sLower );
-		if( !bCreate )
-		{
-			if( i == dirs.end() )
-				return nullptr;
-			return i->second;
-		}
-
-		/* We're allowed to create.  If the directory wasn't found, break out and
-		 * create it. */
-		if( i == dirs.end() )
-			break;
-
-		/* This directory already exists.  If it's still being filled in by another
-		 * thread, wait for it. */
-		FileSet *pFileSet = i->second;
-		if( !pFileSet->m_bFilled )
-		{
-			m_Mutex.Wait();
-
-			/* Beware: when we unlock m_Mutex to wait for it to finish filling,
-			 * we give up our claim to dirs, so i may be invalid.  Start over
-			 * and re-search. */
-			continue;
-		}
-
-		if( ExpireSeconds == -1 || pFileSet->age.PeekDeltaTime() < ExpireSeconds )
-		{
-			/* Found it, and it hasn't expired. */
-			return pFileSet;
-		}
-
-		/* It's expired.  Delete the old entry. */
-		this->DelFileSet( i );
-		break;
-	}
-
-	/* Create the FileSet and insert it.  Set it to !m_bFilled, so if other threads
-	 * happen to try to use this directory before we finish filling it, they'll wait. */
-	FileSet *pRet = new FileSet;
-	pRet->m_bFilled = false;
-	dirs[sLower] = pRet;
-
-	/* Unlock while we populate the directory.  This way, reads to other directories
-	 * won't block if this takes a while. */
-	m_Mutex.Unlock();
-	ASSERT( !m_Mutex.IsLockedByThisThread() );
-	PopulateFileSet( *pRet, sDir );
-
-	/* If this isn't the root directory, we want to set the dirp pointer of our parent
-	 * to the newly-created directory.  Find the pointer we need to set.  Be careful of
-	 * order of operations, here: since we just unlocked, any this->dirs searches we did
-	 * previously are no longer valid. */
-	FileSet **pParentDirp = nullptr;
-	if( sDir != "/" )
-	{
-		RString sParent = Dirname( sDir );
-		if( sParent == "./" )
-			sParent = "";
-
-		/* This also re-locks m_Mutex for us. */
-		FileSet *pParent = GetFileSet( sParent );
-		if( pParent != nullptr )
-		{
-			std::set<File>::iterator it = pParent->files.find( File(Basename(sDir)) );
-			if( it != pParent->files.end() )
-				pParentDirp = const_cast<FileSet **>(&it->dirp);
-		}
-	}
-	else
-	{
-		m_Mutex.Lock();
-	}
-
-	if( pParentDirp != nullptr )
-		*pParentDirp = pRet;
-
-	pRet->age.Touch();
-	pRet->m_bFilled = true;
-
-	/* Signal the event, to wake up any other threads that might be waiting for this
-	 * directory.  Leave the mutex locked; those threads will wake up when the current
-	 * operation completes. */
-	m_Mutex.Broadcast();
-
-	return pRet;
-}
-
 /* Add the file or directory "sPath".  sPath is a directory if it ends with
  * a slash. */
 void FilenameDB::AddFile( const RString &sPath_, int iSize, int iHash, void *pPriv )
@@ -413,160 +657,80 @@ void FilenameDB::AddFile( const RString &sPath_, int iSize, int iHash, void *pPr
 		if( dir != "/" )
 			dir += "/";
 		const RString &fn = *(end-1);
-		FileSet *fs = GetFileSet( dir );
-		ASSERT( m_Mutex.IsLockedByThisThread() );
-
-		// const_cast to cast away the constness that is only needed for the name
-		File &f = const_cast<File&>(*fs->files.insert( fn ).first);
-		f.dir = IsDir;
-		if( !IsDir )
-		{
-			f.size = iSize;
-			f.hash = iHash;
-			f.priv = pPriv;
-		}
-		m_Mutex.Unlock(); /* locked by GetFileSet */
+		ChangeFileSet( dir, true, [&]( FileSet &fs ) {
+			// const_cast to cast away the constness that is only needed for the name
+			File &f = const_cast<File&>(*fs.files.insert( fn ).first);
+			f.dir = IsDir;
+			if( !IsDir )
+			{
+				f.size = iSize;
+				f.hash = iHash;
+				f.priv = pPriv;
+			}
+		} );
 		IsDir = true;
 
 		--end;
 	} while( begin != end );
 }
 
-/* Remove the given FileSet, and all dirp pointers to it.  This means the cache has
- * expired, not that the directory is necessarily gone; don't actually delete the file
- * from the parent. */
-void FilenameDB::DelFileSet( std::map<RString, FileSet*>::iterator dir )
-{
-	/* If this isn't locked, dir may not be valid. */
-	ASSERT( m_Mutex.IsLockedByThisThread() );
-
-	if( dir == dirs.end() )
-		return;
-
-	FileSet *fs = dir->second;
-
-	/* Remove any stale dirp pointers. */
-	for( std::map<RString, FileSet*>::iterator it = dirs.begin(); it != dirs.end(); ++it )
-	{
-		FileSet *Clean = it->second;
-		for( std::set<File>::iterator f = Clean->files.begin(); f != Clean->files.end(); ++f )
-		{
-			File &ff = (File &) *f;
-			if( ff.dirp == fs )
-				ff.dirp = nullptr;
-		}
-	}
-
-	delete fs;
-	dirs.erase( dir );
-}
-
 void FilenameDB::DelFile( const RString &sPath )
 {
-	LockMut(m_Mutex);
-	RString lower = sPath;
-	lower.MakeLower();
-
-	std::map<RString, FileSet*>::iterator fsi = dirs.find( lower );
-	DelFileSet( fsi );
+	/* If it's a directory, forget its contents. */
+	FlushDir( sPath );
 
 	/* Delete sPath from its parent. */
 	RString Dir, Name;
 	SplitPath(sPath, Dir, Name);
-	FileSet *Parent = GetFileSet( Dir, false );
-	if( Parent )
-		Parent->files.erase( Name );
-
-	m_Mutex.Unlock(); /* locked by GetFileSet */
+	ChangeFileSet( Dir, false, [&]( FileSet &fs ) {
+		fs.files.erase( Name );
+	} );
 }
 
 void FilenameDB::FlushDirCache( const RString & /* sDir */ )
 {
-	FileSet *pFileSet = nullptr;
-	m_Mutex.Lock();
-
-	for(;;)
+	/* XXX: We could flush just sDir and its subdirectories, but they're spread
+	 * over every shard, so it wouldn't save much over FlushDir on each. */
+	for( int i = 0; i < NUM_SHARDS; ++i )
 	{
-		if( dirs.empty() )
-			break;
+		FilenameDBShard &s = m_pShards[i];
+		LockMut( s.m_Lock );
 
-		/* Grab the first entry.  Take it out of the list while we hold the
-		 * lock, to guarantee that we own it. */
-		pFileSet = dirs.begin()->second;
+		/* Directories being read in right now will be thrown away when they
+		 * finish, rather than landing in the flushed cache. */
+		++s.m_iFlushes;
 
-		dirs.erase( dirs.begin() );
-
-		/* If it's being filled, we don't really own it until it's finished being
-		 * filled, so wait. */
-		while( !pFileSet->m_bFilled )
-			m_Mutex.Wait();
-		delete pFileSet;
-	}
-
-#if 0
-	/* XXX: This is tricky, we want to flush all of the subdirectories of
-	 * sDir, but once we unlock the mutex, we basically have to start over.
-	 * It's just an optimization though, so it can wait. */
-	{
-		if( it != dirs.end() )
+		DirTable *pTable = s.m_pTable.load( std::memory_order_relaxed );
+		for( std::atomic<DirNode *> &pBucket: pTable->m_vBuckets )
 		{
-			pFileSet = it->second;
-			dirs.erase( it );
-			while( !pFileSet->m_bFilled )
-				m_Mutex.Wait();
-			delete pFileSet;
-
-			if( sDir != "/" )
+			for( DirNode *pNode = pBucket.load(std::memory_order_relaxed); pNode != nullptr; pNode = pNode->m_pNext )
 			{
-				RString sParent = Dirname( sDir );
-				if( sParent == "./" )
-					sParent = "";
-				sParent.MakeLower();
-				it = dirs.find( sParent );
-				if( it != dirs.end() )
-				{
-					FileSet *pParent = it->second;
-					std::set<File>::iterator fileit = pParent->files.find( File(Basename(sDir)) );
-					if( fileit != pParent->files.end() )
-						fileit->dirp = nullptr;
-				}
+				const FileSet *pFileSet = pNode->m_pFileSet.load( std::memory_order_relaxed );
+				if( pFileSet != nullptr )
+					s.m_vpRetiredFileSets.push_back( pFileSet );
 			}
 		}
-		else
-		{
-			LOG->Warn( "Trying to flush an unknown directory %s.", sDir.c_str() );
-		}
-#endif
-		m_Mutex.Unlock();
-}
-
-const File *FilenameDB::GetFile( const RString &sPath )
-{
-	if( m_Mutex.IsLockedByThisThread() && LOG )
-		LOG->Warn( "FilenameDB::GetFile: m_Mutex was locked" );
 
-	RString Dir, Name;
-	SplitPath(sPath, Dir, Name);
-	FileSet *fs = GetFileSet( Dir );
-
-	std::set<File>::iterator it;
-	it = fs->files.find( File(Name) );
-	if( it == fs->files.end() )
-		return nullptr;
-
-	return &*it;
+		s.m_pTable.store( new DirTable(INITIAL_BUCKETS) );
+		s.m_vpRetiredTables.push_back( pTable );
+		s.m_bRetired.store( true, std::memory_order_relaxed );
+		Reclaim( s );
+	}
 }
 
 void *FilenameDB::GetFilePriv( const RString &path )
 {
-	ASSERT( !m_Mutex.IsLockedByThisThread() );
+	RString Dir, Name;
+	SplitPath(path, Dir, Name);
 
-	const File *pFile = GetFile( path );
+	int iShard;
+	const FileSet *fs = GetFileSet( Dir, iShard );
+	std::set<File>::const_iterator it = fs->files.find( File(Name) );
 	void *pRet = nullptr;
-	if( pFile != nullptr )
-		pRet = pFile->priv;
+	if( it != fs->files.end() )
+		pRet = it->priv;
 
-	m_Mutex.Unlock(); /* locked by GetFileSet */
+	EndRead( iShard ); /* started by GetFileSet */
 	return pRet;
 }
 
@@ -610,14 +774,67 @@ void FilenameDB::GetDirListing( const RString &sPath_, std::vector<RString> &asA
 	}
 }
 
+void FilenameDB::FlushDir( const RString &sDir_, bool bRecursive )
+{
+	RString sDir = sDir_;
+	sDir.Replace( "\\", "/" );
+	sDir.Replace( "//", "/" );
+	if( sDir.Right(1) != "/" )
+		sDir += "/";
+
+	DirKey key;
+	MakeDirKey( sDir, key );
+
+	if( bRecursive )
+	{
+		/* A subdirectory can be cached without its parent, and could be in
+		 * any shard, so look for everything under sDir in all of them. */
+		for( int i = 0; i < NUM_SHARDS; ++i )
+		{
+			FilenameDBShard &s = m_pShards[i];
+			LockMut( s.m_Lock );
+
+			/* Directories being read in right now will be thrown away when
+			 * they finish, like FlushDirCache. */
+			++s.m_iFlushes;
+
+			DirTable *pTable = s.m_pTable.load( std::memory_order_relaxed );
+			for( std::atomic<DirNode *> &pBucket: pTable->m_vBuckets )
+			{
+				for( DirNode *pNode = pBucket.load(std::memory_order_relaxed); pNode != nullptr; pNode = pNode->m_pNext )
+				{
+					if( BeginsWith(pNode->m_Key.m_sLower, key.m_sLower) )
+						SetFileSet( s, pNode->m_Key, nullptr );
+				}
+			}
+			Reclaim( s );
+		}
+		return;
+	}
+
+	int iShard;
+	FilenameDBShard &s = GetShard( key, iShard );
+
+	LockMut( s.m_Lock );
+
+	/* If it's being read in, wait for it, so what was read doesn't land in the
+	 * cache after we've flushed it. */
+	while( s.m_setFilling.find(key.m_sLower) != s.m_setFilling.end() )
+		s.m_Lock.Wait();
+
+	SetFileSet( s, key, nullptr );
+	Reclaim( s );
+}
+
 /* Get a complete copy of a FileSet.  This isn't very efficient, since it's a deep
  * copy, but allows retrieving a copy from elsewhere without having to worry about
  * our locking semantics. */
 void FilenameDB::GetFileSetCopy( const RString &sDir, FileSet &out )
 {
-	FileSet *pFileSet = GetFileSet( sDir );
+	int iShard;
+	const FileSet *pFileSet = GetFileSet( sDir, iShard );
 	out = *pFileSet;
-	m_Mutex.Unlock(); /* locked by GetFileSet */
+	EndRead( iShard ); /* started by GetFileSet */
 }
 
 void FilenameDB::CacheFile( const RString &sPath )
@@ -5,7 +5,7 @@
 #include "RageThreads.h"
 #include "RageFileManager.h"
 
-#include <map>
+#include <functional>
 #include <set>
 #include <vector>
 
@@ -32,15 +32,11 @@ struct File
 	/* Private data, for RageFileDrivers. */
 	void *priv;
 
-	/* If this is non-nullptr, and dir is true, this is a pointer to the FileSet containing
-	 * the directory contents.  (This is a cache; it isn't always set.) */
-	const FileSet *dirp;
-
-	File() { dir=false; dirp=nullptr; size=-1; hash=-1; priv=nullptr;}
+	File() { dir=false; size=-1; hash=-1; priv=nullptr;}
 	File( const RString &fn )
 	{
 		SetName( fn );
-		dir=false; size=-1; hash=-1; priv=nullptr; dirp=nullptr;
+		dir=false; size=-1; hash=-1; priv=nullptr;
 	}
 
 	bool operator< (const File &rhs) const { return lname<rhs.lname; }
@@ -63,21 +59,15 @@ inline bool operator!=(File const &lhs, File const &rhs)
 	return !operator==(lhs, rhs);
 }
 
-/** @brief This represents a directory. */
+/** @brief This represents a directory.
+ *
+ * Once a FileSet is in FilenameDB's cache it's never changed, since other
+ * threads may be reading it; changes are made to a copy, which replaces it. */
 struct FileSet
 {
 	std::set<File> files;
 	RageTimer age;
 
-	/*
-	 * If m_bFilled is false, this FileSet hasn't completed being filled in yet; it's
-	 * owned by the thread filling it in.  Wait on FilenameDB::m_Mutex and retry until
-	 * it becomes true.
-	 */
-	bool m_bFilled;
-
-	FileSet() { m_bFilled = true; }
-
 	void GetFilesMatching(
 		const RString &sBeginning, const RString &sContaining, const RString &sEnding,
 		std::vector<RString> &asOut, bool bOnlyDirs ) const;
@@ -87,13 +77,19 @@ struct FileSet
 	int GetFileSize( const RString &sPath ) const;
 	int GetFileHash( const RString &sPath ) const;
 };
-/** @brief A container for a file listing. */
+struct FilenameDBShard;
+struct DirKey;
+
+/** @brief A container for a file listing.
+ *
+ * The cached directories are split into shards by a hash of their lowercased
+ * names.  Looking a directory up takes no lock, so readers never wait on each
+ * other; only reading a directory in, or changing the cache, locks its shard. */
 class FilenameDB
 {
 public:
-	FilenameDB():
-		m_Mutex("FilenameDB"), ExpireSeconds( -1 ) { }
-	virtual ~FilenameDB() { FlushDirCache(); }
+	FilenameDB();
+	virtual ~FilenameDB();
 
 	void AddFile( const RString &sPath, int iSize, int iHash, void *pPriv=nullptr );
 	void DelFile( const RString &sPath );
@@ -114,19 +110,23 @@ public:
 	void GetDirListing( const RString &sPath, std::vector<RString> &asAddTo, bool bOnlyDirs, bool bReturnPathToo );
 
 	void FlushDirCache( const RString &sDir = RString() );
+	/* Forget the listing of one directory, leaving the rest of the cache
+	 * alone.  If bRecursive, forget its cached subdirectories too. */
+	void FlushDir( const RString &sDir, bool bRecursive = false );
 
 	void GetFileSetCopy( const RString &dir, FileSet &out );
 	/* Probably slow, so override it. */
 	virtual void CacheFile( const RString &sPath );
 
 protected:
-	RageEvent m_Mutex;
+	/* Return sDir's listing, reading it in with PopulateFileSet if it isn't cached
+	 * or has expired.  On return, the caller is reading shard iShard; it must call
+	 * EndRead(iShard) once it's done with the FileSet. */
+	const FileSet *GetFileSet( const RString &sDir, int &iShard );
+	void EndRead( int iShard );
 
-	const File *GetFile( const RString &sPath );
-	FileSet *GetFileSet( const RString &sDir, bool create=true );
-
-	/* Directories we have cached: */
-	std::map<RString, FileSet *> dirs;
+	/* If sDir is cached, add f to it, replacing any file with the same name. */
+	void UpdateCachedFile( const RString &sDir, const File &f );
 
 	int ExpireSeconds;
 
@@ -134,10 +134,23 @@ protected:
 	void GetFilesMatching( const RString &sDir,
 		const RString &sBeginning, const RString &sContaining, const RString &sEnding,
 		std::vector<RString> &asOut, bool bOnlyDirs );
-	void DelFileSet( std::map<RString, FileSet *>::iterator dir );
 
 	/* The given path wasn't cached.  Cache it. */
 	virtual void PopulateFileSet( FileSet & /* fs */, const RString & /* sPath */ ) { }
+
+private:
+	FilenameDBShard *m_pShards;
+
+	FilenameDBShard &GetShard( const DirKey &key, int &iShard ) const;
+	bool IsExpired( const FileSet &fs ) const;
+	void FillFileSet( FilenameDBShard &s, const DirKey &key, const RString &sDir );
+
+	/* Replace sDir's listing with a copy changed by fn.  If sDir isn't cached,
+	 * read it in first if bCreate is true, or do nothing if it's false. */
+	void ChangeFileSet( const RString &sDir, bool bCreate, const std::function<void(FileSet &)> &fn );
+
+	FilenameDB( const FilenameDB & ) = delete;
+	FilenameDB &operator=( const FilenameDB & ) = delete;
 };
 
 /* This FilenameDB must be populated in advance. */
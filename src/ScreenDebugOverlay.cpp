@@ -11,8 +11,12 @@
 #include "GameCommand.h"
 #include "ScreenGameplay.h"
 #include "RageSoundManager.h"
+#include "arch/Sound/RageSoundDriver.h"
 #include "GameSoundManager.h"
 #include "InputMapper.h"
+#include "InputLatency.h"
+#include "LightsManager.h"
+#include "FrameProfiler.h"
 #include "RageTextureManager.h"
 #include "MemoryCardManager.h"
 #include "NoteSkinManager.h"
@@ -598,6 +602,13 @@ static LocalizedString CPU				( "ScreenDebugOverlay", "CPU" );
 static LocalizedString SONG			( "ScreenDebugOverlay", "Song" );
 static LocalizedString MACHINE			( "ScreenDebugOverlay", "Machine" );
 static LocalizedString SYNC_TEMPO		( "ScreenDebugOverlay", "Tempo" );
+static LocalizedString INPUT_LATENCY		( "ScreenDebugOverlay", "Input Latency" );
+static LocalizedString RESET_INPUT_LATENCY	( "ScreenDebugOverlay", "Reset Input Latency" );
+static LocalizedString WRITE_INPUT_LATENCY	( "ScreenDebugOverlay", "Write Input Latency" );
+static LocalizedString FRAME_PROFILER		( "ScreenDebugOverlay", "Frame Profiler" );
+static LocalizedString WRITE_FRAME_TRACE	( "ScreenDebugOverlay", "Write Frame Trace" );
+static LocalizedString SOUND_MIXING		( "ScreenDebugOverlay", "Sound Mixing" );
+static LocalizedString LIGHTS_OUTPUT		( "ScreenDebugOverlay", "Lights Output" );
 
 class DebugLineAutoplay : public IDebugLine
 {
@@ -1324,6 +1335,167 @@ class DebugLineUptime : public IDebugLine
 	virtual void DoAndLog( RString &sMessageOut ) {}
 };
 
+class DebugLineInputLatency : public IDebugLine
+{
+	virtual RString GetDisplayTitle() { return INPUT_LATENCY.GetValue(); }
+	virtual RString GetPageName() const { return "Input"; }
+	virtual bool IsEnabled() { return InputLatency::IsEnabled(); }
+	virtual void DoAndLog( RString &sMessageOut )
+	{
+		InputLatency::SetEnabled( !InputLatency::IsEnabled() );
+		IDebugLine::DoAndLog( sMessageOut );
+	}
+};
+
+/* Show the delay to one stage of the input path. */
+class DebugLineInputLatencyStage : public IDebugLine
+{
+public:
+	DebugLineInputLatencyStage( InputLatencyStage s ): m_Stage(s) { }
+	virtual RString GetDisplayTitle() { return InputLatencyStageToString( m_Stage ); }
+	virtual RString GetDisplayValue()
+	{
+		InputLatency::Stats stats;
+		InputLatency::GetStats( m_Stage, stats );
+		if( stats.m_iCount == 0 )
+			return "-";
+		return ssprintf( "%.1f / %.1f / %.1f ms (max %.1f, %u)",
+			stats.m_fMedian, stats.m_f95, stats.m_f99, stats.m_fMax, stats.m_iCount );
+	}
+	virtual RString GetPageName() const { return "Input"; }
+	virtual bool IsEnabled() { return InputLatency::IsEnabled(); }
+	virtual void DoAndLog( RString &sMessageOut ) {}
+
+private:
+	InputLatencyStage m_Stage;
+};
+
+class DebugLineResetInputLatency : public IDebugLine
+{
+	virtual RString GetDisplayTitle() { return RESET_INPUT_LATENCY.GetValue(); }
+	virtual RString GetDisplayValue() { return RString(); }
+	virtual RString GetPageName() const { return "Input"; }
+	virtual bool IsEnabled() { return true; }
+	virtual void DoAndLog( RString &sMessageOut )
+	{
+		InputLatency::Reset();
+		IDebugLine::DoAndLog( sMessageOut );
+	}
+};
+
+class DebugLineWriteInputLatency : public IDebugLine
+{
+	virtual RString GetDisplayTitle() { return WRITE_INPUT_LATENCY.GetValue(); }
+	virtual RString GetDisplayValue() { return RString(); }
+	virtual RString GetPageName() const { return "Input"; }
+	virtual bool IsEnabled() { return true; }
+	virtual void DoAndLog( RString &sMessageOut )
+	{
+		const RString sPath = "/Logs/InputLatency.csv";
+		RString sError;
+		IDebugLine::DoAndLog( sMessageOut );
+		if( InputLatency::WriteCSV(sPath, sError) )
+			sMessageOut += " - " + sPath;
+		else
+			sMessageOut += " - " + sError;
+	}
+};
+
+class DebugLineFrameProfiler : public IDebugLine
+{
+	virtual RString GetDisplayTitle() { return FRAME_PROFILER.GetValue(); }
+	virtual RString GetPageName() const { return "Performance"; }
+	virtual bool IsEnabled() { return FrameProfiler::IsEnabled(); }
+	virtual void DoAndLog( RString &sMessageOut )
+	{
+		FrameProfiler::SetEnabled( !FrameProfiler::IsEnabled() );
+		IDebugLine::DoAndLog( sMessageOut );
+	}
+};
+
+class DebugLineWriteFrameTrace : public IDebugLine
+{
+	virtual RString GetDisplayTitle() { return WRITE_FRAME_TRACE.GetValue(); }
+	virtual RString GetDisplayValue() { return RString(); }
+	virtual RString GetPageName() const { return "Performance"; }
+	virtual bool IsEnabled() { return true; }
+	virtual void DoAndLog( RString &sMessageOut )
+	{
+		const RString sPath = "/Logs/FrameTrace.json";
+		RString sError;
+		IDebugLine::DoAndLog( sMessageOut );
+		if( FrameProfiler::WriteChromeTrace(sPath, sError) )
+			sMessageOut += " - " + sPath;
+		else
+			sMessageOut += " - " + sError;
+	}
+};
+
+/* Show underruns and how quickly the decoding thread wakes up; selecting it
+ * logs each playing sound's refills. */
+class DebugLineSoundMixing : public IDebugLine
+{
+	virtual RString GetDisplayTitle() { return SOUND_MIXING.GetValue(); }
+	virtual RString GetDisplayValue()
+	{
+		RageSoundMixingStats stats;
+		if( !SOUNDMAN->GetMixingStats(stats) )
+			return "-";
+
+		// The wakeup lag bucket that 95% of wakeups fall in or under.
+		const int iLast = RageSoundMixingStats::NUM_LAG_BUCKETS - 1;
+		int iBucket = 0, iSeen = stats.aiDecodeLag[0];
+		while( iBucket < iLast && iSeen < stats.iDecodeWakeups * 0.95f )
+			iSeen += stats.aiDecodeLag[++iBucket];
+		if( iBucket == iLast )
+			return ssprintf( "%i underruns, 95%% of wakeups >= %ims", stats.iUnderruns, 1 << (iLast-1) );
+		return ssprintf( "%i underruns, 95%% of wakeups < %ims", stats.iUnderruns, 1 << iBucket );
+	}
+	virtual RString GetPageName() const { return "Performance"; }
+	virtual bool IsEnabled() { return true; }
+	virtual void DoAndLog( RString &sMessageOut )
+	{
+		RageSoundMixingStats stats;
+		if( SOUNDMAN->GetMixingStats(stats) )
+		{
+			for( RageSoundMixingStats::SoundStats const &s : stats.vSounds )
+			{
+				LOG->Info( "%s: %i underruns, %i refills, %.1fms average, %.1fms max",
+					s.sPath.c_str(), s.iUnderruns, s.iDecodes,
+					s.iDecodes? s.fDecodeSeconds * 1000 / s.iDecodes:0.0f, s.fMaxDecodeSeconds * 1000 );
+			}
+		}
+		IDebugLine::DoAndLog( sMessageOut );
+	}
+};
+
+/* Show how long the lights output thread takes to write a state; selecting
+ * it logs the rest of the counters. */
+class DebugLineLightsOutput : public IDebugLine
+{
+	virtual RString GetDisplayTitle() { return LIGHTS_OUTPUT.GetValue(); }
+	virtual RString GetDisplayValue()
+	{
+		LightsOutputStats stats;
+		if( !LIGHTSMAN->GetOutputStats(stats) )
+			return "-";
+		return ssprintf( "%u written, %.1fms latency, %.1fms max", stats.m_iWritten, stats.m_fMeanLatencyMs, stats.m_fMaxLatencyMs );
+	}
+	virtual RString GetPageName() const { return "Performance"; }
+	virtual bool IsEnabled() { return true; }
+	virtual void DoAndLog( RString &sMessageOut )
+	{
+		LightsOutputStats stats;
+		if( LIGHTSMAN->GetOutputStats(stats) )
+		{
+			LOG->Info( "Lights output: %u published, %u written, %u coalesced, %u unchanged; write %.2fms average, %.2fms max; latency %.2fms average, %.2fms max",
+				stats.m_iPublished, stats.m_iWritten, stats.m_iCoalesced, stats.m_iUnchanged,
+				stats.m_fMeanWriteMs, stats.m_fMaxWriteMs, stats.m_fMeanLatencyMs, stats.m_fMaxLatencyMs );
+		}
+		IDebugLine::DoAndLog( sMessageOut );
+	}
+};
+
 /* #ifdef out the lines below if you don't want them to appear on certain
  * platforms.  This is easier than #ifdefing the whole DebugLine definitions
  * that can span pages.
@@ -1370,6 +1542,18 @@ DECLARE_ONE( DebugLineForceCrash );
 DECLARE_ONE( DebugLineUptime );
 DECLARE_ONE( DebugLineResetKeyMapping );
 DECLARE_ONE( DebugLineMuteActions );
+DECLARE_ONE( DebugLineInputLatency );
+static DebugLineInputLatencyStage g_DebugLineInputLatencyInputFilter( InputLatencyStage_InputFilter );
+static DebugLineInputLatencyStage g_DebugLineInputLatencyGetInputEvents( InputLatencyStage_GetInputEvents );
+static DebugLineInputLatencyStage g_DebugLineInputLatencyHandleInputEvents( InputLatencyStage_HandleInputEvents );
+static DebugLineInputLatencyStage g_DebugLineInputLatencyScreenInput( InputLatencyStage_ScreenInput );
+static DebugLineInputLatencyStage g_DebugLineInputLatencyPlayerStep( InputLatencyStage_PlayerStep );
+DECLARE_ONE( DebugLineResetInputLatency );
+DECLARE_ONE( DebugLineWriteInputLatency );
+DECLARE_ONE( DebugLineFrameProfiler );
+DECLARE_ONE( DebugLineWriteFrameTrace );
+DECLARE_ONE( DebugLineSoundMixing );
+DECLARE_ONE( DebugLineLightsOutput );
 
 
 /*
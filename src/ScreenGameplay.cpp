@@ -46,6 +46,7 @@
 #include "MemoryCardManager.h"
 #include "CommonMetrics.h"
 #include "InputMapper.h"
+#include "InputLatency.h"
 #include "Game.h"
 #include "ActiveAttackList.h"
 #include "Player.h"
@@ -1002,6 +1003,8 @@ ScreenGameplay::~ScreenGameplay()
 
 	LOG->Trace( "ScreenGameplay::~ScreenGameplay()" );
 
+	InputLatency::LogStats();
+
 	SAFE_DELETE( m_pSongBackground );
 	SAFE_DELETE( m_pSongForeground );
 
@@ -2381,6 +2384,8 @@ void ScreenGameplay::ResetGiveUpTimers(bool show_text)
 bool ScreenGameplay::Input( const InputEventPlus &input )
 {
 	//LOG->Trace( "ScreenGameplay::Input()" );
+	if( input.type == IET_FIRST_PRESS )
+		InputLatency::Record( InputLatencyStage_ScreenInput, input.DeviceI.ts );
 
 	Message msg("");
 	if( m_Codes.InputMessage(input, msg) )
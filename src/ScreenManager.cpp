@@ -72,7 +72,17 @@
 #include "ScreenDimensions.h"
 #include "ActorUtil.h"
 #include "InputEventPlus.h"
-
+#include "FrameProfiler.h"
+#include "GameState.h"
+#include "Song.h"
+#include "Font.h"
+#include "NoteSkinManager.h"
+#include "PlayerState.h"
+#include "Sprite.h"
+
+#include <map>
+#include <set>
+#include <utility>
 #include <vector>
 
 
@@ -227,6 +237,153 @@ namespace ScreenManagerUtil
 };
 using namespace ScreenManagerUtil;
 
+/* Building a screen's actors runs Lua and creates GL resources, so it has to
+ * happen on this thread, but much of the time goes to reading and decoding
+ * images.  Remember the textures each screen loaded last time, and when that
+ * screen is about to be loaded, decode them on the texture prefetch thread
+ * while the current screen keeps animating.  Images of the current song are
+ * remembered by which image they were, so the next song's are loaded.
+ * Gameplay's biggest textures are known before it has ever been loaded, so
+ * those are prefetched even without a record. */
+static Preference<bool> g_bConcurrentScreenPrep( "ConcurrentScreenPrep", true );
+
+namespace
+{
+	const int NUM_SONG_IMAGES = 6;
+	void GetSongImagePaths( const Song *pSong, RString sPaths[NUM_SONG_IMAGES] )
+	{
+		sPaths[0] = pSong->GetBannerPath();
+		sPaths[1] = pSong->GetBackgroundPath();
+		sPaths[2] = pSong->GetJacketPath();
+		sPaths[3] = pSong->GetCDImagePath();
+		sPaths[4] = pSong->GetDiscPath();
+		sPaths[5] = pSong->GetCDTitlePath();
+	}
+
+	struct ScreenTextures
+	{
+		std::vector<RageTextureID> m_vTextures;
+		// Images of the song that was playing, by index into GetSongImagePaths.
+		std::vector<std::pair<int, RageTextureID>> m_vSongImages;
+	};
+	std::map<RString, ScreenTextures> g_mapScreenTextures;
+	bool g_bRecordingTextures = false;
+
+	// Fonts ScreenGameplay and its children load by name.
+	const char *const g_asGameplayFonts[][2] =
+	{
+		{ nullptr, "SongNum" },
+		{ nullptr, "StepsDescription" },
+		{ nullptr, "player options" },
+		{ nullptr, "song options" },
+		{ nullptr, "ActiveAttackList" },
+		{ nullptr, "debug" },
+		{ nullptr, "survive time" },
+		{ "ScoreDisplayNormal", "Text" },
+	};
+
+	/* The textures a gameplay screen is sure to load: the song's background
+	 * and banner, each player's noteskin and the screen's fonts. */
+	void GetGameplayTextures( const RString &sScreenName, std::vector<RageTextureID> &vOut )
+	{
+		const Song *pSong = GAMESTATE->m_pCurSong;
+		if( pSong != nullptr )
+		{
+			if( pSong->HasBackground() )
+				vOut.push_back( Sprite::SongBGTexture(pSong->GetBackgroundPath()) );
+			if( pSong->HasBanner() )
+				vOut.push_back( Sprite::SongBannerTexture(pSong->GetBannerPath()) );
+		}
+
+		std::set<RString> setNoteSkins;
+		FOREACH_EnabledPlayer( pn )
+		{
+			RString sNoteSkin = GAMESTATE->m_pPlayerState[pn]->m_PlayerOptions.GetStage().m_sNoteSkin;
+			NOTESKIN->ValidateNoteSkinName( sNoteSkin );
+			sNoteSkin.MakeLower();
+			if( !setNoteSkins.insert(sNoteSkin).second )
+				continue;
+
+			std::vector<RString> vsPaths;
+			NOTESKIN->GetTexturePaths( sNoteSkin, vsPaths );
+			for( const RString &sPath : vsPaths )
+				vOut.push_back( RageTextureID(sPath) );
+		}
+
+		for( unsigned i = 0; i < ARRAYLEN(g_asGameplayFonts); ++i )
+		{
+			const char *szGroup = g_asGameplayFonts[i][0];
+			RString sPath = THEME->GetPathF( szGroup != nullptr? RString(szGroup): sScreenName, g_asGameplayFonts[i][1], true );
+			if( !sPath.empty() )
+				Font::GetTextureIDs( sPath, vOut );
+		}
+	}
+
+	bool IsGameplayScreen( const RString &sScreenName )
+	{
+		return THEME->HasMetric( sScreenName, "Class" ) &&
+			BeginsWith( THEME->GetMetric(sScreenName, "Class"), "ScreenGameplay" );
+	}
+
+	/* Record the textures loaded while this is in scope as sScreenName's.
+	 * Prepared screens are skipped; they're already loaded. */
+	class RecordScreenTextures
+	{
+	public:
+		RecordScreenTextures( const RString &sScreenName ): m_sScreenName( sScreenName )
+		{
+			m_bRecording = g_bConcurrentScreenPrep && !g_bRecordingTextures && !ScreenIsPrepped( sScreenName );
+			if( !m_bRecording )
+				return;
+			g_bRecordingTextures = true;
+			TEXTUREMAN->SetLoadLog( &m_vLoaded );
+		}
+
+		~RecordScreenTextures()
+		{
+			if( !m_bRecording )
+				return;
+			TEXTUREMAN->SetLoadLog( nullptr );
+			g_bRecordingTextures = false;
+
+			const Song *pSong = GAMESTATE->m_pCurSong;
+			RString sSongImages[NUM_SONG_IMAGES];
+			if( pSong != nullptr )
+				GetSongImagePaths( pSong, sSongImages );
+
+			ScreenTextures textures;
+			std::set<RageTextureID> setSeen;
+			for( RageTextureID &ID : m_vLoaded )
+			{
+				if( ActorUtil::GetFileType(ID.filename) != FT_Bitmap || !setSeen.insert(ID).second )
+					continue;
+
+				if( pSong == nullptr || !BeginsWith(ID.filename, pSong->GetSongDir()) )
+				{
+					textures.m_vTextures.push_back( ID );
+					continue;
+				}
+
+				// Other files in the song's directory won't be used with the next song.
+				for( int i = 0; i < NUM_SONG_IMAGES; ++i )
+				{
+					if( !sSongImages[i].empty() && ID.filename == sSongImages[i] )
+					{
+						textures.m_vSongImages.push_back( std::make_pair(i, ID) );
+						break;
+					}
+				}
+			}
+			g_mapScreenTextures[m_sScreenName] = std::move( textures );
+		}
+
+	private:
+		RString m_sScreenName;
+		bool m_bRecording;
+		std::vector<RageTextureID> m_vLoaded;
+	};
+}
+
 RegisterScreenClass::RegisterScreenClass( const RString& sClassName, CreateScreenFn pfn )
 {
 	if( g_pmapRegistrees == nullptr )
@@ -469,13 +626,16 @@ void ScreenManager::Update( float fDeltaTime )
 	}
 
 	// Update screens.
-	for (const LoadedScreen& screen : g_ScreenStack)
-		screen.m_pScreen->Update(fDeltaTime);
+	{
+		PROFILE_SCOPE( "Actor update" );
+		for (const LoadedScreen& screen : g_ScreenStack)
+			screen.m_pScreen->Update(fDeltaTime);
 
-	g_pSharedBGA->Update(fDeltaTime);
+		g_pSharedBGA->Update(fDeltaTime);
 
-	for (Screen* overlay : g_OverlayScreens)
-		overlay->Update(fDeltaTime);
+		for (Screen* overlay : g_OverlayScreens)
+			overlay->Update(fDeltaTime);
+	}
 
 	/* The music may be started on the first update. If we're reading from a CD,
 	 * it might not start immediately. Make sure we start playing the sound before
@@ -504,17 +664,22 @@ void ScreenManager::Draw()
 	if( !DISPLAY->BeginFrame() )
 		return;
 
-	DISPLAY->CameraPushMatrix();
-	DISPLAY->LoadMenuPerspective( 0, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_CENTER_X, SCREEN_CENTER_Y );
-	g_pSharedBGA->Draw();
-	DISPLAY->CameraPopMatrix();
+	{
+		PROFILE_SCOPE( "Actor draw" );
+		DISPLAY->CameraPushMatrix();
+		DISPLAY->LoadMenuPerspective( 0, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_CENTER_X, SCREEN_CENTER_Y );
+		g_pSharedBGA->Draw();
+		DISPLAY->CameraPopMatrix();
 
-	for (const LoadedScreen& screen : g_ScreenStack)	// Draw all screens bottom to top
-		screen.m_pScreen->Draw();
+		for (const LoadedScreen& screen : g_ScreenStack)	// Draw all screens bottom to top
+			screen.m_pScreen->Draw();
 
-	for (Screen* overlayScreen : g_OverlayScreens)
-		overlayScreen->Draw();
+		for (Screen* overlayScreen : g_OverlayScreens)
+			overlayScreen->Draw();
+	}
 
+	/* This includes waiting for vsync. */
+	PROFILE_SCOPE( "EndFrame" );
 	DISPLAY->EndFrame();
 }
 
@@ -561,7 +726,10 @@ void ScreenManager::Input( const InputEventPlus &input )
 // Just create a new screen; don't do any associated cleanup.
 Screen* ScreenManager::MakeNewScreen( const RString &sScreenName )
 {
+	PROFILE_SCOPE( "Screen load" );
 	RageTimer t;
+	ThemeManager::MetricCacheStats before;
+	ThemeManager::GetMetricCacheStats( before );
 	LOG->Trace( "Loading screen: \"%s\"", sScreenName.c_str() );
 
 	RString sClassName = THEME->GetMetric( sScreenName,"Class" );
@@ -578,7 +746,12 @@ Screen* ScreenManager::MakeNewScreen( const RString &sScreenName )
 	CreateScreenFn pfn = iter->second;
 	Screen *ret = pfn( sScreenName );
 
-	LOG->Trace( "Loaded \"%s\" (\"%s\") in %f", sScreenName.c_str(), sClassName.c_str(), t.GetDeltaTime() );
+	ThemeManager::MetricCacheStats after;
+	ThemeManager::GetMetricCacheStats( after );
+	LOG->Trace( "Loaded \"%s\" (\"%s\") in %f; %u metrics read, %u resolved, %u compiled",
+		sScreenName.c_str(), sClassName.c_str(), t.GetDeltaTime(),
+		after.m_iLookups - before.m_iLookups, after.m_iResolved - before.m_iResolved,
+		after.m_iCompiled - before.m_iCompiled );
 
 	return ret;
 }
@@ -589,6 +762,8 @@ void ScreenManager::PrepareScreen( const RString &sScreenName )
 	if( ScreenIsPrepped(sScreenName) )
 		return;
 
+	RecordScreenTextures record( sScreenName );
+
 	Screen* pNewScreen = MakeNewScreen(sScreenName);
 	if(pNewScreen == nullptr)
 	{
@@ -657,6 +832,64 @@ void ScreenManager::SetNewScreen( const RString &sScreenName )
 {
 	ASSERT( sScreenName != "" );
 	m_sDelayedScreen = sScreenName;
+	PrefetchScreen( sScreenName );
+}
+
+void ScreenManager::PrefetchScreen( const RString &sScreenName )
+{
+	if( !g_bConcurrentScreenPrep || ScreenIsPrepped(sScreenName) )
+		return;
+
+	std::map<RString, ScreenTextures>::const_iterator it = g_mapScreenTextures.find( sScreenName );
+	const bool bGameplay = IsGameplayScreen( sScreenName );
+	if( it == g_mapScreenTextures.end() && !bGameplay )
+		return;
+
+	PROFILE_SCOPE( "Prefetch screen" );
+
+	/* Finished prefetches aren't referenced until the screen loads them, and
+	 * deleting the old screen first would free them; LoadDelayedScreen lets
+	 * go once the new one is prepared. */
+	TEXTUREMAN->HoldPrefetches();
+
+	int iTextures = 0;
+	if( bGameplay )
+	{
+		std::vector<RageTextureID> vTextures;
+		GetGameplayTextures( sScreenName, vTextures );
+		for( const RageTextureID &ID : vTextures )
+		{
+			if( TEXTUREMAN->PrefetchTexture(ID) )
+				++iTextures;
+		}
+	}
+
+	if( it != g_mapScreenTextures.end() )
+	{
+		for( const RageTextureID &ID : it->second.m_vTextures )
+		{
+			if( TEXTUREMAN->PrefetchTexture(ID) )
+				++iTextures;
+		}
+
+		const Song *pSong = GAMESTATE->m_pCurSong;
+		if( pSong != nullptr && !it->second.m_vSongImages.empty() )
+		{
+			RString sSongImages[NUM_SONG_IMAGES];
+			GetSongImagePaths( pSong, sSongImages );
+			for( const std::pair<int, RageTextureID> &image : it->second.m_vSongImages )
+			{
+				if( sSongImages[image.first].empty() )
+					continue;
+				RageTextureID ID = image.second;
+				ID.filename = sSongImages[image.first];
+				if( TEXTUREMAN->PrefetchTexture(ID) )
+					++iTextures;
+			}
+		}
+	}
+
+	LOG->Trace( "Prefetching %i textures for \"%s\"", iTextures, sScreenName.c_str() );
 }
 
 /* Activate the screen and/or its background, if either are loaded.
@@ -729,9 +962,14 @@ void ScreenManager::LoadDelayedScreen()
 	if(!IsScreenNameValid(sScreenName))
 	{
 		LuaHelpers::ReportScriptError("Tried to go to invalid screen: " + sScreenName, "INVALID_SCREEN");
+		TEXTUREMAN->ReleasePrefetches();
 		return;
 	}
 
+	/* Remember what the screen loads through BeginScreen, too; many screens
+	 * load most of their textures there. */
+	RecordScreenTextures record( sScreenName );
+
 	// Pop the top screen, if any.
 	ScreenMessage SM = PopTopScreenInternal();
 
@@ -783,6 +1021,9 @@ void ScreenManager::LoadDelayedScreen()
 		AfterDeleteScreen();
 	}
 
+	// The new screen holds what it uses of the prefetched textures now.
+	TEXTUREMAN->ReleasePrefetches();
+
 	MESSAGEMAN->Broadcast( Message_ScreenChanged );
 
 	SendMessageToTopScreen( SM );
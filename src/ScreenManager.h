@@ -35,6 +35,14 @@ public:
 	 * will be very quick.
 	 * @param sScreenName the Screen to prepare. */
 	void PrepareScreen( const RString &sScreenName );
+	/**
+	 * @brief Start loading the textures the Screen used last time in the background.
+	 *
+	 * Call this as soon as it's known which Screen is next, so its textures
+	 * can be decoded while the current Screen is still running.  Gameplay
+	 * screens also prefetch the song, noteskin and font textures they load.
+	 * @param sScreenName the Screen to prefetch. */
+	void PrefetchScreen( const RString &sScreenName );
 	void GroupScreen( const RString &sScreenName );
 	void PersistantScreen( const RString &sScreenName );
 	void PopTopScreen( ScreenMessage SM );
@@ -353,6 +353,14 @@ void ScreenSelectMusic::CheckBackgroundRequests( bool bForce )
 			bFreeCache = true;
 		}
 
+		/* Decode and upload the full-res banner in the background, and fade to
+		 * it once it's resident, so loading it doesn't cause a skip. */
+		RageTextureID BannerID = Sprite::SongBannerTexture( sPath );
+		if( TEXTUREMAN->IsTexturePending(BannerID) )
+			return;
+		if( !TEXTUREMAN->IsTextureRegistered(BannerID) && TEXTUREMAN->PrefetchTexture(BannerID) )
+			return;
+
 		g_bBannerWaiting = false;
 		m_Banner.Load( sPath, true );
 
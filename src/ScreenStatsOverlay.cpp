@@ -1,6 +1,7 @@
 #include "global.h"
 #include "ScreenStatsOverlay.h"
 #include "ActorUtil.h"
+#include "FrameProfiler.h"
 #include "PrefsManager.h"
 #include "RageDisplay.h"
 #include "RageLog.h"
@@ -77,12 +78,34 @@ void ScreenStatsOverlay::Update( float fDeltaTime )
 	this->SetVisible( PREFSMAN->m_bShowStats );
 	if( PREFSMAN->m_bShowStats )
 	{
-		m_textStats.SetText( DISPLAY->GetStats() );
+		RString sStats = DISPLAY->GetStats();
+		if( FrameProfiler::IsEnabled() )
+		{
+			UpdateProfile();
+			sStats += m_sProfile;
+		}
+		m_textStats.SetText( sStats );
 		if ( SHOW_SKIPS )
 			UpdateSkips();
 	}
 }
 
+/* Show the scopes with the slowest frames in the last second.  This is
+ * refreshed twice a second, so it can be read. */
+void ScreenStatsOverlay::UpdateProfile()
+{
+	if( !m_sProfile.empty() && m_timerProfile.Ago() < 0.5f )
+		return;
+	m_timerProfile.Touch();
+
+	std::vector<FrameProfiler::ScopeStats> vStats;
+	FrameProfiler::GetSlowestScopes( 1.0f, NUM_PROFILE_SCOPES_TO_SHOW, vStats );
+
+	m_sProfile = "\nmean / max ms";
+	for( const FrameProfiler::ScopeStats &stats : vStats )
+		m_sProfile += ssprintf( "\n%s: %.2f / %.2f", stats.m_sName, stats.m_fMeanMs, stats.m_fMaxMs );
+}
+
 void ScreenStatsOverlay::AddTimestampLine( const RString &txt, const RageColor &color )
 {
 	m_textSkips[m_LastSkip].SetText( txt );
@@ -9,6 +9,7 @@
 #include <array>
 
 const int NUM_SKIPS_TO_SHOW = 5;
+const int NUM_PROFILE_SCOPES_TO_SHOW = 8;
 
 class ScreenStatsOverlay : public Screen
 {
@@ -20,12 +21,15 @@ public:
 private:
 	void AddTimestampLine( const RString &txt, const RageColor &color );
 	void UpdateSkips();
+	void UpdateProfile();
 
 	BitmapText m_textStats;
 	Quad m_quadSkipBackground;
 	std::array<BitmapText, NUM_SKIPS_TO_SHOW> m_textSkips;
 	RageTimer m_timerSkip;
 	int m_LastSkip;
+	RageTimer m_timerProfile;
+	RString m_sProfile;
 
 	ThemeMetric<bool>  SHOW_SKIPS;
 	ThemeMetric<float> SKIP_X;
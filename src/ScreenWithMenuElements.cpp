@@ -271,6 +271,10 @@ void ScreenWithMenuElements::ResetTimer()
 
 void ScreenWithMenuElements::StartTransitioningScreen( ScreenMessage smSendWhenDone )
 {
+	// Load what we can of the next screen while transitioning out.
+	if( !SCREENMAN->IsStackedScreen(this) )
+		SCREENMAN->PrefetchScreen( smSendWhenDone == SM_GoToPrevScreen? GetPrevScreen(): GetNextScreenName() );
+
 	TweenOffScreen();
 
 	m_Out.StartTransitioning( smSendWhenDone );
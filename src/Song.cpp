@@ -7,6 +7,7 @@
 #include "RageSoundReader_FileReader.h"
 #include "RageSurface_Load.h"
 #include "SongCacheIndex.h"
+#include "SongCacheRecord.h"
 #include "GameManager.h"
 #include "PrefsManager.h"
 #include "Style.h"
@@ -51,7 +52,7 @@
  * @brief The internal version of the cache for StepMania.
  *
  * Increment this value to invalidate the current cache. */
-const int FILE_CACHE_VERSION = 227;
+const int FILE_CACHE_VERSION = 228;
 
 /** @brief How long does a song sample last by default? */
 const float DEFAULT_MUSIC_SAMPLE_LENGTH = 12.f;
@@ -258,11 +259,6 @@ const BackgroundChange &Song::GetBackgroundAtBeat( BackgroundLayer iLayer, float
 }
 
 
-RString Song::GetCacheFilePath() const
-{
-	return SongCacheIndex::GetCacheFilePath( "Songs", m_sSongDir );
-}
-
 // Get a path to the SM containing data for this song. It might be a cache file.
 const RString &Song::GetSongFilePath() const
 {
@@ -272,14 +268,11 @@ const RString &Song::GetSongFilePath() const
 	return m_sSongFileName;
 }
 
-/* Hack: This should be a parameter to TidyUpData, but I don't want to pull in
- * <set> into Song.h, which is heavily used. */
-static std::set<RString> BlacklistedImages;
-
 /* If PREFSMAN->m_bFastLoad is true, always load from cache if possible.
  * Don't read the contents of sDir if we can avoid it. That means we can't call
  * HasMusic(), HasBanner() or GetHashForDirectory().
- * If true, check the directory hash and reload the song from scratch if it's changed.
+ * If false, check the directory hash and reload the song from scratch if it's changed.
+ * SONGINDEX can usually tell that the hash hasn't changed without reading sDir.
  */
 bool Song::LoadFromSongDir(RString sDir, bool load_autosave, ProfileSlot from_profile)
 {
@@ -313,37 +306,37 @@ bool Song::LoadFromSongDir(RString sDir, bool load_autosave, ProfileSlot from_pr
 		use_cache= false;
 	}
 
-	RString cache_file_path;
 	if(m_LoadedFromProfile == ProfileSlot_Invalid)
 	{
 		// First, look in the cache for this song (without loading NoteData)
 		unsigned uCacheHash = SONGINDEX->GetCacheHash(m_sSongDir);
-		cache_file_path = GetCacheFilePath();
 
-		if( !DoesFileExist(cache_file_path) )
+		if( uCacheHash == 0 )
 		{ use_cache = false; }
-		else if(!PREFSMAN->m_bFastLoad && GetHashForDirectory(m_sSongDir) != uCacheHash)
+		else if(!PREFSMAN->m_bFastLoad && SONGINDEX->GetDirectoryHash(m_sSongDir) != uCacheHash)
 		{ use_cache = false; } // this cache is out of date
 		else if(load_autosave)
 		{ use_cache= false; }
 	}
 
+	if(use_cache && !SONGINDEX->LoadCachedSong(*this))
+	{
+		LOG->Warn("The cache entry for '%s' couldn't be read; loading the song from its directory.", sDir.c_str());
+		// Start over with a blank song.
+		RString sSongName = m_sSongName;
+		RString sGroupName = m_sGroupName;
+		Reset();
+		m_sSongDir = sDir;
+		m_sSongName = sSongName;
+		m_sGroupName = sGroupName;
+		use_cache = false;
+	}
+
 	if(use_cache)
 	{
-		/*
-		LOG->Trace("Loading '%s' from cache file '%s'.",
-				   m_sSongDir.c_str(),
-				   GetCacheFilePath().c_str());
-		*/
-		SSCLoader loaderSSC;
-		bool bLoadedFromSSC = loaderSSC.LoadFromSimfile( cache_file_path, *this, true );
-		if( !bLoadedFromSSC )
-		{
-			// load from .sm
-			SMLoader loaderSM;
-			loaderSM.LoadFromSimfile( cache_file_path, *this, true );
-			loaderSM.TidyUpData( *this, true );
-		}
+		// Cache records are saved after SMLoader::TidyUpData, so only the
+		// song's own tidying is left to do.
+		TidyUpData(true, true);
 		if(m_sMainTitle == "" || (m_sMusicFile == "" && m_vsKeysoundFile.empty()))
 		{
 			LOG->Warn("Main title or music file for '%s' came up blank, forced to fall back on TidyUpData to fix title and paths.  Do not use # or ; in a song title.", m_sSongDir.c_str());
@@ -357,6 +350,8 @@ bool Song::LoadFromSongDir(RString sDir, bool load_autosave, ProfileSlot from_pr
 		// There was no entry in the cache for this song, or it was out of date.
 		// Let's load it from a file, then write a cache entry.
 
+		// Songs are loaded on several threads at once, so keep this per load.
+		std::set<RString> BlacklistedImages;
 		if(!NotesLoader::LoadFromDir(sDir, *this, BlacklistedImages, load_autosave))
 		{
 			LOG->UserLog( "Song", sDir, "has no SSC, SM, SMA, DWI, BMS, or KSF files." );
@@ -382,7 +377,7 @@ bool Song::LoadFromSongDir(RString sDir, bool load_autosave, ProfileSlot from_pr
 		// loading time. -Kyz
 		LoadEditsFromSongDir(sDir);
 
-		TidyUpData(false, true);
+		TidyUpData(false, true, &BlacklistedImages);
 
 		// Don't save a cache file if the autosave is being loaded, because the
 		// cache file would contain the autosave filename. -Kyz
@@ -391,9 +386,8 @@ bool Song::LoadFromSongDir(RString sDir, bool load_autosave, ProfileSlot from_pr
 		// entries. -Kyz
 		if(!load_autosave && m_LoadedFromProfile == ProfileSlot_Invalid)
 		{
-			// save a cache file so we don't have to parse it all over again next time
-			if(!SaveToCacheFile())
-			{ cache_file_path = RString(); }
+			// save a cache entry so we don't have to parse it all over again next time
+			SaveToCacheFile();
 		}
 	}
 
@@ -462,9 +456,9 @@ bool Song::LoadFromSongDir(RString sDir, bool load_autosave, ProfileSlot from_pr
  * Song/Steps objects to reload themselves. -- djpohly */
 bool Song::ReloadFromSongDir( RString sDir )
 {
-	// Remove the cache file to force the song to reload from its dir instead
+	// Remove the cache entry to force the song to reload from its dir instead
 	// of loading from the cache. -Kyz
-	FILEMAN->Remove(GetCacheFilePath());
+	SONGINDEX->RemoveCacheIndex(m_sSongDir);
 
 	RemoveAutoGenNotes();
 	std::vector<Steps*> vOldSteps = m_vpSteps;
@@ -626,7 +620,7 @@ void FixupPath( RString &path, const RString &sSongPath )
 }
 
 // Songs in BlacklistImages will never be autodetected as song images.
-void Song::TidyUpData( bool from_cache, bool /* duringCache */ )
+void Song::TidyUpData( bool from_cache, bool /* duringCache */, const std::set<RString> *pBlacklistedImages )
 {
 	// We need to do this before calling any of HasMusic, HasHasCDTitle, etc.
 	ASSERT_M(m_sSongDir.Left(3) != "../", m_sSongDir); // meaningless
@@ -967,7 +961,7 @@ void Song::TidyUpData( bool from_cache, bool /* duringCache */ )
 				// ignore DWI "-char" graphics
 				RString lower = image_list[i];
 				lower.MakeLower();
-				if(BlacklistedImages.find(lower) != BlacklistedImages.end())
+				if(pBlacklistedImages != nullptr && pBlacklistedImages->find(lower) != pBlacklistedImages->end())
 				continue;	// skip
 
 				// Skip any image that we've already classified
@@ -1180,12 +1174,13 @@ void Song::ReCalculateRadarValuesAndLastSecond(bool fromCache, bool duringCache)
 			}
 		}
 
-		// Wipe NoteData
+		// Wipe NoteData, but keep the SM data so the song cache can store it.
+		// It's dropped when the Steps are compressed after loading.
 		if (duringCache)
 		{
-			NoteData dummy;
-			dummy.SetNumTracks(tempNoteData.GetNumTracks());
-			pSteps->SetNoteData(dummy);
+			RString sNoteData;
+			pSteps->GetSMNoteData(sNoteData);
+			pSteps->SetSMNoteData(sNoteData);
 		}
 	}
 
@@ -1372,9 +1367,10 @@ bool Song::SaveToCacheFile()
 	{
 		return true;
 	}
-	SONGINDEX->AddCacheIndex(m_sSongDir, GetHashForDirectory(m_sSongDir));
-	const RString sPath = GetCacheFilePath();
-	return SaveToSSCFile(sPath, true);
+	RString sRecord;
+	SongCacheRecord::Write(*this, sRecord);
+	SONGINDEX->AddCacheRecord(m_sSongDir, SONGINDEX->GetDirectoryHash(m_sSongDir), sRecord);
+	return true;
 }
 
 bool Song::SaveToDWIFile()
@@ -104,8 +104,9 @@ public:
 	/**
 	 * @brief Call this after loading a song to clean up invalid data.
 	 * @param fromCache was this data loaded from the cache file?
-	 * @param duringCache was this data loaded during the cache process? */
-	void TidyUpData( bool fromCache = false, bool duringCache = false );
+	 * @param duringCache was this data loaded during the cache process?
+	 * @param pBlacklistedImages images not to use as the banner, background or CD title. */
+	void TidyUpData( bool fromCache = false, bool duringCache = false, const std::set<RString> *pBlacklistedImages = nullptr );
 
 	/**
 	 * @brief Get the new radar values, and determine the last second at the same time.
@@ -148,7 +149,6 @@ public:
 	{ return m_loaded_from_autosave; }
 
 	const RString &GetSongFilePath() const;
-	RString GetCacheFilePath() const;
 
 	void AddAutoGenNotes();
 	/**
@@ -424,6 +424,7 @@ public:
 	// TODO: Allow for a non const version.
 	const std::vector<Steps*>& GetAllSteps() const { return m_vpSteps; }
 	const std::vector<Steps*>& GetStepsByStepsType( StepsType st ) const { return m_vpStepsByType[st]; }
+	const std::vector<Steps*>& GetUnknownStyleSteps() const { return m_UnknownStyleSteps; }
 	bool IsEasy( StepsType st ) const;
 	bool IsTutorial() const;
 	bool HasEdits( StepsType st ) const;
@@ -1,15 +1,29 @@
 #include "global.h"
 
 #include "SongCacheIndex.h"
+#include "SongCacheRecord.h"
+#include "SongDirWatcher.h"
+#include "PrefsManager.h"
 #include "RageLog.h"
 #include "RageUtil.h"
+#include "RageFile.h"
 #include "RageFileManager.h"
 #include "Song.h"
 #include "SpecialFiles.h"
 #include "CommonMetrics.h"
 
 #include <cstddef>
+#include <cstdint>
+#include <ctime>
 #include <vector>
+#include <sys/stat.h>
+
+#if defined(WIN32)
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
 
 /*
  * A quick explanation of song cache hashes: Each song has two hashes; a hash of the
@@ -17,19 +31,41 @@
  * it stays the same if the contents of the directory change.  The latter is
  * GetHashForDirectory(m_sSongDir), and changes on each modification.
  *
- * The file hash is used as the cache filename.  We don't want to use the directory
- * hash: if we do that, then we'll write a new cache file every time the song changes,
- * and they'll accumulate or we'll have to be careful to delete them.
- *
  * The directory hash is stored in here, indexed by the song path, and used to determine
- * if a song has changed.
+ * if a song has changed.  Songs also keep their whole cache record in here (see
+ * SongCacheRecord); courses still write their own cache files.
  *
  * Another advantage of this system is that we can load songs from cache given only their
  * path; we don't have to actually look in the directory (to find out the directory hash)
- * in order to find the cache file.
+ * in order to find the cache entry.
+ *
+ * Finding the directory hash still means listing the directory, though.  To avoid that,
+ * each song directory also gets a manifest: its hash, the names of the files in it, and
+ * a stamp made by stat()ing the directory and those files on disk.  If the stamp hasn't
+ * changed, neither has the hash.  Group directories get the same treatment, so the song
+ * folders in an unchanged group are known without listing it.  Where inotify is
+ * available, directories that haven't changed since they were last checked don't even
+ * need to be stamped again.
+ *
+ * The cache file is laid out as:
+ *
+ *   header:  magic, CACHE_FORMAT_VERSION, FILE_CACHE_VERSION, entry count
+ *   index:   for each entry: path, directory hash, record offset, record size,
+ *            manifest offset, manifest size
+ *   groups:  group count; for each group: path, stamp, song folders, files
+ *   records: song records and manifests, at the offsets given in the index
+ *
+ * Everything is written in native byte order; a file from a machine with
+ * the other byte order fails the magic check and is rebuilt.
  */
-#define CACHE_INDEX SpecialFiles::CACHE_DIR + "index.cache"
+#define CACHE_INDEX (SpecialFiles::CACHE_DIR + "songs.cache")
 
+static const std::uint32_t CACHE_MAGIC = 0x43534D53; // "SMSC"
+// Bump this when the layout of the file or of song records changes.
+static const std::uint32_t CACHE_FORMAT_VERSION = 2;
+/* New records are held in memory until the file is written.  When caching a
+ * large library from scratch, write them out once they add up to this much. */
+static const std::size_t MAX_PENDING_RECORD_BYTES = 64*1024*1024;
 
 SongCacheIndex *SONGINDEX; // global and accessible from anywhere in our program
 
@@ -57,14 +93,20 @@ RString SongCacheIndex::GetCacheFilePath( const RString &sGroup, const RString &
 	return ssprintf( "%s%s/%s", SpecialFiles::CACHE_DIR.c_str(), sGroup.c_str(), s.c_str() );
 }
 
-SongCacheIndex::SongCacheIndex()
+SongCacheIndex::SongCacheIndex():
+	pDirWatcher( new SongDirWatcher(PREFSMAN->m_bWatchSongFolders) ),
+	bCacheIndexDirty( false ), iPendingRecordBytes( 0 ),
+	pCacheFile( nullptr ), iCacheFileSize( 0 ), bCacheFileMapped( false ),
+	CacheIndexLock( "SongCacheIndex" )
 {
 	ReadCacheIndex();
 }
 
 SongCacheIndex::~SongCacheIndex()
 {
-
+	SaveCacheIndex();
+	UnmapCacheFile();
+	delete pDirWatcher;
 }
 
 void SongCacheIndex::ReadFromDisk()
@@ -85,16 +127,161 @@ static void EmptyDir( RString dir )
 	}
 }
 
-void SongCacheIndex::ReadCacheIndex()
+bool SongCacheIndex::MapCacheFile()
+{
+	UnmapCacheFile();
+
+	RageFile f;
+	if( !f.Open(CACHE_INDEX, RageFile::READ) )
+		return false;
+
+	int iSize = f.GetFileSize();
+	if( iSize <= 0 )
+		return false;
+
+	/* Map the file if it's a real file on disk.  The mapping stays valid
+	 * after the file is closed. */
+	int iFD = f.GetFD();
+	if( iFD != -1 )
+	{
+#if defined(WIN32)
+		HANDLE hFile = reinterpret_cast<HANDLE>( _get_osfhandle(iFD) );
+		HANDLE hMapping = CreateFileMapping( hFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if( hMapping != nullptr )
+		{
+			pCacheFile = static_cast<const char *>( MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) );
+			CloseHandle( hMapping );
+		}
+#else
+		void *p = mmap( nullptr, iSize, PROT_READ, MAP_SHARED, iFD, 0 );
+		if( p != MAP_FAILED )
+			pCacheFile = static_cast<const char *>( p );
+#endif
+		if( pCacheFile != nullptr )
+		{
+			iCacheFileSize = iSize;
+			bCacheFileMapped = true;
+			return true;
+		}
+		LOG->Trace( "Couldn't map %s; reading it instead.", CACHE_INDEX.c_str() );
+	}
+
+	if( f.Read(sCacheFileData, iSize) != iSize )
+	{
+		LOG->Warn( "Error reading %s: %s", CACHE_INDEX.c_str(), f.GetError().c_str() );
+		sCacheFileData = RString();
+		return false;
+	}
+	pCacheFile = sCacheFileData.data();
+	iCacheFileSize = sCacheFileData.size();
+	return true;
+}
+
+void SongCacheIndex::UnmapCacheFile()
 {
-	CacheIndex.ReadFile( CACHE_INDEX );	// don't care if this fails
+	if( bCacheFileMapped )
+	{
+#if defined(WIN32)
+		UnmapViewOfFile( pCacheFile );
+#else
+		munmap( const_cast<char *>(pCacheFile), iCacheFileSize );
+#endif
+	}
+	pCacheFile = nullptr;
+	iCacheFileSize = 0;
+	bCacheFileMapped = false;
+	sCacheFileData = RString();
+}
+
+static void WriteStrings( SongCacheWriter &w, const std::vector<RString> &asStrings )
+{
+	w.WriteU32( static_cast<std::uint32_t>(asStrings.size()) );
+	for( RString const &s : asStrings )
+		w.WriteString( s );
+}
+
+static void ReadStrings( SongCacheReader &r, std::vector<RString> &asOut )
+{
+	std::uint32_t iCount = r.ReadU32();
+	for( std::uint32_t i = 0; i < iCount && !r.Error(); ++i )
+		asOut.push_back( r.ReadString() );
+}
+
+/* Find a block of the cache file, given its offset and size from the index. */
+static bool GetBlock( const char *pFile, std::size_t iFileSize, std::uint32_t iOffset, std::uint32_t iSize,
+	const char *&pBlock, std::size_t &iBlockSize )
+{
+	if( iSize == 0 )
+		return true;
+	if( iOffset > iFileSize || iSize > iFileSize - iOffset )
+		return false;
+	pBlock = pFile + iOffset;
+	iBlockSize = iSize;
+	return true;
+}
+
+/* Read the index of the mapped cache file.  Records are left in place, and
+ * only read when a song is loaded. */
+bool SongCacheIndex::ParseCacheFile()
+{
+	CacheIndex.clear();
+	GroupIndex.clear();
+	if( pCacheFile == nullptr )
+		return false;
+
+	SongCacheReader r( pCacheFile, iCacheFileSize );
+	if( r.ReadU32() != CACHE_MAGIC || r.ReadU32() != CACHE_FORMAT_VERSION ||
+		r.ReadS32() != FILE_CACHE_VERSION )
+		return false;
 
-	int iCacheVersion = -1;
-	CacheIndex.GetValue( "Cache", "CacheVersion", iCacheVersion );
-	if( iCacheVersion == FILE_CACHE_VERSION )
+	std::uint32_t iEntries = r.ReadU32();
+	for( std::uint32_t i = 0; i < iEntries && !r.Error(); ++i )
+	{
+		RString sPath = r.ReadString();
+		CacheEntry &entry = CacheIndex[sPath];
+		entry.hash = r.ReadU32();
+		std::uint32_t iRecordOffset = r.ReadU32();
+		std::uint32_t iRecordSize = r.ReadU32();
+		std::uint32_t iManifestOffset = r.ReadU32();
+		std::uint32_t iManifestSize = r.ReadU32();
+		if( !GetBlock(pCacheFile, iCacheFileSize, iRecordOffset, iRecordSize, entry.pRecord, entry.iRecordSize) ||
+			!GetBlock(pCacheFile, iCacheFileSize, iManifestOffset, iManifestSize, entry.pManifest, entry.iManifestSize) )
+		{
+			CacheIndex.clear();
+			return false;
+		}
+	}
+
+	std::uint32_t iGroups = r.ReadU32();
+	for( std::uint32_t i = 0; i < iGroups && !r.Error(); ++i )
+	{
+		RString sPath = r.ReadString();
+		GroupEntry &group = GroupIndex[sPath];
+		group.sStamp = r.ReadString();
+		ReadStrings( r, group.asSongDirs );
+		ReadStrings( r, group.asFiles );
+	}
+
+	if( r.Error() )
+	{
+		CacheIndex.clear();
+		GroupIndex.clear();
+		return false;
+	}
+	return true;
+}
+
+void SongCacheIndex::ReadCacheIndex()
+{
+	LockMut( CacheIndexLock );
+	bCacheIndexDirty = false;
+	iPendingRecordBytes = 0;
+	MapCacheFile();	// don't care if this fails
+	if( ParseCacheFile() )
 		return; // OK
 
 	LOG->Trace( "Cache format is out of date.  Deleting all cache files." );
+	UnmapCacheFile();
 	EmptyDir( SpecialFiles::CACHE_DIR );
 	EmptyDir( SpecialFiles::CACHE_DIR+"Songs/" );
 	EmptyDir( SpecialFiles::CACHE_DIR+"Courses/" );
@@ -104,7 +291,8 @@ void SongCacheIndex::ReadCacheIndex()
 	for( unsigned c=0; c<ImageDir.size(); c++ )
 		EmptyDir( SpecialFiles::CACHE_DIR+ImageDir[c]+"/" );
 
-	CacheIndex.Clear();
+	CacheIndex.clear();
+	GroupIndex.clear();
 	/* This is right now in place because our song file paths are apparently being
 	 * cached in two distinct areas, and songs were loading from paths in FILEMAN.
 	 * This is admittedly a hack for now, but this does bring up a good question on
@@ -113,39 +301,358 @@ void SongCacheIndex::ReadCacheIndex()
 	FILEMAN->FlushDirCache();
 }
 
+/* Write out the whole cache, and map the new file.  Records that were only
+ * held in memory are dropped in favor of the mapped copies. */
+void SongCacheIndex::WriteCacheFile()
+{
+	RString sHeader;
+	SongCacheWriter w( sHeader );
+	w.WriteU32( CACHE_MAGIC );
+	w.WriteU32( CACHE_FORMAT_VERSION );
+	w.WriteS32( FILE_CACHE_VERSION );
+	w.WriteU32( static_cast<std::uint32_t>(CacheIndex.size()) );
+
+	RString sGroups;
+	SongCacheWriter g( sGroups );
+	g.WriteU32( static_cast<std::uint32_t>(GroupIndex.size()) );
+	for( auto const &group : GroupIndex )
+	{
+		g.WriteString( group.first );
+		g.WriteString( group.second.sStamp );
+		WriteStrings( g, group.second.asSongDirs );
+		WriteStrings( g, group.second.asFiles );
+	}
+
+	std::size_t iHeaderSize = sHeader.size() + sGroups.size();
+	for( auto const &entry : CacheIndex )
+		iHeaderSize += sizeof(std::uint32_t) * 6 + entry.first.size();
+
+	std::size_t iOffset = iHeaderSize;
+	for( auto const &entry : CacheIndex )
+	{
+		w.WriteString( entry.first );
+		w.WriteU32( entry.second.hash );
+		w.WriteU32( entry.second.iRecordSize? static_cast<std::uint32_t>(iOffset):0 );
+		w.WriteU32( static_cast<std::uint32_t>(entry.second.iRecordSize) );
+		iOffset += entry.second.iRecordSize;
+		w.WriteU32( entry.second.iManifestSize? static_cast<std::uint32_t>(iOffset):0 );
+		w.WriteU32( static_cast<std::uint32_t>(entry.second.iManifestSize) );
+		iOffset += entry.second.iManifestSize;
+	}
+	sHeader += sGroups;
+	ASSERT( sHeader.size() == iHeaderSize );
+
+	if( iOffset > UINT32_MAX )
+	{
+		LOG->Warn( "The song cache is too large to write." );
+		return;
+	}
+
+	RageFile f;
+	if( !f.Open(CACHE_INDEX, RageFile::WRITE) )
+	{
+		LOG->Warn( "Couldn't open %s for writing: %s", CACHE_INDEX.c_str(), f.GetError().c_str() );
+		return;
+	}
+
+	f.Write( sHeader );
+	for( auto const &entry : CacheIndex )
+	{
+		if( entry.second.iRecordSize )
+			f.Write( entry.second.pRecord, entry.second.iRecordSize );
+		if( entry.second.iManifestSize )
+			f.Write( entry.second.pManifest, entry.second.iManifestSize );
+	}
+	if( f.Flush() == -1 )
+	{
+		LOG->Warn( "Error writing %s: %s", CACHE_INDEX.c_str(), f.GetError().c_str() );
+		return;
+	}
+
+	/* The new file replaces the old one when it's closed, which can't be done
+	 * while the old one is mapped on some platforms. */
+	UnmapCacheFile();
+	f.Close();
+
+	bCacheIndexDirty = false;
+	iPendingRecordBytes = 0;
+	MapCacheFile();
+	if( !ParseCacheFile() )
+		LOG->Warn( "Couldn't reload %s after writing it.", CACHE_INDEX.c_str() );
+}
+
 void SongCacheIndex::SaveCacheIndex()
 {
-	CacheIndex.WriteFile(CACHE_INDEX);
+	LockMut( CacheIndexLock );
+	if( bCacheIndexDirty )
+		WriteCacheFile();
 }
 
 void SongCacheIndex::AddCacheIndex(const RString &path, unsigned hash)
 {
 	if( hash == 0 )
 		++hash; /* no 0 hash values */
-	CacheIndex.SetValue( "Cache", "CacheVersion", FILE_CACHE_VERSION );
-	CacheIndex.SetValue( "Cache", MangleName(path), hash );
-	if(!delay_save_cache)
-	{
-		CacheIndex.WriteFile(CACHE_INDEX);
-	}
+	LockMut( CacheIndexLock );
+	CacheEntry &entry = CacheIndex[path];
+	entry.hash = hash;
+	bCacheIndexDirty = true;
+}
+
+void SongCacheIndex::AddCacheRecord( const RString &path, unsigned hash, const RString &sRecord )
+{
+	if( hash == 0 )
+		++hash; /* no 0 hash values */
+	LockMut( CacheIndexLock );
+	CacheEntry &entry = CacheIndex[path];
+	entry.hash = hash;
+	entry.sRecord = sRecord;
+	entry.pRecord = entry.sRecord.data();
+	entry.iRecordSize = entry.sRecord.size();
+	bCacheIndexDirty = true;
+	iPendingRecordBytes += entry.iRecordSize;
+	if( iPendingRecordBytes >= MAX_PENDING_RECORD_BYTES )
+		WriteCacheFile();
+}
+
+void SongCacheIndex::RemoveCacheIndex( const RString &path )
+{
+	LockMut( CacheIndexLock );
+	if( CacheIndex.erase(path) )
+		bCacheIndexDirty = true;
 }
 
 unsigned SongCacheIndex::GetCacheHash( const RString &path ) const
 {
-	unsigned iDirHash = 0;
-	if( !CacheIndex.GetValue( "Cache", MangleName(path), iDirHash ) )
+	LockMut( CacheIndexLock );
+	std::map<RString, CacheEntry>::const_iterator it = CacheIndex.find( path );
+	if( it == CacheIndex.end() )
 		return 0;
-	if( iDirHash == 0 )
-		++iDirHash; /* no 0 hash values */
-	return iDirHash;
+	return it->second.hash;
+}
+
+bool SongCacheIndex::LoadCachedSong( Song &out ) const
+{
+	/* Copy the song's metadata out, so the (slower) parsing isn't done with
+	 * the lock held.  The note data stays where it is until it's needed. */
+	RString sMetadata;
+	{
+		LockMut( CacheIndexLock );
+		std::map<RString, CacheEntry>::const_iterator it = CacheIndex.find( out.GetSongDir() );
+		if( it == CacheIndex.end() || it->second.iRecordSize == 0 )
+			return false;
+		const CacheEntry &entry = it->second;
+		sMetadata.assign( entry.pRecord, SongCacheRecord::GetMetadataSize(entry.pRecord, entry.iRecordSize) );
+	}
+
+	return !sMetadata.empty() && SongCacheRecord::Read( sMetadata.data(), sMetadata.size(), out );
 }
 
-RString SongCacheIndex::MangleName( const RString &Name )
+bool SongCacheIndex::LoadCachedNoteData( const RString &sSongDir, unsigned iOffset, RString &sOut ) const
 {
-	/* We store paths in an INI.  We can't store '='. */
-	RString ret = Name;
-	ret.Replace( "=", "");
-	return ret;
+	LockMut( CacheIndexLock );
+	std::map<RString, CacheEntry>::const_iterator it = CacheIndex.find( sSongDir );
+	if( it == CacheIndex.end() )
+		return false;
+	return SongCacheRecord::ReadNoteData( it->second.pRecord, it->second.iRecordSize, iOffset, sOut );
+}
+
+static bool StampPath( SongCacheWriter &w, const RString &sOsPath, std::time_t tNow, bool &bExists )
+{
+	struct stat st;
+	bExists = stat( sOsPath.c_str(), &st ) == 0;
+	w.WriteBool( bExists );
+	if( !bExists )
+		return true;
+
+	/* If this was changed in the last second, another change within the
+	 * same second wouldn't change its time stamp. */
+	if( st.st_mtime >= tNow - 1 )
+		return false;
+	w.WriteU32( static_cast<std::uint32_t>(st.st_mtime) );
+	w.WriteU32( static_cast<std::uint32_t>(st.st_size) );
+	return true;
+}
+
+/* Stamp a directory and the given files in it, by stat()ing them in every
+ * mounted folder the directory could come from.  Unlike listing the
+ * directory, this doesn't have to read it.  Adding, removing or writing
+ * any of them changes the stamp.
+ *
+ * Returns false if that can't be relied on: the directory isn't only on
+ * plain disk mounts, doesn't exist, or was changed too recently. */
+static bool GetDirStamp( const RString &sDir, const std::vector<RString> &asFiles, RString &sOut )
+{
+	std::vector<RString> asOsDirs;
+	if( !FILEMAN->GetOsPaths(sDir, asOsDirs) )
+		return false;
+
+	const std::time_t tNow = std::time( nullptr );
+	SongCacheWriter w( sOut );
+	bool bFound = false;
+	for( RString const &sOsDir : asOsDirs )
+	{
+		bool bExists;
+		if( !StampPath(w, sOsDir, tNow, bExists) )
+			return false;
+		if( !bExists )
+			continue;
+		bFound = true;
+		for( RString const &sFile : asFiles )
+		{
+			if( !StampPath(w, sOsDir + "/" + sFile, tNow, bExists) )
+				return false;
+		}
+	}
+	return bFound;
+}
+
+unsigned SongCacheIndex::GetDirectoryHash( const RString &sDir )
+{
+	/* Start watching before looking, so anything that changes after we look
+	 * is noticed next time. */
+	const bool bUnchanged = pDirWatcher->Watch( sDir );
+
+	RString sManifest;
+	{
+		LockMut( CacheIndexLock );
+		std::map<RString, CacheEntry>::const_iterator it = CacheIndex.find( sDir );
+		if( it != CacheIndex.end() && it->second.iManifestSize != 0 )
+			sManifest.assign( it->second.pManifest, it->second.iManifestSize );
+	}
+
+	if( !sManifest.empty() )
+	{
+		SongCacheReader r( sManifest.data(), sManifest.size() );
+		unsigned hash = r.ReadU32();
+		// The watcher can't see changes inside subdirectories; the stamp can.
+		bool bWatchable = r.ReadBool();
+		RString sStamp = r.ReadString();
+		std::vector<RString> asFiles;
+		ReadStrings( r, asFiles );
+		if( !r.Error() )
+		{
+			if( bUnchanged && bWatchable )
+				return hash;
+			RString sNewStamp;
+			if( GetDirStamp(sDir, asFiles, sNewStamp) && sNewStamp == sStamp )
+				return hash;
+		}
+	}
+
+	/* Something changed, or we haven't seen this directory before.  Make sure
+	 * the listing the hash comes from isn't an old one, and stamp it. */
+	std::vector<RString> asOsPaths;
+	const bool bOnDisk = FILEMAN->GetOsPaths( sDir, asOsPaths );
+	if( bOnDisk )
+		FILEMAN->FlushDir( sDir );
+	const unsigned hash = GetHashForDirectory( sDir );
+
+	RString sNewManifest;
+	if( bOnDisk )
+	{
+		std::vector<RString> asFiles, asSubdirs;
+		GetDirListing( sDir + "*", asFiles, false );
+		GetDirListing( sDir + "*", asSubdirs, true );
+
+		RString sStamp;
+		if( GetDirStamp(sDir, asFiles, sStamp) )
+		{
+			SongCacheWriter w( sNewManifest );
+			w.WriteU32( hash );
+			w.WriteBool( asSubdirs.empty() );
+			w.WriteString( sStamp );
+			WriteStrings( w, asFiles );
+		}
+	}
+
+	LockMut( CacheIndexLock );
+	std::map<RString, CacheEntry>::iterator it = CacheIndex.find( sDir );
+	if( it == CacheIndex.end() && sNewManifest.empty() )
+		return hash;
+	CacheEntry &entry = CacheIndex[sDir];
+	entry.sManifest = sNewManifest;
+	entry.pManifest = sNewManifest.empty()? nullptr:entry.sManifest.data();
+	entry.iManifestSize = entry.sManifest.size();
+	bCacheIndexDirty = true;
+	return hash;
+}
+
+void SongCacheIndex::GetGroupListing( const RString &sGroupDir, std::vector<RString> &asSongDirs, std::vector<RString> &asFiles )
+{
+	const bool bUnchanged = pDirWatcher->Watch( sGroupDir );
+
+	GroupEntry group;
+	bool bFound = false;
+	{
+		LockMut( CacheIndexLock );
+		std::map<RString, GroupEntry>::const_iterator it = GroupIndex.find( sGroupDir );
+		if( it != GroupIndex.end() )
+		{
+			group = it->second;
+			bFound = true;
+		}
+	}
+
+	if( bFound )
+	{
+		RString sStamp;
+		if( bUnchanged || (GetDirStamp(sGroupDir, group.asFiles, sStamp) && sStamp == group.sStamp) )
+		{
+			asSongDirs.insert( asSongDirs.end(), group.asSongDirs.begin(), group.asSongDirs.end() );
+			asFiles.insert( asFiles.end(), group.asFiles.begin(), group.asFiles.end() );
+			return;
+		}
+	}
+
+	std::vector<RString> asOsPaths;
+	const bool bOnDisk = FILEMAN->GetOsPaths( sGroupDir, asOsPaths );
+	if( bOnDisk )
+		FILEMAN->FlushDir( sGroupDir );
+
+	group = GroupEntry();
+	GetDirListing( sGroupDir + "/*", group.asSongDirs, true, true );
+	StripCvsAndSvn( group.asSongDirs );
+	StripMacResourceForks( group.asSongDirs );
+	SortRStringArray( group.asSongDirs );
+
+	std::vector<RString> asAll;
+	GetDirListing( sGroupDir + "/*", asAll, false, false );
+	for( RString const &sName : asAll )
+	{
+		if( !IsADirectory(sGroupDir + "/" + sName) )
+			group.asFiles.push_back( sName );
+	}
+
+	asSongDirs.insert( asSongDirs.end(), group.asSongDirs.begin(), group.asSongDirs.end() );
+	asFiles.insert( asFiles.end(), group.asFiles.begin(), group.asFiles.end() );
+
+	const bool bStamped = bOnDisk && GetDirStamp( sGroupDir, group.asFiles, group.sStamp );
+
+	LockMut( CacheIndexLock );
+	if( bStamped )
+		GroupIndex[sGroupDir] = group;
+	else if( !GroupIndex.erase(sGroupDir) )
+		return;
+	bCacheIndexDirty = true;
+}
+
+void SongCacheIndex::WatchDirectory( const RString &sDir )
+{
+	pDirWatcher->Watch( sDir );
+}
+
+bool SongCacheIndex::FlushChangedDirectories()
+{
+	std::vector<RString> asChanged;
+	if( !pDirWatcher->GetChangedDirs(asChanged) )
+		return false;
+
+	/* Subdirectories aren't watched, so anything under a changed folder may
+	 * have changed too. */
+	LOG->Trace( "%i song folders changed since they were last loaded.", (int) asChanged.size() );
+	for( RString const &sDir : asChanged )
+		FILEMAN->FlushDir( sDir, true );
+	return true;
 }
 
 /*
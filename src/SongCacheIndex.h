@@ -1,12 +1,68 @@
 #ifndef SONG_CACHE_INDEX_H
 #define SONG_CACHE_INDEX_H
 
-#include "IniFile.h"
+#include "RageThreads.h"
 
+#include <cstddef>
+#include <map>
+#include <vector>
+
+class Song;
+class SongDirWatcher;
+
+/**
+ * @brief The song cache: a single binary file holding the directory hash
+ * of every cached song and course, plus a record for each song.
+ *
+ * The file is memory-mapped when possible, so a warm start only touches the
+ * index and the song metadata; chart note data is paged in when it's used.
+ *
+ * It also keeps a snapshot of the song folders (see GetDirectoryHash and
+ * GetGroupListing), so folders that haven't changed needn't be listed. */
 class SongCacheIndex
 {
-	IniFile CacheIndex;
-	static RString MangleName( const RString &Name );
+	struct CacheEntry
+	{
+		CacheEntry(): hash(0), pRecord(nullptr), iRecordSize(0),
+			pManifest(nullptr), iManifestSize(0) { }
+		unsigned hash;
+		/* Points into the mapped file, or into sRecord for records added
+		 * since the file was last written. */
+		const char *pRecord;
+		std::size_t iRecordSize;
+		RString sRecord;
+		// The directory's manifest, kept the same way.
+		const char *pManifest;
+		std::size_t iManifestSize;
+		RString sManifest;
+	};
+	std::map<RString, CacheEntry> CacheIndex;
+
+	struct GroupEntry
+	{
+		RString sStamp;
+		std::vector<RString> asSongDirs;
+		std::vector<RString> asFiles;
+	};
+	std::map<RString, GroupEntry> GroupIndex;
+	SongDirWatcher *pDirWatcher;
+	bool bCacheIndexDirty;
+	std::size_t iPendingRecordBytes;
+
+	/* The cache file as mapped by MapCacheFile.  If it can't be mapped, it's
+	 * read into sCacheFileData instead. */
+	const char *pCacheFile;
+	std::size_t iCacheFileSize;
+	bool bCacheFileMapped;
+	RString sCacheFileData;
+
+	// Songs may be loaded from several threads at once.
+	mutable RageMutex CacheIndexLock;
+
+	bool MapCacheFile();
+	void UnmapCacheFile();
+	bool ParseCacheFile();
+	void WriteCacheFile();
 
 public:
 	SongCacheIndex();
@@ -15,10 +71,39 @@ public:
 	static RString GetCacheFilePath( const RString &sGroup, const RString &sPath );
 
 	void ReadCacheIndex();
+	/* Adding entries only changes the index in memory; this writes it out if
+	 * anything changed.  Call it after loading a batch of songs or courses.
+	 * It's also written when the index is destroyed. */
 	void SaveCacheIndex();
 	void AddCacheIndex( const RString &path, unsigned hash );
 	unsigned GetCacheHash( const RString &path ) const;
-	bool delay_save_cache;
+	void RemoveCacheIndex( const RString &path );
+
+	/** @brief Store a song record written by SongCacheRecord::Write. */
+	void AddCacheRecord( const RString &path, unsigned hash, const RString &sRecord );
+	/** @brief Fill in a blank song from its cache record.  Its song dir must be set. */
+	bool LoadCachedSong( Song &out ) const;
+	/** @brief Fetch a chart's note data from its song's cache record. */
+	bool LoadCachedNoteData( const RString &sSongDir, unsigned iOffset, RString &sOut ) const;
+
+	/**
+	 * @brief Return GetHashForDirectory(sDir).
+	 *
+	 * If nothing in the directory has changed since the last call, this is
+	 * known without listing it. */
+	unsigned GetDirectoryHash( const RString &sDir );
+	/**
+	 * @brief List the song folders (with paths) and the plain files (without)
+	 * in a group folder.
+	 *
+	 * If the folder hasn't changed since the last call, it isn't read. */
+	void GetGroupListing( const RString &sGroupDir, std::vector<RString> &asSongDirs, std::vector<RString> &asFiles );
+	/** @brief Start watching a folder whose listing is cached by FILEMAN. */
+	void WatchDirectory( const RString &sDir );
+	/**
+	 * @brief Flush FILEMAN's cache of the watched folders that changed.
+	 * @return false if it isn't known what changed. */
+	bool FlushChangedDirectories();
 };
 
 extern SongCacheIndex *SONGINDEX;	// global and accessible from anywhere in our program
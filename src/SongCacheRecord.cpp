@@ -0,0 +1,452 @@
+#include "global.h"
+#include "SongCacheRecord.h"
+#include "BackgroundUtil.h"
+#include "GameManager.h"
+#include "RageFileDriverDeflate.h"
+#include "RageLog.h"
+#include "Song.h"
+#include "Steps.h"
+#include "TimingData.h"
+
+#include <vector>
+
+/* Note data blocks start with this, so a stale offset is caught instead of
+ * being handed to the note data parser. */
+static const std::uint32_t NOTE_DATA_MAGIC = 0x444E4D53; // "SMND"
+
+void SongCacheRecord::WriteTiming( SongCacheWriter &w, const TimingData &timing )
+{
+	w.WriteFloat( timing.m_fBeat0OffsetInSeconds );
+
+	FOREACH_TimingSegmentType( tst )
+	{
+		const std::vector<TimingSegment*> &segs = timing.GetTimingSegments( tst );
+		w.WriteU32( static_cast<std::uint32_t>(segs.size()) );
+		for( const TimingSegment *seg : segs )
+		{
+			w.WriteS32( seg->GetRow() );
+			switch( tst )
+			{
+			case SEGMENT_BPM:	w.WriteFloat( ToBPM(seg)->GetBPM() ); break;
+			case SEGMENT_STOP:	w.WriteFloat( ToStop(seg)->GetPause() ); break;
+			case SEGMENT_DELAY:	w.WriteFloat( ToDelay(seg)->GetPause() ); break;
+			case SEGMENT_WARP:	w.WriteS32( ToWarp(seg)->GetLengthRows() ); break;
+			case SEGMENT_FAKE:	w.WriteS32( ToFake(seg)->GetLengthRows() ); break;
+			case SEGMENT_TICKCOUNT:	w.WriteS32( ToTickcount(seg)->GetTicks() ); break;
+			case SEGMENT_LABEL:	w.WriteString( ToLabel(seg)->GetLabel() ); break;
+			case SEGMENT_SCROLL:	w.WriteFloat( ToScroll(seg)->GetRatio() ); break;
+			case SEGMENT_TIME_SIG:
+				w.WriteS32( ToTimeSignature(seg)->GetNum() );
+				w.WriteS32( ToTimeSignature(seg)->GetDen() );
+				break;
+			case SEGMENT_COMBO:
+				w.WriteS32( ToCombo(seg)->GetCombo() );
+				w.WriteS32( ToCombo(seg)->GetMissCombo() );
+				break;
+			case SEGMENT_SPEED:
+				w.WriteFloat( ToSpeed(seg)->GetRatio() );
+				w.WriteFloat( ToSpeed(seg)->GetDelay() );
+				w.WriteU8( static_cast<std::uint8_t>(ToSpeed(seg)->GetUnit()) );
+				break;
+			default:
+				FAIL_M( ssprintf("Invalid timing segment type %i", tst) );
+			}
+		}
+	}
+}
+
+void SongCacheRecord::ReadTiming( SongCacheReader &r, TimingData &timing )
+{
+	timing.Clear();
+	timing.m_fBeat0OffsetInSeconds = r.ReadFloat();
+
+	FOREACH_TimingSegmentType( tst )
+	{
+		std::uint32_t iSegs = r.ReadU32();
+		for( std::uint32_t i = 0; i < iSegs && !r.Error(); ++i )
+		{
+			int iRow = r.ReadS32();
+			switch( tst )
+			{
+			case SEGMENT_BPM:	timing.AddSegment( BPMSegment(iRow, r.ReadFloat()) ); break;
+			case SEGMENT_STOP:	timing.AddSegment( StopSegment(iRow, r.ReadFloat()) ); break;
+			case SEGMENT_DELAY:	timing.AddSegment( DelaySegment(iRow, r.ReadFloat()) ); break;
+			case SEGMENT_WARP:	timing.AddSegment( WarpSegment(iRow, static_cast<int>(r.ReadS32())) ); break;
+			case SEGMENT_FAKE:	timing.AddSegment( FakeSegment(iRow, static_cast<int>(r.ReadS32())) ); break;
+			case SEGMENT_TICKCOUNT:	timing.AddSegment( TickcountSegment(iRow, r.ReadS32()) ); break;
+			case SEGMENT_LABEL:	timing.AddSegment( LabelSegment(iRow, r.ReadString()) ); break;
+			case SEGMENT_SCROLL:	timing.AddSegment( ScrollSegment(iRow, r.ReadFloat()) ); break;
+			case SEGMENT_TIME_SIG:
+			{
+				int iNum = r.ReadS32();
+				int iDen = r.ReadS32();
+				timing.AddSegment( TimeSignatureSegment(iRow, iNum, iDen) );
+				break;
+			}
+			case SEGMENT_COMBO:
+			{
+				int iCombo = r.ReadS32();
+				int iMissCombo = r.ReadS32();
+				timing.AddSegment( ComboSegment(iRow, iCombo, iMissCombo) );
+				break;
+			}
+			case SEGMENT_SPEED:
+			{
+				float fRatio = r.ReadFloat();
+				float fDelay = r.ReadFloat();
+				SpeedSegment::BaseUnit unit = static_cast<SpeedSegment::BaseUnit>( r.ReadU8() );
+				timing.AddSegment( SpeedSegment(iRow, fRatio, fDelay, unit) );
+				break;
+			}
+			default:
+				FAIL_M( ssprintf("Invalid timing segment type %i", tst) );
+			}
+		}
+	}
+}
+
+static void WriteStrings( SongCacheWriter &w, const std::vector<RString> &v )
+{
+	w.WriteU32( static_cast<std::uint32_t>(v.size()) );
+	for( const RString &s : v )
+		w.WriteString( s );
+}
+
+static void ReadStrings( SongCacheReader &r, std::vector<RString> &v )
+{
+	v.clear();
+	std::uint32_t iCount = r.ReadU32();
+	for( std::uint32_t i = 0; i < iCount && !r.Error(); ++i )
+		v.push_back( r.ReadString() );
+}
+
+static void WriteAttacks( SongCacheWriter &w, const AttackArray &attacks, const std::vector<RString> &vsAttackString )
+{
+	w.WriteU32( static_cast<std::uint32_t>(attacks.size()) );
+	for( const Attack &a : attacks )
+	{
+		w.WriteU8( static_cast<std::uint8_t>(a.level) );
+		w.WriteFloat( a.fStartSecond );
+		w.WriteFloat( a.fSecsRemaining );
+		w.WriteString( a.sModifiers );
+		w.WriteBool( a.bGlobal );
+		w.WriteBool( a.bShowInAttackList );
+	}
+	WriteStrings( w, vsAttackString );
+}
+
+static void ReadAttacks( SongCacheReader &r, AttackArray &attacks, std::vector<RString> &vsAttackString )
+{
+	attacks.clear();
+	std::uint32_t iCount = r.ReadU32();
+	for( std::uint32_t i = 0; i < iCount && !r.Error(); ++i )
+	{
+		Attack a;
+		a.level = static_cast<AttackLevel>( r.ReadU8() );
+		a.fStartSecond = r.ReadFloat();
+		a.fSecsRemaining = r.ReadFloat();
+		a.sModifiers = r.ReadString();
+		a.bGlobal = r.ReadBool();
+		a.bShowInAttackList = r.ReadBool();
+		attacks.push_back( a );
+	}
+	ReadStrings( r, vsAttackString );
+}
+
+static void WriteBackgroundChanges( SongCacheWriter &w, const std::vector<BackgroundChange> &changes )
+{
+	w.WriteU32( static_cast<std::uint32_t>(changes.size()) );
+	for( const BackgroundChange &bgc : changes )
+	{
+		w.WriteFloat( bgc.m_fStartBeat );
+		w.WriteFloat( bgc.m_fRate );
+		w.WriteString( bgc.m_sTransition );
+		w.WriteString( bgc.m_def.m_sEffect );
+		w.WriteString( bgc.m_def.m_sFile1 );
+		w.WriteString( bgc.m_def.m_sFile2 );
+		w.WriteString( bgc.m_def.m_sColor1 );
+		w.WriteString( bgc.m_def.m_sColor2 );
+	}
+}
+
+static void ReadBackgroundChanges( SongCacheReader &r, std::vector<BackgroundChange> &changes )
+{
+	changes.clear();
+	std::uint32_t iCount = r.ReadU32();
+	for( std::uint32_t i = 0; i < iCount && !r.Error(); ++i )
+	{
+		BackgroundChange bgc;
+		bgc.m_fStartBeat = r.ReadFloat();
+		bgc.m_fRate = r.ReadFloat();
+		bgc.m_sTransition = r.ReadString();
+		bgc.m_def.m_sEffect = r.ReadString();
+		bgc.m_def.m_sFile1 = r.ReadString();
+		bgc.m_def.m_sFile2 = r.ReadString();
+		bgc.m_def.m_sColor1 = r.ReadString();
+		bgc.m_def.m_sColor2 = r.ReadString();
+		changes.push_back( bgc );
+	}
+}
+
+void SongCacheRecord::Write( Song &song, RString &sOut )
+{
+	sOut = RString();
+	SongCacheWriter w( sOut );
+
+	// Size of everything before the note data; patched below.
+	w.WriteU32( 0 );
+
+	w.WriteString( song.m_sSongFileName );
+	w.WriteString( song.m_sMainTitle );
+	w.WriteString( song.m_sSubTitle );
+	w.WriteString( song.m_sArtist );
+	w.WriteString( song.m_sMainTitleTranslit );
+	w.WriteString( song.m_sSubTitleTranslit );
+	w.WriteString( song.m_sArtistTranslit );
+	w.WriteString( song.m_sGenre );
+	w.WriteString( song.m_sOrigin );
+	w.WriteString( song.m_sCredit );
+	w.WriteString( song.m_sBannerFile );
+	w.WriteString( song.m_sBackgroundFile );
+	w.WriteString( song.m_sPreviewVidFile );
+	w.WriteString( song.m_sJacketFile );
+	w.WriteString( song.m_sCDFile );
+	w.WriteString( song.m_sDiscFile );
+	w.WriteString( song.m_sLyricsFile );
+	w.WriteString( song.m_sCDTitleFile );
+	w.WriteString( song.m_sMusicFile );
+	w.WriteString( song.m_PreviewFile );
+	FOREACH_ENUM( InstrumentTrack, it )
+		w.WriteString( song.m_sInstrumentTrackFile[it] );
+
+	w.WriteFloat( song.m_fMusicSampleStartSeconds );
+	w.WriteFloat( song.m_fMusicSampleLengthSeconds );
+	w.WriteFloat( song.m_fMusicLengthSeconds );
+	w.WriteFloat( song.GetFirstSecond() );
+	w.WriteFloat( song.GetLastSecond() );
+	w.WriteFloat( song.GetSpecifiedLastSecond() );
+	w.WriteBool( song.m_bHasMusic );
+	w.WriteBool( song.m_bHasBanner );
+	w.WriteU8( static_cast<std::uint8_t>(song.m_SelectionDisplay) );
+	w.WriteU8( static_cast<std::uint8_t>(song.m_DisplayBPMType) );
+	w.WriteFloat( song.m_fSpecifiedBPMMin );
+	w.WriteFloat( song.m_fSpecifiedBPMMax );
+
+	WriteTiming( w, song.m_SongTiming );
+
+	FOREACH_BackgroundLayer( bl )
+		WriteBackgroundChanges( w, song.GetBackgroundChanges(bl) );
+	WriteBackgroundChanges( w, song.GetForegroundChanges() );
+	WriteStrings( w, song.m_vsKeysoundFile );
+	WriteAttacks( w, song.m_Attacks, song.m_sAttackString );
+
+	// Same set of charts as the .ssc writer saves.
+	std::vector<Steps*> vpSteps;
+	for( Steps *pSteps : song.GetAllSteps() )
+	{
+		if( !pSteps->IsAutogen() && !pSteps->WasLoadedFromProfile() )
+			vpSteps.push_back( pSteps );
+	}
+	for( Steps *pSteps : song.GetUnknownStyleSteps() )
+		vpSteps.push_back( pSteps );
+
+	/* Write chart metadata first and the note data blocks after all of it, so
+	 * loading a song only touches the front of its record. */
+	std::vector<std::size_t> viOffsetPos;
+	w.WriteU32( static_cast<std::uint32_t>(vpSteps.size()) );
+	for( const Steps *pSteps : vpSteps )
+	{
+		w.WriteString( pSteps->m_StepsTypeStr );
+		w.WriteString( pSteps->GetChartName() );
+		w.WriteString( pSteps->GetDescription() );
+		w.WriteString( pSteps->GetChartStyle() );
+		w.WriteS32( pSteps->GetDifficulty() );
+		w.WriteS32( pSteps->GetMeter() );
+		w.WriteString( pSteps->GetMusicFile() );
+		w.WriteString( pSteps->GetCredit() );
+
+		w.WriteU32( NUM_RadarCategory );
+		FOREACH_PlayerNumber( pn )
+		{
+			const RadarValues &rv = pSteps->GetRadarValues( pn );
+			FOREACH_ENUM( RadarCategory, rc )
+				w.WriteFloat( rv[rc] );
+		}
+
+		w.WriteBool( !pSteps->m_Timing.empty() );
+		if( !pSteps->m_Timing.empty() )
+			WriteTiming( w, pSteps->m_Timing );
+		WriteAttacks( w, pSteps->m_Attacks, pSteps->m_sAttackString );
+
+		w.WriteU8( static_cast<std::uint8_t>(pSteps->GetDisplayBPM()) );
+		w.WriteFloat( pSteps->GetMinBPM() );
+		w.WriteFloat( pSteps->GetMaxBPM() );
+		w.WriteString( pSteps->GetFilename() );
+
+		viOffsetPos.push_back( w.Tell() );
+		w.WriteU32( 0 );
+	}
+	w.PatchU32( 0, static_cast<std::uint32_t>(w.Tell()) );
+
+	for( unsigned i = 0; i < vpSteps.size(); ++i )
+	{
+		Steps *pSteps = vpSteps[i];
+		RString sNoteData;
+		pSteps->GetSMNoteData( sNoteData );
+		if( sNoteData.empty() && !pSteps->GetFilename().empty() )
+		{
+			// Charts loaded from the cache keep no note data in memory.
+			pSteps->Decompress();
+			pSteps->GetSMNoteData( sNoteData );
+		}
+
+		if( sNoteData.empty() )
+		{
+			pSteps->SetCacheNoteDataOffset( 0 );
+			continue;
+		}
+
+		RString sCompressed;
+		GzipString( sNoteData, sCompressed );
+
+		std::uint32_t iOffset = static_cast<std::uint32_t>( w.Tell() );
+		w.WriteU32( NOTE_DATA_MAGIC );
+		w.WriteString( sCompressed );
+		w.PatchU32( viOffsetPos[i], iOffset );
+		pSteps->SetCacheNoteDataOffset( iOffset );
+	}
+}
+
+bool SongCacheRecord::Read( const char *pData, std::size_t iSize, Song &out )
+{
+	SongCacheReader r( pData, iSize );
+
+	r.ReadU32(); // metadata size
+	out.m_sSongFileName = r.ReadString();
+	out.m_sMainTitle = r.ReadString();
+	out.m_sSubTitle = r.ReadString();
+	out.m_sArtist = r.ReadString();
+	out.m_sMainTitleTranslit = r.ReadString();
+	out.m_sSubTitleTranslit = r.ReadString();
+	out.m_sArtistTranslit = r.ReadString();
+	out.m_sGenre = r.ReadString();
+	out.m_sOrigin = r.ReadString();
+	out.m_sCredit = r.ReadString();
+	out.m_sBannerFile = r.ReadString();
+	out.m_sBackgroundFile = r.ReadString();
+	out.m_sPreviewVidFile = r.ReadString();
+	out.m_sJacketFile = r.ReadString();
+	out.m_sCDFile = r.ReadString();
+	out.m_sDiscFile = r.ReadString();
+	out.m_sLyricsFile = r.ReadString();
+	out.m_sCDTitleFile = r.ReadString();
+	out.m_sMusicFile = r.ReadString();
+	out.m_PreviewFile = r.ReadString();
+	FOREACH_ENUM( InstrumentTrack, it )
+		out.m_sInstrumentTrackFile[it] = r.ReadString();
+
+	out.m_fMusicSampleStartSeconds = r.ReadFloat();
+	out.m_fMusicSampleLengthSeconds = r.ReadFloat();
+	out.m_fMusicLengthSeconds = r.ReadFloat();
+	out.SetFirstSecond( r.ReadFloat() );
+	out.SetLastSecond( r.ReadFloat() );
+	out.SetSpecifiedLastSecond( r.ReadFloat() );
+	out.m_bHasMusic = r.ReadBool();
+	out.m_bHasBanner = r.ReadBool();
+	out.m_SelectionDisplay = static_cast<Song::SelectionDisplay>( r.ReadU8() );
+	out.m_DisplayBPMType = static_cast<DisplayBPM>( r.ReadU8() );
+	out.m_fSpecifiedBPMMin = r.ReadFloat();
+	out.m_fSpecifiedBPMMax = r.ReadFloat();
+
+	ReadTiming( r, out.m_SongTiming );
+	out.m_SongTiming.m_sFile = out.m_sSongFileName;
+
+	FOREACH_BackgroundLayer( bl )
+		ReadBackgroundChanges( r, out.GetBackgroundChanges(bl) );
+	ReadBackgroundChanges( r, out.GetForegroundChanges() );
+	ReadStrings( r, out.m_vsKeysoundFile );
+	ReadAttacks( r, out.m_Attacks, out.m_sAttackString );
+	out.m_fVersion = STEPFILE_VERSION_NUMBER;
+
+	if( r.Error() )
+		return false;
+
+	std::uint32_t iSteps = r.ReadU32();
+	for( std::uint32_t i = 0; i < iSteps && !r.Error(); ++i )
+	{
+		Steps *pNewNotes = out.CreateSteps();
+
+		pNewNotes->m_StepsTypeStr = r.ReadString();
+		pNewNotes->m_StepsType = GAMEMAN->StringToStepsType( pNewNotes->m_StepsTypeStr );
+		pNewNotes->SetChartName( r.ReadString() );
+		pNewNotes->SetDescription( r.ReadString() );
+		pNewNotes->SetChartStyle( r.ReadString() );
+		pNewNotes->SetDifficulty( static_cast<Difficulty>(r.ReadS32()) );
+		pNewNotes->SetMeter( r.ReadS32() );
+		pNewNotes->SetMusicFile( r.ReadString() );
+		pNewNotes->SetCredit( r.ReadString() );
+
+		/* The number of radar categories is stored, like the .ssc cache did,
+		 * so that a mismatch is caught rather than misreading the rest. */
+		if( r.ReadU32() != NUM_RadarCategory )
+		{
+			delete pNewNotes;
+			return false;
+		}
+		RadarValues v[NUM_PLAYERS];
+		FOREACH_PlayerNumber( pn )
+		{
+			FOREACH_ENUM( RadarCategory, rc )
+				v[pn][rc] = r.ReadFloat();
+		}
+		pNewNotes->SetCachedRadarValues( v );
+
+		if( r.ReadBool() )
+			ReadTiming( r, pNewNotes->m_Timing );
+		ReadAttacks( r, pNewNotes->m_Attacks, pNewNotes->m_sAttackString );
+
+		pNewNotes->SetDisplayBPM( static_cast<DisplayBPM>(r.ReadU8()) );
+		pNewNotes->SetMinBPM( r.ReadFloat() );
+		pNewNotes->SetMaxBPM( r.ReadFloat() );
+		pNewNotes->SetFilename( r.ReadString() );
+		pNewNotes->SetCacheNoteDataOffset( r.ReadU32() );
+
+		if( r.Error() )
+		{
+			delete pNewNotes;
+			return false;
+		}
+		out.AddSteps( pNewNotes );
+	}
+
+	return !r.Error();
+}
+
+std::size_t SongCacheRecord::GetMetadataSize( const char *pData, std::size_t iSize )
+{
+	SongCacheReader r( pData, iSize );
+	std::size_t iMetadataSize = r.ReadU32();
+	if( r.Error() || iMetadataSize > iSize )
+		return 0;
+	return iMetadataSize;
+}
+
+bool SongCacheRecord::ReadNoteData( const char *pData, std::size_t iSize, unsigned iOffset, RString &sOut )
+{
+	SongCacheReader r( pData, iSize );
+	r.Seek( iOffset );
+	if( r.ReadU32() != NOTE_DATA_MAGIC )
+		return false;
+
+	RString sCompressed = r.ReadString();
+	if( r.Error() )
+		return false;
+
+	RString sError;
+	if( !GunzipString(sCompressed, sOut, sError) )
+	{
+		LOG->Warn( "Song cache note data is corrupt: %s", sError.c_str() );
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,127 @@
+#ifndef SONG_CACHE_RECORD_H
+#define SONG_CACHE_RECORD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class Song;
+class TimingData;
+
+/** @brief Appends plain values to a binary cache buffer. */
+class SongCacheWriter
+{
+public:
+	SongCacheWriter( RString &sOut ): m_sOut(sOut) { }
+
+	void WriteU8( std::uint8_t i ) { m_sOut.append( 1, static_cast<char>(i) ); }
+	void WriteU32( std::uint32_t i ) { m_sOut.append( reinterpret_cast<const char *>(&i), sizeof(i) ); }
+	void WriteS32( std::int32_t i ) { m_sOut.append( reinterpret_cast<const char *>(&i), sizeof(i) ); }
+	void WriteFloat( float f ) { m_sOut.append( reinterpret_cast<const char *>(&f), sizeof(f) ); }
+	void WriteBool( bool b ) { WriteU8( b? 1:0 ); }
+	void WriteString( const RString &s )
+	{
+		WriteU32( static_cast<std::uint32_t>(s.size()) );
+		m_sOut.append( s );
+	}
+
+	std::size_t Tell() const { return m_sOut.size(); }
+	/** @brief Overwrite a value written earlier with WriteU32. */
+	void PatchU32( std::size_t iPos, std::uint32_t i ) { m_sOut.replace( iPos, sizeof(i), reinterpret_cast<const char *>(&i), sizeof(i) ); }
+
+private:
+	RString &m_sOut;
+};
+
+/**
+ * @brief Reads values written by SongCacheWriter.
+ *
+ * Reads past the end of the buffer fail and set an error flag instead of
+ * throwing, so a truncated cache file is simply treated as a cache miss. */
+class SongCacheReader
+{
+public:
+	SongCacheReader( const char *pData, std::size_t iSize ):
+		m_pData(pData), m_iSize(iSize), m_iPos(0), m_bError(false) { }
+
+	std::uint8_t ReadU8() { std::uint8_t i = 0; Read( &i, sizeof(i) ); return i; }
+	std::uint32_t ReadU32() { std::uint32_t i = 0; Read( &i, sizeof(i) ); return i; }
+	std::int32_t ReadS32() { std::int32_t i = 0; Read( &i, sizeof(i) ); return i; }
+	float ReadFloat() { float f = 0; Read( &f, sizeof(f) ); return f; }
+	bool ReadBool() { return ReadU8() != 0; }
+	RString ReadString()
+	{
+		std::uint32_t iLen = ReadU32();
+		if( !Check(iLen) )
+			return RString();
+		RString s( m_pData + m_iPos, iLen );
+		m_iPos += iLen;
+		return s;
+	}
+	/** @brief Return a pointer to the next iLen bytes without copying them. */
+	const char *Skip( std::size_t iLen )
+	{
+		if( !Check(iLen) )
+			return nullptr;
+		const char *p = m_pData + m_iPos;
+		m_iPos += iLen;
+		return p;
+	}
+
+	std::size_t Tell() const { return m_iPos; }
+	void Seek( std::size_t iPos ) { if( iPos > m_iSize ) m_bError = true; else m_iPos = iPos; }
+	bool Error() const { return m_bError; }
+
+private:
+	bool Check( std::size_t iLen )
+	{
+		if( m_bError || iLen > m_iSize - m_iPos )
+			m_bError = true;
+		return !m_bError;
+	}
+	void Read( void *p, std::size_t iLen )
+	{
+		if( Check(iLen) )
+		{
+			std::memcpy( p, m_pData + m_iPos, iLen );
+			m_iPos += iLen;
+		}
+	}
+
+	const char *m_pData;
+	std::size_t m_iSize;
+	std::size_t m_iPos;
+	bool m_bError;
+};
+
+/**
+ * @brief Binary song records stored in the song cache.
+ *
+ * A record holds everything the .ssc cache files used to: song metadata,
+ * timing, background changes and per-chart metadata with cached radar
+ * values.  Each chart's note data is stored gzipped in its own block, so
+ * it is only read (and paged in, when the cache is mapped) once Steps
+ * actually need it. */
+namespace SongCacheRecord
+{
+	/**
+	 * @brief Serialize a song.
+	 *
+	 * Each saved Steps is told where its note data lives in the record. */
+	void Write( Song &song, RString &sOut );
+	/**
+	 * @brief Fill in a blank song from a record written by Write.
+	 *
+	 * Only the start of the record, up to GetMetadataSize, is needed. */
+	bool Read( const char *pData, std::size_t iSize, Song &out );
+	/** @brief Return the size of the part of a record read by Read. */
+	std::size_t GetMetadataSize( const char *pData, std::size_t iSize );
+	/** @brief Read the note data block at iOffset of a record. */
+	bool ReadNoteData( const char *pData, std::size_t iSize, unsigned iOffset, RString &sOut );
+
+	void WriteTiming( SongCacheWriter &w, const TimingData &timing );
+	void ReadTiming( SongCacheReader &r, TimingData &timing );
+}
+
+#endif
+
@@ -0,0 +1,208 @@
+#include "global.h"
+
+#include "SongDirWatcher.h"
+#include "RageFileManager.h"
+#include "RageLog.h"
+#include "RageUtil.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#if defined(LINUX)
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/* Anything that changes a directory's listing, or a file in it. */
+static const std::uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+	IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+static RString DirKey( const RString &sDir )
+{
+	if( sDir.Right(1) == "/" )
+		return sDir;
+	return sDir + "/";
+}
+#endif
+
+SongDirWatcher::SongDirWatcher( bool bEnable ):
+	m_iFD( -1 ), m_bLostEvents( false ), m_Lock( "SongDirWatcher" )
+{
+#if defined(LINUX)
+	if( !bEnable )
+		return;
+	m_iFD = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( m_iFD == -1 )
+		LOG->Warn( "Couldn't watch song folders for changes: %s", strerror(errno) );
+#endif
+}
+
+SongDirWatcher::~SongDirWatcher()
+{
+	Disable();
+}
+
+void SongDirWatcher::Disable()
+{
+#if defined(LINUX)
+	if( m_iFD != -1 )
+		close( m_iFD );
+#endif
+	m_iFD = -1;
+	m_Dirs.clear();
+	m_WatchDescriptors.clear();
+}
+
+bool SongDirWatcher::Watch( const RString &sDir_ )
+{
+#if defined(LINUX)
+	const RString sDir = DirKey( sDir_ );
+
+	LockMut( m_Lock );
+	if( m_iFD == -1 )
+		return false;
+
+	/* Don't answer from what we knew at the last GetChangedDirs; the
+	 * directory may have changed since. */
+	ReadEvents();
+	if( m_bLostEvents )
+		return false;
+
+	std::map<RString, WatchedDir>::iterator it = m_Dirs.find( sDir );
+	if( it != m_Dirs.end() && it->second.iWatches > 0 )
+	{
+		bool bUnchanged = !it->second.bChanged;
+		it->second.bChanged = false;
+		return bUnchanged;
+	}
+
+	std::vector<RString> asOsPaths;
+	if( !FILEMAN->GetOsPaths(sDir, asOsPaths) )
+		return false;
+
+	WatchedDir dir;
+	std::vector<int> aiWatches;
+	for( RString const &sOsPath : asOsPaths )
+	{
+		int iWD = inotify_add_watch( m_iFD, sOsPath.c_str(), WATCH_MASK );
+		if( iWD == -1 )
+		{
+			// It's fine for the directory not to exist in every mount.
+			if( errno == ENOENT || errno == ENOTDIR )
+				continue;
+
+			/* Most likely, we're out of watches (see fs.inotify.max_user_watches).
+			 * A directory that isn't watched could change without our knowing,
+			 * so stop tracking changes at all. */
+			LOG->Warn( "Couldn't watch \"%s\" for changes (%s); song folders will be checked in full on reload.",
+				sOsPath.c_str(), strerror(errno) );
+			Disable();
+			return false;
+		}
+
+		/* If this is already watched as another directory (through a symlink,
+		 * say), a change would only be credited to one of them. */
+		std::map<int, RString>::const_iterator wd = m_WatchDescriptors.find( iWD );
+		if( wd != m_WatchDescriptors.end() && wd->second != sDir )
+			return false;
+
+		aiWatches.push_back( iWD );
+		++dir.iWatches;
+	}
+
+	if( dir.iWatches == 0 )
+		return false;
+
+	for( int iWD : aiWatches )
+		m_WatchDescriptors[iWD] = sDir;
+	m_Dirs[sDir] = dir;
+#endif
+	return false;
+}
+
+void SongDirWatcher::MarkChanged( const RString &sDir )
+{
+	std::map<RString, WatchedDir>::iterator it = m_Dirs.find( sDir );
+	if( it != m_Dirs.end() )
+		it->second.bChanged = true;
+}
+
+void SongDirWatcher::ReadEvents()
+{
+#if defined(LINUX)
+	alignas(struct inotify_event) char buf[4096];
+	for(;;)
+	{
+		ssize_t iGot = read( m_iFD, buf, sizeof(buf) );
+		if( iGot <= 0 )
+			break; // EAGAIN: nothing left to read
+
+		for( const char *p = buf; p < buf + iGot; )
+		{
+			const struct inotify_event *pEvent = reinterpret_cast<const struct inotify_event *>( p );
+			p += sizeof(struct inotify_event) + pEvent->len;
+
+			if( pEvent->mask & IN_Q_OVERFLOW )
+			{
+				m_bLostEvents = true;
+				continue;
+			}
+
+			std::map<int, RString>::iterator wd = m_WatchDescriptors.find( pEvent->wd );
+			if( wd == m_WatchDescriptors.end() )
+				continue;
+			const RString sDir = wd->second;
+			MarkChanged( sDir );
+
+			/* A subdirectory that came or went here may be watched from
+			 * another mount, where it didn't change. */
+			if( (pEvent->mask & IN_ISDIR) && pEvent->len )
+				MarkChanged( sDir + pEvent->name + "/" );
+
+			// The directory was deleted or unmounted, and its watch is gone.
+			if( pEvent->mask & IN_IGNORED )
+			{
+				m_WatchDescriptors.erase( wd );
+				std::map<RString, WatchedDir>::iterator it = m_Dirs.find( sDir );
+				if( it != m_Dirs.end() )
+					--it->second.iWatches;
+			}
+		}
+	}
+#endif
+}
+
+bool SongDirWatcher::GetChangedDirs( std::vector<RString> &asOut )
+{
+	LockMut( m_Lock );
+	if( m_iFD == -1 )
+		return false;
+
+	ReadEvents();
+	if( m_bLostEvents )
+	{
+		/* The kernel's queue overflowed, so anything could have changed.
+		 * Make everything get checked again. */
+		LOG->Trace( "Song folder change events were lost." );
+		m_bLostEvents = false;
+		for( auto &dir : m_Dirs )
+			dir.second.bChanged = true;
+		return false;
+	}
+
+	for( std::map<RString, WatchedDir>::iterator it = m_Dirs.begin(); it != m_Dirs.end(); )
+	{
+		if( it->second.bChanged )
+		{
+			asOut.push_back( it->first );
+			// Forget directories that are gone; Watch will pick them up if they return.
+			if( it->second.iWatches <= 0 )
+			{
+				m_Dirs.erase( it++ );
+				continue;
+			}
+		}
+		++it;
+	}
+	return true;
+}
@@ -0,0 +1,57 @@
+#ifndef SONG_DIR_WATCHER_H
+#define SONG_DIR_WATCHER_H
+
+#include "RageThreads.h"
+
+#include <map>
+#include <vector>
+
+/**
+ * @brief Keeps track of which song folders have changed, so reloading songs
+ * can skip the ones that haven't.
+ *
+ * This uses inotify, so it only does anything on Linux.  Elsewhere, or once
+ * the kernel runs out of watches, every folder counts as changed. */
+class SongDirWatcher
+{
+public:
+	SongDirWatcher( bool bEnable );
+	~SongDirWatcher();
+
+	/**
+	 * @brief Start watching a directory, if it isn't being watched already.
+	 *
+	 * Either way, the directory counts as unchanged from now on.
+	 * @param sDir the VFS path of the directory.
+	 * @return true if it was already being watched and hasn't changed since. */
+	bool Watch( const RString &sDir );
+
+	/**
+	 * @brief Read pending changes, and list every watched directory that has
+	 * changed.
+	 *
+	 * Directories stay on the list until they're passed to Watch again.
+	 * @return false if changes couldn't be tracked, so anything may have
+	 * changed. */
+	bool GetChangedDirs( std::vector<RString> &asOut );
+
+private:
+	void ReadEvents();
+	void MarkChanged( const RString &sDir );
+	void Disable();
+
+	struct WatchedDir
+	{
+		WatchedDir(): iWatches(0), bChanged(false) { }
+		// One for each mounted folder the directory exists in.
+		int iWatches;
+		bool bChanged;
+	};
+	std::map<RString, WatchedDir> m_Dirs;
+	std::map<int, RString> m_WatchDescriptors;
+	int m_iFD;
+	bool m_bLostEvents;
+	RageMutex m_Lock;
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include "RageFile.h"
 #include "RageFileManager.h"
 #include "RageLog.h"
+#include "RageThreads.h"
 #include "Song.h"
 #include "SongCacheIndex.h"
 #include "SongUtil.h"
@@ -38,7 +39,10 @@
 #include "UnlockManager.h"
 #include "SpecialFiles.h"
 
+#include <atomic>
 #include <cstddef>
+#include <memory>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -122,7 +126,9 @@ static LocalizedString SANITY_CHECKING_GROUPS("SongManager", "Sanity checking gr
 
 void SongManager::Reload( bool bAllowFastLoad, LoadingWindow *ld )
 {
-	FILEMAN->FlushDirCache( SpecialFiles::SONGS_DIR );
+	// If we know which song folders changed, only forget those.
+	if( !SONGINDEX->FlushChangedDirectories() )
+		FILEMAN->FlushDirCache( SpecialFiles::SONGS_DIR );
 	FILEMAN->FlushDirCache( SpecialFiles::COURSES_DIR );
 	FILEMAN->FlushDirCache( EDIT_SUBDIR );
 
@@ -218,7 +224,8 @@ void SongManager::Reload( bool bAllowFastLoad, LoadingWindow *ld )
 
 void SongManager::LoadAdditions( LoadingWindow *ld )
 {
-	FILEMAN->FlushDirCache( SpecialFiles::SONGS_DIR );
+	if( !SONGINDEX->FlushChangedDirectories() )
+		FILEMAN->FlushDirCache( SpecialFiles::SONGS_DIR );
 	FILEMAN->FlushDirCache( SpecialFiles::COURSES_DIR );
 	FILEMAN->FlushDirCache( EDIT_SUBDIR );
 
@@ -232,14 +239,12 @@ void SongManager::LoadAdditions( LoadingWindow *ld )
 void SongManager::InitSongsFromDisk( LoadingWindow *ld, bool onlyAdditions )
 {
 	RageTimer tm;
-	// Tell SONGINDEX to not write the cache index file every time a song adds
+	// Tell IMAGECACHE to not write the cache index file every time a song adds
 	// an entry. -Kyz
-	SONGINDEX->delay_save_cache = true;
 	IMAGECACHE->delay_save_cache = true;
 	LoadSongDir( SpecialFiles::SONGS_DIR, ld, onlyAdditions );
 	LoadEnabledSongsFromPref();
 	SONGINDEX->SaveCacheIndex();
-	SONGINDEX->delay_save_cache = false;
 	IMAGECACHE->WriteToDisk();
 	IMAGECACHE->delay_save_cache = false;
 
@@ -247,13 +252,11 @@ void SongManager::InitSongsFromDisk( LoadingWindow *ld, bool onlyAdditions )
 }
 
 static LocalizedString FOLDER_CONTAINS_MUSIC_FILES( "SongManager", "The folder \"%s\" appears to be a song folder.  All song folders must reside in a group folder.  For example, \"Songs/Originals/My Song\"." );
-void SongManager::SanityCheckGroupDir( RString sDir ) const
+void SongManager::SanityCheckGroupDir( RString sDir, const std::vector<RString> &asGroupFiles ) const
 {
 	// Check to see if they put a song directly inside the group folder.
-	std::vector<RString> arrayFiles;
-	GetDirListing( sDir + "/*", arrayFiles );
 	const std::vector<RString>& audio_exts= ActorUtil::GetTypeExtensionList(FT_Sound);
-	for (RString &fname : arrayFiles)
+	for (RString const &fname : asGroupFiles)
 	{
 		const RString ext= GetExtension(fname);
 		for (RString const &aud : audio_exts)
@@ -267,7 +270,18 @@ void SongManager::SanityCheckGroupDir( RString sDir ) const
 	}
 }
 
-void SongManager::AddGroup( RString sDir, RString sGroupDirName )
+/* Add the files with the given extension to asOut, as GetDirListing( "*.ext" )
+ * would if they were listed from disk. */
+static void GetFilesWithExtension( const std::vector<RString> &asFiles, const RString &sExt, std::vector<RString> &asOut )
+{
+	for (RString const &sFile : asFiles)
+	{
+		if( GetExtension(sFile).EqualsNoCase(sExt) )
+			asOut.push_back( sFile );
+	}
+}
+
+void SongManager::AddGroup( RString sDir, RString sGroupDirName, const std::vector<RString> &asGroupFiles )
 {
 	unsigned j;
 	for(j = 0; j < m_sSongGroupNames.size(); ++j)
@@ -279,11 +293,11 @@ void SongManager::AddGroup( RString sDir, RString sGroupDirName )
 
 	// Look for a group banner in this group folder
 	std::vector<RString> arrayGroupBanners;
-	GetDirListing( sDir+sGroupDirName+"/*.png", arrayGroupBanners );
-	GetDirListing( sDir+sGroupDirName+"/*.jpg", arrayGroupBanners );
-	GetDirListing( sDir+sGroupDirName+"/*.jpeg", arrayGroupBanners );
-	GetDirListing( sDir+sGroupDirName+"/*.gif", arrayGroupBanners );
-	GetDirListing( sDir+sGroupDirName+"/*.bmp", arrayGroupBanners );
+	GetFilesWithExtension( asGroupFiles, "png", arrayGroupBanners );
+	GetFilesWithExtension( asGroupFiles, "jpg", arrayGroupBanners );
+	GetFilesWithExtension( asGroupFiles, "jpeg", arrayGroupBanners );
+	GetFilesWithExtension( asGroupFiles, "gif", arrayGroupBanners );
+	GetFilesWithExtension( asGroupFiles, "bmp", arrayGroupBanners );
 
 	RString sBannerPath;
 	if( !arrayGroupBanners.empty() )
@@ -339,6 +353,90 @@ void SongManager::AddGroup( RString sDir, RString sGroupDirName )
 }
 
 static LocalizedString LOADING_SONGS ( "SongManager", "Loading songs..." );
+
+/* Parsing a song directory (or its cache file) doesn't depend on any other
+ * song, so with SongLoadThreads != 1 the directories are handed out to a pool
+ * of worker threads.  Only Song::LoadFromSongDir runs on the workers; adding
+ * the results to the song lists and groups is still done on the main thread,
+ * in directory order, so the result is the same as a serial load. */
+struct SongLoadPool
+{
+	SongLoadPool( const std::vector<RString> &song_dirs ):
+		m_SongDirs(song_dirs), m_Songs(song_dirs.size(), nullptr),
+		m_iNextJob(0), m_Finished("SongLoadPool") { }
+
+	const std::vector<RString> &m_SongDirs;
+	std::vector<Song*> m_Songs;
+	std::atomic<std::size_t> m_iNextJob;
+	// Posted once for each song directory that has been processed.
+	RageSemaphore m_Finished;
+};
+
+static int SongLoadWorkerMain( void *p )
+{
+	SongLoadPool *pool = static_cast<SongLoadPool*>( p );
+	for(;;)
+	{
+		const std::size_t job = pool->m_iNextJob++;
+		if( job >= pool->m_SongDirs.size() )
+			break;
+
+		Song* pNewSong = new Song;
+		if( !pNewSong->LoadFromSongDir( pool->m_SongDirs[job] ) )
+		{
+			// The song failed to load.
+			SAFE_DELETE( pNewSong );
+		}
+		pool->m_Songs[job] = pNewSong;
+		pool->m_Finished.Post();
+	}
+	return 0;
+}
+
+static int GetSongLoadThreadCount( std::size_t iNumSongs )
+{
+	int iThreads = PREFSMAN->m_iSongLoadThreads;
+	if( iThreads <= 0 )
+		iThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	return static_cast<int>( std::min<std::size_t>(iThreads, iNumSongs) );
+}
+
+/* Load every directory in song_dirs on iThreads worker threads.  The returned
+ * vector is parallel to song_dirs, with nullptr for songs that failed to load. */
+static std::vector<Song*> LoadSongsInParallel( const std::vector<RString> &song_dirs,
+	int iThreads, LoadingWindow *ld )
+{
+	SongLoadPool pool( song_dirs );
+
+	std::vector<std::unique_ptr<RageThread>> workers;
+	for( int i = 0; i < iThreads; ++i )
+	{
+		workers.emplace_back( new RageThread );
+		workers.back()->SetName( ssprintf("Song load thread %i", i) );
+		workers.back()->Create( SongLoadWorkerMain, &pool );
+	}
+
+	RageTimer loading_window_last_update_time;
+	for( std::size_t i = 0; i < song_dirs.size(); ++i )
+	{
+		// Loading a single song can legitimately take a long time, so don't
+		// let the semaphore time out.
+		pool.m_Finished.Wait( false );
+		if( ld && loading_window_last_update_time.Ago() > next_loading_window_update )
+		{
+			loading_window_last_update_time.Touch();
+			ld->SetProgress( i );
+			ld->SetText( LOADING_SONGS.GetValue() +
+				ssprintf("\n%i / %i", int(i+1), int(song_dirs.size())) );
+		}
+	}
+
+	for( std::unique_ptr<RageThread> &worker : workers )
+		worker->Wait();
+
+	return pool.m_Songs;
+}
+
 void SongManager::LoadSongDir( RString sDir, LoadingWindow *ld, bool onlyAdditions )
 {
 	if( ld )
@@ -355,6 +453,7 @@ void SongManager::LoadSongDir( RString sDir, LoadingWindow *ld, bool onlyAdditio
 		sDir += "/";
 
 	// Find all group directories in "Songs" folder
+	SONGINDEX->WatchDirectory( sDir );
 	std::vector<RString> arrayGroupDirs;
 	GetDirListing( sDir+"*", arrayGroupDirs, true );
 	SortRStringArray( arrayGroupDirs );
@@ -362,6 +461,7 @@ void SongManager::LoadSongDir( RString sDir, LoadingWindow *ld, bool onlyAdditio
 	StripMacResourceForks( arrayGroupDirs );
 
 	std::vector<std::vector<RString>> arrayGroupSongDirs;
+	std::vector<std::vector<RString>> arrayGroupFiles;
 	int groupIndex, songCount, songIndex;
 
 	groupIndex = 0;
@@ -381,17 +481,16 @@ void SongManager::LoadSongDir( RString sDir, LoadingWindow *ld, bool onlyAdditio
 			ld->SetText(SANITY_CHECKING_GROUPS.GetValue() + ssprintf("\n%s",
 					Basename(sGroupDirName).c_str()));
 		}
-		// TODO: If this check fails, log a warning instead of crashing.
-		SanityCheckGroupDir(sDir+sGroupDirName);
+		// Find all Song folders in this group directory.  This doesn't have
+		// to read the folder if it hasn't changed since last time.
+		std::vector<RString> arraySongDirs, arrayFiles;
+		SONGINDEX->GetGroupListing( sDir+sGroupDirName, arraySongDirs, arrayFiles );
 
-		// Find all Song folders in this group directory
-		std::vector<RString> arraySongDirs;
-		GetDirListing( sDir+sGroupDirName + "/*", arraySongDirs, true, true );
-		StripCvsAndSvn( arraySongDirs );
-		StripMacResourceForks( arraySongDirs );
-		SortRStringArray( arraySongDirs );
+		// TODO: If this check fails, log a warning instead of crashing.
+		SanityCheckGroupDir(sDir+sGroupDirName, arrayFiles);
 
 		arrayGroupSongDirs.push_back(arraySongDirs);
+		arrayGroupFiles.push_back(arrayFiles);
 		songCount += arraySongDirs.size();
 
 	}
@@ -403,11 +502,48 @@ void SongManager::LoadSongDir( RString sDir, LoadingWindow *ld, bool onlyAdditio
 		ld->SetTotalWork( songCount );
 	}
 
+	// Skip already loaded songs if onlyAdditions is set.
+	if( onlyAdditions )
+	{
+		for (std::vector<RString> &arraySongDirs : arrayGroupSongDirs)
+		{
+			std::vector<RString> new_song_dirs;
+			for (RString const &sSongDirName : arraySongDirs)
+			{
+				SongID songID;
+				songID.FromString(sSongDirName);
+				if (songID.ToSong() == nullptr)
+					new_song_dirs.push_back(sSongDirName);
+			}
+			arraySongDirs.swap(new_song_dirs);
+		}
+	}
+
+	// With more than one thread, parse all of the songs up front; they're
+	// added to the groups below exactly as if they had been loaded serially.
+	std::vector<Song*> preloaded_songs;
+	std::size_t preloaded_index = 0;
+	std::size_t songs_to_load = 0;
+	for (std::vector<RString> const &arraySongDirs : arrayGroupSongDirs)
+		songs_to_load += arraySongDirs.size();
+	const int iLoadThreads = GetSongLoadThreadCount( songs_to_load );
+	if( iLoadThreads > 1 )
+	{
+		std::vector<RString> all_song_dirs;
+		all_song_dirs.reserve( songs_to_load );
+		for (std::vector<RString> const &arraySongDirs : arrayGroupSongDirs)
+			all_song_dirs.insert( all_song_dirs.end(), arraySongDirs.begin(), arraySongDirs.end() );
+
+		LOG->Trace( "Loading %i songs on %i threads", int(songs_to_load), iLoadThreads );
+		preloaded_songs = LoadSongsInParallel( all_song_dirs, iLoadThreads, ld );
+	}
+
 	groupIndex = 0;
 	songIndex = 0;
 	for (RString const &sGroupDirName : arrayGroupDirs)	// foreach dir in /Songs/
 	{
-		std::vector<RString> &arraySongDirs = arrayGroupSongDirs[groupIndex++];
+		std::vector<RString> &arraySongDirs = arrayGroupSongDirs[groupIndex];
+		const std::vector<RString> &arrayFiles = arrayGroupFiles[groupIndex++];
 
 		LOG->Trace("Attempting to load %i songs from \"%s\"", int(arraySongDirs.size()),
 				   (sDir+sGroupDirName).c_str() );
@@ -419,34 +555,35 @@ void SongManager::LoadSongDir( RString sDir, LoadingWindow *ld, bool onlyAdditio
 		{
 			RString sSongDirName = arraySongDirs[j];
 
-			// Skip already loaded songs if onlyAdditions is set.
-			if (onlyAdditions)
+			Song* pNewSong;
+			if( iLoadThreads > 1 )
 			{
-				SongID songID;
-				songID.FromString(sSongDirName);
-				if (songID.ToSong() != nullptr)
-					continue;
+				pNewSong = preloaded_songs[preloaded_index++];
+				if( pNewSong == nullptr )
+					continue; // The song failed to load.
 			}
-
-			// this is a song directory. Load a new song.
-			if(ld && loading_window_last_update_time.Ago() > next_loading_window_update)
+			else
 			{
-				loading_window_last_update_time.Touch();
-				ld->SetProgress(songIndex);
-				ld->SetText( LOADING_SONGS.GetValue() +
-					ssprintf("\n%s\n%s",
-						group_base_name.c_str(),
-						Basename(sSongDirName).c_str()
-					)
-				);
-			}
+				// this is a song directory. Load a new song.
+				if(ld && loading_window_last_update_time.Ago() > next_loading_window_update)
+				{
+					loading_window_last_update_time.Touch();
+					ld->SetProgress(songIndex);
+					ld->SetText( LOADING_SONGS.GetValue() +
+						ssprintf("\n%s\n%s",
+							group_base_name.c_str(),
+							Basename(sSongDirName).c_str()
+						)
+					);
+				}
 
-			Song* pNewSong = new Song;
-			if( !pNewSong->LoadFromSongDir( sSongDirName ) )
-			{
-				// The song failed to load.
-				delete pNewSong;
-				continue;
+				pNewSong = new Song;
+				if( !pNewSong->LoadFromSongDir( sSongDirName ) )
+				{
+					// The song failed to load.
+					delete pNewSong;
+					continue;
+				}
 			}
 			AddSongToList(pNewSong);
 
@@ -461,13 +598,13 @@ void SongManager::LoadSongDir( RString sDir, LoadingWindow *ld, bool onlyAdditio
 		if(!loaded) continue;
 
 		// Add this group to the group array.
-		AddGroup(sDir, sGroupDirName);
+		AddGroup(sDir, sGroupDirName, arrayFiles);
 
 		// Cache and load the group banner. (and background if it has one -aj)
 		IMAGECACHE->CacheImage( "Banner", GetSongGroupBannerPath(sGroupDirName) );
 
 		// Load the group sym links (if any)
-		LoadGroupSymLinks(sDir, sGroupDirName);
+		LoadGroupSymLinks(sDir, sGroupDirName, arrayFiles);
 	}
 
 	if( ld ) {
@@ -476,11 +613,11 @@ void SongManager::LoadSongDir( RString sDir, LoadingWindow *ld, bool onlyAdditio
 }
 
 // Instead of "symlinks", songs should have membership in multiple groups. -Chris
-void SongManager::LoadGroupSymLinks(RString sDir, RString sGroupFolder)
+void SongManager::LoadGroupSymLinks(RString sDir, RString sGroupFolder, const std::vector<RString> &asGroupFiles)
 {
 	// Find all symlink files in this folder
 	std::vector<RString> arraySymLinks;
-	GetDirListing( sDir+sGroupFolder+"/*.include", arraySymLinks, false );
+	GetFilesWithExtension( asGroupFiles, "include", arraySymLinks );
 	SortRStringArray( arraySymLinks );
 	SongPointerVector& index_entry = m_mapSongGroupIndex[sGroupFolder];
 	for( unsigned s=0; s< arraySymLinks.size(); s++ )	// for each symlink in this dir, add it in as a song.
@@ -964,6 +1101,8 @@ void SongManager::InitCoursesFromDisk( LoadingWindow *ld, bool onlyAdditions )
 	vsCourseGroupNames.push_back( SpecialFiles::COURSES_DIR );
 	SortRStringArray( vsCourseGroupNames );
 
+	// Courses add cache index entries too; they're written out at the end.
+
 	int courseIndex = 0;
 	for (RString const &sCourseGroup : vsCourseGroupNames) // for each dir in /Courses/
 	{
@@ -1013,6 +1152,8 @@ void SongManager::InitCoursesFromDisk( LoadingWindow *ld, bool onlyAdditions )
 		}
 	}
 
+	SONGINDEX->SaveCacheIndex();
+
 	if( ld ) {
 		ld->SetIndeterminate( true );
 	}
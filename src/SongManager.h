@@ -62,7 +62,7 @@ public:
 	int GetNumStepsLoadedFromProfile();
 	void FreeAllLoadedFromProfile( ProfileSlot slot = ProfileSlot_Invalid );
 
-	void LoadGroupSymLinks( RString sDir, RString sGroupFolder );
+	void LoadGroupSymLinks( RString sDir, RString sGroupFolder, const std::vector<RString> &asGroupFiles );
 
 	/**
 	 * @brief Initialize all courses from disk
@@ -211,8 +211,8 @@ protected:
 	 */
 	void LoadSongDir( RString sDir, LoadingWindow *ld, bool onlyAdditions );
 	bool GetExtraStageInfoFromCourse( bool bExtra2, RString sPreferredGroup, Song*& pSongOut, Steps*& pStepsOut, StepsType stype );
-	void SanityCheckGroupDir( RString sDir ) const;
-	void AddGroup( RString sDir, RString sGroupDirName );
+	void SanityCheckGroupDir( RString sDir, const std::vector<RString> &asGroupFiles ) const;
+	void AddGroup( RString sDir, RString sGroupDirName, const std::vector<RString> &asGroupFiles );
 	int GetNumEditsLoadedFromProfile( ProfileSlot slot ) const;
 
 	void AddSongToList(Song* new_song);
@@ -13,7 +13,7 @@ void SongPosition::UpdateSongPosition( float fPositionSeconds, const TimingData
 
 	TimingData::GetBeatArgs beat_info;
 	beat_info.elapsed_time= fPositionSeconds;
-	timing.GetBeatAndBPSFromElapsedTime(beat_info);
+	timing.GetBeatAndBPSFromElapsedTime(beat_info, m_BeatCursor);
 	m_fSongBeat= beat_info.beat;
 	m_fCurBPS= beat_info.bps_out;
 	m_bFreeze= beat_info.freeze_out;
@@ -27,13 +27,19 @@ void SongPosition::UpdateSongPosition( float fPositionSeconds, const TimingData
 
 	m_fMusicSeconds = fPositionSeconds;
 
-	m_fLightSongBeat = timing.GetBeatFromElapsedTime( fPositionSeconds + g_fLightsAheadSeconds );
+	TimingData::GetBeatArgs light_info;
+	light_info.elapsed_time= fPositionSeconds + g_fLightsAheadSeconds;
+	timing.GetBeatAndBPSFromElapsedTime(light_info, m_LightBeatCursor);
+	m_fLightSongBeat = light_info.beat;
 
-	m_fSongBeatNoOffset = timing.GetBeatFromElapsedTimeNoOffset( fPositionSeconds );
+	TimingData::GetBeatArgs no_offset_info;
+	no_offset_info.elapsed_time= fPositionSeconds;
+	timing.GetBeatAndBPSFromElapsedTimeNoOffset(no_offset_info, m_BeatNoOffsetCursor);
+	m_fSongBeatNoOffset = no_offset_info.beat;
 	
 	m_fMusicSecondsVisible = fPositionSeconds - g_fVisualDelaySeconds.Get() - fAdditionalVisualDelay;
 	beat_info.elapsed_time= m_fMusicSecondsVisible;
-	timing.GetBeatAndBPSFromElapsedTime(beat_info);
+	timing.GetBeatAndBPSFromElapsedTime(beat_info, m_VisibleBeatCursor);
 	m_fSongBeatVisible= beat_info.beat;
 }
 
@@ -33,6 +33,13 @@ public:
 	float		m_fMusicSecondsVisible;
 	float		m_fSongBeatVisible;
 
+	// Each of the positions above moves forward every frame, so keep where
+	// the last lookup for each left off.
+	TimingData::LookupCursor	m_BeatCursor;
+	TimingData::LookupCursor	m_LightBeatCursor;
+	TimingData::LookupCursor	m_BeatNoOffsetCursor;
+	TimingData::LookupCursor	m_VisibleBeatCursor;
+
 	void Reset();
 	void UpdateSongPosition( float fPositionSeconds, const TimingData &timing, const RageTimer &timestamp = RageZeroTimer, float fAdditionalVisualDelay = 0.0f );
 
@@ -175,6 +175,7 @@ RageTextureID Sprite::SongBannerTexture( RageTextureID ID )
 
 void Sprite::Load( RageTextureID ID )
 {
+	m_sPendingCachedPath = "";
 	if( !ID.filename.empty() )
 		LoadFromTexture( ID );
 
@@ -382,6 +383,13 @@ void Sprite::LoadFromCached( const RString &sDir, const RString &sPath )
 
 	if( TEXTUREMAN->IsTextureRegistered(ID) )
 		Load( ID );
+	else if( IMAGECACHE->IsImagePending(sPath) )
+	{
+		/* Show the fallback until the image cache has loaded it. */
+		Load( THEME->GetPathG("Common","fallback %s", sDir) );
+		m_sPendingCachedDir = sDir;
+		m_sPendingCachedPath = sPath;
+	}
 	else if( IsAFile(sPath) )
 		Load( sPath );
 	else
@@ -455,6 +463,9 @@ void Sprite::Update( float fDelta )
 {
 	Actor::Update( fDelta ); // do tweening
 
+	if( !m_sPendingCachedPath.empty() && !IMAGECACHE->IsImagePending(m_sPendingCachedPath) )
+		LoadFromCached( RString(m_sPendingCachedDir), RString(m_sPendingCachedPath) );
+
 	const bool bSkipThisMovieUpdate = m_bSkipNextUpdate;
 	m_bSkipNextUpdate = false;
 
@@ -529,7 +540,14 @@ void TexCoordArrayFromRect( float fImageCoords[8], const RectF &rect )
 
 void Sprite::DrawTexture( const TweenState *state )
 {
-	Actor::SetGlobalRenderStates(); // set Actor-specified render states
+	/* If a quad batch is open, add to it instead of drawing, and leave the
+	 * render states alone; they're set when the batch is drawn. */
+	const bool bBatch = DISPLAY->IsBatchingQuads() && CanDrawBatched();
+	if( DISPLAY->IsBatchingQuads() && !bBatch )
+		DISPLAY->FlushQuadBatch();
+
+	if( !bBatch )
+		Actor::SetGlobalRenderStates(); // set Actor-specified render states
 
 	RectF crop = state->crop;
 	// bail if cropped all the way
@@ -577,13 +595,30 @@ void Sprite::DrawTexture( const TweenState *state )
 		}
 	}
 
-	DISPLAY->ClearAllTextures();
-	DISPLAY->SetTexture( TextureUnit_1, m_pTexture? m_pTexture->GetTexHandle():0 );
+	RageQuadBatchState batch;
+	if( bBatch )
+	{
+		batch.m_iTexture = m_pTexture? m_pTexture->GetTexHandle():0;
+		batch.m_TextureMode = TextureMode_Modulate;
+		batch.m_EffectMode = m_EffectMode;
+		batch.m_BlendMode = m_BlendMode;
+		batch.m_ZTestMode = m_ZTestMode;
+		batch.m_CullMode = m_CullMode;
+		batch.m_fZBias = m_fZBias;
+		batch.m_bZWrite = m_bZWrite;
+		batch.m_bTextureWrapping = m_bTextureWrapping;
+		batch.m_bTextureFiltering = m_bTextureFiltering;
+	}
+	else
+	{
+		DISPLAY->ClearAllTextures();
+		DISPLAY->SetTexture( TextureUnit_1, m_pTexture? m_pTexture->GetTexHandle():0 );
 
-	// Must call this after setting the texture or else texture
-	// parameters have no effect.
-	Actor::SetTextureRenderStates(); // set Actor-specified render states
-	DISPLAY->SetEffectMode( m_EffectMode );
+		// Must call this after setting the texture or else texture
+		// parameters have no effect.
+		Actor::SetTextureRenderStates(); // set Actor-specified render states
+		DISPLAY->SetEffectMode( m_EffectMode );
+	}
 
 	if( m_pTexture )
 	{
@@ -633,7 +668,8 @@ void Sprite::DrawTexture( const TweenState *state )
 		state->diffuse[2].a > 0 ||
 		state->diffuse[3].a > 0 )
 	{
-		DISPLAY->SetTextureMode( TextureUnit_1, TextureMode_Modulate );
+		if( !bBatch )
+			DISPLAY->SetTextureMode( TextureUnit_1, TextureMode_Modulate );
 
 		// render the shadow
 		if( m_fShadowLengthX != 0  ||  m_fShadowLengthY != 0 )
@@ -652,17 +688,29 @@ void Sprite::DrawTexture( const TweenState *state )
 		v[1].c = state->diffuse[2]; // bottom left
 		v[2].c = state->diffuse[3]; // bottom right
 		v[3].c = state->diffuse[1]; // top right
-		DISPLAY->DrawQuad( v );
+		if( bBatch )
+			DISPLAY->AddQuadsToBatch( batch, v, 4 );
+		else
+			DISPLAY->DrawQuad( v );
 	}
 
 	// render the glow pass
 	if( state->glow.a > 0.0001f )
 	{
-		DISPLAY->SetTextureMode( TextureUnit_1, TextureMode_Glow );
 		v[0].c = v[1].c = v[2].c = v[3].c = state->glow;
-		DISPLAY->DrawQuad( v );
+		if( bBatch )
+		{
+			batch.m_TextureMode = TextureMode_Glow;
+			DISPLAY->AddQuadsToBatch( batch, v, 4 );
+		}
+		else
+		{
+			DISPLAY->SetTextureMode( TextureUnit_1, TextureMode_Glow );
+			DISPLAY->DrawQuad( v );
+		}
 	}
-	DISPLAY->SetEffectMode( EffectMode_Normal );
+	if( !bBatch )
+		DISPLAY->SetEffectMode( EffectMode_Normal );
 }
 
 bool Sprite::EarlyAbortDraw() const
@@ -670,6 +718,13 @@ bool Sprite::EarlyAbortDraw() const
 	return m_pTexture == nullptr;
 }
 
+bool Sprite::CanDrawBatched() const
+{
+	// Masks (BLEND_NO_EFFECT) and shadows need render states of their own.
+	return m_FakeParent == nullptr && m_WrapperStates.empty() && !m_bClearZBuffer && m_BlendMode != BLEND_NO_EFFECT &&
+		m_fShadowLengthX == 0 && m_fShadowLengthY == 0;
+}
+
 void Sprite::DrawPrimitives()
 {
 	if( m_pTempState->fade.top > 0 ||
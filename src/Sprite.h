@@ -36,6 +36,7 @@ public:
 	virtual Sprite *Copy() const override;
 
 	virtual bool EarlyAbortDraw() const override;
+	virtual bool CanDrawBatched() const override;
 	virtual void DrawPrimitives() override;
 	virtual void Update( float fDeltaTime ) override;
 
@@ -112,6 +113,9 @@ private:
 
 	RageTexture* m_pTexture;
 
+	/* The cached image we're waiting on the image cache for, if any. */
+	RString m_sPendingCachedDir, m_sPendingCachedPath;
+
 	std::vector<State> m_States;
 	int		m_iCurState;
 	/** @brief The number of seconds that have elapsed since we switched to this frame. */
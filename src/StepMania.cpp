@@ -1,6 +1,7 @@
 #include "global.h"
 
 #include "StepMania.h"
+#include "Benchmark.h"
 
 // Rage global classes
 #include "RageLog.h"
@@ -52,6 +53,7 @@
 #include "InputFilter.h"
 #include "InputMapper.h"
 #include "InputQueue.h"
+#include "InputLatency.h"
 #include "SongCacheIndex.h"
 #include "ImageCache.h"
 #include "UnlockManager.h"
@@ -517,6 +519,10 @@ static RString GetVideoDriverName()
 
 bool CheckVideoDefaultSettings()
 {
+	// A benchmark always uses the null renderer.
+	if( Benchmark::IsEnabled() )
+		return false;
+
 	// Video card changed since last run
 	RString sVideoDriver = GetVideoDriverName();
 
@@ -918,6 +924,8 @@ int sm_main(int argc, char* argv[])
 	/* One of the above filesystems might contain files that affect preferences
 	 * (e.g. Data/Static.ini). Re-read preferences. */
 	PREFSMAN->ReadPrefsFromDisk();
+	if( Benchmark::IsEnabled() )
+		Benchmark::ApplyPreferences();
 	ApplyLogPreferences();
 
 	// This needs PREFSMAN.
@@ -1042,7 +1050,10 @@ int sm_main(int argc, char* argv[])
 	/* Now that GAMESTATE is reset, tell SCREENMAN to update the theme (load
 	 * overlay screens and global sounds), and load the initial screen. */
 	SCREENMAN->ThemeChanged();
-	SCREENMAN->SetNewScreen( StepMania::GetInitialScreen() );
+	if( Benchmark::IsEnabled() )
+		Benchmark::Start();
+	else
+		SCREENMAN->SetNewScreen( StepMania::GetInitialScreen() );
 
 	// Do this after ThemeChanged so that we can show a system message
 	RString sMessage;
@@ -1440,6 +1451,8 @@ void HandleInputEvents(float fDeltaTime)
 			input.MenuI = GAME_BUTTON_BACK;
 		}
 
+		if( input.type == IET_FIRST_PRESS )
+			InputLatency::Record( InputLatencyStage_HandleInputEvents, input.DeviceI.ts );
 		SCREENMAN->Input( input );
 	}
 
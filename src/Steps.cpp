@@ -21,6 +21,7 @@
 #include "NoteData.h"
 #include "GameManager.h"
 #include "SongManager.h"
+#include "SongCacheIndex.h"
 #include "NoteDataUtil.h"
 #include "NotesLoaderSSC.h"
 #include "NotesLoaderSM.h"
@@ -50,7 +51,8 @@ LuaXType( DisplayBPM );
 
 Steps::Steps(Song *song): m_StepsType(StepsType_Invalid), m_pSong(song),
 	parent(nullptr), m_pNoteData(new NoteData), m_bNoteDataIsFilled(false),
-	m_sNoteDataCompressed(""), m_sFilename(""), m_bSavedToDisk(false),
+	m_sNoteDataCompressed(""), m_sFilename(""), m_iCacheNoteDataOffset(0),
+	m_bSavedToDisk(false),
 	m_LoadedFromProfile(ProfileSlot_Invalid), m_iHash(0),
 	m_sDescription(""), m_sChartStyle(""),
 	m_Difficulty(Difficulty_Invalid), m_iMeter(0),
@@ -417,6 +419,13 @@ void Steps::Decompress()
 		return;
 	}
 
+	if( !m_sFilename.empty() && m_sNoteDataCompressed.empty() && m_iCacheNoteDataOffset != 0 && m_pSong != nullptr )
+	{
+		// Prefer the copy in the song cache; it's much cheaper than reparsing the simfile.
+		if( !SONGINDEX->LoadCachedNoteData(m_pSong->GetSongDir(), m_iCacheNoteDataOffset, m_sNoteDataCompressed) )
+			m_iCacheNoteDataOffset = 0;
+	}
+
 	if( !m_sFilename.empty() && m_sNoteDataCompressed.empty() )
 	{
 		// We have NoteData on disk and not in memory. Load it.
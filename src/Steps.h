@@ -117,6 +117,9 @@ public:
 	void SetChartName(const RString name)		{ this->chartName = name; }
 	void SetFilename( RString fn )			{ m_sFilename = fn; }
 	RString GetFilename() const			{ return m_sFilename; }
+	/** @brief Where this chart's note data is stored in its song's cache record, or 0. */
+	void SetCacheNoteDataOffset( unsigned iOffset )	{ m_iCacheNoteDataOffset = iOffset; }
+	unsigned GetCacheNoteDataOffset() const		{ return m_iCacheNoteDataOffset; }
 	void SetSavedToDisk( bool b )			{ DeAutogen(); m_bSavedToDisk = b; }
 	bool GetSavedToDisk() const			{ return Real()->m_bSavedToDisk; }
 	void SetDifficulty( Difficulty dc )		{ SetDifficultyAndDescription( dc, GetDescription() ); }
@@ -231,6 +234,8 @@ private:
 
 	/** @brief The name of the file where these steps are stored. */
 	RString				m_sFilename;
+	/** @brief The offset of the note data in the song cache record, or 0 if it isn't cached. */
+	unsigned			m_iCacheNoteDataOffset;
 	/** @brief true if these Steps were loaded from or saved to disk. */
 	bool				m_bSavedToDisk;
 	/** @brief allows the steps to specify their own music file. */
@@ -26,9 +26,14 @@
 #include "EnumHelper.h"
 #include "PrefsManager.h"
 #include "XmlFileUtil.h"
+#include "RageThreads.h"
 
+#include <atomic>
 #include <cstddef>
+#include <cstdlib>
 #include <deque>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 
@@ -128,6 +133,58 @@ void ThemeManager::ClearThemePathCache()
 		g_ThemePathCache[i].clear();
 }
 
+/* Metrics are looked up by name through a chain of fallback groups, and
+ * evaluated as Lua, every time a ThemeMetric is read.  Cache both: the value
+ * each group::name resolves to, and that value parsed into a number, boolean
+ * or string, or else compiled into a chunk.  Entries are only added, and
+ * never move once added, until the metrics are reloaded.  The compiled parts
+ * are only touched with the Lua lock held. */
+static Preference<bool> g_bCompiledMetrics( "CompiledMetrics", true );
+
+struct CachedMetric
+{
+	enum Type { NOT_COMPILED, NUMBER, BOOLEAN, STRING, CHUNK, FAILED };
+
+	CachedMetric(): m_bFound(false), m_Type(NOT_COMPILED), m_fNumber(0), m_bBoolean(false) { }
+
+	bool m_bFound;
+	RString m_sValue;
+
+	Type m_Type;
+	double m_fNumber;
+	bool m_bBoolean;
+	RString m_sString;
+	LuaReference m_Chunk;
+};
+
+static RageMutex g_MetricCacheLock( "MetricCache" );
+static std::unordered_map<std::string, CachedMetric> g_MetricCache;
+static std::unordered_map<std::string, RString> g_GroupFallbackCache;
+static std::atomic<unsigned> g_iMetricLookups( 0 );
+static std::atomic<unsigned> g_iMetricsResolved( 0 );
+static std::atomic<unsigned> g_iMetricsCompiled( 0 );
+
+static void ClearMetricCache()
+{
+	/* Destroying a compiled chunk's LuaReference takes the Lua lock, and the
+	 * lookups take g_MetricCacheLock with the Lua lock held.  Take the caches
+	 * out under the lock, and destroy them after it's released. */
+	std::unordered_map<std::string, CachedMetric> oldMetrics;
+	std::unordered_map<std::string, RString> oldFallbacks;
+	{
+		LockMut( g_MetricCacheLock );
+		oldMetrics.swap( g_MetricCache );
+		oldFallbacks.swap( g_GroupFallbackCache );
+	}
+}
+
+void ThemeManager::GetMetricCacheStats( MetricCacheStats &out )
+{
+	out.m_iLookups = g_iMetricLookups.load();
+	out.m_iResolved = g_iMetricsResolved.load();
+	out.m_iCompiled = g_iMetricsCompiled.load();
+}
+
 static void FileNameToMetricsGroupAndElement( const RString &sFileName, RString &sMetricsGroupOut, RString &sElementOut )
 {
 	// split into class name and file name
@@ -177,6 +234,8 @@ ThemeManager::ThemeManager()
 ThemeManager::~ThemeManager()
 {
 	g_vThemes.clear();
+	// This holds Lua references, so clear it while Lua is still around.
+	ClearMetricCache();
 	SAFE_DELETE( g_pLoadedThemeData );
 
 	// Unregister with Lua.
@@ -294,6 +353,7 @@ void ThemeManager::LoadThemeMetrics( const RString &sThemeName_, const RString &
 	// on the stack, so Clear them instead.
 	g_pLoadedThemeData->ClearAll();
 	g_vThemes.clear();
+	ClearMetricCache();
 
 	RString sThemeName(sThemeName_);
 	RString sLanguage(sLanguage_);
@@ -373,6 +433,9 @@ void ThemeManager::LoadThemeMetrics( const RString &sThemeName_, const RString &
 		g_pLoadedThemeData->iniMetrics.SetValue( sBits[0], sBits[1], sBits[2] );
 	}
 
+	// Anything looked up while loading may have seen a partial theme.
+	ClearMetricCache();
+
 	LOG->MapLog( "theme", "Theme: %s", m_sCurThemeName.c_str() );
 	LOG->MapLog( "language", "Language: %s", m_sCurLanguage.c_str() );
 }
@@ -946,23 +1009,75 @@ RString ThemeManager::GetMetricsGroupFallback( const RString &sMetricsGroup )
 {
 	ASSERT( g_pLoadedThemeData != nullptr );
 
+	if( g_bCompiledMetrics )
+	{
+		LockMut( g_MetricCacheLock );
+		std::unordered_map<std::string, RString>::const_iterator it = g_GroupFallbackCache.find( sMetricsGroup );
+		if( it != g_GroupFallbackCache.end() )
+			return it->second;
+	}
+
 	// always look in iniMetrics for "Fallback"
 	RString sFallback;
-	if( !GetMetricRawRecursive(g_pLoadedThemeData->iniMetrics,sMetricsGroup,"Fallback",sFallback) )
-		return RString();
-
-	Lua *L = LUA->Get();
-	LuaHelpers::RunExpression( L, sFallback );
 	RString sRet;
-	LuaHelpers::Pop( L, sRet );
-	LUA->Release( L );
+	if( GetMetricRawRecursive(g_pLoadedThemeData->iniMetrics,sMetricsGroup,"Fallback",sFallback) )
+	{
+		Lua *L = LUA->Get();
+		LuaHelpers::RunExpression( L, sFallback );
+		LuaHelpers::Pop( L, sRet );
+		LUA->Release( L );
+	}
+
+	if( g_bCompiledMetrics )
+	{
+		LockMut( g_MetricCacheLock );
+		g_GroupFallbackCache.emplace( sMetricsGroup, sRet );
+	}
 
 	return sRet;
 }
 
-bool ThemeManager::GetMetricRawRecursive( const IniFile &ini, const RString &sMetricsGroup_, const RString &sValueName, RString &sOut )
+bool ThemeManager::GetMetricRawRecursive( const IniFile &ini, const RString &sMetricsGroup, const RString &sValueName, RString &sOut )
 {
 	ASSERT( sValueName != "" );
+
+	if( !g_bCompiledMetrics || &ini != &g_pLoadedThemeData->iniMetrics )
+		return FindMetricRaw( ini, sMetricsGroup, sValueName, sOut );
+
+	const CachedMetric *pMetric = GetCachedMetric( sMetricsGroup, sValueName );
+	if( !pMetric->m_bFound )
+		return false;
+	sOut = pMetric->m_sValue;
+	return true;
+}
+
+CachedMetric *ThemeManager::GetCachedMetric( const RString &sMetricsGroup, const RString &sValueName )
+{
+	++g_iMetricLookups;
+
+	std::string sKey;
+	sKey.reserve( sMetricsGroup.size() + 1 + sValueName.size() );
+	sKey.append( sMetricsGroup ).append( 1, '\n' ).append( sValueName );
+	{
+		LockMut( g_MetricCacheLock );
+		std::unordered_map<std::string, CachedMetric>::iterator it = g_MetricCache.find( sKey );
+		if( it != g_MetricCache.end() )
+			return &it->second;
+	}
+
+	/* Resolve it without the lock held: following fallbacks runs Lua, and
+	 * another thread may hold the Lua lock while waiting for ours. */
+	++g_iMetricsResolved;
+	CachedMetric metric;
+	metric.m_bFound = FindMetricRaw( g_pLoadedThemeData->iniMetrics, sMetricsGroup, sValueName, metric.m_sValue );
+
+	// If another thread got here first, keep its entry.
+	LockMut( g_MetricCacheLock );
+	return &g_MetricCache.emplace( sKey, metric ).first->second;
+}
+
+bool ThemeManager::FindMetricRaw( const IniFile &ini, const RString &sMetricsGroup_, const RString &sValueName, RString &sOut )
+{
 	RString sMetricsGroup( sMetricsGroup_ );
 
 	int n = 100;
@@ -1104,6 +1219,14 @@ void ThemeManager::PushMetric( Lua *L, const RString &sMetricsGroup, const RStri
 		lua_pushnil(L);
 		return;
 	}
+
+	if( g_bCompiledMetrics )
+	{
+		CachedMetric *pMetric = GetCachedMetric( sMetricsGroup, sValueName );
+		if( pMetric->m_bFound && PushCachedMetric(L, *pMetric, sMetricsGroup, sValueName) )
+			return;
+	}
+
 	RString sValue = GetMetricRaw( g_pLoadedThemeData->iniMetrics, sMetricsGroup, sValueName );
 
 	RString sName = ssprintf( "%s::%s", sMetricsGroup.c_str(), sValueName.c_str() );
@@ -1121,6 +1244,112 @@ void ThemeManager::PushMetric( Lua *L, const RString &sMetricsGroup, const RStri
 	}
 }
 
+/* Parse a plain number, as Lua would, without accepting anything Lua
+ * wouldn't (like "inf"). */
+static bool ParseMetricNumber( const RString &sValue, double &fOut )
+{
+	const char *p = sValue.c_str();
+	const char *pDigits = (*p == '-')? p+1: p;
+	if( !isdigit((unsigned char) *pDigits) && *pDigits != '.' )
+		return false;
+
+	char *pEnd;
+	fOut = std::strtod( p, &pEnd );
+	if( pEnd == p )
+		return false;
+	while( isspace((unsigned char) *pEnd) )
+		++pEnd;
+	return *pEnd == '\0';
+}
+
+/* Push a metric that has been found, compiling it the first time.  Return
+ * false if it doesn't compile, so the caller can report the error the usual
+ * way. */
+bool ThemeManager::PushCachedMetric( Lua *L, CachedMetric &metric, const RString &sMetricsGroup, const RString &sValueName )
+{
+	const bool bCommand = EndsWith( sValueName, "Command" );
+	if( metric.m_Type == CachedMetric::NOT_COMPILED )
+	{
+		++g_iMetricsCompiled;
+		RString sName = ssprintf( "%s::%s", sMetricsGroup.c_str(), sValueName.c_str() );
+		RString sScript;
+		if( bCommand )
+		{
+			sScript = LuaHelpers::CommandListToScript( metric.m_sValue, false );
+		}
+		else
+		{
+			// Remove unary +, eg. "+50"; Lua doesn't support that.
+			RString sValue = metric.m_sValue;
+			if( sValue.size() >= 1 && sValue[0] == '+' )
+				sValue.erase( 0, 1 );
+
+			if( ParseMetricNumber(sValue, metric.m_fNumber) )
+				metric.m_Type = CachedMetric::NUMBER;
+			else if( sValue == "true" || sValue == "false" )
+			{
+				metric.m_Type = CachedMetric::BOOLEAN;
+				metric.m_bBoolean = sValue == "true";
+			}
+			else if( sValue.size() >= 2 && sValue.front() == '"' && sValue.back() == '"' &&
+				sValue.find_first_of("\"\\\n", 1) == sValue.size()-1 )
+			{
+				metric.m_Type = CachedMetric::STRING;
+				metric.m_sString = sValue.substr( 1, sValue.size()-2 );
+			}
+			else
+			{
+				sScript = "return " + sValue;
+			}
+		}
+
+		if( metric.m_Type == CachedMetric::NOT_COMPILED )
+		{
+			RString sError;
+			if( LuaHelpers::LoadScript(L, sScript, sName, sError) )
+			{
+				metric.m_Chunk.SetFromStack( L );
+				metric.m_Type = CachedMetric::CHUNK;
+			}
+			else
+			{
+				metric.m_Type = CachedMetric::FAILED;
+			}
+		}
+	}
+
+	switch( metric.m_Type )
+	{
+	case CachedMetric::NUMBER:
+		lua_pushnumber( L, metric.m_fNumber );
+		return true;
+	case CachedMetric::BOOLEAN:
+		lua_pushboolean( L, metric.m_bBoolean );
+		return true;
+	case CachedMetric::STRING:
+		LuaHelpers::Push( L, metric.m_sString );
+		return true;
+	case CachedMetric::CHUNK:
+		break;
+	default:
+		return false;
+	}
+
+	metric.m_Chunk.PushSelf( L );
+	if( bCommand )
+	{
+		RString sError;
+		if( !LuaHelpers::RunScriptOnStack(L, sError, 0, 1) )
+			LOG->Warn( "Running \"%s::%s\": %s", sMetricsGroup.c_str(), sValueName.c_str(), sError.c_str() );
+	}
+	else
+	{
+		RString sError = ssprintf( "Lua runtime error parsing \"%s::%s\": ", sMetricsGroup.c_str(), sValueName.c_str() );
+		LuaHelpers::RunScriptOnStack( L, sError, 0, 1, true );
+	}
+	return true;
+}
+
 void ThemeManager::GetMetric( const RString &sMetricsGroup, const RString &sValueName, LuaReference &valueOut )
 {
 	Lua *L = LUA->Get();
@@ -10,6 +10,7 @@
 
 class IThemeMetric;
 class IniFile;
+struct CachedMetric;
 struct lua_State;
 
 enum ElementCategory
@@ -100,6 +101,17 @@ public:
 
 	RString GetMetricsGroupFallback( const RString &sMetricsGroup );
 
+	/* Counts of metric lookups since startup, for measuring screen loads.
+	 * Resolved lookups searched the metrics and fallback groups; compiled
+	 * ones parsed the value or loaded it as Lua.  The rest were cached. */
+	struct MetricCacheStats
+	{
+		unsigned m_iLookups;
+		unsigned m_iResolved;
+		unsigned m_iCompiled;
+	};
+	static void GetMetricCacheStats( MetricCacheStats &out );
+
 	static RString GetBlankGraphicPath();
 
 	//needs to be public for its binding to work
@@ -116,6 +128,9 @@ protected:
 	void LoadThemeMetrics( const RString &sThemeName, const RString &sLanguage_ );
 	RString GetMetricRaw( const IniFile &ini, const RString &sMetricsGroup, const RString &sValueName );
 	bool GetMetricRawRecursive( const IniFile &ini, const RString &sMetricsGroup, const RString &sValueName, RString &sRet );
+	bool FindMetricRaw( const IniFile &ini, const RString &sMetricsGroup, const RString &sValueName, RString &sRet );
+	CachedMetric *GetCachedMetric( const RString &sMetricsGroup, const RString &sValueName );
+	static bool PushCachedMetric( Lua *L, CachedMetric &metric, const RString &sMetricsGroup, const RString &sValueName );
 
 	bool GetPathInfoToAndFallback( PathInfo &out, ElementCategory category, const RString &sMetricsGroup, const RString &sFile );
 	bool GetPathInfoToRaw( PathInfo &out, const RString &sThemeName, ElementCategory category, const RString &sMetricsGroup, const RString &sFile );
@@ -7,6 +7,7 @@
 #include "ThemeManager.h"
 #include "NoteTypes.h"
 
+#include <atomic>
 #include <cfloat>
 #include <cmath>
 #include <cstddef>
@@ -52,21 +53,21 @@ void TimingData::Clear()
 
 		vSegs.clear();
 	}
+	m_lookup_serial= 0;
+	++m_revision;
 }
 
 bool TimingData::IsSafeFullTiming()
 {
-	static std::vector<TimingSegmentType> needed_segments;
-	if(needed_segments.empty())
-	{
-		needed_segments.push_back(SEGMENT_BPM);
-		needed_segments.push_back(SEGMENT_TIME_SIG);
-		needed_segments.push_back(SEGMENT_TICKCOUNT);
-		needed_segments.push_back(SEGMENT_COMBO);
-		needed_segments.push_back(SEGMENT_LABEL);
-		needed_segments.push_back(SEGMENT_SPEED);
-		needed_segments.push_back(SEGMENT_SCROLL);
-	}
+	static const std::vector<TimingSegmentType> needed_segments = {
+		SEGMENT_BPM,
+		SEGMENT_TIME_SIG,
+		SEGMENT_TICKCOUNT,
+		SEGMENT_COMBO,
+		SEGMENT_LABEL,
+		SEGMENT_SPEED,
+		SEGMENT_SCROLL,
+	};
 	for(std::size_t s= 0; s < needed_segments.size(); ++s)
 	{
 		if(m_avpTimingSegments[needed_segments[s]].empty())
@@ -110,6 +111,7 @@ void TimingData::PrepareLookup()
 
 		GetBeatStarts time_start;
 		time_start.last_time= -m_fBeat0OffsetInSeconds;
+		GetElapsedTimeInternal(time_start, FLT_MAX, curr_segment);
 		m_time_start_lookup.push_back(lookup_item_t(NoteRowToBeat(time_start.last_row), time_start));
 	}
 	// If there are less than two entries, then FindEntryInLookup in lookup
@@ -119,6 +121,11 @@ void TimingData::PrepareLookup()
 	{
 		ReleaseLookup();
 	}
+	// Cursors from before now may have walked different timing data.
+	static std::atomic<unsigned int> next_serial(0);
+	do {
+		m_lookup_serial= ++next_serial;
+	} while(m_lookup_serial == 0);
 	// DumpLookupTables();
 }
 
@@ -136,6 +143,7 @@ void TimingData::ReleaseLookup()
 	CLEAR_LOOKUP(m_beat_start_lookup);
 	CLEAR_LOOKUP(m_time_start_lookup);
 #undef CLEAR_LOOKUP
+	m_lookup_serial= 0;
 }
 
 RString SegInfoStr(const std::vector<TimingSegment*>& segs, unsigned int index, const RString& name)
@@ -262,6 +270,7 @@ void TimingData::CopyRange(int start_row, int end_row,
 void TimingData::ShiftRange(int start_row, int end_row,
 	TimingSegmentType shift_type, int shift_amount)
 {
+	++m_revision;
 	FOREACH_TimingSegmentType(seg_type)
 	{
 		if(seg_type == shift_type || shift_type == TimingSegmentType_Invalid)
@@ -327,6 +336,7 @@ void TimingData::ShiftRange(int start_row, int end_row,
 
 void TimingData::ClearRange(int start_row, int end_row, TimingSegmentType clear_type)
 {
+	++m_revision;
 	FOREACH_TimingSegmentType(seg_type)
 	{
 		if(seg_type == clear_type || clear_type == TimingSegmentType_Invalid)
@@ -435,6 +445,7 @@ struct ts_less
 // Multiply the BPM in the range [fStartBeat,fEndBeat) by fFactor.
 void TimingData::MultiplyBPMInBeatRange( int iStartIndex, int iEndIndex, float fFactor )
 {
+	++m_revision;
 	// Change all other BPM segments in this range.
 	std::vector<TimingSegment *> &bpms = m_avpTimingSegments[SEGMENT_BPM];
 	for( unsigned i=0; i<bpms.size(); i++ )
@@ -600,6 +611,7 @@ void TimingData::AddSegment( const TimingSegment *seg )
 	LOG->Trace( "AddSegment( %s )", TimingSegmentTypeToString(seg->GetType()).c_str() );
 	seg->DebugPrint();
 #endif
+	++m_revision;
 
 	TimingSegmentType tst = seg->GetType();
 	std::vector<TimingSegment*> &vSegs = m_avpTimingSegments[tst];
@@ -810,7 +822,7 @@ void FindEvent(int& event_row, int& event_type,
 }
 
 void TimingData::GetBeatInternal(GetBeatStarts& start, GetBeatArgs& args,
-	unsigned int max_segment) const
+	unsigned int max_segment, LookupCursor* cursor) const
 {
 	const std::vector<TimingSegment*>& bpms= m_avpTimingSegments[SEGMENT_BPM];
 	const std::vector<TimingSegment*>& warps= m_avpTimingSegments[SEGMENT_WARP];
@@ -818,11 +830,22 @@ void TimingData::GetBeatInternal(GetBeatStarts& start, GetBeatArgs& args,
 	const std::vector<TimingSegment*>& delays= m_avpTimingSegments[SEGMENT_DELAY];
 	unsigned int curr_segment= start.bpm+start.warp+start.stop+start.delay;
 
-	float bps= GetBPMAtRow(start.last_row) / 60.0f;
+	float bps= start.has_bps ? start.bps : GetBPMAtRow(start.last_row) / 60.0f;
 #define INC_INDEX(index) ++curr_segment; ++index;
 
 	while(curr_segment < max_segment)
 	{
+		// Everything up to here comes before args.elapsed_time, so a later
+		// lookup can pick up from here.
+		if(cursor != nullptr)
+		{
+			cursor->start= start;
+			cursor->start.bps= bps;
+			cursor->start.has_bps= true;
+			cursor->warp_begin= args.warp_begin_out;
+			cursor->warp_dest= args.warp_dest_out;
+			cursor->valid= true;
+		}
 		int event_row= INT_MAX;
 		int event_type= NOT_FOUND;
 		FindEvent(event_row, event_type, start, 0, false, bpms, warps, stops,
@@ -905,6 +928,8 @@ void TimingData::GetBeatInternal(GetBeatStarts& start, GetBeatArgs& args,
 		start.last_row= event_row;
 	}
 #undef INC_INDEX
+	start.bps= bps;
+	start.has_bps= true;
 	if(args.elapsed_time == FLT_MAX)
 	{
 		args.elapsed_time= start.last_time;
@@ -927,8 +952,56 @@ void TimingData::GetBeatAndBPSFromElapsedTimeNoOffset(GetBeatArgs& args) const
 	GetBeatInternal(start, args, INT_MAX);
 }
 
+void TimingData::GetBeatAndBPSFromElapsedTime(GetBeatArgs& args, LookupCursor& cursor) const
+{
+	args.elapsed_time += GAMESTATE->m_SongOptions.GetCurrent().m_fMusicRate * PREFSMAN->m_fGlobalOffsetSeconds;
+	GetBeatAndBPSFromElapsedTimeNoOffset(args, cursor);
+}
+
+void TimingData::GetBeatAndBPSFromElapsedTimeNoOffset(GetBeatArgs& args, LookupCursor& cursor) const
+{
+	CheckCursor(cursor);
+	GetBeatFromLookup(args, cursor);
+}
+
+static unsigned int GetSegmentCount(const TimingData::GetBeatStarts& start)
+{
+	return start.bpm + start.warp + start.stop + start.delay;
+}
+
+void TimingData::CheckCursor(LookupCursor& cursor) const
+{
+	if(m_lookup_serial == 0 || cursor.serial != m_lookup_serial)
+	{
+		cursor.valid= false;
+	}
+	cursor.serial= m_lookup_serial;
+}
+
+void TimingData::GetBeatFromLookup(GetBeatArgs& args, LookupCursor& cursor) const
+{
+	GetBeatStarts start;
+	start.last_time= -m_fBeat0OffsetInSeconds;
+	beat_start_lookup_t::const_iterator looked_up_start=
+		FindEntryInLookup(m_beat_start_lookup, args.elapsed_time);
+	if(looked_up_start != m_beat_start_lookup.end())
+	{
+		start= looked_up_start->second;
+	}
+	// Resume from the cursor if it's before the time, and closer than the
+	// table entry.
+	if(cursor.valid && cursor.start.last_time <= args.elapsed_time &&
+		GetSegmentCount(cursor.start) >= GetSegmentCount(start))
+	{
+		start= cursor.start;
+		args.warp_begin_out= cursor.warp_begin;
+		args.warp_dest_out= cursor.warp_dest;
+	}
+	GetBeatInternal(start, args, INT_MAX, &cursor);
+}
+
 float TimingData::GetElapsedTimeInternal(GetBeatStarts& start, float beat,
-	unsigned int max_segment) const
+	unsigned int max_segment, LookupCursor* cursor) const
 {
 	const std::vector<TimingSegment*>& bpms= m_avpTimingSegments[SEGMENT_BPM];
 	const std::vector<TimingSegment*>& warps= m_avpTimingSegments[SEGMENT_WARP];
@@ -936,12 +1009,30 @@ float TimingData::GetElapsedTimeInternal(GetBeatStarts& start, float beat,
 	const std::vector<TimingSegment*>& delays= m_avpTimingSegments[SEGMENT_DELAY];
 	unsigned int curr_segment= start.bpm+start.warp+start.stop+start.delay;
 
-	float bps= GetBPMAtRow(start.last_row) / 60.0f;
+	float bps= start.has_bps ? start.bps : GetBPMAtRow(start.last_row) / 60.0f;
 #define INC_INDEX(index) ++curr_segment; ++index;
 	bool find_marker= beat < FLT_MAX;
+	int warp_begin= -1;
+	float warp_dest= 0;
+	if(cursor != nullptr && cursor->valid)
+	{
+		warp_begin= cursor->warp_begin;
+		warp_dest= cursor->warp_dest;
+	}
 
 	while(curr_segment < max_segment)
 	{
+		// Everything up to here comes before the beat (or ends on its row,
+		// without a stop), so a later lookup can pick up from here.
+		if(cursor != nullptr)
+		{
+			cursor->start= start;
+			cursor->start.bps= bps;
+			cursor->start.has_bps= true;
+			cursor->warp_begin= warp_begin;
+			cursor->warp_dest= warp_dest;
+			cursor->valid= true;
+		}
 		int event_row= INT_MAX;
 		int event_type= NOT_FOUND;
 		FindEvent(event_row, event_type, start, beat, find_marker, bpms, warps, stops,
@@ -983,6 +1074,8 @@ float TimingData::GetElapsedTimeInternal(GetBeatStarts& start, float beat,
 					{
 						start.warp_destination= warp_sum;
 					}
+					warp_begin= event_row;
+					warp_dest= start.warp_destination;
 					INC_INDEX(start.warp);
 					break;
 				}
@@ -990,6 +1083,8 @@ float TimingData::GetElapsedTimeInternal(GetBeatStarts& start, float beat,
 		start.last_row= event_row;
 	}
 #undef INC_INDEX
+	start.bps= bps;
+	start.has_bps= true;
 	return start.last_time;
 }
 
@@ -1013,6 +1108,56 @@ float TimingData::GetElapsedTimeFromBeatNoOffset( float fBeat ) const
 	return start.last_time;
 }
 
+float TimingData::GetElapsedTimeFromBeat( float fBeat, LookupCursor& cursor ) const
+{
+	return TimingData::GetElapsedTimeFromBeatNoOffset( fBeat, cursor )
+		- GAMESTATE->m_SongOptions.GetCurrent().m_fMusicRate * PREFSMAN->m_fGlobalOffsetSeconds;
+}
+
+float TimingData::GetElapsedTimeFromBeatNoOffset( float fBeat, LookupCursor& cursor ) const
+{
+	CheckCursor(cursor);
+	return GetElapsedTimeFromLookup(fBeat, cursor);
+}
+
+void TimingData::GetElapsedTimesFromBeats( const std::vector<float>& beats, std::vector<float>& times_out ) const
+{
+	const float offset= GAMESTATE->m_SongOptions.GetCurrent().m_fMusicRate * PREFSMAN->m_fGlobalOffsetSeconds;
+	// The timing data can't change during this call, so the cursor is good
+	// whether or not the lookups are prepared.
+	LookupCursor cursor;
+	times_out.resize(beats.size());
+	for(std::size_t i= 0; i < beats.size(); ++i)
+	{
+		times_out[i]= GetElapsedTimeFromLookup(beats[i], cursor) - offset;
+	}
+}
+
+float TimingData::GetElapsedTimeFromLookup(float fBeat, LookupCursor& cursor) const
+{
+	GetBeatStarts start;
+	start.last_time= -m_fBeat0OffsetInSeconds;
+	beat_start_lookup_t::const_iterator looked_up_start=
+		FindEntryInLookup(m_time_start_lookup, fBeat);
+	if(looked_up_start != m_time_start_lookup.end())
+	{
+		start= looked_up_start->second;
+	}
+	// A stop on the beat's own row comes after the beat, so the cursor has to
+	// be on an earlier row.
+	if(cursor.valid && cursor.start.last_row < BeatToNoteRow(fBeat) &&
+		GetSegmentCount(cursor.start) >= GetSegmentCount(start))
+	{
+		start= cursor.start;
+	}
+	else
+	{
+		cursor.valid= false;
+	}
+	GetElapsedTimeInternal(start, fBeat, INT_MAX, &cursor);
+	return start.last_time;
+}
+
 float TimingData::GetDisplayedBeat( float fBeat ) const
 {
 	float fOutBeat = 0;
@@ -1033,6 +1178,7 @@ void TimingData::ScaleRegion( float fScale, int iStartIndex, int iEndIndex, bool
 	ASSERT( fScale > 0 );
 	ASSERT( iStartIndex >= 0 );
 	ASSERT( iStartIndex < iEndIndex );
+	++m_revision;
 
 	int length = iEndIndex - iStartIndex;
 	int newLength = std::lrint( fScale * length );
@@ -1070,6 +1216,7 @@ void TimingData::ScaleRegion( float fScale, int iStartIndex, int iEndIndex, bool
 
 void TimingData::InsertRows( int iStartRow, int iRowsToAdd )
 {
+	++m_revision;
 	FOREACH_TimingSegmentType( tst )
 	{
 		std::vector<TimingSegment *> &segs = m_avpTimingSegments[tst];
@@ -1095,6 +1242,7 @@ void TimingData::InsertRows( int iStartRow, int iRowsToAdd )
 // Delete timing changes in [iStartRow, iStartRow + iRowsToDelete) and shift up.
 void TimingData::DeleteRows( int iStartRow, int iRowsToDelete )
 {
+	++m_revision;
 	FOREACH_TimingSegmentType( tst )
 	{
 		// Don't delete the indefinite segments that are still in effect
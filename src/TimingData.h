@@ -109,9 +109,13 @@ public:
 		int last_row;
 		float last_time;
 		float warp_destination;
+		// The bps at last_row, if known, so resuming needn't look it up.
+		float bps;
+		bool has_bps;
 		bool is_warping;
 	GetBeatStarts() :bpm(0), warp(0), stop(0), delay(0), last_row(0),
-			last_time(0), warp_destination(0), is_warping(false) {}
+			last_time(0), warp_destination(0), bps(0), has_bps(false),
+			is_warping(false) {}
 	};
 	// map can't be used for the lookup table because its find or *_bound
 	// functions would return the wrong entry.
@@ -130,8 +134,35 @@ public:
 	beat_start_lookup_t m_beat_start_lookup;
 	beat_start_lookup_t m_time_start_lookup;
 
+	// A LookupCursor remembers where the last lookup's walk through the
+	// segments stopped, so that the next lookup can resume from there instead
+	// of starting from the lookup table.  Gameplay mostly asks about times and
+	// beats just past the ones it asked about last, so with a cursor each
+	// lookup only walks the segments in between.  Asking about an earlier time
+	// or beat starts over, as if no cursor was given.
+	// Cursors are only kept between PrepareLookup and ReleaseLookup, when the
+	// timing data isn't changing.  Use a separate cursor for each series of
+	// lookups, or they'll keep sending each other back to the start.
+	struct LookupCursor
+	{
+		GetBeatStarts start;
+		int warp_begin;
+		float warp_dest;
+		unsigned int serial;
+		bool valid;
+	LookupCursor() :warp_begin(-1), warp_dest(0), serial(0), valid(false) {}
+	};
+
 	void PrepareLookup();
 	void ReleaseLookup();
+
+	// Changes whenever the segments do, so that anything worked out from them
+	// can tell when to work it out again.  Code that edits a segment in place,
+	// through a pointer from GetSegmentAtRow and the like, has to call
+	// SegmentsChanged itself.
+	unsigned int GetRevision() const { return m_revision; }
+	void SegmentsChanged() { ++m_revision; }
+
 	void DumpOneTable(const beat_start_lookup_t& lookup, const RString& name);
 	void DumpLookupTables();
 
@@ -357,10 +388,11 @@ public:
 	void NoteRowToMeasureAndBeat( int iNoteRow, int &iMeasureIndexOut, int &iBeatIndexOut, int &iRowsRemainder ) const;
 
 	void GetBeatInternal(GetBeatStarts& start, GetBeatArgs& args,
-		unsigned int max_segment) const;
+		unsigned int max_segment, LookupCursor* cursor= nullptr) const;
 	float GetElapsedTimeInternal(GetBeatStarts& start, float beat,
-		unsigned int max_segment) const;
+		unsigned int max_segment, LookupCursor* cursor= nullptr) const;
 	void GetBeatAndBPSFromElapsedTime(GetBeatArgs& args) const;
+	void GetBeatAndBPSFromElapsedTime(GetBeatArgs& args, LookupCursor& cursor) const;
 	float GetBeatFromElapsedTime(float elapsed_time) const	// shortcut for places that care only about the beat
 	{
 		GetBeatArgs args;
@@ -369,8 +401,18 @@ public:
 		return args.beat;
 	}
 	float GetElapsedTimeFromBeat( float fBeat ) const;
+	float GetElapsedTimeFromBeat( float fBeat, LookupCursor& cursor ) const;
+	/**
+	 * @brief Convert a list of beats to times in one pass.
+	 *
+	 * This is much faster than converting them one at a time when the beats
+	 * are sorted, and works (slowly) when they aren't.
+	 * @param beats the beats to convert.
+	 * @param times_out the times of the beats, in the same order. */
+	void GetElapsedTimesFromBeats( const std::vector<float>& beats, std::vector<float>& times_out ) const;
 
 	void GetBeatAndBPSFromElapsedTimeNoOffset(GetBeatArgs& args) const;
+	void GetBeatAndBPSFromElapsedTimeNoOffset(GetBeatArgs& args, LookupCursor& cursor) const;
 	float GetBeatFromElapsedTimeNoOffset(float elapsed_time) const	// shortcut for places that care only about the beat
 	{
 		GetBeatArgs args;
@@ -379,6 +421,7 @@ public:
 		return args.beat;
 	}
 	float GetElapsedTimeFromBeatNoOffset( float fBeat ) const;
+	float GetElapsedTimeFromBeatNoOffset( float fBeat, LookupCursor& cursor ) const;
 	float GetDisplayedBeat( float fBeat ) const;
 
 	bool HasBpmChanges() const { return GetTimingSegments(SEGMENT_BPM).size() > 1; }
@@ -472,6 +515,16 @@ protected:
 
 	// All of the following vectors must be sorted before gameplay.
 	std::array<std::vector<TimingSegment *>, NUM_TimingSegmentType> m_avpTimingSegments;
+
+private:
+	// Walk from wherever is closest: the cursor or the lookup table.
+	void GetBeatFromLookup(GetBeatArgs& args, LookupCursor& cursor) const;
+	float GetElapsedTimeFromLookup(float fBeat, LookupCursor& cursor) const;
+	void CheckCursor(LookupCursor& cursor) const;
+
+	// Identifies the current PrepareLookup; 0 if lookups aren't prepared.
+	unsigned int m_lookup_serial= 0;
+	unsigned int m_revision= 0;
 };
 
 #undef COMPARE
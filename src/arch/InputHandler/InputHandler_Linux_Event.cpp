@@ -4,6 +4,7 @@
 #include "RageUtil.h"
 #include "LinuxInputManager.h"
 #include "GamePreferences.h" //needed for Axis Fix
+#include "arch/ArchHooks/ArchHooks_Unix.h"
 
 #include <cerrno>
 #include <cstdint>
@@ -19,8 +20,17 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 #include <linux/input.h>
 
+/* Older headers only have input_event.time. */
+#if !defined(input_event_sec)
+#define input_event_sec time.tv_sec
+#define input_event_usec time.tv_usec
+#endif
+
 REGISTER_INPUT_HANDLER_CLASS2( LinuxEvent, Linux_Event );
 
 static RString BustypeToString( int iBus )
@@ -63,6 +73,8 @@ struct EventDevice
 	RString m_sPath;
 	RString m_sName;
 	InputDevice m_Dev;
+	/* If true, events are stamped with the clock RageTimer uses. */
+	bool m_bKernelTimestamps;
 
 	int aiAbsMin[ABS_MAX];
 	int aiAbsMax[ABS_MAX];
@@ -80,13 +92,14 @@ static bool BitIsSet( const std::uint8_t *pArray, std::uint32_t iBit )
 EventDevice::EventDevice()
 {
 	m_iFD = -1;
+	m_bKernelTimestamps = false;
 }
 
 bool EventDevice::Open( RString sFile, InputDevice dev )
 {
 	m_sPath = sFile;
 	m_Dev = dev;
-	m_iFD = open( sFile, O_RDWR );
+	m_iFD = open( sFile, O_RDWR | O_NONBLOCK );
 	if( m_iFD == -1 )
 	{
 		// HACK: Let the caller handle errno.
@@ -257,6 +270,22 @@ bool EventDevice::Open( RString sFile, InputDevice dev )
 	}
 	LOG->Info( "    Total keys: %i; total axes: %i", iTotalKeys, iTotalAxes );
 
+	/* Have the kernel stamp events with the clock RageTimer uses, so a press
+	 * is timed from when it happened, not from when we got around to reading
+	 * it.  Events are stamped with CLOCK_REALTIME by default. */
+	clockid_t iClock = ArchHooks_Unix::GetClock();
+	m_bKernelTimestamps = (iClock == CLOCK_REALTIME);
+#if defined(EVIOCSCLOCKID)
+	if( !m_bKernelTimestamps )
+	{
+		int iClockID = iClock;
+		if( ioctl(m_iFD, EVIOCSCLOCKID, &iClockID) == -1 )
+			LOG->Warn( "ioctl(EVIOCSCLOCKID): %s", strerror(errno) );
+		else
+			m_bKernelTimestamps = true;
+	}
+#endif
+
 	return true;
 }
 
@@ -269,6 +298,7 @@ InputHandler_Linux_Event::InputHandler_Linux_Event()
 	: m_NextDevice(DEVICE_JOY10)
 	, m_bShutdown(true)
 	, m_bDevicesChanged(false)
+	, m_iWakeFD(-1)
 {
 	if(LINUXINPUT == nullptr) LINUXINPUT = new LinuxInputManager;
 	LINUXINPUT->InitDriver(this);
@@ -289,6 +319,9 @@ InputHandler_Linux_Event::~InputHandler_Linux_Event()
 void InputHandler_Linux_Event::StartThread()
 {
 	m_bShutdown = false;
+	m_iWakeFD = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK );
+	if( m_iWakeFD == -1 )
+		LOG->Warn( "eventfd: %s", strerror(errno) );
 	m_InputThread.SetName( "Event input thread" );
 	m_InputThread.Create( InputThread_Start, this );
 }
@@ -297,7 +330,16 @@ void InputHandler_Linux_Event::StopThread()
 {
 	m_bShutdown = true;
 	LOG->Trace( "Shutting down joystick thread ..." );
+	if( m_iWakeFD != -1 )
+	{
+		std::uint64_t iWake = 1;
+		if( write(m_iWakeFD, &iWake, sizeof(iWake)) == -1 )
+			LOG->Warn( "write(eventfd): %s", strerror(errno) );
+	}
 	m_InputThread.Wait();
+	if( m_iWakeFD != -1 )
+		close( m_iWakeFD );
+	m_iWakeFD = -1;
 	LOG->Trace( "Joystick thread shut down." );
 }
 
@@ -335,55 +377,122 @@ int InputHandler_Linux_Event::InputThread_Start( void *p )
 	return 0;
 }
 
+/* Get the time an event happened.  If the kernel didn't stamp it with our
+ * clock, use the time it was read. */
+static RageTimer GetEventTime( const EventDevice &dev, const input_event &event, const RageTimer &now )
+{
+	if( !dev.m_bKernelTimestamps )
+		return now;
+
+	RageTimer tm( event.input_event_sec, event.input_event_usec );
+
+	/* Don't trust a stamp from the future. */
+	if( now < tm )
+		return now;
+	return tm;
+}
+
 void InputHandler_Linux_Event::InputThread()
 {
-	while( !m_bShutdown )
-	{
-		fd_set fdset;
-		FD_ZERO( &fdset );
-		int iMaxFD = -1;
+	/* Presses carry the kernel's timestamp, but they still have to reach the
+	 * game in time to be judged, so don't wait behind other threads. */
+	setpriority( PRIO_PROCESS, 0, -10 );
 
-		for( int i = 0; i < (int) g_apEventDevices.size(); ++i )
-		{
-			int iFD = g_apEventDevices[i]->m_iFD;
-			if( !g_apEventDevices[i]->IsOpen() )
-				continue;
+	int iEpollFD = epoll_create1( EPOLL_CLOEXEC );
+	if( iEpollFD == -1 )
+	{
+		LOG->Warn( "epoll_create1: %s", strerror(errno) );
+		return;
+	}
 
-			FD_SET( iFD, &fdset );
-			iMaxFD = std::max( iMaxFD, iFD );
-		}
+	/* The wake FD has no device. */
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = nullptr;
+	if( m_iWakeFD != -1 && epoll_ctl(iEpollFD, EPOLL_CTL_ADD, m_iWakeFD, &ev) == -1 )
+		LOG->Warn( "epoll_ctl(eventfd): %s", strerror(errno) );
 
-		if( iMaxFD == -1 )
-			break;
+	int iOpenDevices = 0;
+	for( EventDevice *pDev : g_apEventDevices )
+	{
+		if( !pDev->IsOpen() )
+			continue;
 
-		struct timeval zero = {0,100000};
-		if( select(iMaxFD+1, &fdset, nullptr, nullptr, &zero) <= 0 )
+		ev.events = EPOLLIN;
+		ev.data.ptr = pDev;
+		if( epoll_ctl(iEpollFD, EPOLL_CTL_ADD, pDev->m_iFD, &ev) == -1 )
+		{
+			LOG->Warn( "epoll_ctl(%s): %s; disabled", pDev->m_sPath.c_str(), strerror(errno) );
+			pDev->Close();
 			continue;
-		RageTimer now;
+		}
+		++iOpenDevices;
+	}
 
-		for( int i = 0; i < (int) g_apEventDevices.size(); ++i )
+	epoll_event aReady[16];
+	while( !m_bShutdown && iOpenDevices > 0 )
+	{
+		/* If we have no wake FD, wake up now and then to check m_bShutdown. */
+		const int iTimeoutMs = m_iWakeFD != -1? -1:100;
+		const int iReady = epoll_wait( iEpollFD, aReady, ARRAYLEN(aReady), iTimeoutMs );
+		if( iReady == -1 )
 		{
-			if( !g_apEventDevices[i]->IsOpen() )
+			if( errno == EINTR )
 				continue;
+			LOG->Warn( "epoll_wait: %s", strerror(errno) );
+			break;
+		}
 
-			if( !FD_ISSET(g_apEventDevices[i]->m_iFD, &fdset) )
+		for( int i = 0; i < iReady; ++i )
+		{
+			EventDevice *pDev = (EventDevice *) aReady[i].data.ptr;
+			if( pDev == nullptr || !pDev->IsOpen() )
 				continue;
 
-			input_event event;
-			int ret = read( g_apEventDevices[i]->m_iFD, &event, sizeof(event) );
-			if( ret == -1 )
+			if( !ReadEvents(pDev) )
 			{
-				LOG->Warn( "Error reading from %s: %s; disabled", g_apEventDevices[i]->m_sPath.c_str(), strerror(errno) );
-				g_apEventDevices[i]->Close();
-				continue;
+				/* Closing the FD takes it out of the epoll set. */
+				pDev->Close();
+				--iOpenDevices;
 			}
+		}
+	}
 
-			if( ret != sizeof(event) )
-			{
-				LOG->Warn("Unexpected packet (size %i != %i) from joystick %i; disabled", ret, (int)sizeof(event), i);
-				g_apEventDevices[i]->Close();
+	close( iEpollFD );
+	InputHandler::UpdateTimer();
+}
+
+/* Read and handle all of a device's pending events.  Return false if the
+ * device should be disabled. */
+bool InputHandler_Linux_Event::ReadEvents( EventDevice *pDev )
+{
+	input_event aEvents[64];
+	for(;;)
+	{
+		const int ret = read( pDev->m_iFD, aEvents, sizeof(aEvents) );
+		if( ret == -1 )
+		{
+			if( errno == EINTR )
 				continue;
-			}
+			if( errno == EAGAIN || errno == EWOULDBLOCK )
+				return true;
+			LOG->Warn( "Error reading from %s: %s; disabled", pDev->m_sPath.c_str(), strerror(errno) );
+			return false;
+		}
+
+		if( ret % sizeof(input_event) != 0 )
+		{
+			LOG->Warn( "Unexpected packet (size %i, not a multiple of %i) from %s; disabled",
+				ret, (int) sizeof(input_event), pDev->m_sPath.c_str() );
+			return false;
+		}
+
+		const RageTimer now;
+		const int iEvents = ret / sizeof(input_event);
+		for( int i = 0; i < iEvents; ++i )
+		{
+			const input_event &event = aEvents[i];
+			const RageTimer tm = GetEventTime( *pDev, event, now );
 
 			switch (event.type) {
 			case EV_KEY: {
@@ -400,35 +509,39 @@ void InputHandler_Linux_Event::InputThread()
 					iNum = event.code;
 				}
 				wrap( iNum, 32 );	// max number of joystick buttons.  Make this a constant?
-				ButtonPressed( DeviceInput(g_apEventDevices[i]->m_Dev, enum_add2(JOY_BUTTON_1, iNum), event.value != 0, now) );
+				ButtonPressed( DeviceInput(pDev->m_Dev, enum_add2(JOY_BUTTON_1, iNum), event.value != 0, tm) );
 				break;
 			}
 
 			case EV_ABS: {
 				ASSERT_M( event.code < ABS_MAX, ssprintf("%i", event.code) );
-				DeviceButton neg = g_apEventDevices[i]->aiAbsMappingLow[event.code];
-				DeviceButton pos = g_apEventDevices[i]->aiAbsMappingHigh[event.code];
+				DeviceButton neg = pDev->aiAbsMappingLow[event.code];
+				DeviceButton pos = pDev->aiAbsMappingHigh[event.code];
 
-				float l = SCALE( int(event.value), (float) g_apEventDevices[i]->aiAbsMin[event.code], (float) g_apEventDevices[i]->aiAbsMax[event.code], -1.0f, 1.0f );
+				float l = SCALE( int(event.value), (float) pDev->aiAbsMin[event.code], (float) pDev->aiAbsMax[event.code], -1.0f, 1.0f );
 				if (GamePreferences::m_AxisFix)
 				{
-				  ButtonPressed( DeviceInput(g_apEventDevices[i]->m_Dev, neg, (l < -0.5)||((l > 0.0001)&&(l < 0.5)), now) ); //Up if between 0.0001 and 0.5 or if less than -0.5
-				  ButtonPressed( DeviceInput(g_apEventDevices[i]->m_Dev, pos, (l > 0.5)||((l > 0.0001)&&(l < 0.5)) , now) ); //Down if between 0.0001 and 0.5 or if more than 0.5
+				  ButtonPressed( DeviceInput(pDev->m_Dev, neg, (l < -0.5)||((l > 0.0001)&&(l < 0.5)), tm) ); //Up if between 0.0001 and 0.5 or if less than -0.5
+				  ButtonPressed( DeviceInput(pDev->m_Dev, pos, (l > 0.5)||((l > 0.0001)&&(l < 0.5)) , tm) ); //Down if between 0.0001 and 0.5 or if more than 0.5
 				}
 				else
 				{
-				  ButtonPressed( DeviceInput(g_apEventDevices[i]->m_Dev, neg, std::max(-l, 0.0f), now) );
-				  ButtonPressed( DeviceInput(g_apEventDevices[i]->m_Dev, pos, std::max(+l, 0.0f), now) );
+				  ButtonPressed( DeviceInput(pDev->m_Dev, neg, std::max(-l, 0.0f), tm) );
+				  ButtonPressed( DeviceInput(pDev->m_Dev, pos, std::max(+l, 0.0f), tm) );
 				}
 				break;
 			}
-			}
 
+			case EV_SYN:
+				if( event.code == SYN_DROPPED )
+					LOG->Trace( "%s: events dropped", pDev->m_sPath.c_str() );
+				break;
+			}
 		}
 
+		if( ret < (int) sizeof(aEvents) )
+			return true;
 	}
-
-	InputHandler::UpdateTimer();
 }
 
 void InputHandler_Linux_Event::GetDevicesAndDescriptions( std::vector<InputDeviceInfo>& vDevicesOut )
@@ -8,6 +8,7 @@
 
 #include <vector>
 
+struct EventDevice;
 
 class InputHandler_Linux_Event: public InputHandler
 {
@@ -23,10 +24,13 @@ private:
 	void StopThread();
 	static int InputThread_Start( void *p );
 	void InputThread();
+	bool ReadEvents( EventDevice *pDev );
 
 	RageThread m_InputThread;
 	InputDevice m_NextDevice;
 	bool m_bShutdown, m_bDevicesChanged;
+	/* Written to wake the input thread when it's being stopped. */
+	int m_iWakeFD;
 };
 #define USE_INPUT_HANDLER_LINUX_JOYSTICK
 
@@ -48,6 +48,8 @@ void LightsDriver::Reset()
 	ZERO( state.m_bCabinetLights );
 	ZERO( state.m_bGameButtonLights );
 	ZERO( state.m_bCoinCounter );
+	state.m_LightsMode = LIGHTSMODE_ALL_CLEARED;
+	state.m_pInputScheme = nullptr;
 	Set( &state );
 }
 
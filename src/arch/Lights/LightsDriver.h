@@ -20,6 +20,11 @@ public:
 
 	virtual void Set( const LightsState *ls ) = 0;
 
+	/* Most drivers are set from the lights output thread, so slow hardware
+	 * can't stall a frame.  Drivers that use game objects in Set, or that
+	 * are cheap enough not to matter, can stay on the game thread. */
+	virtual bool SetFromGameThread() const { return false; }
+
 	// Reset all lights to off
 	void Reset();
 };
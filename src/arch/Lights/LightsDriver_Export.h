@@ -12,6 +12,8 @@ public:
 	LightsDriver_Export();
 	virtual ~LightsDriver_Export();
 	virtual void Set( const LightsState *ls );
+	// This only copies the state, so there's no reason to delay it.
+	virtual bool SetFromGameThread() const { return true; }
 
 	// Get the current lights state. This can be called from a thread.
 	static LightsState GetState();
@@ -31,6 +31,11 @@ LightsDriver_LinuxParallel::~LightsDriver_LinuxParallel()
 	ioperm( PORT_ADDRESS, 1, 0 );
 }
 
+bool LightsDriver_LinuxParallel::SetFromGameThread() const
+{
+	return SCREEN_DEBUG;
+}
+
 void LightsDriver_LinuxParallel::Set( const LightsState *ls )
 {
 	// Set LightState to port
@@ -38,7 +43,7 @@ void LightsDriver_LinuxParallel::Set( const LightsState *ls )
 
 	// Prepare screen output too for debugging
 	s += "LinuxParallel Lights Driver Debug\n";
-	s += "Lights Mode: " + LightsModeToString(LIGHTSMAN->GetLightsMode()) + "\n";
+	s += "Lights Mode: " + LightsModeToString(ls->m_LightsMode) + "\n";
 
 	// Cabinet Lights
 	int i = 0;
@@ -53,9 +58,13 @@ void LightsDriver_LinuxParallel::Set( const LightsState *ls )
 	}
 	s += "\n";
 
-	int iNumGameButtonsToShow = INPUTMAPPER->GetInputScheme()->ButtonNameToIndex( "Start" );
-	if( iNumGameButtonsToShow == GameButton_Invalid )
-		iNumGameButtonsToShow = INPUTMAPPER->GetInputScheme()->m_iButtonsPerController;
+	int iNumGameButtonsToShow = 0;
+	if( ls->m_pInputScheme != nullptr )
+	{
+		iNumGameButtonsToShow = ls->m_pInputScheme->ButtonNameToIndex( "Start" );
+		if( iNumGameButtonsToShow == GameButton_Invalid )
+			iNumGameButtonsToShow = ls->m_pInputScheme->m_iButtonsPerController;
+	}
 	FOREACH_ENUM( GameController,  gc )
 	{
 		s += ssprintf("Controller%d Bits: ",gc+1);
@@ -12,6 +12,8 @@ public:
 
 	virtual ~LightsDriver_LinuxParallel();
 	virtual void Set( const LightsState *ls );
+	// The debug output shows a system message, which only the game thread can do.
+	virtual bool SetFromGameThread() const;
 };
 
 #endif
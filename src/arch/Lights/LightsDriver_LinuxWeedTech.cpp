@@ -137,7 +137,7 @@ void LightsDriver_LinuxWeedTech::Set( const LightsState *ls )
 	bool bOn = false;
 
 	{
-		LightsMode lm = LIGHTSMAN->GetLightsMode();
+		LightsMode lm = ls->m_LightsMode;
 		if( lm == LIGHTSMODE_GAMEPLAY )
 		{
 			// Since all cabinet lights flash together during gameplay.. If 1 light is on, all are on.
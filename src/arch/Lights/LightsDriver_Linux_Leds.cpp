@@ -44,17 +44,21 @@ bool LightsDriver_Linux_Leds::WriteLight(const char *filename, bool state)
 	return true;
 }
 
-bool LightsDriver_Linux_Leds::IsDance()
+bool LightsDriver_Linux_Leds::IsDance(const LightsState *ls)
 {
-	pInput = &GAMESTATE->GetCurrentGame()->m_InputScheme;
+	pInput = ls->m_pInputScheme;
+	if (pInput == nullptr)
+		return false;
 	sInputName = pInput->m_szName;
 
 	return sInputName.EqualsNoCase("dance");
 }
 
-bool LightsDriver_Linux_Leds::IsPump()
+bool LightsDriver_Linux_Leds::IsPump(const LightsState *ls)
 {
-	pInput = &GAMESTATE->GetCurrentGame()->m_InputScheme;
+	pInput = ls->m_pInputScheme;
+	if (pInput == nullptr)
+		return false;
 	sInputName = pInput->m_szName;
 
 	return sInputName.EqualsNoCase("pump");
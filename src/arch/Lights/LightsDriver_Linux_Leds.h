@@ -22,8 +22,8 @@ private:
 protected:
 	LightsState previousLS;
 
-	bool IsDance();
-	bool IsPump();
+	bool IsDance(const LightsState *ls);
+	bool IsPump(const LightsState *ls);
 
 	void SetLight(const char *filename, bool previous, bool desired);
 
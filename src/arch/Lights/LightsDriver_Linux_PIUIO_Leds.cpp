@@ -174,12 +174,12 @@ void LightsDriver_Linux_PIUIO_Leds::Set(const LightsState *ls)
 	//...although I'd be impressed if someone wanted to swap from pump to dance
 	//on a cabinet without shutting down first...
 	//...including swapping pads from your pump cabinet to your itg cabinet...
-	if (IsDance())
+	if (IsDance(ls))
 	{
 		SetGameControllerLights(GameController_1, player1_dance_lights, ls);
 		SetGameControllerLights(GameController_2, player2_dance_lights, ls);
 	}
-	else if (IsPump())
+	else if (IsPump(ls))
 	{
 		SetGameControllerLights(GameController_1, player1_pump_lights, ls);
 		SetGameControllerLights(GameController_2, player2_pump_lights, ls);
@@ -242,8 +242,8 @@ LightsDriver_Linux_stac::~LightsDriver_Linux_stac()
 void LightsDriver_Linux_stac::HandleState(const LightsState *ls, StacDevice *dev, GameController ctrlNum)
 {
     //check to see which game we are running as it can change during gameplay.
-    const InputScheme *pInput = &GAMESTATE->GetCurrentGame()->m_InputScheme;
-    RString sInputName = pInput->m_szName;
+    const InputScheme *pInput = ls->m_pInputScheme;
+    RString sInputName = pInput != nullptr? pInput->m_szName: "";
 
     if (sInputName.EqualsNoCase("dance"))
     {
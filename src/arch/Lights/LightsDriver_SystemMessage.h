@@ -11,6 +11,8 @@ public:
 	virtual ~LightsDriver_SystemMessage();
 
 	virtual void Set( const LightsState *ls );
+	// This shows a message, which only the game thread can do.
+	virtual bool SetFromGameThread() const { return true; }
 };
 
 #endif
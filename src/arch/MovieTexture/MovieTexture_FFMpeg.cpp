@@ -10,6 +10,11 @@
 #include <cerrno>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <thread>
+
+/* The number of frames to decode ahead of the one being shown. */
+static const unsigned MAX_DECODED_FRAMES = 4;
 
 static void FixLilEndian()
 {
@@ -44,11 +49,14 @@ static void FixLilEndian()
 	}
 }
 
-static int FindCompatibleAVFormat( bool bHighColor )
+static int FindCompatibleAVFormat( bool bHighColor, bool bAllowPlanar )
 {
 	for( int i = 0; AVPixelFormats[i].bpp; ++i )
 	{
 		AVPixelFormat_t &fmt = AVPixelFormats[i];
+		if( fmt.YUV == PixelFormatYCbCr_YUV420P && !bAllowPlanar )
+			continue;
+
 		if( fmt.YUV != PixelFormatYCbCr_Invalid )
 		{
 			EffectMode em = MovieTexture_Generic::GetEffectMode( fmt.YUV );
@@ -77,20 +85,22 @@ static int FindCompatibleAVFormat( bool bHighColor )
 	return -1;
 }
 
-RageSurface *RageMovieTextureDriver_FFMpeg::AVCodecCreateCompatibleSurface( int iTextureWidth, int iTextureHeight, bool bPreferHighColor, int &iAVTexfmt, MovieDecoderPixelFormatYCbCr &fmtout )
+RageSurface *RageMovieTextureDriver_FFMpeg::AVCodecCreateCompatibleSurface( int iTextureWidth, int iTextureHeight, bool bPreferHighColor, bool bAllowPlanar, int &iAVTexfmt, MovieDecoderPixelFormatYCbCr &fmtout )
 {
 	FixLilEndian();
 
-	int iAVTexfmtIndex = FindCompatibleAVFormat( bPreferHighColor );
+	int iAVTexfmtIndex = FindCompatibleAVFormat( bPreferHighColor, bAllowPlanar );
 	if( iAVTexfmtIndex == -1 )
-		iAVTexfmtIndex = FindCompatibleAVFormat( !bPreferHighColor );
+		iAVTexfmtIndex = FindCompatibleAVFormat( !bPreferHighColor, bAllowPlanar );
 
 	if( iAVTexfmtIndex == -1 )
 	{
 		/* No dice.  Use the first avcodec format of the preferred bit depth,
-		 * and let the display system convert. */
+		 * and let the display system convert.  The display can't convert
+		 * YUV, so skip those. */
 		for( iAVTexfmtIndex = 0; AVPixelFormats[iAVTexfmtIndex].bpp; ++iAVTexfmtIndex )
-			if( AVPixelFormats[iAVTexfmtIndex].bHighColor == bPreferHighColor )
+			if( AVPixelFormats[iAVTexfmtIndex].YUV == PixelFormatYCbCr_Invalid &&
+				AVPixelFormats[iAVTexfmtIndex].bHighColor == bPreferHighColor )
 				break;
 		ASSERT( AVPixelFormats[iAVTexfmtIndex].bpp != 0 );
 	}
@@ -103,13 +113,22 @@ RageSurface *RageMovieTextureDriver_FFMpeg::AVCodecCreateCompatibleSurface( int
 		pfd->bpp, pfd->masks[0], pfd->masks[1], pfd->masks[2], pfd->masks[3] );
 
 	if( pfd->YUV == PixelFormatYCbCr_YUYV422 )
+	{
 		iTextureWidth /= 2;
+	}
+	else if( pfd->YUV == PixelFormatYCbCr_YUV420P )
+	{
+		/* Four samples to a texel; every two rows of Y are followed by a row of U and V. */
+		iTextureWidth /= 4;
+		iTextureHeight = iTextureHeight * 3 / 2;
+	}
 
 	return CreateSurface( iTextureWidth, iTextureHeight, pfd->bpp,
 		pfd->masks[0], pfd->masks[1], pfd->masks[2], pfd->masks[3] );
 }
 
-MovieDecoder_FFMpeg::MovieDecoder_FFMpeg()
+MovieDecoder_FFMpeg::MovieDecoder_FFMpeg():
+	m_DecodedFramesEvent( "MovieDecoder_FFMpeg" )
 {
 	FixLilEndian();
 
@@ -118,11 +137,20 @@ MovieDecoder_FFMpeg::MovieDecoder_FFMpeg()
 	m_iCurrentPacketOffset = -1;
 	m_Frame = avcodec::av_frame_alloc();
 
+	m_bStopDecoding = false;
+	m_bDecodeFinished = true;
+	m_pCurrentFrame = nullptr;
+	m_fCurrentTimestamp = 0;
+	m_fCurrentDuration = 0;
+
 	Init();
 }
 
 MovieDecoder_FFMpeg::~MovieDecoder_FFMpeg()
 {
+	StopDecoding();
+	avcodec::av_frame_free( &m_pCurrentFrame );
+
 	if( m_iCurrentPacketOffset != -1 )
 	{
 		avcodec::av_packet_unref( &m_Packet );
@@ -169,7 +197,76 @@ void MovieDecoder_FFMpeg::Init()
 	}
 }
 
-/* Read until we get a frame, EOF or error.  Return -1 on error, 0 on EOF, 1 if we have a frame. */
+void MovieDecoder_FFMpeg::StartDecoding()
+{
+	ASSERT( !m_DecodeThread.IsCreated() );
+	m_bStopDecoding = false;
+	m_bDecodeFinished = false;
+	m_DecodeThread.SetName( "Movie decoder" );
+	m_DecodeThread.Create( StartDecodeThread, this );
+}
+
+void MovieDecoder_FFMpeg::StopDecoding()
+{
+	if( !m_DecodeThread.IsCreated() )
+		return;
+
+	m_DecodedFramesEvent.Lock();
+	m_bStopDecoding = true;
+	m_DecodedFramesEvent.Broadcast();
+	m_DecodedFramesEvent.Unlock();
+
+	m_DecodeThread.Wait();
+	m_bDecodeFinished = true;
+	ClearDecodedFrames();
+}
+
+void MovieDecoder_FFMpeg::ClearDecodedFrames()
+{
+	LockMut( m_DecodedFramesEvent );
+	for( DecodedFrame &frame: m_DecodedFrames )
+		avcodec::av_frame_free( &frame.m_pFrame );
+	m_DecodedFrames.clear();
+}
+
+void MovieDecoder_FFMpeg::DecodeThreadMain()
+{
+	for(;;)
+	{
+		m_DecodedFramesEvent.Lock();
+		while( !m_bStopDecoding && m_DecodedFrames.size() >= MAX_DECODED_FRAMES )
+			m_DecodedFramesEvent.Wait();
+		const bool bStop = m_bStopDecoding;
+		m_DecodedFramesEvent.Unlock();
+		if( bStop )
+			return;
+
+		DecodedFrame frame;
+		frame.m_iResult = DecodeNextFrame();
+		frame.m_pFrame = nullptr;
+		frame.m_fTimestamp = m_fTimestamp - m_fTimestampOffset;
+		frame.m_fDuration = m_fLastFrameDelay;
+		if( frame.m_iResult == 1 )
+		{
+			/* Take the frame's buffers, leaving m_Frame empty for the next one. */
+			frame.m_pFrame = avcodec::av_frame_alloc();
+			avcodec::av_frame_move_ref( frame.m_pFrame, m_Frame );
+		}
+
+		LockMut( m_DecodedFramesEvent );
+		m_DecodedFrames.push_back( frame );
+		m_DecodedFramesEvent.Broadcast();
+
+		/* On EOF or error, leave the result at the end of the queue until we're rewound. */
+		if( frame.m_iResult != 1 )
+		{
+			m_bDecodeFinished = true;
+			return;
+		}
+	}
+}
+
+/* Return the next decoded frame.  Return -1 on error, 0 on EOF, 1 if we have a frame. */
 int MovieDecoder_FFMpeg::DecodeFrame( float fTargetTime )
 {
 	//hack to filter out stuttering
@@ -182,9 +279,52 @@ int MovieDecoder_FFMpeg::DecodeFrame( float fTargetTime )
 		m_fLastFrame=fTargetTime;
 	}
 
+	LockMut( m_DecodedFramesEvent );
+	for(;;)
+	{
+		while( m_DecodedFrames.empty() )
+		{
+			/* If the decoder isn't running (we failed to rewind), nothing is coming. */
+			if( m_bDecodeFinished )
+				return -1;
+			m_DecodedFramesEvent.Wait();
+		}
+
+		DecodedFrame frame = m_DecodedFrames.front();
+		if( frame.m_iResult != 1 )
+			return frame.m_iResult;
+
+		/* If we're behind, skip frames that are already over, as long as
+		 * there's a newer frame to show instead. */
+		const bool bSkipThisFrame =
+			fTargetTime != -1 &&
+			frame.m_fTimestamp + frame.m_fDuration < fTargetTime &&
+			m_DecodedFrames.size() > 1 &&
+			m_DecodedFrames[1].m_iResult == 1;
+
+		m_DecodedFrames.pop_front();
+		m_DecodedFramesEvent.Broadcast();
+
+		if( bSkipThisFrame )
+		{
+			avcodec::av_frame_free( &frame.m_pFrame );
+			continue;
+		}
+
+		avcodec::av_frame_free( &m_pCurrentFrame );
+		m_pCurrentFrame = frame.m_pFrame;
+		m_fCurrentTimestamp = frame.m_fTimestamp;
+		m_fCurrentDuration = frame.m_fDuration;
+		return 1;
+	}
+}
+
+/* Read until we get a frame, EOF or error.  Return -1 on error, 0 on EOF, 1 if we have a frame. */
+int MovieDecoder_FFMpeg::DecodeNextFrame()
+{
 	for(;;)
 	{
-		int ret = DecodePacket( fTargetTime );
+		int ret = DecodePacket();
 
 		if( ret == 1 )
 		{
@@ -209,12 +349,12 @@ int MovieDecoder_FFMpeg::DecodeFrame( float fTargetTime )
 
 float MovieDecoder_FFMpeg::GetTimestamp() const
 {
-	return m_fTimestamp - m_fTimestampOffset;
+	return m_fCurrentTimestamp;
 }
 
 float MovieDecoder_FFMpeg::GetFrameDuration() const
 {
-	return m_fLastFrameDelay;
+	return m_fCurrentDuration;
 }
 
 
@@ -256,7 +396,7 @@ int MovieDecoder_FFMpeg::ReadPacket()
 
 /* Decode data from the current packet.  Return -1 on error, 0 if the packet is finished,
  * and 1 if we have a frame (we may have more data in the packet). */
-int MovieDecoder_FFMpeg::DecodePacket( float fTargetTime )
+int MovieDecoder_FFMpeg::DecodePacket()
 {
 	if( m_iEOF == 0 && m_iCurrentPacketOffset == -1 )
 		return 0; /* no packet */
@@ -270,18 +410,13 @@ int MovieDecoder_FFMpeg::DecodePacket( float fTargetTime )
 		if( m_Packet.size == 0 && m_iFrameNumber == -1 )
 			return 0; /* eof */
 
-		bool bSkipThisFrame =
-			fTargetTime != -1 &&
-			GetTimestamp() + GetFrameDuration() < fTargetTime &&
-			(m_pStreamCodec->frame_number % 2) == 0;
-
 		int iGotFrame;
 		int len;
 		/* Hack: we need to send size = 0 to flush frames at the end, but we have
 		 * to give it a buffer to read from since it tries to read anyway. */
 		m_Packet.data = m_Packet.size ? m_Packet.data : nullptr;
 		len = m_Packet.size;
-		avcodec::avcodec_send_packet(m_pStreamCodec, &m_Packet);
+		int iSendRet = avcodec::avcodec_send_packet(m_pStreamCodec, &m_Packet);
 		iGotFrame = !avcodec::avcodec_receive_frame(m_pStreamCodec, m_Frame);
 
 		if( len < 0 )
@@ -290,7 +425,10 @@ int MovieDecoder_FFMpeg::DecodePacket( float fTargetTime )
 			return -1; // XXX
 		}
 
-		m_iCurrentPacketOffset += len;
+		/* With frame threading, the codec may be holding finished frames and
+		 * refuse the packet until we take them.  Send it again next time. */
+		if( iSendRet != AVERROR(EAGAIN) )
+			m_iCurrentPacketOffset += len;
 
 		if( !iGotFrame )
 		{
@@ -330,17 +468,46 @@ int MovieDecoder_FFMpeg::DecodePacket( float fTargetTime )
 			}
 		}
 
-		if( bSkipThisFrame )
-			continue;
-
 		return 1;
 	}
 
 	return 0; /* packet done */
 }
 
+/* Copy a planar 4:2:0 frame into the layout described in CreateCompatibleSurface. */
+static void CopyPlanarFrame( const avcodec::AVFrame *pFrame, RageSurface *pSurface )
+{
+	const int iWidth = pSurface->w * 4;
+	for( int y = 0; y < pSurface->h / 3; ++y )
+	{
+		std::uint8_t *pDest = pSurface->pixels + y * 3 * pSurface->pitch;
+		std::memcpy( pDest, pFrame->data[0] + (y*2) * pFrame->linesize[0], iWidth );
+		std::memcpy( pDest + pSurface->pitch, pFrame->data[0] + (y*2+1) * pFrame->linesize[0], iWidth );
+
+		std::uint8_t *pChroma = pDest + 2 * pSurface->pitch;
+		const std::uint8_t *pU = pFrame->data[1] + y * pFrame->linesize[1];
+		const std::uint8_t *pV = pFrame->data[2] + y * pFrame->linesize[2];
+		for( int x = 0; x < iWidth / 2; ++x )
+		{
+			*pChroma++ = pU[x];
+			*pChroma++ = pV[x];
+		}
+	}
+}
+
 void MovieDecoder_FFMpeg::GetFrame( RageSurface *pSurface )
 {
+	if( m_pCurrentFrame == nullptr )
+		return;
+
+	if( m_AVTexfmt == avcodec::AV_PIX_FMT_YUV420P )
+	{
+		/* The YUV420P shader converts these; no need to scale. */
+		if( m_pCurrentFrame->format == avcodec::AV_PIX_FMT_YUV420P )
+			CopyPlanarFrame( m_pCurrentFrame, pSurface );
+		return;
+	}
+
 	avcodec::AVFrame pict;
 	pict.data[0] = (unsigned char *) pSurface->pixels;
 	pict.linesize[0] = pSurface->pitch;
@@ -363,7 +530,7 @@ void MovieDecoder_FFMpeg::GetFrame( RageSurface *pSurface )
 	}
 
 	avcodec::sws_scale( m_swsctx,
-			m_Frame->data, m_Frame->linesize, 0, GetHeight(),
+			m_pCurrentFrame->data, m_pCurrentFrame->linesize, 0, GetHeight(),
 			pict.data, pict.linesize );
 }
 
@@ -456,6 +623,8 @@ RString MovieDecoder_FFMpeg::Open( RString sFile )
 	LOG->Trace( "Bitrate: %i", static_cast<int>(m_pStreamCodec->bit_rate) );
 	LOG->Trace( "Codec pixel format: %s", avcodec::av_get_pix_fmt_name(m_pStreamCodec->pix_fmt) );
 
+	StartDecoding();
+
 	return RString();
 }
 
@@ -475,6 +644,10 @@ RString MovieDecoder_FFMpeg::OpenCodec()
 	m_pStreamCodec->idct_algo         = FF_IDCT_AUTO;
 	m_pStreamCodec->error_concealment = 3;
 
+	/* Leave a core for the game and one for the decode thread itself. */
+	m_pStreamCodec->thread_count      = clamp( (int) std::thread::hardware_concurrency() - 2, 1, 8 );
+	m_pStreamCodec->thread_type       = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
 	LOG->Trace("Opening codec %s", pCodec->name );
 
 	int ret = avcodec::avcodec_open2( m_pStreamCodec, pCodec, nullptr );
@@ -487,6 +660,9 @@ RString MovieDecoder_FFMpeg::OpenCodec()
 
 void MovieDecoder_FFMpeg::Close()
 {
+	StopDecoding();
+	avcodec::av_frame_free( &m_pCurrentFrame );
+
 	if( m_pStream && m_pStreamCodec->codec )
 	{
 		avcodec::avcodec_close( m_pStreamCodec );
@@ -504,13 +680,23 @@ void MovieDecoder_FFMpeg::Close()
 
 void MovieDecoder_FFMpeg::Rewind()
 {
+	StopDecoding();
 	avcodec::av_seek_frame( m_fctx, -1, 0, 0 );
-	OpenCodec();
+	if( OpenCodec().empty() )
+		StartDecoding();
 }
 
 RageSurface *MovieDecoder_FFMpeg::CreateCompatibleSurface( int iTextureWidth, int iTextureHeight, bool bPreferHighColor, MovieDecoderPixelFormatYCbCr &fmtout )
 {
-	return RageMovieTextureDriver_FFMpeg::AVCodecCreateCompatibleSurface( iTextureWidth, iTextureHeight, bPreferHighColor, *ConvertValue<int>(&m_AVTexfmt), fmtout );
+	/* Limited-range 4:2:0 frames can go to the YUV420P shader as they are, if
+	 * they're being drawn at their own size and fit its layout exactly. */
+	const bool bAllowPlanar =
+		m_pStreamCodec->pix_fmt == avcodec::AV_PIX_FMT_YUV420P &&
+		m_pStreamCodec->color_range != avcodec::AVCOL_RANGE_JPEG &&
+		iTextureWidth == GetWidth() && iTextureHeight == GetHeight() &&
+		(iTextureWidth % 4) == 0 && (iTextureHeight % 2) == 0;
+
+	return RageMovieTextureDriver_FFMpeg::AVCodecCreateCompatibleSurface( iTextureWidth, iTextureHeight, bPreferHighColor, bAllowPlanar, *ConvertValue<int>(&m_AVTexfmt), fmtout );
 }
 
 MovieTexture_FFMpeg::MovieTexture_FFMpeg( RageTextureID ID ):
@@ -4,8 +4,10 @@
 #define RAGE_MOVIE_TEXTURE_FFMPEG_H
 
 #include "MovieTexture_Generic.h"
+#include "RageThreads.h"
 
 #include <cstdint>
+#include <deque>
 
 struct RageSurface;
 
@@ -28,14 +30,14 @@ class MovieTexture_FFMpeg: public MovieTexture_Generic
 public:
 	MovieTexture_FFMpeg( RageTextureID ID );
 
-	static RageSurface *AVCodecCreateCompatibleSurface( int iTextureWidth, int iTextureHeight, bool bPreferHighColor, int &iAVTexfmt, MovieDecoderPixelFormatYCbCr &fmtout );
+	static RageSurface *AVCodecCreateCompatibleSurface( int iTextureWidth, int iTextureHeight, bool bPreferHighColor, bool bAllowPlanar, int &iAVTexfmt, MovieDecoderPixelFormatYCbCr &fmtout );
 };
 
 class RageMovieTextureDriver_FFMpeg: public RageMovieTextureDriver
 {
 public:
 	virtual RageMovieTexture *Create( RageTextureID ID, RString &sError );
-	static RageSurface *AVCodecCreateCompatibleSurface( int iTextureWidth, int iTextureHeight, bool bPreferHighColor, int &iAVTexfmt, MovieDecoderPixelFormatYCbCr &fmtout );
+	static RageSurface *AVCodecCreateCompatibleSurface( int iTextureWidth, int iTextureHeight, bool bPreferHighColor, bool bAllowPlanar, int &iAVTexfmt, MovieDecoderPixelFormatYCbCr &fmtout );
 };
 
 class MovieDecoder_FFMpeg: public MovieDecoder
@@ -63,7 +65,35 @@ private:
 	void Init();
 	RString OpenCodec();
 	int ReadPacket();
-	int DecodePacket( float fTargetTime );
+	int DecodePacket();
+	int DecodeNextFrame();
+
+	/* Frames are decoded ahead in a thread, so a slow frame doesn't stall
+	 * the game loop.  The decoder state below (m_Frame through m_iEOF) belongs
+	 * to the thread while it's running. */
+	static int StartDecodeThread( void *p ) { ((MovieDecoder_FFMpeg *) p)->DecodeThreadMain(); return 0; }
+	void DecodeThreadMain();
+	void StartDecoding();
+	void StopDecoding();
+	void ClearDecodedFrames();
+
+	struct DecodedFrame
+	{
+		avcodec::AVFrame *m_pFrame; /* null on EOF or error */
+		float m_fTimestamp;
+		float m_fDuration;
+		int m_iResult; /* as DecodeFrame */
+	};
+	std::deque<DecodedFrame> m_DecodedFrames;
+	RageThread m_DecodeThread;
+	RageEvent m_DecodedFramesEvent;
+	bool m_bStopDecoding;
+	bool m_bDecodeFinished;
+
+	/* The frame returned by the last DecodeFrame. */
+	avcodec::AVFrame *m_pCurrentFrame;
+	float m_fCurrentTimestamp;
+	float m_fCurrentDuration;
 
 	avcodec::AVStream *m_pStream;
 	avcodec::AVFrame *m_Frame;
@@ -99,6 +129,17 @@ static struct AVPixelFormat_t
 	bool bByteSwapOnLittleEndian;
 	MovieDecoderPixelFormatYCbCr YUV;
 } AVPixelFormats[] = {
+	{
+		32,
+		{ 0xFF000000,
+		  0x00FF0000,
+		  0x0000FF00,
+		  0x000000FF },
+		avcodec::AV_PIX_FMT_YUV420P,
+		false, /* N/A */
+		true,
+		PixelFormatYCbCr_YUV420P,
+	},
 	{
 		32,
 		{ 0xFF000000,
@@ -493,6 +493,7 @@ void MovieTexture_Generic::UpdateFrame()
 static EffectMode EffectModes[] =
 {
 	EffectMode_YUYV422,
+	EffectMode_YUV420P,
 };
 static_assert( ARRAYLEN(EffectModes) == NUM_PixelFormatYCbCr );
 
@@ -14,6 +14,7 @@ class Sprite;
 enum MovieDecoderPixelFormatYCbCr
 {
 	PixelFormatYCbCr_YUYV422,
+	PixelFormatYCbCr_YUV420P,
 	NUM_PixelFormatYCbCr,
 	PixelFormatYCbCr_Invalid
 };
@@ -63,6 +64,10 @@ public:
 	 * If DISPLAY supports the EffectMode_YUYV422 blend mode, this may be
 	 * a packed-pixel YUV surface.  UYVY maps to RGBA, respectively.  If
 	 * used, set fmtout.
+	 *
+	 * If DISPLAY supports EffectMode_YUV420P, this may instead hold planar
+	 * 4:2:0 samples, four to a texel: each group of three rows holds two rows
+	 * of Y followed by one row of interleaved U and V for both.
 	 */
 	virtual RageSurface *CreateCompatibleSurface( int iTextureWidth, int iTextureHeight, bool bPreferHighColor, MovieDecoderPixelFormatYCbCr &fmtout ) = 0;
 
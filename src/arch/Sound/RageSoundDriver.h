@@ -7,13 +7,39 @@
 #include "RageTimer.h"
 #include "RageUtil_CircularBuffer.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <mutex>
+#include <vector>
 
 class RageSoundBase;
 class RageTimer;
 class RageSoundMixBuffer;
 static const int samples_per_block = 512;
 
+/* Counters kept by the mixing and decoding threads, for RageSoundDriver::GetMixingStats. */
+struct RageSoundMixingStats
+{
+	/* How long the decoding thread took to start refilling after the mixer
+	 * made room: under 1ms, under 2ms, under 4ms, ... and 64ms or more. */
+	static const int NUM_LAG_BUCKETS = 8;
+
+	struct SoundStats
+	{
+		RString sPath;
+		int iUnderruns;
+		int iDecodes; // times the decoding thread refilled this sound
+		float fDecodeSeconds; // total time spent in those refills
+		float fMaxDecodeSeconds;
+	};
+
+	int iUnderruns;
+	int iDecodeWakeups;
+	int aiDecodeLag[NUM_LAG_BUCKETS];
+	std::vector<SoundStats> vSounds; // sounds that are currently playing
+};
+
 class RageSoundDriver: public RageDriver
 {
 public:
@@ -69,6 +95,10 @@ public:
 
 	virtual int GetSampleRate() const { return 44100; }
 
+	/* Underruns and decode lag are counted since the driver was started; sound
+	 * counts since each sound started playing. */
+	void GetMixingStats( RageSoundMixingStats &out ) const;
+
 protected:
 	/* Start the decoding.  This should be called once the hardware is set up and
 	 * GetSampleRate will return the correct value. */
@@ -103,9 +133,9 @@ protected:
 	void MixDeinterlaced( float **pBufs, int iChannels, int iFrames, std::int64_t iFrameNumber, std::int64_t iCurrentFrame );
 
 private:
-	/* This mutex is used for serializing with the decoder thread.  Locking this mutex
-	 * can take a while. */
-	RageMutex m_Mutex;
+	/* This mutex serializes StopMixing, PauseMixing and Update with each other.  The
+	 * decoding thread doesn't take it; it locks one sound at a time. */
+	mutable RageMutex m_Mutex;
 
 	/* This mutex locks all sounds[] which are "available".  (Other sound may safely
 	 * be accessed, and sounds may be set to available, without locking this.) */
@@ -143,8 +173,13 @@ private:
 	 * happen on the next iteration.
 	 *
 	 * The only state change made by the decoding thread is on EOF: the state is changed
-	 * from PLAYING to STOPPING.  This is done while m_Mutex is held, to prevent
-	 * races with other threads.
+	 * from PLAYING to STOPPING.  This is done while the sound's m_DecodeLock is held;
+	 * StartMixing and StopMixing take the same lock when they change the state, so the
+	 * decoding thread never touches a sound that has left PLAYING.
+	 *
+	 * m_Buffer is a single-producer, single-consumer queue: StartMixing (while BUFFERING)
+	 * or the decoding thread writes it, and the mixing thread reads it.  When the mixing
+	 * thread frees a block, it wakes the decoding thread to refill it.
 	 *
 	 * The only state change made by the mixing thread is from HALTING to STOPPED.
 	 * This is done with no locks; no other thread can take a sound out of the HALTING state.
@@ -174,6 +209,18 @@ private:
 
 		bool m_bPaused;
 
+		/* Held by the decoding thread while it fills this sound. */
+		RageMutex m_DecodeLock;
+
+		/* Stats for GetMixingStats.  m_iUnderruns is written by the mixing thread, and
+		 * the rest by the decoding thread. */
+		RString m_sPath;
+		std::atomic<int> m_iUnderruns;
+		std::atomic<int> m_iDecodes;
+		std::atomic<std::uint64_t> m_iDecodeUsecs;
+		std::atomic<std::uint64_t> m_iMaxDecodeUsecs;
+		void ResetStats();
+
 		struct QueuedPosMap
 		{
 			int iFrames;
@@ -207,7 +254,21 @@ private:
 	mutable std::int64_t m_iVMaxHardwareFrame;
 	mutable std::int32_t soundDriverMaxSamples = 0;
 
-	bool m_bShutdownDecodeThread;
+	std::atomic<bool> m_bShutdownDecodeThread;
+
+	/* The mixing thread sets m_bDecodeRequested and notifies m_DecodeWake when it
+	 * frees buffer space.  It never locks m_DecodeWakeMutex, so a wakeup can be
+	 * missed; the decoding thread also wakes up on its own once per chunk. */
+	std::mutex m_DecodeWakeMutex;
+	std::condition_variable m_DecodeWake;
+	std::atomic<bool> m_bDecodeRequested;
+	std::atomic<std::uint64_t> m_iDecodeRequestUsecs;
+
+	std::atomic<int> m_iUnderruns;
+	int m_iLoggedUnderruns;
+	std::atomic<int> m_iDecodeWakeups;
+	std::atomic<int> m_aiDecodeLag[RageSoundMixingStats::NUM_LAG_BUCKETS];
+	void WaitForDecodeRequest();
 
 	static int DecodeThread_start( void *p );
 	void DecodeThread();
@@ -7,6 +7,7 @@
 #include "RageSoundMixBuffer.h"
 #include "RageSoundReader.h"
 
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 
@@ -17,13 +18,21 @@ static int frames_to_buffer;
 /* 512 is about 10ms, which is big enough for the tolerance of most schedulers. */
 static int chunksize() { return 512; }
 
-static int underruns = 0, logged_underruns = 0;
-
-RageSoundDriver::Sound::Sound()
+RageSoundDriver::Sound::Sound():
+	m_DecodeLock( "SoundDecodeLock" )
 {
 	m_pSound = nullptr;
 	m_State = AVAILABLE;
 	m_bPaused = false;
+	ResetStats();
+}
+
+void RageSoundDriver::Sound::ResetStats()
+{
+	m_iUnderruns = 0;
+	m_iDecodes = 0;
+	m_iDecodeUsecs = 0;
+	m_iMaxDecodeUsecs = 0;
 }
 
 void RageSoundDriver::Sound::Allocate( int iFrames )
@@ -62,6 +71,7 @@ RageSoundMixBuffer &RageSoundDriver::MixIntoBuffer( int iFrames, std::int64_t iF
 	}
 
 	static RageSoundMixBuffer mix;
+	bool bFreedBlocks = false;
 
 	for( unsigned i = 0; i < ARRAYLEN(m_Sounds); ++i )
 	{
@@ -115,6 +125,7 @@ RageSoundMixBuffer &RageSoundDriver::MixIntoBuffer( int iFrames, std::int64_t iF
 			{
 				/* We've processed all of the sound in this block.  Mark it read. */
 				s.m_Buffer.advance_read_pointer( 1 );
+				bFreedBlocks = true;
 				++p[0];
 				--pSize[0];
 
@@ -155,7 +166,20 @@ RageSoundMixBuffer &RageSoundDriver::MixIntoBuffer( int iFrames, std::int64_t iF
 
 		/* If we don't have enough to fill the buffer, we've underrun. */
 		if( iGotFrames < iFrames && s.m_State == Sound::PLAYING )
-			++underruns;
+		{
+			m_iUnderruns.fetch_add( 1, std::memory_order_relaxed );
+			s.m_iUnderruns.fetch_add( 1, std::memory_order_relaxed );
+			bFreedBlocks = true;
+		}
+	}
+
+	/* Wake the decoding thread to refill what we've used.  Don't lock anything here;
+	 * if the decoding thread misses this, it'll wake up on its own shortly. */
+	if( bFreedBlocks && !m_bDecodeRequested.load(std::memory_order_acquire) )
+	{
+		m_iDecodeRequestUsecs.store( RageTimer::GetUsecsSinceStart(), std::memory_order_relaxed );
+		m_bDecodeRequested.store( true, std::memory_order_release );
+		m_DecodeWake.notify_one();
 	}
 
 	return mix;
@@ -180,30 +204,57 @@ void RageSoundDriver::MixDeinterlaced( float **pBufs, int iChannels, int iFrames
 	MixIntoBuffer( iFrames, iFrameNumber, iCurrentFrame ).read_deinterlace( pBufs, iChannels );
 }
 
+/* Sleep until the mixer asks for more data, or for one chunk, whichever is first. */
+void RageSoundDriver::WaitForDecodeRequest()
+{
+	int iSampleRate = GetSampleRate();
+	ASSERT_M( iSampleRate > 0, ssprintf("%i", iSampleRate) );
+	int iUsecs = 1000000*chunksize() / iSampleRate;
+
+	{
+		std::unique_lock<std::mutex> lock( m_DecodeWakeMutex );
+		m_DecodeWake.wait_for( lock, std::chrono::microseconds(iUsecs), [this] {
+			return m_bDecodeRequested.load(std::memory_order_acquire) || m_bShutdownDecodeThread.load();
+		} );
+	}
+
+	if( !m_bDecodeRequested.load(std::memory_order_acquire) )
+		return;
+
+	const std::uint64_t iRequested = m_iDecodeRequestUsecs.load( std::memory_order_relaxed );
+	m_bDecodeRequested.store( false, std::memory_order_release );
+
+	const std::uint64_t iNow = RageTimer::GetUsecsSinceStart();
+	const std::uint64_t iLagMs = iNow > iRequested? (iNow - iRequested) / 1000:0;
+	int iBucket = 0;
+	while( iBucket < RageSoundMixingStats::NUM_LAG_BUCKETS-1 && iLagMs >= (1u << iBucket) )
+		++iBucket;
+	m_aiDecodeLag[iBucket].fetch_add( 1, std::memory_order_relaxed );
+	m_iDecodeWakeups.fetch_add( 1, std::memory_order_relaxed );
+}
+
 void RageSoundDriver::DecodeThread()
 {
 	SetupDecodingThread();
 
 	while( !m_bShutdownDecodeThread )
 	{
-		/* Fill each playing sound, round-robin. */
-		{
-			int iSampleRate = GetSampleRate();
-			ASSERT_M( iSampleRate > 0, ssprintf("%i", iSampleRate) );
-			int iUsecs = 1000000*chunksize() / iSampleRate;
-			usleep( iUsecs );
-		}
-
-		LockMut( m_Mutex );
-//		LOG->Trace("begin mix");
+		WaitForDecodeRequest();
 
+		/* Fill each playing sound, round-robin. */
 		for( unsigned i = 0; i < ARRAYLEN(m_Sounds); ++i )
 		{
-			if( m_Sounds[i].m_State != Sound::PLAYING )
+			Sound *pSound = &m_Sounds[i];
+			if( pSound->m_State != Sound::PLAYING || !pSound->m_Buffer.num_writable() )
 				continue;
 
-			Sound *pSound = &m_Sounds[i];
+			/* Only this sound is locked, so stopping or starting other sounds doesn't
+			 * wait on us. */
+			LockMut( pSound->m_DecodeLock );
+			if( pSound->m_State != Sound::PLAYING )
+				continue;
 
+			const std::uint64_t iStartUsecs = RageTimer::GetUsecsSinceStart();
 			CHECKPOINT_M("Processing the sound while buffers are available.");
 			while( pSound->m_Buffer.num_writable() )
 			{
@@ -218,8 +269,13 @@ void RageSoundDriver::DecodeThread()
 //					LOG->Trace("mixer: (#%i) eof (%p)", i, pSound->m_pSound );
 				}
 			}
+
+			const std::uint64_t iUsecs = RageTimer::GetUsecsSinceStart() - iStartUsecs;
+			pSound->m_iDecodes.fetch_add( 1, std::memory_order_relaxed );
+			pSound->m_iDecodeUsecs.fetch_add( iUsecs, std::memory_order_relaxed );
+			if( iUsecs > pSound->m_iMaxDecodeUsecs.load(std::memory_order_relaxed) )
+				pSound->m_iMaxDecodeUsecs.store( iUsecs, std::memory_order_relaxed );
 		}
-//		LOG->Trace("end mix");
 	}
 }
 
@@ -295,13 +351,13 @@ void RageSoundDriver::Update()
 	static float fNext = 0;
 	if( RageTimer::GetTimeSinceStart() >= fNext )
 	{
-		/* Lockless: only Mix() can write to underruns. */
-		int current_underruns = underruns;
-		if( current_underruns > logged_underruns )
+		/* Lockless: only Mix() can write to m_iUnderruns. */
+		int current_underruns = m_iUnderruns.load( std::memory_order_relaxed );
+		if( current_underruns > m_iLoggedUnderruns )
 		{
-			LOG->MapLog( "GenericMixingUnderruns", "Mixing underruns: %i", current_underruns - logged_underruns );
-			LOG->Trace( "Mixing underruns: %i", current_underruns - logged_underruns );
-			logged_underruns = current_underruns;
+			LOG->MapLog( "GenericMixingUnderruns", "Mixing underruns: %i", current_underruns - m_iLoggedUnderruns );
+			LOG->Trace( "Mixing underruns: %i", current_underruns - m_iLoggedUnderruns );
+			m_iLoggedUnderruns = current_underruns;
 
 			/* Don't log again for at least a second, or we'll burst output
 			 * and possibly cause more underruns. */
@@ -337,6 +393,8 @@ void RageSoundDriver::StartMixing( RageSoundBase *pSound )
 	s.m_pSound = pSound;
 	s.m_StartTime = pSound->GetStartTime();
 	s.m_Buffer.clear();
+	s.m_sPath = pSound->GetLoadedFilePath();
+	s.ResetStats();
 
 	/* Initialize the sound buffer. */
 	int BufferSize = frames_to_buffer;
@@ -354,14 +412,16 @@ void RageSoundDriver::StartMixing( RageSoundBase *pSound )
 			break;
 	}
 
+	/* Hand the buffer to the decoding thread. */
+	s.m_DecodeLock.Lock();
 	s.m_State = Sound::PLAYING;
+	s.m_DecodeLock.Unlock();
 
 //	LOG->Trace("StartMixing: (#%i) finished prebuffering(%s) (%p)", i, s.m_pSound->GetLoadedFilePath().c_str(), s.m_pSound );
 }
 
 void RageSoundDriver::StopMixing( RageSoundBase *pSound )
 {
-	/* Lock, to make sure the decoder thread isn't running on this sound while we do this. */
 	m_Mutex.Lock();
 
 	/* Find the sound. */
@@ -386,9 +446,11 @@ void RageSoundDriver::StopMixing( RageSoundBase *pSound )
 
 //	LOG->Trace("StopMixing: set %p (%s) to HALTING", m_Sounds[i].m_pSound, m_Sounds[i].m_pSound->GetLoadedFilePath().c_str());
 
-	/* Tell the mixing thread to flush the buffer.  We don't have to worry about
-	 * the decoding thread, since we've locked m_Mutex. */
+	/* Tell the mixing thread to flush the buffer.  Lock the sound, to make sure the
+	 * decoding thread isn't running on it while we do this. */
+	m_Sounds[i].m_DecodeLock.Lock();
 	m_Sounds[i].m_State = Sound::HALTING;
+	m_Sounds[i].m_DecodeLock.Unlock();
 
 	/* Invalidate the m_pSound pointer to guarantee we don't make any further references to
 	 * it.  Once this call returns, the sound may no longer exist. */
@@ -426,6 +488,32 @@ bool RageSoundDriver::PauseMixing( RageSoundBase *pSound, bool bStop )
 	return true;
 }
 
+void RageSoundDriver::GetMixingStats( RageSoundMixingStats &out ) const
+{
+	out.iUnderruns = m_iUnderruns.load( std::memory_order_relaxed );
+	out.iDecodeWakeups = m_iDecodeWakeups.load( std::memory_order_relaxed );
+	for( int i = 0; i < RageSoundMixingStats::NUM_LAG_BUCKETS; ++i )
+		out.aiDecodeLag[i] = m_aiDecodeLag[i].load( std::memory_order_relaxed );
+
+	/* m_sPath is only changed by StartMixing, in the main thread. */
+	LockMut( m_Mutex );
+	out.vSounds.clear();
+	for( unsigned i = 0; i < ARRAYLEN(m_Sounds); ++i )
+	{
+		const Sound &s = m_Sounds[i];
+		if( s.m_State != Sound::PLAYING && s.m_State != Sound::STOPPING )
+			continue;
+
+		RageSoundMixingStats::SoundStats stats;
+		stats.sPath = s.m_sPath;
+		stats.iUnderruns = s.m_iUnderruns.load( std::memory_order_relaxed );
+		stats.iDecodes = s.m_iDecodes.load( std::memory_order_relaxed );
+		stats.fDecodeSeconds = s.m_iDecodeUsecs.load( std::memory_order_relaxed ) / 1000000.0f;
+		stats.fMaxDecodeSeconds = s.m_iMaxDecodeUsecs.load( std::memory_order_relaxed ) / 1000000.0f;
+		out.vSounds.push_back( stats );
+	}
+}
+
 void RageSoundDriver::StartDecodeThread()
 {
 	ASSERT( !m_DecodeThread.IsCreated() );
@@ -450,6 +538,13 @@ RageSoundDriver::RageSoundDriver():
 	m_SoundListMutex("SoundListMutex")
 {
 	m_bShutdownDecodeThread = false;
+	m_bDecodeRequested = false;
+	m_iDecodeRequestUsecs = 0;
+	m_iUnderruns = 0;
+	m_iLoggedUnderruns = 0;
+	m_iDecodeWakeups = 0;
+	for( std::atomic<int> &iLag : m_aiDecodeLag )
+		iLag = 0;
 	m_iMaxHardwareFrame = 0;
 	m_iVMaxHardwareFrame = 0;
 	SetDecodeBufferSize( 4096 );
@@ -463,6 +558,7 @@ RageSoundDriver::~RageSoundDriver()
 	if( m_DecodeThread.IsCreated() )
 	{
 		m_bShutdownDecodeThread = true;
+		m_DecodeWake.notify_one();
 		LOG->Trace("Shutting down decode thread ...");
 		LOG->Flush();
 		m_DecodeThread.Wait();
@@ -12,6 +12,12 @@ const int channels = 2;
 
 void RageSoundDriver_Null::Update()
 {
+	if( m_fFixedStepSeconds > 0 )
+	{
+		++m_iUpdates;
+		m_iFixedStepPosition.store( std::int64_t(m_iUpdates * double(m_fFixedStepSeconds) * m_iSampleRate) );
+	}
+
 	/* "Play" frames. */
 	while( m_iLastCursorPos < GetPosition()+1024*4 )
 	{
@@ -25,6 +31,8 @@ void RageSoundDriver_Null::Update()
 
 std::int64_t RageSoundDriver_Null::GetPosition() const
 {
+	if( m_fFixedStepSeconds > 0 )
+		return m_iFixedStepPosition.load();
 	return std::int64_t( RageTimer::GetTimeSinceStart() * m_iSampleRate );
 }
 
@@ -33,6 +41,9 @@ RageSoundDriver_Null::RageSoundDriver_Null()
 	m_iSampleRate = PREFSMAN->m_iSoundPreferredSampleRate;
 	if( m_iSampleRate == 0 )
 		m_iSampleRate = 44100;
+	m_fFixedStepSeconds = PREFSMAN->m_fConstantUpdateDeltaSeconds;
+	m_iUpdates = 0;
+	m_iFixedStepPosition.store( 0 );
 	m_iLastCursorPos = GetPosition();
 	StartDecodeThread();
 }
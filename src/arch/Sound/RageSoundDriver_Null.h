@@ -3,6 +3,7 @@
 
 #include "RageSoundDriver.h"
 
+#include <atomic>
 #include <cstdint>
 
 class RageSoundDriver_Null: public RageSoundDriver
@@ -16,6 +17,12 @@ public:
 private:
 	std::int64_t m_iLastCursorPos;
 	int m_iSampleRate;
+
+	/* If the game updates at a fixed rate, play a fixed amount each update
+	 * instead of following the clock. */
+	float m_fFixedStepSeconds;
+	std::int64_t m_iUpdates;
+	std::atomic<std::int64_t> m_iFixedStepPosition;
 };
 #define USE_RAGE_SOUND_NULL
 
@@ -0,0 +1,253 @@
+#include "global.h"
+#include "RageLog.h"
+#include "RageThreads.h"
+#include "RageTimer.h"
+#include "RageUtil.h"
+#include "RageUtil_FileDB.h"
+#include "test_misc.h"
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Look files up in a FilenameDB from several threads at once, the way loading
+ * songs, themes and noteskins in parallel does, and check every answer.  This
+ * is run with the cache left alone, and again with another thread flushing
+ * directories, so they're read back in while other threads are using them.
+ * For each, report the lookups per second.
+ */
+
+static const int NUM_GROUPS = 20;
+static const int NUM_SONGS = 50;
+static const char *g_asSongFiles[] = { "Song.ssc", "Song.sm", "Song.ogg", "Banner.png", "BG.png" };
+static const int SECONDS = 1;
+
+static int ExpectedSize( int iGroup, int iSong, int iFile ) { return iGroup*10000 + iSong*10 + iFile; }
+
+/* Lists a made-up tree of /Songs/Group NN/Song NN/ folders.  Callers ask for
+ * them in any case. */
+class TestFilenameDB: public FilenameDB
+{
+public:
+	std::atomic<int> m_iPopulates{ 0 };
+
+protected:
+	void PopulateFileSet( FileSet &fs, const RString &sPath )
+	{
+		++m_iPopulates;
+
+		/* Take a moment, like a real directory read, so other threads pile up
+		 * waiting for the same directory. */
+		usleep( 50 );
+
+		RString sLower = sPath;
+		sLower.MakeLower();
+		int iGroup, iSong;
+		if( sLower == "/" )
+		{
+			AddDir( fs, "Songs" );
+		}
+		else if( sLower == "/songs/" )
+		{
+			for( int g = 0; g < NUM_GROUPS; ++g )
+				AddDir( fs, ssprintf("Group %02d", g) );
+		}
+		else if( sscanf(sLower.c_str(), "/songs/group %d/song %d/", &iGroup, &iSong) == 2 )
+		{
+			for( unsigned f = 0; f < ARRAYLEN(g_asSongFiles); ++f )
+			{
+				File file( g_asSongFiles[f] );
+				file.size = ExpectedSize( iGroup, iSong, f );
+				file.hash = 0;
+				fs.files.insert( file );
+			}
+		}
+		else if( sscanf(sLower.c_str(), "/songs/group %d/", &iGroup) == 1 )
+		{
+			for( int s = 0; s < NUM_SONGS; ++s )
+				AddDir( fs, ssprintf("Song %02d", s) );
+		}
+	}
+
+	static void AddDir( FileSet &fs, const RString &sName )
+	{
+		File file( sName );
+		file.dir = true;
+		fs.files.insert( file );
+	}
+};
+
+struct Worker
+{
+	TestFilenameDB *m_pDB;
+	unsigned m_iSeed;
+	int m_iLookups;
+	int m_iErrors;
+};
+
+static std::atomic<bool> g_bStop;
+
+static RString RandomCase( std::mt19937 &rand, RString s )
+{
+	switch( rand() % 3 )
+	{
+	case 0: s.MakeLower(); break;
+	case 1: s.MakeUpper(); break;
+	}
+	return s;
+}
+
+static int LookupThread( void *p )
+{
+	Worker &w = *(Worker *) p;
+	std::mt19937 rand( w.m_iSeed );
+	std::vector<RString> asFiles;
+
+	while( !g_bStop )
+	{
+		const int g = rand() % NUM_GROUPS, s = rand() % NUM_SONGS, f = rand() % ARRAYLEN(g_asSongFiles);
+		const RString sDir = ssprintf( "/Songs/Group %02d/Song %02d/", g, s );
+		const RString sFile = sDir + g_asSongFiles[f];
+
+		bool bOK = true;
+		switch( rand() % 5 )
+		{
+		case 0:
+			bOK = w.m_pDB->GetFileSize( RandomCase(rand, sFile) ) == ExpectedSize( g, s, f );
+			break;
+		case 1:
+			bOK = w.m_pDB->GetFileType( RandomCase(rand, sFile) ) == RageFileManager::TYPE_FILE &&
+				w.m_pDB->GetFileType( RandomCase(rand, sDir + "missing.ssc") ) == RageFileManager::TYPE_NONE;
+			break;
+		case 2:
+			asFiles.clear();
+			w.m_pDB->GetDirListing( RandomCase(rand, sDir) + "*.png", asFiles, false, false );
+			bOK = asFiles.size() == 2;
+			break;
+		case 3:
+			asFiles.clear();
+			w.m_pDB->GetDirListing( RandomCase(rand, ssprintf("/Songs/Group %02d/", g)), asFiles, true, false );
+			bOK = asFiles.size() == NUM_SONGS;
+			break;
+		case 4:
+		{
+			RString sPath = RandomCase( rand, sFile );
+			bOK = w.m_pDB->ResolvePath( sPath ) && sPath == sFile;
+			break;
+		}
+		}
+
+		if( !bOK )
+			++w.m_iErrors;
+		++w.m_iLookups;
+	}
+	return 0;
+}
+
+static int FlushThread( void *p )
+{
+	TestFilenameDB *pDB = (TestFilenameDB *) p;
+	std::mt19937 rand( 1 );
+	for( int i = 0; !g_bStop; ++i )
+	{
+		const int g = rand() % NUM_GROUPS, s = rand() % NUM_SONGS;
+		if( i % 100 == 99 )
+			pDB->FlushDirCache();
+		else if( i % 10 == 9 )
+			pDB->FlushDir( ssprintf("/Songs/Group %02d/", g), (i / 10) % 2 == 0 );
+		else
+			pDB->FlushDir( ssprintf("/Songs/Group %02d/Song %02d/", g, s) );
+		usleep( 100 );
+	}
+	return 0;
+}
+
+static bool RunCase( int iThreads, bool bFlush )
+{
+	TestFilenameDB db;
+	g_bStop = false;
+
+	std::vector<Worker> vWorkers( iThreads );
+	std::vector<RageThread> vThreads( iThreads );
+	for( int i = 0; i < iThreads; ++i )
+	{
+		Worker &w = vWorkers[i];
+		w.m_pDB = &db;
+		w.m_iSeed = 1234 + i;
+		w.m_iLookups = 0;
+		w.m_iErrors = 0;
+		vThreads[i].SetName( ssprintf("Lookup %i", i) );
+		vThreads[i].Create( LookupThread, &w );
+	}
+
+	RageThread flusher;
+	if( bFlush )
+	{
+		flusher.SetName( "Flush" );
+		flusher.Create( FlushThread, &db );
+	}
+
+	usleep( SECONDS * 1000000 );
+	g_bStop = true;
+	for( RageThread &thread: vThreads )
+		thread.Wait();
+	if( bFlush )
+		flusher.Wait();
+
+	int iLookups = 0, iErrors = 0;
+	for( const Worker &w: vWorkers )
+	{
+		iLookups += w.m_iLookups;
+		iErrors += w.m_iErrors;
+	}
+
+	LOG->Info( "%i thread(s)%s: %.2f M lookups/s, %i directories read, %i errors",
+		iThreads, bFlush? ", flushing":"", iLookups / float(SECONDS) / 1e6f, db.m_iPopulates.load(), iErrors );
+	return iErrors == 0;
+}
+
+/* Flushing a directory recursively has to reach folders under it, even ones
+ * whose parents aren't cached, and only those. */
+static bool TestRecursiveFlush()
+{
+	TestFilenameDB db;
+	const RString sSong = "/Songs/Group 01/Song 01/Song.ssc";
+	const RString sOther = "/Songs/Group 02/Song 01/Song.ssc";
+	db.GetFileSize( sSong );
+	db.GetFileSize( sOther );
+
+	int iStart = db.m_iPopulates;
+	db.FlushDir( "/Songs/Group 01/" );
+	db.GetFileSize( sSong );
+	const int iShallow = db.m_iPopulates - iStart;
+
+	iStart = db.m_iPopulates;
+	db.FlushDir( "/songs/group 01/", true );
+	db.GetFileSize( sSong );
+	db.GetFileSize( sOther );
+	const int iDeep = db.m_iPopulates - iStart;
+
+	const bool bOK = iShallow == 0 && iDeep == 1;
+	if( !bOK )
+		LOG->Warn( "Recursive flush: %i and %i directories read back, expected 0 and 1", iShallow, iDeep );
+	return bOK;
+}
+
+int main( int argc, char *argv[] )
+{
+	test_handle_args( argc, argv );
+	test_init();
+
+	bool bOK = TestRecursiveFlush();
+	for( int iThreads = 1; iThreads <= 8; iThreads *= 2 )
+	{
+		bOK &= RunCase( iThreads, false );
+		bOK &= RunCase( iThreads, true );
+	}
+
+	test_deinit();
+	exit( bOK? 0:1 );
+}
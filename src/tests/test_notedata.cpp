@@ -0,0 +1,187 @@
+#include "global.h"
+#include "RageLog.h"
+#include "RageTimer.h"
+#include "RageUtil.h"
+#include "GameState.h"
+#include "LuaManager.h"
+#include "NoteData.h"
+#include "NoteDataUtil.h"
+#include "RadarValues.h"
+#include "TimingData.h"
+#include "test_misc.h"
+
+#include <random>
+#include <set>
+
+/*
+ * Time the NoteData queries that look across every track, on long, dense
+ * charts: the row lookups Player makes while judging, a few NoteDataUtil
+ * transforms, and radar calculation.
+ *
+ * Queries across tracks use NoteData's flat row index; run this before and
+ * after a change to NoteData to compare.  Each chart is also checked against
+ * its per-track maps, so a stale index shows up as a failure.
+ */
+
+static const int NUM_MEASURES = 1200;
+
+/* A stream of 16ths with jumps, holds and mines, like a long stamina chart. */
+static void MakeChart( NoteData &nd, int iNumTracks )
+{
+	std::mt19937 rng( 1234 );
+	nd.SetNumTracks( iNumTracks );
+
+	const int iSixteenth = ROWS_PER_BEAT / 4;
+	const int iLastRow = NUM_MEASURES * 4 * ROWS_PER_BEAT;
+	for( int iRow = 0; iRow < iLastRow; iRow += iSixteenth )
+	{
+		int iTrack = rng() % iNumTracks;
+		switch( rng() % 16 )
+		{
+		case 0:
+		{
+			TapNote tn = TAP_ORIGINAL_HOLD_HEAD;
+			tn.iDuration = iSixteenth * (1 + rng() % 8);
+			nd.AddHoldNote( iTrack, iRow, iRow + tn.iDuration, tn );
+			break;
+		}
+		case 1:
+			nd.SetTapNote( iTrack, iRow, TAP_ORIGINAL_MINE );
+			break;
+		case 2:
+		case 3:
+			nd.SetTapNote( (iTrack+1) % iNumTracks, iRow, TAP_ORIGINAL_TAP );
+			// fall through
+		default:
+			nd.SetTapNote( iTrack, iRow, TAP_ORIGINAL_TAP );
+			break;
+		}
+	}
+}
+
+/* Compare the rows seen across all tracks against the track maps themselves. */
+static bool CheckChart( const NoteData &nd, const char *szName )
+{
+	std::set<int> expected;
+	for( int t = 0; t < nd.GetNumTracks(); ++t )
+		for( NoteData::const_iterator it = nd.begin(t); it != nd.end(t); ++it )
+			expected.insert( it->first );
+
+	std::set<int>::const_iterator next = expected.begin();
+	FOREACH_NONEMPTY_ROW_ALL_TRACKS( nd, iRow )
+	{
+		if( next == expected.end() || *next != iRow )
+		{
+			LOG->Warn( "%s: unexpected row %i", szName, iRow );
+			return false;
+		}
+		++next;
+
+		int iExpected = 0;
+		for( int t = 0; t < nd.GetNumTracks(); ++t )
+			if( nd.FindTapNote(t, iRow) != nd.end(t) )
+				++iExpected;
+		if( nd.GetNumTapNonEmptyTracks(iRow) != iExpected )
+		{
+			LOG->Warn( "%s: row %i has %i tracks, expected %i", szName, iRow, nd.GetNumTapNonEmptyTracks(iRow), iExpected );
+			return false;
+		}
+	}
+	if( next != expected.end() )
+	{
+		LOG->Warn( "%s: missed row %i", szName, *next );
+		return false;
+	}
+
+	int iRow = MAX_NOTE_ROW;
+	for( std::set<int>::const_reverse_iterator it = expected.rbegin(); it != expected.rend(); ++it )
+	{
+		if( !nd.GetPrevTapNoteRowForAllTracks(iRow) || iRow != *it )
+		{
+			LOG->Warn( "%s: reverse search found row %i, expected %i", szName, iRow, *it );
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Step through the chart the way Player does while judging: find each row
+ * with notes, see what's on it, and look around it for nearby rows. */
+static int JudgeRows( const NoteData &nd )
+{
+	int iTotal = 0;
+	FOREACH_NONEMPTY_ROW_ALL_TRACKS( nd, iRow )
+	{
+		iTotal += nd.GetNumTracksWithTapOrHoldHead( iRow );
+		iTotal += nd.GetFirstTrackWithTapOrHoldHead( iRow );
+		iTotal += nd.IsRowEmpty( iRow + 1 )? 0:1;
+
+		int iPrev = iRow;
+		if( nd.GetPrevTapNoteRowForAllTracks(iPrev) )
+			iTotal += iRow - iPrev;
+		for( int t = 0; t < nd.GetNumTracks(); ++t )
+			iTotal += nd.GetTapNote( t, iRow ).type;
+	}
+	return iTotal;
+}
+
+static void Transform( NoteData &nd, StepsType st )
+{
+	NoteDataUtil::Turn( nd, st, NoteDataUtil::mirror );
+	NoteDataUtil::Little( nd );
+	NoteDataUtil::Wide( nd );
+	NoteDataUtil::Big( nd );
+	NoteDataUtil::Quick( nd );
+	NoteDataUtil::Echo( nd );
+}
+
+static void Run( int iNumTracks, StepsType st )
+{
+	NoteData chart;
+	MakeChart( chart, iNumTracks );
+	LOG->Info( "%i tracks, %i measures, %i taps:", iNumTracks, NUM_MEASURES, chart.GetNumTapNotesNoTiming() );
+	if( !CheckChart(chart, "chart") )
+		return;
+
+	RageTimer tm;
+	int iTotal = 0;
+	for( int i = 0; i < 10; ++i )
+		iTotal += JudgeRows( chart );
+	LOG->Info( "  judgment lookups: %.3fs (%i)", tm.GetDeltaTime(), iTotal );
+
+	NoteData transformed;
+	for( int i = 0; i < 3; ++i )
+	{
+		transformed = chart;
+		Transform( transformed, st );
+	}
+	LOG->Info( "  transforms: %.3fs", tm.GetDeltaTime() );
+	if( !CheckChart(transformed, "transformed") )
+		return;
+
+	const float fSeconds = GAMESTATE->GetProcessedTimingData()->GetElapsedTimeFromBeat( chart.GetLastBeat() );
+	RadarValues rv;
+	for( int i = 0; i < 10; ++i )
+		NoteDataUtil::CalculateRadarValues( chart, fSeconds, rv );
+	LOG->Info( "  radar values: %.3fs", tm.GetDeltaTime() );
+}
+
+int main( int argc, char *argv[] )
+{
+	test_handle_args( argc, argv );
+	test_init();
+
+	LUA = new LuaManager;
+	GAMESTATE = new GameState;
+	TimingData *pTiming = new TimingData;
+	pTiming->AddSegment( BPMSegment(0, 180) );
+	GAMESTATE->SetProcessedTimingData( pTiming );
+
+	Run( 4, StepsType_dance_single );
+	Run( 8, StepsType_dance_double );
+
+	SAFE_DELETE( GAMESTATE );
+	SAFE_DELETE( LUA );
+	test_deinit();
+	exit(0);
+}
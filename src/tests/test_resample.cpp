@@ -0,0 +1,136 @@
+#include "global.h"
+#include "RageLog.h"
+#include "RageMath.h"
+#include "RageTimer.h"
+#include "RageSoundReader.h"
+#include "RageSoundReader_Resample_Good.h"
+#include "RageUtil.h"
+#include "test_misc.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/*
+ * Compare RageSoundReader_Resample_Good's SIMD filters against the plain
+ * per-channel filter, over a range of sample rate conversions and rate mods.
+ * For each, report the frames per second of both, and the SNR of the SIMD
+ * output, treating the plain output as the signal.
+ */
+
+static const int SECONDS = 20;
+
+/* A few seconds of tones, with the channels out of phase.  They're generated
+ * up front, so reading them costs next to nothing. */
+class RageSoundReader_Tones: public RageSoundReader
+{
+public:
+	RageSoundReader_Tones( int iSampleRate, int iChannels ):
+		m_iSampleRate( iSampleRate ), m_iChannels( iChannels ), m_iFrame( 0 )
+	{
+		for( int i = 0; i < SECONDS * m_iSampleRate; ++i )
+		{
+			const float t = float(i) / m_iSampleRate;
+			for( int c = 0; c < m_iChannels; ++c )
+			{
+				const float fPhase = c * 0.7f;
+				m_vData.push_back( 0.3f * std::sin(2*PI*440*t + fPhase) +
+					0.2f * std::sin(2*PI*3150*t + fPhase) +
+					0.1f * std::sin(2*PI*9800*t + fPhase) );
+			}
+		}
+	}
+	int GetLength() const { return SECONDS * 1000; }
+	int SetPosition( int iFrame ) { m_iFrame = iFrame; return 1; }
+	int Read( float *pBuf, int iFrames )
+	{
+		iFrames = std::min( iFrames, SECONDS * m_iSampleRate - m_iFrame );
+		if( iFrames <= 0 )
+			return END_OF_FILE;
+
+		memcpy( pBuf, &m_vData[m_iFrame * m_iChannels], iFrames * m_iChannels * sizeof(float) );
+		m_iFrame += iFrames;
+		return iFrames;
+	}
+	RageSoundReader *Copy() const { return new RageSoundReader_Tones( *this ); }
+	int GetSampleRate() const { return m_iSampleRate; }
+	unsigned GetNumChannels() const { return m_iChannels; }
+	int GetNextSourceFrame() const { return m_iFrame; }
+	float GetStreamToSourceRatio() const { return 1.0f; }
+	RString GetError() const { return RString(); }
+
+private:
+	int m_iSampleRate;
+	int m_iChannels;
+	int m_iFrame;
+	std::vector<float> m_vData;
+};
+
+static float Resample( std::vector<float> &vOut, int iFromRate, int iToRate, float fRate, int iChannels )
+{
+	RageSoundReader_Resample_Good resample( new RageSoundReader_Tones(iFromRate, iChannels), iToRate );
+	if( fRate != 1 )
+		resample.SetRate( fRate );
+
+	vOut.clear();
+	vOut.reserve( SECONDS * iToRate * iChannels * 2 );
+	float buf[1024*8];
+	RageTimer tm;
+	for(;;)
+	{
+		int iGot = resample.Read( buf, 1024 );
+		if( iGot < 0 )
+			break;
+		vOut.insert( vOut.end(), buf, buf + iGot*iChannels );
+	}
+	return tm.GetDeltaTime();
+}
+
+static void RunCase( int iFromRate, int iToRate, float fRate, int iChannels )
+{
+	std::vector<float> vExpected, vGot;
+	RageSoundReader_Resample_Good::SetVectorFilter( false );
+	const float fPlain = Resample( vExpected, iFromRate, iToRate, fRate, iChannels );
+	RageSoundReader_Resample_Good::SetVectorFilter( true );
+	const float fVector = Resample( vGot, iFromRate, iToRate, fRate, iChannels );
+
+	if( vExpected.size() != vGot.size() )
+	{
+		LOG->Warn( "%i -> %i at %.2fx: got %i samples, expected %i",
+			iFromRate, iToRate, fRate, (int) vGot.size(), (int) vExpected.size() );
+		return;
+	}
+
+	double fSignal = 0, fNoise = 0;
+	for( std::size_t i = 0; i < vExpected.size(); ++i )
+	{
+		fSignal += double(vExpected[i]) * vExpected[i];
+		fNoise += double(vExpected[i] - vGot[i]) * (vExpected[i] - vGot[i]);
+	}
+	RString sSNR = fNoise == 0? RString("identical"): ssprintf( "%.1f dB", 10 * std::log10(fSignal / fNoise) );
+
+	const float fFrames = float(vGot.size() / iChannels);
+	LOG->Info( "%i ch, %5i -> %5i at %.2fx: plain %6.2f Mframes/s, SIMD %6.2f Mframes/s (%.2fx), SNR %s",
+		iChannels, iFromRate, iToRate, fRate, fFrames / fPlain / 1e6f, fFrames / fVector / 1e6f,
+		fPlain / fVector, sSNR.c_str() );
+}
+
+int main( int argc, char *argv[] )
+{
+	test_handle_args( argc, argv );
+	test_init();
+
+	static const int aRates[][2] = { {44100, 48000}, {48000, 44100}, {22050, 48000}, {32000, 48000} };
+	static const float aRateMods[] = { 0.5f, 0.75f, 1.1f, 1.5f, 2.0f };
+
+	for( int iChannels = 1; iChannels <= 2; ++iChannels )
+	{
+		for( auto const &rates : aRates )
+			RunCase( rates[0], rates[1], 1, iChannels );
+		for( float fRate : aRateMods )
+			RunCase( 44100, 48000, fRate, iChannels );
+	}
+
+	test_deinit();
+	exit(0);
+}
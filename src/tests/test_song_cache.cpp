@@ -0,0 +1,135 @@
+#include "global.h"
+#include "RageLog.h"
+#include "RageFile.h"
+#include "RageFileManager.h"
+#include "RageTimer.h"
+#include "RageUtil.h"
+#include "GameManager.h"
+#include "NotesLoader.h"
+#include "NotesLoaderSSC.h"
+#include "NotesWriterSSC.h"
+#include "PrefsManager.h"
+#include "Song.h"
+#include "SongCacheIndex.h"
+#include "SongCacheRecord.h"
+#include "SpecialFiles.h"
+#include "test_misc.h"
+
+#include <set>
+#include <vector>
+
+/*
+ * Compare warm-start loading from the binary song cache against the old
+ * path, which parsed one .ssc cache file per song.
+ *
+ * Point -r at a directory containing a Songs/ folder.  Every song is loaded
+ * from its simfile once and both kinds of cache are written; then each cache
+ * is loaded back, and the times are compared.
+ */
+
+static RString SSCCachePath( const RString &sSongDir )
+{
+	return SongCacheIndex::GetCacheFilePath( "SongsBenchmark", sSongDir );
+}
+
+static void GetSongDirs( std::vector<RString> &vsSongDirs )
+{
+	std::vector<RString> vsGroups;
+	GetDirListing( SpecialFiles::SONGS_DIR + "*", vsGroups, true, true );
+	for( RString const &sGroup : vsGroups )
+	{
+		std::vector<RString> vsSongs;
+		GetDirListing( sGroup + "/*", vsSongs, true, true );
+		for( RString const &sSong : vsSongs )
+			vsSongDirs.push_back( sSong + "/" );
+	}
+}
+
+/* Load every song from its simfile and write both caches.  This isn't timed. */
+static void CreateCaches( const std::vector<RString> &vsSongDirs )
+{
+	for( RString const &sDir : vsSongDirs )
+	{
+		Song song;
+		song.SetSongDir( sDir );
+		std::set<RString> BlacklistedImages;
+		if( !NotesLoader::LoadFromDir(sDir, song, BlacklistedImages) )
+			continue;
+		song.TidyUpData( false, true );
+
+		song.SaveToSSCFile( SSCCachePath(sDir), true );
+
+		RString sRecord;
+		SongCacheRecord::Write( song, sRecord );
+		SONGINDEX->AddCacheRecord( sDir, GetHashForDirectory(sDir), sRecord );
+	}
+	SONGINDEX->SaveCacheIndex();
+}
+
+static float LoadFromSSCCache( const std::vector<RString> &vsSongDirs, int &iLoaded )
+{
+	RageTimer tm;
+	iLoaded = 0;
+	for( RString const &sDir : vsSongDirs )
+	{
+		Song song;
+		song.SetSongDir( sDir );
+		SSCLoader loader;
+		if( loader.LoadFromSimfile(SSCCachePath(sDir), song, true) )
+			++iLoaded;
+	}
+	return tm.GetDeltaTime();
+}
+
+static float LoadFromBinaryCache( const std::vector<RString> &vsSongDirs, int &iLoaded )
+{
+	RageTimer tm;
+	iLoaded = 0;
+
+	// Include mapping the file and reading its index, as startup does.
+	delete SONGINDEX;
+	SONGINDEX = new SongCacheIndex;
+
+	for( RString const &sDir : vsSongDirs )
+	{
+		Song song;
+		song.SetSongDir( sDir );
+		if( !SONGINDEX->LoadCachedSong(song) )
+			continue;
+		song.TidyUpData( true, true );
+		++iLoaded;
+	}
+	return tm.GetDeltaTime();
+}
+
+int main( int argc, char *argv[] )
+{
+	test_handle_args( argc, argv );
+	test_init();
+
+	PREFSMAN = new PrefsManager;
+	GAMEMAN = new GameManager;
+	SONGINDEX = new SongCacheIndex;
+
+	std::vector<RString> vsSongDirs;
+	GetSongDirs( vsSongDirs );
+	LOG->Info( "Caching %i songs ...", (int) vsSongDirs.size() );
+	CreateCaches( vsSongDirs );
+
+	/* Run each a few times, so both are measured with a warm OS file cache,
+	 * as they would be when the game is restarted. */
+	for( int iPass = 0; iPass < 3; ++iPass )
+	{
+		int iSSC, iBinary;
+		float fSSC = LoadFromSSCCache( vsSongDirs, iSSC );
+		float fBinary = LoadFromBinaryCache( vsSongDirs, iBinary );
+		LOG->Info( "Pass %i: .ssc cache: %i songs in %.3fs; binary cache: %i songs in %.3fs (%.1fx)",
+			iPass+1, iSSC, fSSC, iBinary, fBinary, fBinary > 0? fSSC/fBinary:0 );
+	}
+
+	SAFE_DELETE( SONGINDEX );
+	SAFE_DELETE( GAMEMAN );
+	SAFE_DELETE( PREFSMAN );
+	test_deinit();
+	exit(0);
+}
@@ -0,0 +1,166 @@
+#include "global.h"
+#include "RageLog.h"
+#include "RageTimer.h"
+#include "RageUtil.h"
+#include "RageSoundMixBuffer.h"
+#include "RageSoundMixKernels.h"
+#include "test_misc.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+/*
+ * Check each set of mixing kernels this CPU can run against the scalar ones,
+ * and time them.
+ *
+ * The results have to match bit for bit, so the inputs include the values
+ * most likely to round differently: exact clamp limits, values just past them,
+ * signed zeroes and denormals.
+ */
+
+static std::mt19937 g_Rand( 1234 );
+
+static void MakeSamples( std::vector<float> &v, unsigned iSize )
+{
+	static const float aSpecial[] = {
+		0.0f, -0.0f, 1.0f, -1.0f, 1.0000001f, -1.0000001f, 0.5f, -0.5f,
+		1e-40f, -1e-40f, 0.49999997f, 1.0f/32767, -1.0f/32767, 0.9999999f
+	};
+	std::uniform_real_distribution<float> dist( -1.5f, 1.5f );
+	v.resize( iSize );
+	for( unsigned i = 0; i < iSize; ++i )
+	{
+		if( g_Rand() % 8 == 0 )
+			v[i] = aSpecial[ g_Rand() % ARRAYLEN(aSpecial) ];
+		else
+			v[i] = dist( g_Rand );
+	}
+}
+
+static bool Same( const void *a, const void *b, size_t iBytes, const char *szKernels, const char *szWhat, unsigned iSize )
+{
+	if( iBytes == 0 || !memcmp(a, b, iBytes) )
+		return true;
+	LOG->Warn( "%s: %s doesn't match scalar (%u samples)", szKernels, szWhat, iSize );
+	return false;
+}
+
+static bool Check( const RageSoundMixKernels &k, const RageSoundMixKernels &scalar )
+{
+	static const int aStrides[][2] = { {1,1}, {2,1}, {1,2}, {2,2}, {3,2} };
+
+	bool bOK = true;
+	for( unsigned iSize = 0; iSize < 100; ++iSize )
+	{
+		// Start at an odd offset, so nothing lines up.
+		std::vector<float> vSrc, vDest;
+		MakeSamples( vSrc, iSize*3 + 1 );
+		MakeSamples( vDest, iSize*2 + 1 );
+
+		for( auto const &stride : aStrides )
+		{
+			if( iSize == 0 )
+				break;
+			const unsigned iSrcUsed = (iSize-1)*stride[0] + 1, iDestUsed = (iSize-1)*stride[1] + 1;
+			std::vector<float> vExpected( vDest.begin()+1, vDest.begin()+1+iDestUsed );
+			std::vector<float> vGot( vExpected );
+			// Copy the source to its own buffer, so reading past the end would be caught by ASan.
+			std::vector<float> vIn( vSrc.begin()+1, vSrc.begin()+1+iSrcUsed );
+			scalar.AddStrided( vExpected.data(), vIn.data(), iSize, stride[0], stride[1] );
+			k.AddStrided( vGot.data(), vIn.data(), iSize, stride[0], stride[1] );
+			bOK &= Same( vExpected.data(), vGot.data(), iDestUsed*sizeof(float), k.m_szName, "AddStrided", iSize );
+		}
+
+		{
+			std::vector<float> vExpected( vDest.begin()+1, vDest.begin()+1+iSize );
+			std::vector<float> vGot( vExpected );
+			scalar.Add( vExpected.data(), vSrc.data()+1, iSize );
+			k.Add( vGot.data(), vSrc.data()+1, iSize );
+			bOK &= Same( vExpected.data(), vGot.data(), iSize*sizeof(float), k.m_szName, "Add", iSize );
+		}
+
+		{
+			std::vector<std::int16_t> vExpected( iSize ), vGot( iSize );
+			scalar.ToInt16( vExpected.data(), vSrc.data()+1, iSize );
+			k.ToInt16( vGot.data(), vSrc.data()+1, iSize );
+			bOK &= Same( vExpected.data(), vGot.data(), iSize*sizeof(std::int16_t), k.m_szName, "ToInt16", iSize );
+		}
+
+		for( int iChannels = 1; iChannels <= 6; ++iChannels )
+		{
+			const unsigned iFrames = iSize*3 / iChannels;
+			std::vector<float> vExpected( iFrames*iChannels ), vGot( iFrames*iChannels );
+			float *pExpected[6], *pGot[6];
+			for( int c = 0; c < iChannels; ++c )
+			{
+				pExpected[c] = vExpected.data() + c*iFrames;
+				pGot[c] = vGot.data() + c*iFrames;
+			}
+			scalar.Deinterlace( pExpected, vSrc.data()+1, iFrames, iChannels );
+			k.Deinterlace( pGot, vSrc.data()+1, iFrames, iChannels );
+			bOK &= Same( vExpected.data(), vGot.data(), vExpected.size()*sizeof(float), k.m_szName, "Deinterlace", iSize );
+		}
+	}
+	return bOK;
+}
+
+/* Mix the way the sound driver does: several stereo sounds into one buffer,
+ * then read it out as 16-bit and as separate channels. */
+static void Benchmark( const RageSoundMixKernels &k )
+{
+	RageSoundMixKernels::Set( k );
+
+	const unsigned iFrames = 1024, iSounds = 8, iPasses = 20000;
+	std::vector<float> vSound;
+	MakeSamples( vSound, iFrames*2 );
+	std::vector<std::int16_t> vOut16( iFrames*2 );
+	std::vector<float> vLeft( iFrames ), vRight( iFrames );
+	float *pChannels[2] = { vLeft.data(), vRight.data() };
+
+	RageSoundMixBuffer mix;
+	RageTimer tm;
+	for( unsigned iPass = 0; iPass < iPasses; ++iPass )
+	{
+		for( unsigned s = 0; s < iSounds; ++s )
+			mix.write( vSound.data(), iFrames*2 );
+		mix.read( vOut16.data() );
+	}
+	const float fInterleaved = tm.GetDeltaTime();
+
+	for( unsigned iPass = 0; iPass < iPasses; ++iPass )
+	{
+		for( unsigned s = 0; s < iSounds; ++s )
+		{
+			// Split the stereo sound into two mono halves, as RageSoundReader_ChannelSplit does.
+			mix.write( vSound.data(), iFrames, 2, 1 );
+			mix.write( vSound.data()+1, iFrames, 2, 1 );
+		}
+		mix.read_deinterlace( pChannels, 2 );
+	}
+	const float fSplit = tm.GetDeltaTime();
+
+	const float fSamples = float(iFrames) * 2 * iSounds * iPasses;
+	LOG->Info( "%-8s mix+int16: %.3fs (%.0f Msamples/s); split+deinterlace: %.3fs (%.0f Msamples/s)",
+		k.m_szName, fInterleaved, fSamples / fInterleaved / 1e6f, fSplit, fSamples / fSplit / 1e6f );
+}
+
+int main( int argc, char *argv[] )
+{
+	test_handle_args( argc, argv );
+	test_init();
+
+	std::vector<const RageSoundMixKernels *> vKernels;
+	RageSoundMixKernels::GetAvailable( vKernels );
+
+	bool bOK = true;
+	for( const RageSoundMixKernels *k : vKernels )
+		bOK &= Check( *k, *vKernels[0] );
+	LOG->Info( "%s", bOK? "All kernels match the scalar versions.":"Kernel mismatches found." );
+
+	for( const RageSoundMixKernels *k : vKernels )
+		Benchmark( *k );
+
+	test_deinit();
+	exit( bOK? 0:1 );
+}
@@ -138,6 +138,117 @@ LOG->Trace("... %i in %f", q, foobar.GetDeltaTime());
 	CHECK( test2.GetElapsedTimeFromBeat(2), 3.0f );
 }
 
+/* Lookups through a cursor have to agree with lookups without one, whichever
+ * order they come in. */
+void run_cursors()
+{
+	TimingData test;
+	test.AddSegment( BPMSegment(0, 150) );
+	for( int i = 1; i < 2000; ++i )
+	{
+		const int iRow = i * ROWS_PER_BEAT;
+		switch( i % 5 )
+		{
+		case 0: test.AddSegment( StopSegment(iRow, 0.25f) ); break;
+		case 1: test.AddSegment( BPMSegment(iRow, 120 + (i % 7) * 10) ); break;
+		case 2: test.AddSegment( WarpSegment(iRow, 0.5f) ); break;
+		case 3: test.AddSegment( DelaySegment(iRow, 0.1f) ); break;
+		}
+	}
+	test.PrepareLookup();
+
+	TimingData::LookupCursor beat_cursor, time_cursor;
+	RageTimer timer;
+	for( int pass = 0; pass < 2; ++pass )
+	{
+		for( float f = 0; f < 2000; f += 0.05f )
+		{
+			// Step back now and then, as a rewind would.
+			const float fBeat = (pass == 1 && int(f*20) % 97 == 0)? f/2: f;
+
+			TimingData::GetBeatArgs plain, cursor;
+			plain.elapsed_time = cursor.elapsed_time = fBeat;
+			test.GetBeatAndBPSFromElapsedTimeNoOffset( plain );
+			test.GetBeatAndBPSFromElapsedTimeNoOffset( cursor, beat_cursor );
+			if( plain.beat != cursor.beat || plain.bps_out != cursor.bps_out ||
+				plain.freeze_out != cursor.freeze_out || plain.delay_out != cursor.delay_out )
+			{
+				LOG->Warn( "Beat at %f: got %f, expected %f", fBeat, cursor.beat, plain.beat );
+				return;
+			}
+
+			const float fPlain = test.GetElapsedTimeFromBeatNoOffset( fBeat );
+			const float fCursor = test.GetElapsedTimeFromBeatNoOffset( fBeat, time_cursor );
+			if( fPlain != fCursor )
+			{
+				LOG->Warn( "Time at beat %f: got %f, expected %f", fBeat, fCursor, fPlain );
+				return;
+			}
+		}
+	}
+	LOG->Trace( "Cursor lookups checked in %f", timer.GetDeltaTime() );
+
+	// A batch has to agree too, including when it steps back.
+	std::vector<float> beats, times;
+	for( float f = 0; f < 2000; f += 0.05f )
+		beats.push_back( int(f*20) % 97 == 0? f/2: f );
+	test.GetElapsedTimesFromBeats( beats, times );
+	for( std::size_t i = 0; i < beats.size(); ++i )
+	{
+		const float fPlain = test.GetElapsedTimeFromBeat( beats[i] );
+		if( fPlain != times[i] )
+		{
+			LOG->Warn( "Batched time at beat %f: got %f, expected %f", beats[i], times[i], fPlain );
+			return;
+		}
+	}
+	test.ReleaseLookup();
+}
+
+/* Player keeps note times for judging and rebuilds them when the revision
+ * changes.  Editing the BPM mid-song, as the sync overlay does, has to change
+ * it, and the times worked out again have to judge a step on the new beat as
+ * dead on. */
+void run_revisions()
+{
+	TimingData test;
+	test.AddSegment( BPMSegment(0, 60) );
+	test.AddSegment( StopSegment(BeatToNoteRow(4), 1) );
+	test.PrepareLookup();
+
+	TimingData::LookupCursor cursor;
+	const float fNoteBeat = 8;
+	const float fOldSeconds = test.GetElapsedTimeFromBeatNoOffset( fNoteBeat, cursor );
+	const unsigned int iRevision = test.GetRevision();
+
+	// The sync overlay releases the lookups before it edits the segment.
+	test.ReleaseLookup();
+	BPMSegment *seg = test.GetBPMSegmentAtBeat( 0 );
+	seg->SetBPS( seg->GetBPS() * 2 );
+	test.SegmentsChanged();
+	if( test.GetRevision() == iRevision )
+	{
+		LOG->Warn( "Revision didn't change after editing a BPM" );
+		return;
+	}
+
+	// A step right on the note, by the new tempo.
+	const float fStepSeconds = fNoteBeat / 2 + 1;
+	const float fNewSeconds = test.GetElapsedTimeFromBeatNoOffset( fNoteBeat, cursor );
+	if( fNewSeconds - fStepSeconds != 0 || fOldSeconds - fStepSeconds == 0 )
+	{
+		LOG->Warn( "Judged offset after a BPM change: got %f, expected 0 (was %f)",
+			fNewSeconds - fStepSeconds, fOldSeconds - fStepSeconds );
+		return;
+	}
+
+	// Autosync adds segments instead.
+	const unsigned int iEditedRevision = test.GetRevision();
+	test.AddSegment( StopSegment(BeatToNoteRow(4), 0.5f) );
+	if( test.GetRevision() == iEditedRevision )
+		LOG->Warn( "Revision didn't change after adding a segment" );
+}
+
 int main( int argc, char *argv[] )
 {
 	FILEMAN			= new RageFileManager( argv[0] );
@@ -148,6 +259,8 @@ int main( int argc, char *argv[] )
 	LOG->SetFlushing( true );
 
 	run();
+	run_cursors();
+	run_revisions();
 
 	delete PREFSMAN;
 	delete LOG;